@@ -0,0 +1,500 @@
+#include "MeshFiles.h"
+#include "PerfCounters.h"
+
+#include <ClosestPointQuery.h>
+#include <QueryTrace.h>
+#include <Tracing.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+using namespace cpom;
+
+namespace {
+
+/// Number of calls to the global operator new, replaced below.
+std::atomic<std::size_t> allocationCount(0);
+
+} // anonymous namespace
+
+void *operator new(std::size_t size)
+{
+    ++allocationCount;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+/// \file
+/// Benchmark of cpom::ClosestPointQuery reporting build cost, memory and query throughput.
+///
+/// Usage: cpom_bench [--resolution R] [--queries N] [--far-queries N] [--seed S]
+///                   [--index octree|bvh4|bvh8] [--subdivision fill|area|volume]
+///                   [--shuffle] [--no-reorder] [--arena]
+///                   [--huge-pages] [--prefetch D] [--batch] [--triangles] [--planar-quads]
+///                   [--proxies] [--record PREFIX] [--trace FILE]
+///
+/// Hardware counters are reported per query and per face tested where perf_event_open
+/// allows it, see cpom::PerfCounters.
+///
+/// With --record, the mesh is written to PREFIX.mesh and the queries to PREFIX.trace,
+/// to be replayed by cpom_replay. With --trace, spans of the build and of batch queries
+/// are written to FILE as Chrome trace-event JSON, if cpom was built with tracing.
+
+constexpr float infinity(std::numeric_limits<float>::infinity());
+
+/// \brief Plane mesh of R*R quad faces, tilted along y=z like StubDensePlaneMesh in the unit tests.
+///
+/// Faces and vertices are listed row by row, or in a random order when shuffled
+/// to mimic meshes whose order has no spatial coherence. Quads are split in two
+/// triangles when requested, to mimic scanned meshes.
+class DensePlaneMesh : public Mesh
+{
+public:
+    DensePlaneMesh(int resolution, bool shuffle, bool triangulate, unsigned seed)
+    : m_resolution(resolution),
+      m_shuffle(shuffle),
+      m_triangulate(triangulate),
+      m_vertexOrder((resolution+1) * (resolution+1)),
+      m_seed(seed)
+    {
+        for (std::size_t i = 0; i < m_vertexOrder.size(); ++i)
+            m_vertexOrder[i] = static_cast<int>(i);
+        if (m_shuffle)
+        {
+            std::mt19937 generator(seed);
+            std::shuffle(m_vertexOrder.begin(), m_vertexOrder.end(), generator);
+        }
+    }
+
+    virtual std::vector<Point> getVertices() const
+    {
+        const int R = m_resolution;
+        std::vector<Point> vertices( (R+1) * (R+1) );
+        const float stepSize = 1.0f / (float) R;
+        for (int y = 0; y <= R; ++y)
+        {
+            for (int x = 0; x <= R; ++x)
+            {
+                vertices[vertexIndex(x, y)] = Point(x, y, y) * stepSize;
+            }
+        }
+        return vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        const int R = m_resolution;
+        std::vector<Face> faces;
+        faces.reserve( m_triangulate ? 2 * R * R : R * R );
+        for (int y = 0; y < R; ++y)
+        {
+            for (int x = 0; x < R; ++x)
+            {
+                if (m_triangulate)
+                {
+                    faces.push_back({{ vertexIndex(x,   y),
+                                       vertexIndex(x+1, y),
+                                       vertexIndex(x+1, y+1) }});
+                    faces.push_back({{ vertexIndex(x+1, y+1),
+                                       vertexIndex(x,   y+1),
+                                       vertexIndex(x,   y) }});
+                }
+                else
+                {
+                    faces.push_back({{ vertexIndex(x,   y),
+                                       vertexIndex(x+1, y),
+                                       vertexIndex(x+1, y+1),
+                                       vertexIndex(x,   y+1) }});
+                }
+            }
+        }
+        if (m_shuffle)
+        {
+            std::mt19937 generator(m_seed + 1);
+            std::shuffle(faces.begin(), faces.end(), generator);
+        }
+        return faces;
+    }
+
+private:
+    int vertexIndex(int x, int y) const
+    {
+        return m_vertexOrder[x + y * (m_resolution+1)];
+    }
+
+    int m_resolution;
+    bool m_shuffle;
+    bool m_triangulate;
+    std::vector<int> m_vertexOrder;
+    unsigned m_seed;
+};
+
+/// \brief Return the memory in use by the process in bytes, or 0 when unknown.
+///
+/// With glibc, this is the number of bytes allocated on the heap, otherwise
+/// the resident memory, which is less accurate since freed memory is not
+/// necessarily returned to the system.
+std::size_t getMemoryInUse()
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    const auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    std::size_t totalPages = 0;
+    std::size_t residentPages = 0;
+    if (statm >> totalPages >> residentPages)
+    {
+        return residentPages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+/// Return the memory of the process backed by huge pages in bytes, or 0 when unknown.
+std::size_t getHugePageMemory()
+{
+    std::size_t total = 0;
+#if defined(__linux__)
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string key;
+    std::size_t kiloBytes = 0;
+    std::string unit;
+    while (smaps >> key)
+    {
+        if (key == "AnonHugePages:" || key == "Private_Hugetlb:" || key == "Shared_Hugetlb:")
+        {
+            if (smaps >> kiloBytes >> unit)
+                total += kiloBytes * 1024;
+        }
+        else
+        {
+            smaps.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+    }
+#endif
+    return total;
+}
+
+/// Return the name of an octree subdivision.
+const char *subdivisionName(const OctreeSubdivision subdivision)
+{
+    switch (subdivision)
+    {
+    case OctreeSubdivision::Fill: return "fill";
+    case OctreeSubdivision::SurfaceAreaCost: return "area";
+    case OctreeSubdivision::VolumeCost: return "volume";
+    }
+    return "unknown";
+}
+
+/// Return the name of an index type.
+const char *indexTypeName(const IndexType indexType)
+{
+    switch (indexType)
+    {
+    case IndexType::Octree: return "octree";
+    case IndexType::WideBvh4: return "bvh4";
+    case IndexType::WideBvh8: return "bvh8";
+    }
+    return "unknown";
+}
+
+/// Print the hardware counts of a phase, divided by a number of items of each kind.
+void printCounters(const PerfCounters &counters, const double queryCount,
+                   const double faceCount)
+{
+    if (!counters.isAvailable())
+        return;
+    const auto print = [&counters](PerfCounters::Event event, const char *name,
+                                   double count, const char *separator)
+    {
+        std::cout << separator;
+        if (counters.has(event))
+            std::cout << counters.get(event) / count << " " << name;
+        else
+            std::cout << "n/a " << name;
+    };
+    std::cout << std::setw(15) << "  counters:";
+    const char *perItem = queryCount > 0.0 ? "per query: " : "total: ";
+    const double itemCount = queryCount > 0.0 ? queryCount : 1.0;
+    print(PerfCounters::Cycles, "cycles", itemCount, perItem);
+    print(PerfCounters::Instructions, "instructions", itemCount, ", ");
+    if (counters.has(PerfCounters::Cycles) && counters.has(PerfCounters::Instructions) &&
+        counters.get(PerfCounters::Cycles) > 0.0)
+    {
+        std::cout << " (IPC " << counters.get(PerfCounters::Instructions) /
+                                 counters.get(PerfCounters::Cycles) << ")";
+    }
+    print(PerfCounters::CacheMisses, "cache misses", itemCount, ", ");
+    print(PerfCounters::L1DataMisses, "L1D misses", itemCount, ", ");
+    print(PerfCounters::BranchMisses, "branch misses", itemCount, ", ");
+    if (faceCount > 0.0)
+    {
+        print(PerfCounters::Cycles, "cycles", faceCount, "; per face: ");
+        print(PerfCounters::CacheMisses, "cache misses", faceCount, ", ");
+        print(PerfCounters::BranchMisses, "branch misses", faceCount, ", ");
+    }
+    std::cout << std::endl;
+}
+
+/// \brief Evaluate the query on all points, one by one or in a batch, and report
+/// throughput and hardware counts.
+///
+/// The nodes visited and faces tested are counted by a second batch, not measured.
+void runQueries(const char *name,
+                const ClosestPointQuery &query,
+                const std::vector<Point> &queryPoints,
+                const bool isBatch,
+                PerfCounters &counters)
+{
+    Point checksum(0.0f);
+    std::vector<ClosestPointQuery::Result> results(queryPoints.size());
+    const std::size_t allocationsBefore = allocationCount;
+    counters.start();
+    const auto start = std::chrono::steady_clock::now();
+    if (isBatch)
+    {
+        query.find(queryPoints.data(), queryPoints.size(), infinity, results.data());
+        for (const auto &result: results)
+            checksum = checksum + result.point;
+    }
+    else
+    {
+        for (const auto &queryPoint: queryPoints)
+            checksum = checksum + query(queryPoint, infinity);
+    }
+    const double seconds = secondsSince(start);
+    counters.stop();
+    const std::size_t allocations = allocationCount - allocationsBefore;
+    // Count on the same index, without recording the calls of the original query.
+    ClosestPointQuery::Statistics statistics;
+    const ClosestPointQuery countingQuery(query.getIndex());
+    countingQuery.find(queryPoints.data(), queryPoints.size(), infinity, results.data(),
+                       statistics);
+
+    std::cout << std::left << std::setw(15) << name
+              << queryPoints.size() << " queries in " << seconds << " s ("
+              << queryPoints.size() / seconds << " queries/s, "
+              << 1e9 * seconds / queryPoints.size() << " ns/query, "
+              << allocations / double(queryPoints.size()) << " allocations/query)"
+              << " checksum " << checksum << std::endl;
+    const double queryCount = static_cast<double>(queryPoints.size());
+    std::cout << std::setw(15) << "  search:"
+              << statistics.nodeCount / queryCount << " nodes/query, "
+              << statistics.faceCount / queryCount << " faces tested/query" << std::endl;
+    printCounters(counters, queryCount, static_cast<double>(statistics.faceCount));
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    int resolution = 1000;
+    int queryCount = 100000;
+    int farQueryCount = 1000;
+    unsigned seed = 1;
+    bool shuffle = false;
+    bool triangulate = false;
+    bool useArena = false;
+    bool isBatch = false;
+    const char *recordPrefix = nullptr;
+    const char *tracePath = nullptr;
+    std::ofstream traceFile; // Outlives the recorder of the query options.
+    BuildOptions options;
+    QueryOptions queryOptions;
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i+1 < argc;
+        if (!std::strcmp(argv[i], "--resolution") && hasValue)
+            resolution = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--queries") && hasValue)
+            queryCount = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--far-queries") && hasValue)
+            farQueryCount = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--seed") && hasValue)
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--index") && hasValue && parseIndexType(argv[i+1], options))
+            ++i;
+        else if (!std::strcmp(argv[i], "--subdivision") && hasValue &&
+                 parseSubdivision(argv[i+1], options))
+            ++i;
+        else if (!std::strcmp(argv[i], "--shuffle"))
+            shuffle = true;
+        else if (!std::strcmp(argv[i], "--no-reorder"))
+            options.reorderForLocality = false;
+        else if (!std::strcmp(argv[i], "--arena"))
+            useArena = true;
+        else if (!std::strcmp(argv[i], "--huge-pages"))
+            options.useHugePages = true;
+        else if (!std::strcmp(argv[i], "--prefetch") && hasValue)
+            queryOptions.prefetchDistance = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--batch"))
+            isBatch = true;
+        else if (!std::strcmp(argv[i], "--triangles"))
+            triangulate = true;
+        else if (!std::strcmp(argv[i], "--planar-quads"))
+            options.planarQuadTolerance = 1e-5f;
+        else if (!std::strcmp(argv[i], "--proxies"))
+            options.useProxyBounds = true;
+        else if (!std::strcmp(argv[i], "--record") && hasValue)
+            recordPrefix = argv[++i];
+        else if (!std::strcmp(argv[i], "--trace") && hasValue)
+            tracePath = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--resolution R] [--queries N] [--far-queries N] [--seed S]"
+                      << " [--index octree|bvh4|bvh8] [--subdivision fill|area|volume]"
+                      << " [--shuffle] [--no-reorder] [--arena]"
+                      << " [--huge-pages] [--prefetch D] [--batch]"
+                      << " [--triangles] [--planar-quads] [--proxies] [--record PREFIX] [--trace FILE]"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    const DensePlaneMesh mesh(resolution, shuffle, triangulate, seed);
+    std::cout << std::left << std::setw(15) << "mesh:"
+              << "dense plane " << resolution << "x" << resolution
+              << " (" << (triangulate ? 2 : 1) * resolution * resolution
+              << (triangulate ? " triangles" : " quads")
+              << (shuffle ? ", shuffled" : "") << ")" << std::endl;
+    std::cout << std::setw(15) << "index:" << indexTypeName(options.indexType);
+    if (options.indexType == IndexType::Octree)
+        std::cout << ", " << subdivisionName(options.octreeSubdivision) << " subdivision";
+    std::cout << (options.reorderForLocality ? ", reordered" : "")
+              << (options.planarQuadTolerance >= 0.0f ? ", planar quads" : "")
+              << (options.useProxyBounds ? ", proxies" : "")
+              << ", prefetch distance " << queryOptions.prefetchDistance << std::endl;
+
+    // Record the mesh and the queries if requested, before measuring anything.
+    if (recordPrefix)
+    {
+        std::ofstream meshFile(std::string(recordPrefix) + ".mesh", std::ios::binary);
+        writeMesh(meshFile, mesh);
+        traceFile.open(std::string(recordPrefix) + ".trace", std::ios::binary);
+        queryOptions.traceRecorder = std::make_shared<QueryTraceRecorder>(traceFile, mesh);
+    }
+
+    // Count the allocations made by the mesh itself when the build reads it.
+    const std::size_t meshAllocationsBefore = allocationCount;
+    mesh.getVertices();
+    mesh.getFaces();
+    const std::size_t meshAllocations = allocationCount - meshAllocationsBefore;
+
+    // Allocate the index from an arena if requested, itself in huge pages if requested.
+    MonotonicBuffer indexArena(options.useHugePages ? getHugePageMemoryResource()
+                                                    : getDefaultMemoryResource());
+    if (useArena)
+        options.indexMemoryResource = &indexArena;
+
+    // Build.
+    const std::size_t memoryBefore = getMemoryInUse();
+    const std::size_t hugePageMemoryBefore = getHugePageMemory();
+    const std::size_t allocationsBefore = allocationCount;
+    if (tracePath)
+    {
+        if (!isTracingAvailable())
+            std::cerr << "Tracing is not available, build with CPOM_ENABLE_TRACING" << std::endl;
+        startTracing();
+    }
+
+    PerfCounters counters;
+    if (!counters.isAvailable())
+    {
+        std::cout << std::setw(15) << "counters:" << "unavailable ("
+                  << counters.getError() << ")" << std::endl;
+    }
+    counters.start();
+    const auto buildStart = std::chrono::steady_clock::now();
+    const ClosestPointQuery query(mesh, options, queryOptions);
+    const double buildSeconds = secondsSince(buildStart);
+    counters.stop();
+    const std::size_t buildAllocations = allocationCount - allocationsBefore;
+    const std::size_t memoryAfter = getMemoryInUse();
+    const std::size_t hugePageMemory = getHugePageMemory() - hugePageMemoryBefore;
+    std::cout << std::setw(15) << "build:" << buildSeconds << " s";
+    if (memoryBefore && memoryAfter >= memoryBefore)
+    {
+        // Huge pages are mapped outside of the heap.
+        std::cout << ", " << (memoryAfter - memoryBefore + hugePageMemory) / (1024.0 * 1024.0)
+                  << " MiB in use";
+    }
+    std::cout << ", " << buildAllocations - meshAllocations << " allocations"
+              << " (plus " << meshAllocations << " by the mesh)";
+    if (useArena)
+        std::cout << ", " << indexArena.getChunkCount() << " arena chunks";
+    if (options.useHugePages)
+        std::cout << ", " << hugePageMemory / (1024.0 * 1024.0) << " MiB in huge pages";
+    std::cout << std::endl;
+    printCounters(counters, 0.0, 0.0);
+    const MemoryFootprint footprint = query.getMemoryFootprint();
+    const double mebiByte = 1024.0 * 1024.0;
+    std::cout << std::setw(15) << "footprint:" << footprint.getTotal() / mebiByte << " MiB: "
+              << footprint.vertices / mebiByte << " vertices ("
+              << footprint.duplicatedVertices / mebiByte << " duplicated), "
+              << footprint.faces / mebiByte << " faces ("
+              << footprint.duplicatedFaces / mebiByte << " duplicated), "
+              << footprint.meshlets / mebiByte << " meshlets, "
+              << footprint.nodes / mebiByte << " nodes, "
+              << footprint.leafElements / mebiByte << " leaf elements, "
+              << footprint.proxies / mebiByte << " proxies" << std::endl;
+
+    // Queries are offset from random points of the plane along its normal:
+    // by less than a hundredth for near queries, by up to a half for far ones.
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const Point normal = Point(0.0f, -1.0f, 1.0f) / std::sqrt(2.0f);
+    const auto generatePoints = [&](int count, float minOffset, float maxOffset)
+    {
+        std::vector<Point> points(count);
+        for (auto &point: points)
+        {
+            const float x = unit(generator);
+            const float y = unit(generator);
+            const float offset = minOffset + (maxOffset-minOffset) * unit(generator);
+            point = Point(x, y, y) + normal * offset;
+        }
+        return points;
+    };
+    const std::vector<Point> nearPoints = generatePoints(queryCount, -0.01f, 0.01f);
+    const std::vector<Point> farPoints = generatePoints(farQueryCount, 0.1f, 0.5f);
+    runQueries(isBatch ? "near batch:" : "near queries:", query, nearPoints, isBatch, counters);
+    runQueries(isBatch ? "far batch:" : "far queries:", query, farPoints, isBatch, counters);
+
+    if (tracePath)
+    {
+        stopTracing();
+        std::ofstream traceEvents(tracePath);
+        writeTraceEvents(traceEvents);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+#include "MeshFiles.h"
+
+#include <ClosestPointQuery.h>
+#include <IndexLayout.h>
+#include <QueryTrace.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Inspection of the spatial index built on a mesh, to diagnose meshes slow to query.
+/// Prints the node count of each level, histograms of leaf depth, leaf fill and face
+/// duplication, and the fullest leaves with their bounds.
+///
+/// Usage: cpom_inspect MESH [--index octree|bvh4|bvh8] [--subdivision fill|area|volume]
+///                     [--limit] [--no-reorder] [--leaves N] [--obj FILE]
+///
+/// MESH is a Wavefront OBJ file, or a mesh written by cpom::writeMesh(). With --obj,
+/// the boxes of all leaves are written to FILE, to be viewed next to the mesh.
+
+/// \brief Histogram of values binned by powers of two.
+///
+/// Bin 0 holds the value 0, bin i > 0 the values in [2^(i-1), 2^i).
+class Histogram
+{
+public:
+    void add(std::size_t value, std::size_t weight = 1)
+    {
+        std::size_t bin = 0;
+        while (value >> bin)
+            ++bin;
+        if (m_counts.size() <= bin)
+        {
+            m_counts.resize(bin + 1, 0);
+            m_weights.resize(bin + 1, 0);
+        }
+        ++m_counts[bin];
+        m_weights[bin] += weight;
+    }
+
+    /// Print the count, and the total weight, of each non empty bin.
+    void print(const char *title, const char *weightName) const
+    {
+        std::cout << title << std::endl;
+        for (std::size_t bin = 0; bin < m_counts.size(); ++bin)
+        {
+            if (m_counts[bin] == 0)
+                continue;
+            std::ostringstream range;
+            if (bin <= 1)
+                range << bin;
+            else
+                range << (std::size_t(1) << (bin - 1)) << "-" << (std::size_t(1) << bin) - 1;
+            std::cout << "  " << std::right << std::setw(13) << range.str() << ": "
+                      << std::setw(10) << m_counts[bin];
+            if (weightName)
+                std::cout << "  (" << m_weights[bin] << " " << weightName << ")";
+            std::cout << std::left << std::endl;
+        }
+    }
+
+private:
+    std::vector<std::size_t> m_counts;
+    std::vector<std::size_t> m_weights;
+};
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    const char *meshPath = nullptr;
+    const char *objPath = nullptr;
+    std::size_t listedLeafCount = 10;
+    BuildOptions options;
+    bool isValid = true;
+    for (int i = 1; i < argc && isValid; ++i)
+    {
+        const bool hasValue = i+1 < argc;
+        if (!std::strcmp(argv[i], "--index") && hasValue && parseIndexType(argv[i+1], options))
+            ++i;
+        else if (!std::strcmp(argv[i], "--subdivision") && hasValue &&
+                 parseSubdivision(argv[i+1], options))
+            ++i;
+        else if (!std::strcmp(argv[i], "--limit"))
+            options.surfaceType = SurfaceType::CatmullClarkLimit;
+        else if (!std::strcmp(argv[i], "--no-reorder"))
+            options.reorderForLocality = false;
+        else if (!std::strcmp(argv[i], "--leaves") && hasValue)
+            listedLeafCount = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--obj") && hasValue)
+            objPath = argv[++i];
+        else if (argv[i][0] != '-' && !meshPath)
+            meshPath = argv[i];
+        else
+            isValid = false;
+    }
+    if (!isValid || !meshPath)
+    {
+        std::cerr << "Usage: " << argv[0] << " MESH"
+                  << " [--index octree|bvh4|bvh8] [--subdivision fill|area|volume]"
+                  << " [--limit] [--no-reorder]"
+                  << " [--leaves N] [--obj FILE]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    MeshData mesh;
+    IndexLayout layout;
+    MemoryFootprint footprint;
+    try
+    {
+        mesh = readMeshFile(meshPath);
+        const MeshIndex index(mesh, options);
+        layout = index.getLayout();
+        footprint = index.getMemoryFootprint();
+        if (objPath)
+        {
+            std::ofstream objFile(objPath);
+            writeLeafBoxes(objFile, layout);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::size_t nodeCount = 0;
+    for (const std::size_t levelNodeCount : layout.levelNodeCounts)
+        nodeCount += levelNodeCount;
+    std::size_t storedFaceCount = 0;
+    for (const IndexLeaf &leaf : layout.leaves)
+        storedFaceCount += leaf.faceCount;
+    const double mebiByte = 1024.0 * 1024.0;
+    std::cout << std::left << std::setw(15) << "mesh:"
+              << mesh.vertices.size() << " vertices, " << mesh.faces.size() << " faces"
+              << std::endl;
+    std::cout << std::setw(15) << "index:"
+              << nodeCount << " nodes, " << layout.leaves.size() << " leaves, "
+              << storedFaceCount << " faces stored ("
+              << (mesh.faces.empty() ? 0.0 : double(storedFaceCount) / mesh.faces.size())
+              << " per face), " << footprint.getTotal() / mebiByte << " MiB" << std::endl;
+    if (layout.leaves.empty())
+    {
+        std::cout << "Faces are processed in order, without index" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::cout << "Nodes per level:" << std::endl;
+    for (std::size_t depth = 0; depth < layout.levelNodeCounts.size(); ++depth)
+    {
+        std::cout << "  " << std::right << std::setw(13) << depth << ": "
+                  << std::setw(10) << layout.levelNodeCounts[depth] << std::left << std::endl;
+    }
+
+    std::vector<std::size_t> depthLeafCounts(layout.levelNodeCounts.size(), 0);
+    std::vector<std::size_t> depthFaceCounts(layout.levelNodeCounts.size(), 0);
+    Histogram fill;
+    for (const IndexLeaf &leaf : layout.leaves)
+    {
+        ++depthLeafCounts[leaf.depth];
+        depthFaceCounts[leaf.depth] += leaf.faceCount;
+        fill.add(leaf.faceCount, leaf.faceCount);
+    }
+    std::cout << "Leaves per depth:" << std::endl;
+    for (std::size_t depth = 0; depth < depthLeafCounts.size(); ++depth)
+    {
+        if (depthLeafCounts[depth] == 0)
+            continue;
+        std::cout << "  " << std::right << std::setw(13) << depth << ": "
+                  << std::setw(10) << depthLeafCounts[depth] << "  ("
+                  << depthFaceCounts[depth] << " faces)"
+                  << (layout.maxDepth > 0 && depth == layout.maxDepth ? ", at the maximal depth" : "")
+                  << std::left << std::endl;
+    }
+    fill.print("Leaves per face count:", "faces");
+
+    Histogram duplication;
+    for (const std::uint32_t faceLeafCount : layout.faceLeafCounts)
+        duplication.add(faceLeafCount);
+    duplication.print("Faces per number of leaves storing them:", nullptr);
+
+    // List the fullest leaves, those costing the most to the queries reaching them.
+    std::vector<std::size_t> order(layout.leaves.size());
+    for (std::size_t l = 0; l < order.size(); ++l)
+        order[l] = l;
+    listedLeafCount = std::min(listedLeafCount, order.size());
+    std::partial_sort(order.begin(), order.begin() + listedLeafCount, order.end(),
+        [&layout](std::size_t a, std::size_t b)
+        {
+            return layout.leaves[a].faceCount > layout.leaves[b].faceCount;
+        });
+    if (listedLeafCount > 0)
+        std::cout << "Fullest leaves:" << std::endl;
+    for (std::size_t i = 0; i < listedLeafCount; ++i)
+    {
+        const IndexLeaf &leaf = layout.leaves[order[i]];
+        std::cout << "  leaf " << order[i] << ": " << leaf.faceCount << " faces, "
+                  << leaf.meshletCount << " meshlets, depth " << leaf.depth
+                  << ", bounds (" << leaf.min.x << ", " << leaf.min.y << ", " << leaf.min.z
+                  << ") - (" << leaf.max.x << ", " << leaf.max.y << ", " << leaf.max.z
+                  << ")" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#ifndef __MESHFILES_H__
+#define __MESHFILES_H__
+
+#include <BuildOptions.h>
+#include <QueryTrace.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace cpom
+{
+
+/// \brief Read the vertices and faces of a Wavefront OBJ file.
+///
+/// Texture coordinates and normals of face vertices are ignored, other statements
+/// are skipped.
+///
+/// \throw std::invalid_argument in the case a face references a missing vertex.
+///
+inline MeshData readObj(std::istream &in)
+{
+    MeshData mesh;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream statement(line);
+        std::string keyword;
+        statement >> keyword;
+        if (keyword == "v")
+        {
+            Point vertex;
+            statement >> vertex.x >> vertex.y >> vertex.z;
+            mesh.vertices.push_back(vertex);
+        }
+        else if (keyword == "f")
+        {
+            Face face;
+            std::string reference;
+            while (statement >> reference)
+            {
+                // Negative indices count back from the last vertex read.
+                const long index = std::strtol(reference.c_str(), nullptr, 10);
+                const long vertexCount = static_cast<long>(mesh.vertices.size());
+                const long vertexId = index < 0 ? vertexCount + index : index - 1;
+                if (index == 0 || vertexId < 0 || vertexId >= vertexCount)
+                    throw std::invalid_argument("Vertex id out of range: " + line);
+                face.vertexIds.push_back(static_cast<int>(vertexId));
+            }
+            mesh.faces.push_back(face);
+        }
+    }
+    return mesh;
+}
+
+/// Return true if a path ends with a given suffix, ignoring case.
+inline bool hasSuffix(const std::string &path, const std::string &suffix)
+{
+    if (path.size() < suffix.size())
+        return false;
+    return std::equal(suffix.begin(), suffix.end(), path.end() - suffix.size(),
+                      [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+/// \brief Read a Wavefront OBJ mesh, or a mesh written by writeMesh(), depending on
+/// the extension of its path.
+///
+/// \throw std::invalid_argument in the case the file cannot be read.
+///
+inline MeshData readMeshFile(const std::string &path)
+{
+    std::ifstream meshFile(path, std::ios::binary);
+    if (!meshFile)
+        throw std::invalid_argument("Cannot open mesh " + path);
+    return hasSuffix(path, ".obj") ? readObj(meshFile) : readMesh(meshFile);
+}
+
+/// Set the index type of the build options from its name, return false if unknown.
+inline bool parseIndexType(const char *name, BuildOptions &options)
+{
+    if (!std::strcmp(name, "octree"))
+        options.indexType = IndexType::Octree;
+    else if (!std::strcmp(name, "bvh4"))
+        options.indexType = IndexType::WideBvh4;
+    else if (!std::strcmp(name, "bvh8"))
+        options.indexType = IndexType::WideBvh8;
+    else
+        return false;
+    return true;
+}
+
+/// Set the octree subdivision of the build options from its name, return false if unknown.
+inline bool parseSubdivision(const char *name, BuildOptions &options)
+{
+    if (!std::strcmp(name, "fill"))
+        options.octreeSubdivision = OctreeSubdivision::Fill;
+    else if (!std::strcmp(name, "area"))
+        options.octreeSubdivision = OctreeSubdivision::SurfaceAreaCost;
+    else if (!std::strcmp(name, "volume"))
+        options.octreeSubdivision = OctreeSubdivision::VolumeCost;
+    else
+        return false;
+    return true;
+}
+
+/// Return the seconds elapsed since a given time point.
+inline double secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+} // namespace cpom
+
+#endif // __MESHFILES_H__
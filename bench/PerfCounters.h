@@ -0,0 +1,161 @@
+#ifndef __PERFCOUNTERS_H__
+#define __PERFCOUNTERS_H__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cpom
+{
+
+/// \brief Hardware performance counters of the calling process, read around measured phases.
+///
+/// On Linux, counters are opened with perf_event_open, counting user space only so
+/// that the default perf_event_paranoid setting allows them, and including threads
+/// created while counting. Counters the kernel or the hardware do not provide are
+/// reported as unavailable, as are all counters on other systems.
+class PerfCounters
+{
+public:
+    /// Events counted.
+    enum Event
+    {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        BranchMisses,
+        L1DataMisses,
+        eventCount
+    };
+
+    PerfCounters()
+    {
+        for (int event = 0; event < eventCount; ++event)
+        {
+            m_fds[event] = -1;
+            m_values[event] = 0.0;
+        }
+#if defined(__linux__)
+        const std::uint32_t types[eventCount] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                  PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                  PERF_TYPE_HW_CACHE };
+        const std::uint64_t configs[eventCount] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) };
+        for (int event = 0; event < eventCount; ++event)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[event];
+            attr.config = configs[event];
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            m_fds[event] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (m_fds[event] < 0 && m_error.empty())
+                m_error = std::strerror(errno);
+        }
+#else
+        m_error = "not supported on this system";
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#if defined(__linux__)
+        for (int event = 0; event < eventCount; ++event)
+        {
+            if (m_fds[event] >= 0)
+                close(m_fds[event]);
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters &operator=(const PerfCounters&) = delete;
+
+    /// Return true if at least one event is counted.
+    bool isAvailable() const
+    {
+        for (int event = 0; event < eventCount; ++event)
+        {
+            if (has(static_cast<Event>(event)))
+                return true;
+        }
+        return false;
+    }
+
+    /// Return the reason why the first unavailable event is not counted, empty if all are.
+    const std::string &getError() const { return m_error; }
+
+    /// Return true if an event is counted.
+    bool has(Event event) const { return m_fds[event] >= 0; }
+
+    /// Return the count of an event during the last phase measured, 0 if not counted.
+    double get(Event event) const { return m_values[event]; }
+
+    /// Reset and start counting.
+    void start()
+    {
+#if defined(__linux__)
+        for (int event = 0; event < eventCount; ++event)
+        {
+            if (m_fds[event] >= 0)
+            {
+                ioctl(m_fds[event], PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_fds[event], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /// \brief Stop counting and read the counts.
+    ///
+    /// Counts are scaled when the kernel multiplexed the counters, having counted
+    /// events only for part of the phase.
+    void stop()
+    {
+#if defined(__linux__)
+        for (int event = 0; event < eventCount; ++event)
+        {
+            if (m_fds[event] >= 0)
+                ioctl(m_fds[event], PERF_EVENT_IOC_DISABLE, 0);
+        }
+        for (int event = 0; event < eventCount; ++event)
+        {
+            m_values[event] = 0.0;
+            std::uint64_t data[3];
+            if (m_fds[event] < 0 || read(m_fds[event], data, sizeof(data)) != sizeof(data))
+                continue;
+            const std::uint64_t enabled = data[1];
+            const std::uint64_t running = data[2];
+            if (running > 0)
+                m_values[event] = static_cast<double>(data[0]) * enabled / running;
+        }
+#endif
+    }
+
+private:
+    int m_fds[eventCount];
+    double m_values[eventCount];
+    std::string m_error;
+};
+
+} // namespace cpom
+
+#endif // __PERFCOUNTERS_H__
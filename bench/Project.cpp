@@ -0,0 +1,608 @@
+#include "MeshFiles.h"
+
+#include <ClosestPointQuery.h>
+#include <QueryTrace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Projection of a file of points onto a mesh, writing the closest points, their
+/// distances and face ids. Points are processed by chunks in a pipeline: while a
+/// chunk is projected by all threads, the next one is read and the previous one is
+/// written, so that the input and output of large files overlap the queries.
+///
+/// Usage: cpom_project MESH POINTS OUTPUT [--chunk N] [--threads N] [--max-dist D]
+///                     [--index octree|bvh4|bvh8] [--proxies]
+///
+/// MESH is a Wavefront OBJ file, or a mesh written by cpom::writeMesh(). POINTS is a
+/// CSV file of x,y,z lines, a PLY file whose first element is the vertices, in ASCII
+/// or binary little endian, or otherwise a raw file of float x,y,z in host byte
+/// order. OUTPUT is a CSV file of x,y,z,distance,face_id lines if its extension is
+/// .csv, otherwise a raw file of records of float x,y,z,distance and int32 face id,
+/// in host byte order. Points farther than the maximum distance have NaN closest
+/// points, an infinite distance and face id -1. Their searches stop at the index
+/// nodes beyond 4 times the maximum distance.
+
+constexpr float infinity(std::numeric_limits<float>::infinity());
+
+/// Number of chunks in flight: one read, one projected and one written.
+constexpr int chunkCount = 3;
+
+static_assert(sizeof(Point) == 3 * sizeof(float), "Points are read as packed floats");
+
+/// Return true if the host stores numbers in little endian byte order.
+bool isLittleEndian()
+{
+    const std::uint16_t one = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &one, 1);
+    return firstByte == 1;
+}
+
+/// Source of points, read by chunks.
+class PointReader
+{
+public:
+    virtual ~PointReader() = default;
+
+    /// \brief Read up to maxCount points, return the number read, 0 at the end of input.
+    ///
+    /// \throw std::invalid_argument in the case the input is malformed.
+    ///
+    virtual std::size_t read(Point *points, std::size_t maxCount) = 0;
+};
+
+/// Reader of raw float x,y,z triplets in host byte order.
+class RawPointReader : public PointReader
+{
+public:
+    explicit RawPointReader(std::istream &in)
+    : m_in(in)
+    { }
+
+    std::size_t read(Point *points, std::size_t maxCount) override
+    {
+        m_in.read(reinterpret_cast<char *>(points),
+                  static_cast<std::streamsize>(maxCount * sizeof(Point)));
+        const auto byteCount = static_cast<std::size_t>(m_in.gcount());
+        if (byteCount % sizeof(Point) != 0)
+            throw std::invalid_argument("Truncated point at the end of the input");
+        return byteCount / sizeof(Point);
+    }
+
+private:
+    std::istream &m_in;
+};
+
+/// \brief Reader of CSV lines of x,y,z coordinates.
+///
+/// Values may be separated by commas, semicolons or blanks, and may be followed
+/// by other columns. Empty lines, and lines not starting with a number, such as
+/// headers, are skipped.
+class CsvPointReader : public PointReader
+{
+public:
+    explicit CsvPointReader(std::istream &in)
+    : m_in(in),
+      m_lineNumber(0)
+    { }
+
+    std::size_t read(Point *points, std::size_t maxCount) override
+    {
+        std::size_t count = 0;
+        while (count < maxCount && std::getline(m_in, m_line))
+        {
+            ++m_lineNumber;
+            const char *cursor = m_line.c_str();
+            float coordinates[3];
+            int coordinateCount = 0;
+            while (coordinateCount < 3)
+            {
+                cursor += std::strspn(cursor, ",; \t\r");
+                char *end = nullptr;
+                coordinates[coordinateCount] = std::strtof(cursor, &end);
+                if (end == cursor)
+                    break;
+                cursor = end;
+                ++coordinateCount;
+            }
+            if (coordinateCount == 0)
+                continue;
+            if (coordinateCount < 3)
+            {
+                throw std::invalid_argument("Expected 3 coordinates at line " +
+                                            std::to_string(m_lineNumber));
+            }
+            points[count++] = Point(coordinates[0], coordinates[1], coordinates[2]);
+        }
+        return count;
+    }
+
+private:
+    std::istream &m_in;
+    std::string m_line;
+    std::size_t m_lineNumber;
+};
+
+/// \brief Reader of the vertices of a PLY file, in ASCII or binary little endian.
+///
+/// Vertices must be the first element of the file. Their x, y and z properties
+/// may be stored as float or double, other properties are skipped, and elements
+/// after the vertices are ignored.
+class PlyPointReader : public PointReader
+{
+public:
+    /// \brief Read the header of a PLY file.
+    ///
+    /// \throw std::invalid_argument in the case the header is malformed or unsupported.
+    ///
+    explicit PlyPointReader(std::istream &in)
+    : m_in(in),
+      m_isBinary(false),
+      m_remainingCount(0),
+      m_recordSize(0),
+      m_propertyCount(0)
+    {
+        std::string line;
+        if (!std::getline(in, line) || line.compare(0, 3, "ply") != 0)
+            throw std::invalid_argument("Not a PLY file");
+        bool hasFormat = false;
+        bool isInVertices = false;
+        bool hasVertices = false;
+        int coordinateCount = 0;
+        while (std::getline(in, line))
+        {
+            std::istringstream statement(line);
+            std::string keyword;
+            statement >> keyword;
+            if (keyword == "format")
+            {
+                std::string format;
+                statement >> format;
+                if (format == "binary_little_endian" && isLittleEndian())
+                    m_isBinary = true;
+                else if (format != "ascii")
+                    throw std::invalid_argument("Unsupported PLY format " + format);
+                hasFormat = true;
+            }
+            else if (keyword == "element")
+            {
+                std::string name;
+                std::size_t count = 0;
+                statement >> name >> count;
+                if (!hasVertices && name != "vertex")
+                    throw std::invalid_argument("PLY vertices must be the first element");
+                isInVertices = !hasVertices;
+                if (isInVertices)
+                    m_remainingCount = count;
+                hasVertices = true;
+            }
+            else if (keyword == "property" && isInVertices)
+            {
+                std::string type;
+                std::string name;
+                statement >> type >> name;
+                const std::size_t size = getTypeSize(type);
+                if (size == 0)
+                    throw std::invalid_argument("Unsupported PLY vertex property " + line);
+                const int axis = name == "x" ? 0 : name == "y" ? 1 : name == "z" ? 2 : -1;
+                if (axis >= 0)
+                {
+                    if (type != "float" && type != "float32" &&
+                        type != "double" && type != "float64")
+                        throw std::invalid_argument("PLY coordinates must be float or double");
+                    m_coordinates[axis] = Coordinate{ m_recordSize, m_propertyCount, size == 8 };
+                    ++coordinateCount;
+                }
+                m_recordSize += size;
+                ++m_propertyCount;
+            }
+            else if (keyword == "end_header")
+            {
+                if (!hasFormat || !hasVertices || coordinateCount != 3)
+                    throw std::invalid_argument("PLY header lacks a format or vertex coordinates");
+                return;
+            }
+        }
+        throw std::invalid_argument("PLY header is not terminated");
+    }
+
+    std::size_t read(Point *points, std::size_t maxCount) override
+    {
+        const std::size_t count = std::min(maxCount, m_remainingCount);
+        if (m_isBinary)
+            readBinary(points, count);
+        else
+            readAscii(points, count);
+        m_remainingCount -= count;
+        return count;
+    }
+
+private:
+    /// Location of a coordinate in a vertex record.
+    struct Coordinate
+    {
+        /// Offset in bytes of binary records.
+        std::size_t offset;
+        /// Index of the property in ASCII records.
+        std::size_t column;
+        bool isDouble;
+    };
+
+    /// Return the size of a scalar type of property, 0 if not a scalar type.
+    static std::size_t getTypeSize(const std::string &type)
+    {
+        if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+            return 1;
+        if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+            return 2;
+        if (type == "int" || type == "uint" || type == "int32" || type == "uint32" ||
+            type == "float" || type == "float32")
+            return 4;
+        if (type == "double" || type == "float64")
+            return 8;
+        return 0;
+    }
+
+    void readBinary(Point *points, const std::size_t count)
+    {
+        m_buffer.resize(count * m_recordSize);
+        m_in.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+        if (static_cast<std::size_t>(m_in.gcount()) != m_buffer.size())
+            throw std::invalid_argument("Truncated PLY vertices");
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const char *record = m_buffer.data() + i * m_recordSize;
+            float coordinates[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const Coordinate &coordinate = m_coordinates[axis];
+                if (coordinate.isDouble)
+                {
+                    double value;
+                    std::memcpy(&value, record + coordinate.offset, sizeof(value));
+                    coordinates[axis] = static_cast<float>(value);
+                }
+                else
+                {
+                    std::memcpy(&coordinates[axis], record + coordinate.offset, sizeof(float));
+                }
+            }
+            points[i] = Point(coordinates[0], coordinates[1], coordinates[2]);
+        }
+    }
+
+    void readAscii(Point *points, const std::size_t count)
+    {
+        std::vector<double> values(m_propertyCount);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!std::getline(m_in, m_line))
+                throw std::invalid_argument("Truncated PLY vertices");
+            const char *cursor = m_line.c_str();
+            for (double &value : values)
+            {
+                char *end = nullptr;
+                value = std::strtod(cursor, &end);
+                if (end == cursor)
+                    throw std::invalid_argument("Malformed PLY vertex: " + m_line);
+                cursor = end;
+            }
+            points[i] = Point(static_cast<float>(values[m_coordinates[0].column]),
+                              static_cast<float>(values[m_coordinates[1].column]),
+                              static_cast<float>(values[m_coordinates[2].column]));
+        }
+    }
+
+    std::istream &m_in;
+    bool m_isBinary;
+    std::size_t m_remainingCount;
+    std::size_t m_recordSize;
+    std::size_t m_propertyCount;
+    Coordinate m_coordinates[3];
+    std::vector<char> m_buffer;
+    std::string m_line;
+};
+
+/// \brief Write the results of count points, as CSV lines or raw records.
+///
+/// \throw std::invalid_argument in the case the stream fails.
+///
+void writeResults(std::ostream &out, const ClosestPointQuery::Result *results,
+                  const std::size_t count, const bool isCsv, std::vector<char> &buffer)
+{
+    if (isCsv)
+    {
+        // Each line holds at most 4 floats of 16 characters and an int of 11.
+        constexpr std::size_t maxLineSize = 4 * 17 + 12 + 1;
+        buffer.resize(count * maxLineSize + 1);
+        char *cursor = buffer.data();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const ClosestPointQuery::Result &result = results[i];
+            cursor += std::snprintf(cursor, maxLineSize + 1, "%.9g,%.9g,%.9g,%.9g,%d\n",
+                                    result.point.x, result.point.y, result.point.z,
+                                    result.distance, result.faceId);
+        }
+        out.write(buffer.data(), cursor - buffer.data());
+    }
+    else
+    {
+        constexpr std::size_t recordSize = 4 * sizeof(float) + sizeof(std::int32_t);
+        buffer.resize(count * recordSize);
+        char *cursor = buffer.data();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const ClosestPointQuery::Result &result = results[i];
+            const float values[4] = { result.point.x, result.point.y, result.point.z,
+                                      result.distance };
+            const std::int32_t faceId = result.faceId;
+            std::memcpy(cursor, values, sizeof(values));
+            std::memcpy(cursor + sizeof(values), &faceId, sizeof(faceId));
+            cursor += recordSize;
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+    if (!out)
+        throw std::invalid_argument("Cannot write results");
+}
+
+/// Type of a chunk of points and of their results, passed along the pipeline.
+struct Chunk
+{
+    std::vector<Point> points;
+    std::vector<ClosestPointQuery::Result> results;
+    std::size_t count = 0;
+};
+
+/// \brief Queue of chunks handed from a stage of the pipeline to the next.
+///
+/// A null chunk marks the end of the input.
+class ChunkQueue
+{
+public:
+    void push(Chunk *chunk)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_chunks.push_back(chunk);
+        }
+        m_isNotEmpty.notify_one();
+    }
+
+    Chunk *pop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_isNotEmpty.wait(lock, [this]() { return !m_chunks.empty(); });
+        Chunk *chunk = m_chunks.front();
+        m_chunks.pop_front();
+        return chunk;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_isNotEmpty;
+    std::deque<Chunk *> m_chunks;
+};
+
+/// Return a reader of points for a stream, in the format told by the extension of its path.
+std::unique_ptr<PointReader> createPointReader(std::istream &in, const std::string &path)
+{
+    if (hasSuffix(path, ".csv"))
+        return std::unique_ptr<PointReader>(new CsvPointReader(in));
+    if (hasSuffix(path, ".ply"))
+        return std::unique_ptr<PointReader>(new PlyPointReader(in));
+    return std::unique_ptr<PointReader>(new RawPointReader(in));
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    const char *meshPath = nullptr;
+    const char *pointsPath = nullptr;
+    const char *outputPath = nullptr;
+    std::size_t chunkSize = 1 << 20;
+    unsigned threadCount = 0;
+    float maxDist = infinity;
+    BuildOptions options;
+    bool isValid = true;
+    for (int i = 1; i < argc && isValid; ++i)
+    {
+        const bool hasValue = i+1 < argc;
+        if (!std::strcmp(argv[i], "--chunk") && hasValue)
+            chunkSize = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--threads") && hasValue)
+            threadCount = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--max-dist") && hasValue)
+            maxDist = std::strtof(argv[++i], nullptr);
+        else if (!std::strcmp(argv[i], "--index") && hasValue && parseIndexType(argv[i+1], options))
+            ++i;
+        else if (!std::strcmp(argv[i], "--proxies"))
+            options.useProxyBounds = true;
+        else if (argv[i][0] != '-' && !meshPath)
+            meshPath = argv[i];
+        else if (argv[i][0] != '-' && !pointsPath)
+            pointsPath = argv[i];
+        else if (argv[i][0] != '-' && !outputPath)
+            outputPath = argv[i];
+        else
+            isValid = false;
+    }
+    if (!isValid || !outputPath || chunkSize == 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " MESH POINTS OUTPUT"
+                  << " [--chunk N] [--threads N] [--max-dist D]"
+                  << " [--index octree|bvh4|bvh8] [--proxies]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    std::unique_ptr<ClosestPointQuery> query;
+    std::ifstream pointsFile;
+    std::ofstream outputFile;
+    std::unique_ptr<PointReader> reader;
+    double inputSize = 0.0;
+    try
+    {
+        const auto buildStart = std::chrono::steady_clock::now();
+        const MeshData mesh = readMeshFile(meshPath);
+        QueryOptions queryOptions;
+        queryOptions.noFacePruningFactor = 4.0f;
+        query.reset(new ClosestPointQuery(mesh, options, queryOptions));
+        std::cout << std::left << std::setw(15) << "mesh:"
+                  << mesh.vertices.size() << " vertices, " << mesh.faces.size()
+                  << " faces, read and indexed in " << secondsSince(buildStart) << " s"
+                  << std::endl;
+
+        pointsFile.open(pointsPath, std::ios::binary);
+        if (!pointsFile)
+            throw std::invalid_argument("Cannot open points " + std::string(pointsPath));
+        pointsFile.seekg(0, std::ios::end);
+        inputSize = static_cast<double>(pointsFile.tellg());
+        pointsFile.seekg(0, std::ios::beg);
+        reader = createPointReader(pointsFile, pointsPath);
+        outputFile.open(outputPath, std::ios::binary);
+        if (!outputFile)
+            throw std::invalid_argument("Cannot open output " + std::string(outputPath));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    const bool isCsvOutput = hasSuffix(outputPath, ".csv");
+
+    // Chunks cycle from the reader, to the queries on this thread, to the writer and
+    // back. After an error, stages pass chunks along without processing them, until
+    // the end of the input.
+    std::vector<Chunk> chunks(chunkCount);
+    ChunkQueue freeChunks;
+    ChunkQueue readChunks;
+    ChunkQueue projectedChunks;
+    for (Chunk &chunk : chunks)
+    {
+        chunk.points.resize(chunkSize);
+        chunk.results.resize(chunkSize);
+        freeChunks.push(&chunk);
+    }
+    std::atomic<bool> hasFailed(false);
+    std::exception_ptr readError;
+    std::exception_ptr projectError;
+    std::exception_ptr writeError;
+    std::size_t pointCount = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread readThread([&]()
+    {
+        try
+        {
+            while (!hasFailed)
+            {
+                Chunk *chunk = freeChunks.pop();
+                chunk->count = reader->read(chunk->points.data(), chunkSize);
+                if (chunk->count == 0)
+                    break;
+                readChunks.push(chunk);
+            }
+        }
+        catch (...)
+        {
+            readError = std::current_exception();
+            hasFailed = true;
+        }
+        readChunks.push(nullptr);
+    });
+
+    std::thread writeThread([&]()
+    {
+        std::vector<char> buffer;
+        while (Chunk *chunk = projectedChunks.pop())
+        {
+            try
+            {
+                if (!hasFailed)
+                {
+                    writeResults(outputFile, chunk->results.data(), chunk->count,
+                                 isCsvOutput, buffer);
+                    pointCount += chunk->count;
+                }
+            }
+            catch (...)
+            {
+                writeError = std::current_exception();
+                hasFailed = true;
+            }
+            freeChunks.push(chunk);
+        }
+    });
+
+    while (Chunk *chunk = readChunks.pop())
+    {
+        try
+        {
+            if (!hasFailed)
+                query->find(chunk->points.data(), chunk->count, maxDist,
+                            chunk->results.data(), threadCount);
+        }
+        catch (...)
+        {
+            projectError = std::current_exception();
+            hasFailed = true;
+        }
+        projectedChunks.push(chunk);
+    }
+    projectedChunks.push(nullptr);
+    readThread.join();
+    writeThread.join();
+    outputFile.close();
+
+    for (const std::exception_ptr &error : { readError, projectError, writeError })
+    {
+        if (!error)
+            continue;
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+        return EXIT_FAILURE;
+    }
+
+    const double seconds = secondsSince(start);
+    const double inputMebiBytes = inputSize / (1024.0 * 1024.0);
+    std::cout << std::setw(15) << "project:"
+              << pointCount << " points in " << seconds << " s ("
+              << pointCount / seconds << " points/s, "
+              << inputMebiBytes / seconds << " MiB/s read, "
+              << threadCount << " threads)" << std::endl;
+    return EXIT_SUCCESS;
+}
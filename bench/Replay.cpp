@@ -0,0 +1,223 @@
+#include "MeshFiles.h"
+
+#include <ClosestPointQuery.h>
+#include <ParallelChunks.h>
+#include <QueryTrace.h>
+#include <Tracing.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Replay of a query trace recorded by cpom::QueryTraceRecorder, reporting throughput
+/// and latency. Calls are replayed in the order they were recorded, split in
+/// contiguous ranges among threads, so that results do not depend on the threading.
+///
+/// Usage: cpom_replay MESH TRACE [--threads N] [--repeat K] [--index octree|bvh4|bvh8]
+///                    [--proxies] [--prefetch D] [--ignore-fingerprint] [--trace FILE]
+///
+/// With --trace, spans of the build and of each call replayed, per thread, are
+/// written to FILE as Chrome trace-event JSON, if cpom was built with tracing.
+
+/// \brief Return the first call of each of threadCount ranges, plus the end of the last one.
+///
+/// Ranges hold about the same number of query points.
+std::vector<std::size_t> splitCalls(const QueryTrace &trace, std::size_t threadCount)
+{
+    std::vector<std::size_t> bounds(1, 0);
+    std::size_t call = 0;
+    for (std::size_t t = 1; t < threadCount; ++t)
+    {
+        const std::size_t pointEnd = trace.points.size() * t / threadCount;
+        while (call < trace.calls.size() && trace.calls[call].begin < pointEnd)
+            ++call;
+        bounds.push_back(call);
+    }
+    bounds.push_back(trace.calls.size());
+    return bounds;
+}
+
+/// Replay calls [begin, end) of a trace, storing results and the duration of each call.
+void replayCalls(const ClosestPointQuery &query, const QueryTrace &trace,
+                 std::size_t begin, std::size_t end,
+                 std::vector<ClosestPointQuery::Result> &results,
+                 std::vector<double> &latencies)
+{
+    for (std::size_t c = begin; c < end; ++c)
+    {
+        const QueryTrace::Call &call = trace.calls[c];
+        const auto start = std::chrono::steady_clock::now();
+        query.find(trace.points.data() + call.begin, call.count, call.maxDist,
+                   results.data() + call.begin);
+        latencies[c] = secondsSince(start);
+    }
+}
+
+/// Return the value of sorted values at a given fraction of their count.
+double percentile(const std::vector<double> &sortedValues, double fraction)
+{
+    if (sortedValues.empty())
+        return 0.0;
+    const std::size_t i = static_cast<std::size_t>(fraction * (sortedValues.size() - 1) + 0.5);
+    return sortedValues[i];
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    const char *meshPath = nullptr;
+    const char *tracePath = nullptr;
+    unsigned threadCount = 1;
+    int repeatCount = 1;
+    bool ignoreFingerprint = false;
+    const char *traceEventPath = nullptr;
+    BuildOptions options;
+    QueryOptions queryOptions;
+    bool isValid = true;
+    for (int i = 1; i < argc && isValid; ++i)
+    {
+        const bool hasValue = i+1 < argc;
+        if (!std::strcmp(argv[i], "--threads") && hasValue)
+            threadCount = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--repeat") && hasValue)
+            repeatCount = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--index") && hasValue && parseIndexType(argv[i+1], options))
+            ++i;
+        else if (!std::strcmp(argv[i], "--proxies"))
+            options.useProxyBounds = true;
+        else if (!std::strcmp(argv[i], "--prefetch") && hasValue)
+            queryOptions.prefetchDistance = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--ignore-fingerprint"))
+            ignoreFingerprint = true;
+        else if (!std::strcmp(argv[i], "--trace") && hasValue)
+            traceEventPath = argv[++i];
+        else if (argv[i][0] != '-' && !meshPath)
+            meshPath = argv[i];
+        else if (argv[i][0] != '-' && !tracePath)
+            tracePath = argv[i];
+        else
+            isValid = false;
+    }
+    if (!isValid || !meshPath || !tracePath)
+    {
+        std::cerr << "Usage: " << argv[0] << " MESH TRACE"
+                  << " [--threads N] [--repeat K] [--index octree|bvh4|bvh8]"
+                  << " [--proxies] [--prefetch D] [--ignore-fingerprint]"
+                  << " [--trace FILE]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    MeshData mesh;
+    QueryTrace trace;
+    try
+    {
+        std::ifstream meshFile(meshPath, std::ios::binary);
+        if (!meshFile)
+            throw std::invalid_argument("Cannot open mesh " + std::string(meshPath));
+        mesh = readMesh(meshFile);
+        std::ifstream traceFile(tracePath, std::ios::binary);
+        if (!traceFile)
+            throw std::invalid_argument("Cannot open trace " + std::string(tracePath));
+        trace = readQueryTrace(traceFile);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (computeMeshFingerprint(mesh) != trace.meshFingerprint)
+    {
+        std::cerr << "The trace was recorded on another mesh" << std::endl;
+        if (!ignoreFingerprint)
+            return EXIT_FAILURE;
+    }
+    std::cout << std::left << std::setw(15) << "mesh:"
+              << mesh.vertices.size() << " vertices, " << mesh.faces.size() << " faces"
+              << std::endl;
+    std::cout << std::setw(15) << "trace:"
+              << trace.calls.size() << " calls, " << trace.points.size() << " queries"
+              << std::endl;
+
+    if (traceEventPath)
+    {
+        if (!isTracingAvailable())
+            std::cerr << "Tracing is not available, build with CPOM_ENABLE_TRACING" << std::endl;
+        startTracing();
+    }
+
+    const auto buildStart = std::chrono::steady_clock::now();
+    const ClosestPointQuery query(mesh, options, queryOptions);
+    std::cout << std::setw(15) << "build:" << secondsSince(buildStart) << " s" << std::endl;
+
+    const std::vector<std::size_t> bounds = splitCalls(trace, threadCount);
+    std::vector<ClosestPointQuery::Result> results(trace.points.size());
+    std::vector<double> latencies(trace.calls.size());
+    for (int r = 0; r < repeatCount; ++r)
+    {
+        // Each thread replays one range of calls.
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            forEachChunk(threadCount, threadCount,
+                         [&](std::size_t begin, std::size_t end)
+                         {
+                             for (std::size_t t = begin; t < end; ++t)
+                                 replayCalls(query, trace, bounds[t], bounds[t+1], results,
+                                             latencies);
+                         });
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        const double seconds = secondsSince(start);
+
+        // The checksum sums results in the order of the trace, whatever the threading.
+        double checksum = 0.0;
+        for (const ClosestPointQuery::Result &result : results)
+        {
+            if (result.faceId >= 0)
+                checksum += result.distance + result.faceId;
+        }
+        std::vector<double> sortedLatencies(latencies);
+        std::sort(sortedLatencies.begin(), sortedLatencies.end());
+        std::cout << std::setw(15) << "replay:"
+                  << trace.points.size() << " queries in " << seconds << " s ("
+                  << trace.points.size() / seconds << " queries/s, "
+                  << threadCount << " threads), call latency p50 "
+                  << 1e6 * percentile(sortedLatencies, 0.5) << " us, p99 "
+                  << 1e6 * percentile(sortedLatencies, 0.99) << " us, max "
+                  << 1e6 * percentile(sortedLatencies, 1.0) << " us"
+                  << " checksum " << std::setprecision(10) << checksum
+                  << std::setprecision(6) << std::endl;
+    }
+
+    if (traceEventPath)
+    {
+        stopTracing();
+        std::ofstream traceEvents(traceEventPath);
+        writeTraceEvents(traceEvents);
+    }
+
+    return EXIT_SUCCESS;
+}
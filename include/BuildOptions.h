@@ -0,0 +1,181 @@
+#ifndef __BUILDOPTIONS_H__
+#define __BUILDOPTIONS_H__
+
+#include <Float3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cpom
+{
+
+class MemoryResource;
+
+/// Type of spatial index used to accelerate the nearest face search.
+enum class IndexType
+{
+    /// Octree whose leaves reference all the faces they overlap.
+    Octree,
+    /// Bounding volume hierarchy with 4 children per node, each face in one leaf.
+    WideBvh4,
+    /// Bounding volume hierarchy with 8 children per node, each face in one leaf.
+    WideBvh8
+};
+
+/// Rule deciding whether an octree cell is split into eight children.
+enum class OctreeSubdivision
+{
+    /// Split cells holding more than 3 faces per level of depth, whatever their geometry.
+    Fill,
+    /// \brief Split cells when the expected number of faces tested by a query drops,
+    /// children being visited with a probability proportional to their surface area.
+    ///
+    /// Faces overlapping several children are counted in each of them, so that cells
+    /// whose faces all meet at a point, or cross the cell, are not split.
+    SurfaceAreaCost,
+    /// \brief Split cells when the expected number of faces tested by a query drops,
+    /// children being visited with a probability proportional to their volume.
+    ///
+    /// Cells are split more eagerly than with SurfaceAreaCost.
+    VolumeCost
+};
+
+/// Type limiting the depth of the octree cells overlapping a region of space.
+struct OctreeDepthLimit
+{
+    /// Lower corner of the region.
+    Point min;
+    /// Upper corner of the region.
+    Point max;
+    /// Depth at which cells overlapping the region are no longer split.
+    int maxDepth;
+};
+
+/// Type of surface on which closest points are computed.
+enum class SurfaceType
+{
+    /// Faces of the mesh.
+    Cage,
+    /// \brief Catmull-Clark limit surface of the mesh, which must be made of quads,
+    /// Loop subdivision of triangles not being supported.
+    ///
+    /// Faces whose vertices are regular, interior with four faces around them, on
+    /// the boundary with two, or corners of a single face, are indexed as the exact
+    /// bicubic patches of their limit surface, the boundary being the cubic B-spline
+    /// curve of the boundary vertices. Faces next to an extraordinary vertex are
+    /// subdivided around it down to BuildOptions::limitSurfaceTolerance.
+    CatmullClarkLimit
+};
+
+/// Type holding the options controlling how a ClosestPointQuery is built.
+struct BuildOptions
+{
+    /// Spatial index used to accelerate the nearest face search.
+    IndexType indexType = IndexType::Octree;
+
+    /// Rule deciding whether an octree cell is split.
+    OctreeSubdivision octreeSubdivision = OctreeSubdivision::SurfaceAreaCost;
+
+    /// \brief Depth at which octree cells are no longer split, whatever the faces
+    /// they hold, unless they overlap one of octreeDepthLimits.
+    int maxOctreeDepth = 10;
+
+    /// \brief Regions of space where octree cells are split up to another depth.
+    ///
+    /// Cells overlapping regions are split up to the deepest of their limits, for
+    /// instance to refine a detailed part of a scan, or to stop refining a noisy one.
+    std::vector<OctreeDepthLimit> octreeDepthLimits;
+
+    /// \brief Surface on which closest points are computed.
+    ///
+    /// Limit surfaces are indexed patch by patch, one per regular face of the cage,
+    /// and a few per level of subdivision for faces next to an extraordinary vertex,
+    /// so that memory and build time scale with the cage rather than with a
+    /// subdivided mesh. They are always indexed by a bounding volume hierarchy, a
+    /// WideBvh4 being used when indexType is Octree.
+    SurfaceType surfaceType = SurfaceType::Cage;
+
+    /// \brief Distance to the Catmull-Clark limit surface allowed next to
+    /// extraordinary vertices, relative to the size of the 1-ring of their faces.
+    ///
+    /// Faces next to an extraordinary vertex are subdivided until the 1-ring of its
+    /// last child is smaller than the tolerance times the 1-ring of the face, each
+    /// level adding three exact patches. That child is then approximated by the
+    /// bilinear patch through the limit positions of its corners. Must be positive.
+    float limitSurfaceTolerance = 1e-3f;
+
+    /// \brief Reorder faces and vertices along a space-filling curve before building.
+    ///
+    /// Faces close in space then end up close in memory, which reduces cache
+    /// misses while building the index and gathering leaf vertices. Results
+    /// still report the face ids of the original mesh.
+    bool reorderForLocality = true;
+
+    /// \brief Tolerance under which quads are considered planar, relative to their
+    /// longest diagonal. Negative, the default, to always split quads in two triangles.
+    ///
+    /// The closest point on a convex quad whose vertices are all within the tolerance
+    /// times its longest diagonal of the plane through its center is computed by
+    /// projecting the query onto that plane, and onto the edges it falls outside of,
+    /// if any, instead of two triangle solves. The point found is then off the quad
+    /// by at most the tolerance times its longest diagonal. A tolerance of 1e-5 keeps
+    /// this error within float precision.
+    float planarQuadTolerance = -1.0f;
+
+    /// \brief Bound each octree node by a proxy of the surface it holds.
+    ///
+    /// Proxies are slabs around the faces of the node, whose distance is a tighter
+    /// lower bound than the distance to the node cube, and one of their vertices,
+    /// whose distance bounds the result from above. They prune most of the octree
+    /// for queries far from a flat region of the mesh, at the cost of 32 bytes per
+    /// node. Results are unchanged. Hierarchies fit their boxes to the faces and
+    /// do not use proxies. Queries with a FaceFilter only use the slabs, the vertex
+    /// possibly lying on faces filtered out.
+    bool useProxyBounds = false;
+
+    /// \brief Bound the normals of the faces of each octree node by a cone.
+    ///
+    /// Queries with a FaceFilter direction then skip the nodes whose cone lies
+    /// beyond the maximum angle of the filter, such as the far side of a thin shell,
+    /// at the cost of 20 bytes per node. Results are unchanged. Hierarchies do not
+    /// use cones: their queries test the normal of each face.
+    bool useNormalCones = false;
+
+    /// \brief Group of each face, in [0, 64), indexed like Mesh::getFaces(), or empty
+    /// to put all faces in group 0.
+    ///
+    /// Groups tag the parts of a mesh, such as materials or objects, so that queries
+    /// with a FaceFilter::groupMask only search some of them without building an
+    /// index per subset. Nodes store the groups of the faces below them, so that
+    /// subtrees holding no group searched are skipped, at the cost of one byte per
+    /// face and 8 bytes per meshlet and node, or per child of hierarchy nodes.
+    ///
+    /// \throw std::invalid_argument from the MeshIndex constructor in the case it is
+    /// neither empty nor of the size of the faces, or holds a group above 63.
+    std::vector<std::uint8_t> faceGroups;
+
+    /// \brief Allocate the index with getHugePageMemoryResource(), unless
+    /// indexMemoryResource is set.
+    ///
+    /// This reduces TLB misses when querying large meshes. It has no effect on
+    /// systems other than Linux.
+    bool useHugePages = false;
+
+    /// \brief Memory resource from which the index is allocated, or null to use
+    /// the global operator new, or huge pages if useHugePages is set.
+    ///
+    /// It must outlive the MeshIndex. Each array of the index is allocated
+    /// once, with its exact size, so that a MonotonicBuffer is used efficiently.
+    MemoryResource *indexMemoryResource = nullptr;
+
+    /// \brief Memory resource from which temporary data is allocated while
+    /// building, or null to use an internal PoolResource over a MonotonicBuffer.
+    ///
+    /// The internal MonotonicBuffer draws chunks from the global operator new,
+    /// and releases them all at once at the end of the build.
+    MemoryResource *buildMemoryResource = nullptr;
+};
+
+} // namespace cpom
+
+#endif // __BUILDOPTIONS_H__
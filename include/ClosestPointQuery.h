@@ -1,8 +1,15 @@
 #ifndef __CLOSESTPOINTQUERY_H__
 #define __CLOSESTPOINTQUERY_H__
 
+#include <BuildOptions.h>
+#include <FaceFilter.h>
+#include <MemoryResource.h>
 #include <Mesh.h>
+#include <MeshIndex.h>
+#include <QueryOptions.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
 namespace cpom
@@ -10,24 +17,79 @@ namespace cpom
 
 /// \brief Functor object that efficiently compute the points closest to the associated mesh.
 ///
-/// An octree structure is used to partition space and accelerate the nearest face search.
+/// A spatial index, an octree by default, is used to partition space and accelerate
+/// the nearest face search. The index is held by a shared MeshIndex: copying a query,
+/// or constructing one from the index of another, does not build the index again.
 class ClosestPointQuery
 {
 public:
-    /// \brief Construct the functor for a given mesh.
+    /// Type holding the closest point found by a query and the face it lies on.
+    struct Result
+    {
+        /// Coordinate of the closest point, NaN if no face is within the search distance.
+        Point point;
+        /// Distance from the query point to the closest point, infinity if none is found.
+        float distance;
+        /// Index in Mesh::getFaces() of the face holding the closest point, -1 if none is found.
+        int faceId;
+        /// \brief Distance the query point may move while faceId stays the closest face.
+        ///
+        /// Within this radius, no other face comes closer than the distance to faceId
+        /// minus QueryOptions::safeRadiusTolerance, and faceId stays within the maximum
+        /// search distance. If no face is found, none comes within the maximum search
+        /// distance. Points that moved less than their radius need not be queried again.
+        /// The radius is conservative: it is derived from the second closest face tested
+        /// and from the bounds of the index nodes left unvisited, see
+        /// QueryOptions::noFacePruningFactor.
+        float safeRadius;
+    };
+
+    /// Type counting the work done by queries, to normalize performance measurements.
+    struct Statistics
+    {
+        /// Number of query points processed.
+        std::uint64_t queryCount = 0;
+        /// Number of index nodes, or leaves, visited.
+        std::uint64_t nodeCount = 0;
+        /// Number of faces, or limit surface patches, whose closest point was computed.
+        std::uint64_t faceCount = 0;
+    };
+
+    /// \brief Construct the functor for a given mesh, building its index.
     ///
     /// \pre The mesh is expected to contain only triangle and quadrilateral faces.
     /// \pre None of the faces should have 3 or more collinear vertices.
     /// \pre The mesh is expected to contain at least one face.
     ///
     /// \param[in] m Mesh where to find closest points.
+    /// \param[in] options Options controlling how the spatial index is built.
+    /// \param[in] queryOptions Options controlling how the index is searched.
     ///
     /// \post No reference to the Mesh m is maintened.
     ///
-    ClosestPointQuery(const Mesh &m);
+    ClosestPointQuery(const Mesh &m, const BuildOptions &options = BuildOptions(),
+                      const QueryOptions &queryOptions = QueryOptions());
+
+    /// \brief Construct the functor searching an index already built.
+    ///
+    /// \param[in] index Index shared with other functors, must not be null.
+    /// \param[in] queryOptions Options controlling how the index is searched.
+    ///
+    /// \throw std::invalid_argument in the case index is null.
+    ///
+    explicit ClosestPointQuery(std::shared_ptr<const MeshIndex> index,
+                               const QueryOptions &queryOptions = QueryOptions());
 
-    //// Destructor
-    ~ClosestPointQuery();
+    /// Return the index searched, to share it with other functors.
+    const std::shared_ptr<const MeshIndex> &getIndex() const { return m_index; }
+
+    /// \brief Return the bytes taken by the index, broken down by component.
+    ///
+    /// Queries sharing an index report the same footprint.
+    MemoryFootprint getMemoryFootprint() const { return m_index->getMemoryFootprint(); }
+
+    /// Return the options controlling how the index is searched.
+    const QueryOptions &getQueryOptions() const { return m_queryOptions; }
 
     /// \brief Return the closest point on the mesh within the specified maximum search distance.
     ///
@@ -41,9 +103,106 @@ public:
     ///
     Point operator() (const Point &queryPoint, float maxDist) const;
 
+    /// \brief Return the closest point on the mesh within the specified maximum
+    /// search distance, along with its distance and face.
+    ///
+    /// \param[in] queryPoint Coordinate from which we want to find the closest point.
+    /// \param[in] maxDist Maximum search distance.
+    ///
+    /// \return Closest point, distance and id of the face in the original mesh.
+    ///
+    /// \throw std::invalid_argument in the case a face has 3 or more collinear vertices.
+    /// \throw std::invalid_argument in the case a face is not a triangle or quadrilateral.
+    ///
+    Result find(const Point &queryPoint, float maxDist) const;
+
+    /// \brief Find the closest points to a batch of query points.
+    ///
+    /// While a query is processed, the index nodes on the path to the next query
+    /// point are prefetched, hiding part of the memory latency of the next query.
+    /// Queries close to each other in space are best submitted consecutively.
+    ///
+    /// \param[in] queryPoints Coordinates from which we want to find the closest points.
+    /// \param[in] count Number of query points.
+    /// \param[in] maxDist Maximum search distance.
+    /// \param[out] results Array of count results, indexed like queryPoints.
+    ///
+    /// \throw std::invalid_argument in the case a face has 3 or more collinear vertices.
+    /// \throw std::invalid_argument in the case a face is not a triangle or quadrilateral.
+    ///
+    void find(const Point *queryPoints, std::size_t count, float maxDist,
+              Result *results) const;
+
+    /// \brief Find the closest points to a batch of query points, counting the work done.
+    ///
+    /// \param[in] queryPoints Coordinates from which we want to find the closest points.
+    /// \param[in] count Number of query points.
+    /// \param[in] maxDist Maximum search distance.
+    /// \param[out] results Array of count results, indexed like queryPoints.
+    /// \param[in,out] statistics Counts to which those of the batch are added.
+    ///
+    /// \throw std::invalid_argument in the case a face has 3 or more collinear vertices.
+    /// \throw std::invalid_argument in the case a face is not a triangle or quadrilateral.
+    ///
+    void find(const Point *queryPoints, std::size_t count, float maxDist,
+              Result *results, Statistics &statistics) const;
+
+    /// \brief Find the closest points to a batch of query points on several threads.
+    ///
+    /// Each thread finds those of a contiguous chunk of the batch, as a batch of its
+    /// own, see forEachChunk(). Query traces record one call per chunk.
+    ///
+    /// \param[in] queryPoints Coordinates from which we want to find the closest points.
+    /// \param[in] count Number of query points.
+    /// \param[in] maxDist Maximum search distance.
+    /// \param[out] results Array of count results, indexed like queryPoints.
+    /// \param[in] threadCount Number of threads, the calling one included, 0 for one
+    /// per hardware thread.
+    ///
+    /// \throw std::invalid_argument in the case a face has 3 or more collinear vertices.
+    /// \throw std::invalid_argument in the case a face is not a triangle or quadrilateral.
+    ///
+    void find(const Point *queryPoints, std::size_t count, float maxDist,
+              Result *results, unsigned threadCount) const;
+
+    /// \brief Return the closest point on the faces accepted by a filter, within the
+    /// specified maximum search distance, along with its distance and face.
+    ///
+    /// Octrees built with BuildOptions::useNormalCones skip the nodes holding no face
+    /// accepted by the filter, and indices built with BuildOptions::faceGroups those
+    /// holding no group of its mask. Query traces record the call without its filter.
+    ///
+    /// \param[in] queryPoint Coordinate from which we want to find the closest point.
+    /// \param[in] maxDist Maximum search distance.
+    /// \param[in] filter Filter of the faces the closest point may lie on.
+    ///
+    /// \return Closest point, distance and id of the face in the original mesh, the
+    /// safe radius only accounting for the faces accepted.
+    ///
+    /// \throw std::invalid_argument in the case a face has 3 or more collinear vertices.
+    /// \throw std::invalid_argument in the case a face is not a triangle or quadrilateral.
+    ///
+    Result find(const Point &queryPoint, float maxDist, const FaceFilter &filter) const;
+
+    /// \brief Find the closest points on the faces accepted by a filter to a batch of
+    /// query points, counting the work done.
+    ///
+    /// \param[in] queryPoints Coordinates from which we want to find the closest points.
+    /// \param[in] count Number of query points.
+    /// \param[in] maxDist Maximum search distance.
+    /// \param[in] filter Filter of the faces the closest points may lie on.
+    /// \param[out] results Array of count results, indexed like queryPoints.
+    /// \param[in,out] statistics Counts to which those of the batch are added.
+    ///
+    /// \throw std::invalid_argument in the case a face has 3 or more collinear vertices.
+    /// \throw std::invalid_argument in the case a face is not a triangle or quadrilateral.
+    ///
+    void find(const Point *queryPoints, std::size_t count, float maxDist,
+              const FaceFilter &filter, Result *results, Statistics &statistics) const;
+
 private:
-    struct Impl;
-    std::unique_ptr<Impl> m_impl;
+    std::shared_ptr<const MeshIndex> m_index;
+    QueryOptions m_queryOptions;
 };
 
 } // namespace cpom
@@ -0,0 +1,51 @@
+#ifndef __FACEFILTER_H__
+#define __FACEFILTER_H__
+
+#include <Float3.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace cpom
+{
+
+/// \brief Type restricting the faces on which a ClosestPointQuery may find the
+/// closest point.
+///
+/// The closest point returned is the closest one on the faces accepted, other faces
+/// being ignored as if they were not in the mesh. The default filter accepts all faces.
+struct FaceFilter
+{
+    /// \brief Direction within maxAngle of which face normals must lie, the null
+    /// vector accepting any normal.
+    ///
+    /// The normal of a face points to the side from which its vertices are seen in
+    /// counterclockwise order. Quads take the normal of their diagonals, and limit
+    /// surface patches the normal at their center. For instance, the direction from
+    /// a query point to the mesh with a maximum angle below 90 degrees ignores the
+    /// faces seen from behind.
+    Float3 direction = Float3(0.0f);
+
+    /// Maximum angle, in radians, between face normals and direction.
+    float maxAngle = 1.57079633f;
+
+    /// \brief Mask of the groups of the faces accepted, bit g accepting the faces of
+    /// group g, see BuildOptions::faceGroups.
+    ///
+    /// Faces of an index built without groups are in group 0. Index nodes holding
+    /// no group of the mask are skipped, so that searching a few groups costs about
+    /// as much as searching an index built on their faces alone.
+    std::uint64_t groupMask = ~std::uint64_t(0);
+
+    /// \brief Function accepting a face given its id in the mesh, or empty to accept
+    /// all faces.
+    ///
+    /// It is called for each face tested, after the checks above, and prunes no index
+    /// node: groups are preferred for subsets known when building. It must be safe to
+    /// call from several threads when batch queries are split among threads.
+    std::function<bool(int)> predicate;
+};
+
+} // namespace cpom
+
+#endif // __FACEFILTER_H__
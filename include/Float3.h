@@ -125,6 +125,14 @@ struct Float3
         return x*rhs.x + y*rhs.y + z*rhs.z;
     }
 
+    /// Cross product with another Float3.
+    constexpr Float3 cross(const Float3 &rhs) const
+    {
+        return Float3(y*rhs.z - z*rhs.y,
+                      z*rhs.x - x*rhs.z,
+                      x*rhs.y - y*rhs.x);
+    }
+
     /// Return a Float3 with the absolute value of components
     inline Float3 abs() const
     {
@@ -0,0 +1,57 @@
+#ifndef __INDEXLAYOUT_H__
+#define __INDEXLAYOUT_H__
+
+#include <Float3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace cpom
+{
+
+/// Type describing a leaf of the spatial index of a MeshIndex.
+struct IndexLeaf
+{
+    /// Lower corner of the octree cell, or of the hierarchy box, of the leaf.
+    Point min;
+    /// Upper corner of the octree cell, or of the hierarchy box, of the leaf.
+    Point max;
+    /// Depth of the leaf, the root node having depth 0.
+    unsigned depth;
+    /// Number of faces, or limit patches, stored in the leaf.
+    std::uint32_t faceCount;
+    /// Number of meshlets holding the faces of the leaf, 0 for limit patches.
+    std::uint32_t meshletCount;
+};
+
+/// \brief Type describing the structure of the spatial index of a MeshIndex.
+///
+/// It tells why a mesh is slow to query: leaves holding many faces, often at the
+/// maximal depth of the octree, or faces stored in many leaves.
+struct IndexLayout
+{
+    /// Depth at which octree cells are no longer split, whatever the number of
+    /// faces they hold, the deepest of all regions if several, 0 for hierarchies.
+    unsigned maxDepth = 0;
+    /// Number of nodes at each depth, leaves included, the root being at depth 0.
+    std::vector<std::size_t> levelNodeCounts;
+    /// Leaves of the index, in the order they are stored.
+    std::vector<IndexLeaf> leaves;
+    /// Number of leaves storing each face, indexed like the faces of the mesh.
+    std::vector<std::uint32_t> faceLeafCounts;
+};
+
+/// \brief Write the boxes of the leaves of an index as a Wavefront OBJ mesh.
+///
+/// Each leaf is written as a group named after its index in IndexLayout::leaves,
+/// made of the 8 corners and 6 quad faces of its box.
+///
+/// \throw std::invalid_argument in the case the stream fails.
+///
+void writeLeafBoxes(std::ostream &out, const IndexLayout &layout);
+
+} // namespace cpom
+
+#endif // __INDEXLAYOUT_H__
@@ -0,0 +1,57 @@
+#ifndef __MEMORYFOOTPRINT_H__
+#define __MEMORYFOOTPRINT_H__
+
+#include <cstddef>
+
+namespace cpom
+{
+
+/// \brief Type holding the bytes taken by a MeshIndex, broken down by component.
+///
+/// Arrays are counted by the size of their allocation, whichever memory resource
+/// they are drawn from. Components are disjoint, except the duplication overheads
+/// which are the part of vertices and faces spent on copies.
+struct MemoryFootprint
+{
+    /// Vertices copied into meshlets, each meshlet holding the vertices it uses.
+    std::size_t vertices = 0;
+    /// Faces stored in meshlets, with the id of each in the original mesh.
+    std::size_t faces = 0;
+    /// Headers of the meshlets.
+    std::size_t meshlets = 0;
+    /// Control points of Catmull-Clark limit patches.
+    std::size_t patches = 0;
+    /// Nodes of the octree or of the bounding volume hierarchy.
+    std::size_t nodes = 0;
+    /// Lists of the meshlets, or patches, of the leaves.
+    std::size_t leafElements = 0;
+    /// Proxies of the surface bounding octree nodes, see BuildOptions::useProxyBounds.
+    std::size_t proxies = 0;
+    /// Cones bounding the normals of octree nodes, see BuildOptions::useNormalCones.
+    std::size_t normalCones = 0;
+    /// Groups of the faces and masks of the groups below meshlets and nodes, see
+    /// BuildOptions::faceGroups.
+    std::size_t groups = 0;
+    /// Objects of the index themselves.
+    std::size_t objects = 0;
+    /// \brief Part of vertices copied in more than one meshlet.
+    ///
+    /// Vertices shared by faces in different leaves are copied in each.
+    std::size_t duplicatedVertices = 0;
+    /// \brief Part of faces stored in more than one meshlet.
+    ///
+    /// Octree leaves hold all the faces crossing them, so large faces are stored in
+    /// several leaves.
+    std::size_t duplicatedFaces = 0;
+
+    /// Return the bytes taken by all components.
+    std::size_t getTotal() const
+    {
+        return vertices + faces + meshlets + patches + nodes + leafElements + proxies +
+               normalCones + groups + objects;
+    }
+};
+
+} // namespace cpom
+
+#endif // __MEMORYFOOTPRINT_H__
@@ -0,0 +1,214 @@
+#ifndef __MEMORYRESOURCE_H__
+#define __MEMORYRESOURCE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+namespace cpom
+{
+
+/// \brief Interface of a source of memory for the internal allocations of cpom.
+///
+/// This mirrors std::pmr::memory_resource, which is not available in C++11.
+class MemoryResource
+{
+public:
+    virtual ~MemoryResource() = default;
+
+    /// \brief Allocate a block of memory.
+    ///
+    /// \param[in] bytes Size of the block.
+    /// \param[in] alignment Alignment of the block, a power of two.
+    ///
+    /// \throw std::bad_alloc if the memory cannot be allocated.
+    ///
+    virtual void *allocate(std::size_t bytes, std::size_t alignment) = 0;
+
+    /// \brief Deallocate a block of memory returned by allocate().
+    ///
+    /// \param[in] p Pointer to the block.
+    /// \param[in] bytes Size of the block, as passed to allocate().
+    /// \param[in] alignment Alignment of the block, as passed to allocate().
+    ///
+    virtual void deallocate(void *p, std::size_t bytes, std::size_t alignment) = 0;
+};
+
+/// Return a MemoryResource using the global operators new and delete.
+MemoryResource &getDefaultMemoryResource();
+
+/// \brief Return a MemoryResource backing large blocks with 2 MiB huge pages.
+///
+/// On Linux, blocks of at least 1 MiB are mapped with MAP_HUGETLB, or, when no
+/// huge page is reserved, mapped on 2 MiB boundaries and advised with
+/// MADV_HUGEPAGE for transparent huge pages. Smaller blocks, and all blocks on
+/// other systems, are allocated by the default resource.
+///
+/// Huge pages reduce the TLB misses of traversals touching many pages at random.
+MemoryResource &getHugePageMemoryResource();
+
+/// \brief MemoryResource handing out memory from chunks that are only released all at once.
+///
+/// Deallocation does nothing: memory is reclaimed by release() or by the destructor.
+/// Chunks are obtained from an upstream resource, each one twice as large as the
+/// previous one. This makes allocations cheap and keeps them contiguous, at the
+/// cost of not reusing freed blocks.
+class MonotonicBuffer : public MemoryResource
+{
+public:
+    /// \brief Construct a MonotonicBuffer.
+    ///
+    /// \param[in] upstream Resource from which chunks are allocated.
+    /// \param[in] initialChunkSize Size in bytes of the first chunk.
+    ///
+    /// \post A reference to upstream is maintained.
+    ///
+    explicit MonotonicBuffer(MemoryResource &upstream = getDefaultMemoryResource(),
+                             std::size_t initialChunkSize = 64 * 1024);
+
+    /// \brief Construct a MonotonicBuffer starting with a caller-supplied buffer.
+    ///
+    /// \param[in] buffer Memory used before any chunk is allocated.
+    /// \param[in] bufferSize Size of buffer in bytes.
+    /// \param[in] upstream Resource from which chunks are allocated.
+    ///
+    /// \post References to buffer and upstream are maintained.
+    ///
+    MonotonicBuffer(void *buffer, std::size_t bufferSize,
+                    MemoryResource &upstream = getDefaultMemoryResource());
+
+    MonotonicBuffer(const MonotonicBuffer &) = delete;
+    MonotonicBuffer &operator=(const MonotonicBuffer &) = delete;
+
+    /// Destructor, releasing all chunks.
+    virtual ~MonotonicBuffer();
+
+    virtual void *allocate(std::size_t bytes, std::size_t alignment);
+
+    virtual void deallocate(void *, std::size_t, std::size_t) { }
+
+    /// Release all chunks to the upstream resource, invalidating all allocated blocks.
+    void release();
+
+    /// Return the number of chunks allocated from the upstream resource.
+    std::size_t getChunkCount() const { return m_chunkCount; }
+
+private:
+    struct Chunk;
+
+    MemoryResource &m_upstream;
+    Chunk *m_chunks;
+    std::size_t m_chunkCount;
+    std::size_t m_nextChunkSize;
+    void *m_initialBuffer;
+    std::size_t m_initialBufferSize;
+    char *m_current;
+    char *m_end;
+};
+
+/// \brief MemoryResource reusing deallocated blocks, for data that grows and shrinks.
+///
+/// Small blocks are rounded up to a power of two, carved from slabs allocated
+/// upstream, and kept in a free list per size when deallocated to be handed out
+/// again; larger or over-aligned blocks are passed to the upstream resource. Memory is only returned upstream by release() or by the destructor,
+/// which makes a MonotonicBuffer a good upstream resource.
+/// This mirrors std::pmr::unsynchronized_pool_resource, and is not thread safe.
+class PoolResource : public MemoryResource
+{
+public:
+    /// Size in bytes of the largest block kept in free lists.
+    static constexpr std::size_t maxPooledBlockSize = 4096;
+
+    /// \brief Construct a PoolResource.
+    ///
+    /// \param[in] upstream Resource from which blocks are allocated.
+    ///
+    /// \post A reference to upstream is maintained.
+    ///
+    explicit PoolResource(MemoryResource &upstream = getDefaultMemoryResource());
+
+    PoolResource(const PoolResource &) = delete;
+    PoolResource &operator=(const PoolResource &) = delete;
+
+    /// Destructor, releasing all blocks.
+    virtual ~PoolResource();
+
+    virtual void *allocate(std::size_t bytes, std::size_t alignment);
+
+    virtual void deallocate(void *p, std::size_t bytes, std::size_t alignment);
+
+    /// Release all pooled blocks to the upstream resource, invalidating them.
+    void release();
+
+private:
+    struct FreeBlock;
+    static constexpr int poolCount = 9;
+
+    static int getPoolIndex(std::size_t bytes, std::size_t alignment);
+
+    MemoryResource &m_upstream;
+    FreeBlock *m_freeBlocks[poolCount];
+    // Slabs allocated from upstream for each pool, linked to be released.
+    FreeBlock *m_slabs[poolCount];
+};
+
+/// \brief Allocator drawing memory from a MemoryResource.
+///
+/// This mirrors std::pmr::polymorphic_allocator, and can be used with the standard
+/// containers. The allocator is not propagated on container copy, move or swap.
+template<class T>
+class PolymorphicAllocator
+{
+public:
+    using value_type = T;
+
+    /// Construct an allocator using the default memory resource.
+    PolymorphicAllocator()
+    : m_resource(&getDefaultMemoryResource())
+    { }
+
+    /// Construct an allocator using a given memory resource.
+    PolymorphicAllocator(MemoryResource &resource)
+    : m_resource(&resource)
+    { }
+
+    template<class U>
+    PolymorphicAllocator(const PolymorphicAllocator<U> &other)
+    : m_resource(&other.getResource())
+    { }
+
+    T *allocate(std::size_t n)
+    {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            throw std::bad_alloc();
+        return static_cast<T *>(m_resource->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n)
+    {
+        m_resource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    /// Return the memory resource of this allocator.
+    MemoryResource &getResource() const { return *m_resource; }
+
+private:
+    MemoryResource *m_resource;
+};
+
+template<class T, class U>
+bool operator==(const PolymorphicAllocator<T> &a, const PolymorphicAllocator<U> &b)
+{
+    return &a.getResource() == &b.getResource();
+}
+
+template<class T, class U>
+bool operator!=(const PolymorphicAllocator<T> &a, const PolymorphicAllocator<U> &b)
+{
+    return !(a == b);
+}
+
+} // namespace cpom
+
+#endif // __MEMORYRESOURCE_H__
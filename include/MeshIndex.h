@@ -0,0 +1,67 @@
+#ifndef __MESHINDEX_H__
+#define __MESHINDEX_H__
+
+#include <BuildOptions.h>
+#include <IndexLayout.h>
+#include <MemoryFootprint.h>
+#include <Mesh.h>
+
+#include <memory>
+
+namespace cpom
+{
+
+class ClosestPointQuery;
+
+/// \brief Immutable spatial index over the faces of a mesh.
+///
+/// An index is built once, then shared through a std::shared_ptr by any number of
+/// ClosestPointQuery front-ends, each with its own QueryOptions. Queries only read
+/// the index, so a single instance may be used from several threads at once.
+class MeshIndex
+{
+public:
+    /// \brief Build the index of a mesh.
+    ///
+    /// \pre The mesh is expected to contain only triangle and quadrilateral faces.
+    /// \pre None of the faces should have 3 or more collinear vertices.
+    /// \pre The mesh is expected to contain at least one face.
+    ///
+    /// \param[in] m Mesh to index.
+    /// \param[in] options Options controlling how the spatial index is built.
+    ///
+    /// \post No reference to the Mesh m is maintened.
+    ///
+    /// \throw std::invalid_argument in the case the mesh is empty.
+    ///
+    MeshIndex(const Mesh &m, const BuildOptions &options = BuildOptions());
+
+    /// Destructor
+    ~MeshIndex();
+
+    /// \brief Return the bytes taken by the index, broken down by component.
+    ///
+    /// Sizes are kept by the arrays of the index, so this is cheap enough to be
+    /// called by monitoring.
+    MemoryFootprint getMemoryFootprint() const;
+
+    /// \brief Return the structure of the spatial index: its nodes, its leaves and
+    /// the faces they store.
+    ///
+    /// The index is walked to describe each leaf, so this is meant for diagnosis.
+    /// Meshes of less than 32 faces, processed without index, have no leaf.
+    IndexLayout getLayout() const;
+
+    MeshIndex(const MeshIndex&) = delete;
+    MeshIndex &operator=(const MeshIndex&) = delete;
+
+private:
+    friend class ClosestPointQuery;
+
+    struct Impl;
+    std::unique_ptr<const Impl> m_impl;
+};
+
+} // namespace cpom
+
+#endif // __MESHINDEX_H__
@@ -0,0 +1,31 @@
+#ifndef __PARALLELCHUNKS_H__
+#define __PARALLELCHUNKS_H__
+
+#include <cstddef>
+#include <functional>
+
+namespace cpom
+{
+
+/// \brief Split count items in contiguous chunks, and process each chunk on its own
+/// thread.
+///
+/// Chunks hold about the same number of items. There are threadCount of them, or one
+/// per hardware thread if threadCount is 0, but never more than items, nor less than
+/// one. The first chunk is processed on the calling thread. Each chunk is recorded as
+/// a "find chunk" trace span, see startTracing().
+///
+/// \param[in] count Number of items.
+/// \param[in] threadCount Number of threads, 0 for one per hardware thread.
+/// \param[in] task Function processing the items in [begin, end), called once per
+/// chunk, concurrently.
+///
+/// \throw Any exception thrown by task, the one of the first chunk throwing, once all
+/// threads have finished.
+///
+void forEachChunk(std::size_t count, unsigned threadCount,
+                  const std::function<void(std::size_t begin, std::size_t end)> &task);
+
+} // namespace cpom
+
+#endif // __PARALLELCHUNKS_H__
@@ -0,0 +1,50 @@
+#ifndef __QUERYOPTIONS_H__
+#define __QUERYOPTIONS_H__
+
+#include <memory>
+
+namespace cpom
+{
+
+class QueryTraceRecorder;
+
+/// \brief Type holding the options controlling how a ClosestPointQuery searches
+/// its index.
+///
+/// Unlike BuildOptions, they do not affect the index, so front-ends sharing one
+/// MeshIndex may each use different query options.
+struct QueryOptions
+{
+    /// \brief Number of candidates, taken from the top of the search heap, whose
+    /// data is prefetched while the current one is visited. 0 disables prefetching.
+    ///
+    /// Octree children are also prefetched when pushed into the heap, and batch queries
+    /// prefetch the path to the next query point, unless prefetching is disabled.
+    unsigned prefetchDistance = 1;
+
+    /// \brief Distance by which another face may come closer than the face found,
+    /// within ClosestPointQuery::Result::safeRadius.
+    ///
+    /// A positive tolerance widens the radius of query points close to several faces,
+    /// such as points above an edge, the closest point then staying within the
+    /// tolerance of the closest distance.
+    float safeRadiusTolerance = 0.0f;
+
+    /// \brief Multiple of the maximum search distance beyond which searches finding
+    /// no face stop, 0 to search the whole index. Factors below 1 are taken as 1.
+    ///
+    /// Queries far from the mesh then visit a few index nodes instead of walking the
+    /// index towards the closest face, which lies beyond the maximum search distance
+    /// and is not returned anyway. Their ClosestPointQuery::Result::safeRadius is then
+    /// only at least the factor minus 1 times the maximum search distance, or the gap
+    /// to the mesh if smaller, instead of that gap.
+    float noFacePruningFactor = 0.0f;
+
+    /// \brief Recorder logging every call to ClosestPointQuery::find(), null to
+    /// record nothing. See QueryTraceRecorder.
+    std::shared_ptr<QueryTraceRecorder> traceRecorder;
+};
+
+} // namespace cpom
+
+#endif // __QUERYOPTIONS_H__
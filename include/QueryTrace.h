@@ -0,0 +1,118 @@
+#ifndef __QUERYTRACE_H__
+#define __QUERYTRACE_H__
+
+#include <Mesh.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+namespace cpom
+{
+
+/// \brief Return a fingerprint of the vertices and faces of a mesh.
+///
+/// Meshes with the same vertex coordinates and faces, in the same order, have the
+/// same fingerprint, which tells whether a query trace was recorded on a mesh.
+std::uint64_t computeMeshFingerprint(const Mesh &m);
+
+/// Mesh holding its vertices and faces in memory, as read by readMesh().
+class MeshData : public Mesh
+{
+public:
+    virtual std::vector<Point> getVertices() const { return vertices; }
+
+    virtual std::vector<Face> getFaces() const { return faces; }
+
+    /// Vertices of the mesh.
+    std::vector<Point> vertices;
+    /// Faces of the mesh.
+    std::vector<Face> faces;
+};
+
+/// \brief Write the vertices and faces of a mesh in the binary mesh format.
+///
+/// Data is written in the byte order of the host, and read back by readMesh().
+///
+/// \throw std::invalid_argument in the case the stream fails.
+///
+void writeMesh(std::ostream &out, const Mesh &m);
+
+/// \brief Read a mesh written by writeMesh().
+///
+/// \throw std::invalid_argument in the case the data is not a valid mesh.
+///
+MeshData readMesh(std::istream &in);
+
+/// \brief Recorder logging the queries of a ClosestPointQuery to a binary trace.
+///
+/// A recorder is attached to a query through QueryOptions::traceRecorder. The trace
+/// starts with the fingerprint of the mesh, followed by one record per call to
+/// ClosestPointQuery::find(): its maximum search distance and its query points.
+/// Records are buffered and written by blocks, under a mutex so that queries used
+/// from several threads may share a recorder.
+class QueryTraceRecorder
+{
+public:
+    /// \brief Start a trace of queries on a mesh.
+    ///
+    /// \param[in] out Stream where to write the trace, which must outlive the recorder.
+    /// \param[in] m Mesh queried, whose fingerprint is written.
+    ///
+    /// \throw std::invalid_argument in the case the stream fails.
+    ///
+    QueryTraceRecorder(std::ostream &out, const Mesh &m);
+
+    /// Destructor, writing the records still buffered.
+    ~QueryTraceRecorder();
+
+    QueryTraceRecorder(const QueryTraceRecorder&) = delete;
+    QueryTraceRecorder &operator=(const QueryTraceRecorder&) = delete;
+
+    /// Record a call finding the closest points to count query points.
+    void record(const Point *queryPoints, std::size_t count, float maxDist);
+
+    /// Write the records buffered to the stream, and flush it.
+    void flush();
+
+private:
+    void writeBuffer();
+
+    std::ostream &m_out;
+    std::vector<char> m_buffer;
+    std::mutex m_mutex;
+};
+
+/// Type holding a query trace, as read by readQueryTrace().
+struct QueryTrace
+{
+    /// Type holding a call recorded, finding the closest points of consecutive points.
+    struct Call
+    {
+        /// Index of the first query point of the call.
+        std::size_t begin;
+        /// Number of query points of the call.
+        std::size_t count;
+        /// Maximum search distance of the call.
+        float maxDist;
+    };
+
+    /// Fingerprint of the mesh queried, see computeMeshFingerprint().
+    std::uint64_t meshFingerprint;
+    /// Query points of all calls, in the order they were recorded.
+    std::vector<Point> points;
+    /// Calls recorded.
+    std::vector<Call> calls;
+};
+
+/// \brief Read a trace written by a QueryTraceRecorder.
+///
+/// \throw std::invalid_argument in the case the data is not a valid trace.
+///
+QueryTrace readQueryTrace(std::istream &in);
+
+} // namespace cpom
+
+#endif // __QUERYTRACE_H__
@@ -0,0 +1,32 @@
+#ifndef __TRACING_H__
+#define __TRACING_H__
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace cpom
+{
+
+/// \brief Return true if cpom was built with the CPOM_ENABLE_TRACING option.
+///
+/// Otherwise no span is ever recorded: the instrumentation is compiled out, and the
+/// functions below do nothing.
+bool isTracingAvailable();
+
+/// \brief Start recording spans of the index build and of batch queries.
+///
+/// Spans are kept in a ring buffer shared by all threads, the oldest ones being
+/// overwritten once it holds capacity spans. Starting again clears the buffer.
+void startTracing(std::size_t capacity = 65536);
+
+/// Stop recording spans, keeping those already recorded.
+void stopTracing();
+
+/// \brief Write the spans recorded, oldest first, as Chrome trace-event JSON.
+///
+/// The output loads in chrome://tracing or Perfetto, one track per thread.
+void writeTraceEvents(std::ostream &out);
+
+} // namespace cpom
+
+#endif // __TRACING_H__
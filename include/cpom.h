@@ -0,0 +1,166 @@
+#ifndef __CPOM_H__
+#define __CPOM_H__
+
+/// \file
+/// \brief Stable C interface of cpom, for use through foreign function interfaces.
+///
+/// Indices and queries are opaque handles. Entry points never let an exception
+/// escape: they return a cpom_status, and the message of the last error of the
+/// calling thread is available through cpom_last_error_message().
+///
+/// Thread-safety rules:
+/// - An index is immutable once created. It may be shared by any number of queries,
+///   created and used from any threads.
+/// - A query only reads its index and its options. It may be used by several
+///   threads at once, each passing its own output buffers.
+/// - A handle must not be destroyed while another thread uses it. An index may be
+///   destroyed before the queries created from it, which keep it alive.
+///
+/// The ABI only grows: new entry points are added, and option structs are extended
+/// at their end, their size member telling which members the caller knows of.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Version of the ABI, incremented when entry points or option members are added.
+#define CPOM_ABI_VERSION 1
+
+/// Status returned by all entry points.
+typedef enum cpom_status
+{
+    CPOM_OK = 0,
+    /// An argument is invalid, like a null handle, an empty mesh or a face with an
+    /// unsupported number of vertices.
+    CPOM_INVALID_ARGUMENT = 1,
+    /// Memory could not be allocated.
+    CPOM_OUT_OF_MEMORY = 2,
+    /// Any other failure.
+    CPOM_INTERNAL_ERROR = 3
+} cpom_status;
+
+/// Spatial index type, see cpom::IndexType.
+typedef enum cpom_index_type
+{
+    CPOM_INDEX_OCTREE = 0,
+    CPOM_INDEX_WIDE_BVH4 = 1,
+    CPOM_INDEX_WIDE_BVH8 = 2
+} cpom_index_type;
+
+/// Surface on which closest points are computed, see cpom::SurfaceType.
+typedef enum cpom_surface_type
+{
+    CPOM_SURFACE_CAGE = 0,
+    CPOM_SURFACE_CATMULL_CLARK_LIMIT = 1
+} cpom_surface_type;
+
+/// Options controlling how an index is built, see cpom::BuildOptions.
+typedef struct cpom_build_options
+{
+    /// Size of the struct known by the caller, set by cpom_build_options_init().
+    uint32_t struct_size;
+    /// A cpom_index_type.
+    int32_t index_type;
+    /// A cpom_surface_type.
+    int32_t surface_type;
+    /// Non-zero to reorder faces and vertices along a space-filling curve.
+    int32_t reorder_for_locality;
+    /// Tolerance under which quads are considered planar, relative to their longest
+    /// diagonal, negative to split them.
+    float planar_quad_tolerance;
+    /// Non-zero to bound octree nodes by proxies of their surface.
+    int32_t use_proxy_bounds;
+    /// Non-zero to allocate the index with huge pages where supported.
+    int32_t use_huge_pages;
+} cpom_build_options;
+
+/// Options controlling how a query searches its index, see cpom::QueryOptions.
+typedef struct cpom_query_options
+{
+    /// Size of the struct known by the caller, set by cpom_query_options_init().
+    uint32_t struct_size;
+    /// Number of search candidates whose data is prefetched, 0 to disable.
+    uint32_t prefetch_distance;
+} cpom_query_options;
+
+/// Opaque handle of an immutable spatial index over a mesh.
+typedef struct cpom_index cpom_index;
+
+/// Opaque handle of a query searching an index.
+typedef struct cpom_query cpom_query;
+
+/// Return CPOM_ABI_VERSION of the library, which may be newer than the header.
+uint32_t cpom_abi_version(void);
+
+/// \brief Return the message of the last error of the calling thread.
+///
+/// The message is empty if no error occurred, and valid until the next call
+/// failing on the same thread.
+const char *cpom_last_error_message(void);
+
+/// Set options to their default values, and their struct_size.
+void cpom_build_options_init(cpom_build_options *options);
+
+/// Set options to their default values, and their struct_size.
+void cpom_query_options_init(cpom_query_options *options);
+
+/// \brief Build the index of a mesh. Buffers are only read during the call.
+///
+/// \param[in] vertices Coordinates of the vertices, 3 floats per vertex.
+/// \param[in] vertex_count Number of vertices.
+/// \param[in] face_vertex_ids Vertex indices of all faces, one face after another.
+/// \param[in] face_count Number of faces.
+/// \param[in] face_sizes Number of vertices of each face, or null if all faces
+/// have face_size vertices.
+/// \param[in] face_size Number of vertices of each face, if face_sizes is null.
+/// \param[in] options Build options, or null for the defaults.
+/// \param[out] index Index created, to destroy with cpom_index_destroy().
+///
+cpom_status cpom_index_create(const float *vertices, size_t vertex_count,
+                              const int32_t *face_vertex_ids, size_t face_count,
+                              const uint32_t *face_sizes, uint32_t face_size,
+                              const cpom_build_options *options, cpom_index **index);
+
+/// Release a handle on an index. Null handles are ignored.
+void cpom_index_destroy(cpom_index *index);
+
+/// \brief Create a query searching an index, which it keeps alive.
+///
+/// \param[in] index Index to search.
+/// \param[in] options Query options, or null for the defaults.
+/// \param[out] query Query created, to destroy with cpom_query_destroy().
+///
+cpom_status cpom_query_create(const cpom_index *index, const cpom_query_options *options,
+                              cpom_query **query);
+
+/// Destroy a query. Null handles are ignored.
+void cpom_query_destroy(cpom_query *query);
+
+/// \brief Find the closest points on the mesh of a batch of positions.
+///
+/// Positions close to each other in space are best submitted consecutively.
+/// Outputs may be null when not needed. Where no face is within max_dist, closest
+/// points are NaN, distances infinite and face ids -1.
+///
+/// \param[in] query Query to run.
+/// \param[in] points Coordinates of the positions, 3 floats per position.
+/// \param[in] count Number of positions.
+/// \param[in] max_dist Maximum search distance, INFINITY to search the whole mesh.
+/// \param[out] closest_points Closest points, 3 floats per position, or null.
+/// \param[out] distances Distance to each closest point, or null.
+/// \param[out] face_ids Index of the face holding each closest point, or null.
+///
+/// \return CPOM_OK, or an error after which outputs are partially written.
+///
+cpom_status cpom_query_find(const cpom_query *query, const float *points, size_t count,
+                            float max_dist, float *closest_points, float *distances,
+                            int32_t *face_ids);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __CPOM_H__
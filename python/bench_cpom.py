@@ -0,0 +1,66 @@
+"""Benchmark of the cpom Python bindings against a per-point query loop.
+
+Usage: python bench_cpom.py [--resolution R] [--queries N] [--index octree|bvh4|bvh8]
+"""
+
+import argparse
+import time
+
+import numpy as np
+
+import cpom
+
+
+def dense_plane_mesh(resolution):
+    """Return the vertices and quad faces of the plane mesh of the C++ benchmark."""
+    steps = np.arange(resolution + 1, dtype=np.float32) / resolution
+    x, y = np.meshgrid(steps, steps)
+    vertices = np.stack([x.ravel(), y.ravel(), y.ravel()], axis=1)
+    ids = np.arange((resolution + 1) ** 2, dtype=np.int32).reshape(resolution + 1, -1)
+    faces = np.stack([ids[:-1, :-1].ravel(), ids[:-1, 1:].ravel(),
+                      ids[1:, 1:].ravel(), ids[1:, :-1].ravel()], axis=1)
+    return vertices, faces
+
+
+def report(name, count, seconds):
+    print(f"{name:<22}{count} queries in {seconds:.4f} s "
+          f"({count / seconds:.0f} queries/s, {1e9 * seconds / count:.0f} ns/query)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--resolution", type=int, default=300)
+    parser.add_argument("--queries", type=int, default=100000)
+    parser.add_argument("--index", default="octree", choices=("octree", "bvh4", "bvh8"))
+    args = parser.parse_args()
+
+    vertices, faces = dense_plane_mesh(args.resolution)
+    start = time.perf_counter()
+    query = cpom.ClosestPointQuery(vertices, faces, index=args.index)
+    print(f"{'build:':<22}{time.perf_counter() - start:.4f} s, {len(faces)} faces")
+
+    # Queries are offset from random points of the plane along its normal.
+    generator = np.random.default_rng(0)
+    uv = generator.uniform(0.0, 1.0, (args.queries, 2)).astype(np.float32)
+    offsets = generator.uniform(-0.01, 0.01, args.queries).astype(np.float32)
+    normal = np.array([0.0, -1.0, 1.0], dtype=np.float32) / np.sqrt(2.0)
+    points = np.stack([uv[:, 0], uv[:, 1], uv[:, 1]], axis=1) + offsets[:, None] * normal
+
+    start = time.perf_counter()
+    loop_distances = np.array([query.find_point(point)[1] for point in points])
+    report("per-point loop:", len(points), time.perf_counter() - start)
+
+    start = time.perf_counter()
+    _, distances, _ = query.find(points)
+    report("batch:", len(points), time.perf_counter() - start)
+
+    start = time.perf_counter()
+    _, parallel_distances, _ = query.find(points, threads=0)
+    report("parallel batch:", len(points), time.perf_counter() - start)
+
+    assert np.allclose(loop_distances, distances, atol=1e-6)
+    assert np.array_equal(distances, parallel_distances)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+"""Closest point queries on meshes, backed by the cpom C++ library.
+
+Vertices, faces and query points are read in place when they are C-contiguous
+NumPy arrays of float32 and int32, and converted once otherwise. Batch queries
+release the GIL, so that other Python threads keep running meanwhile.
+"""
+
+import numpy as np
+
+from ._cpom import Query as _Query
+
+__all__ = ["ClosestPointQuery"]
+
+
+class ClosestPointQuery:
+    """Closest point query on a mesh of triangles or quads.
+
+    Args:
+        vertices: Array of shape (V, 3) of vertex coordinates.
+        faces: Array of shape (F, 3) or (F, 4) of vertex indices.
+        index: Spatial index, "octree", "bvh4" or "bvh8".
+        proxies: Bound octree nodes by proxies of their surface.
+        limit_surface: Query the Catmull-Clark limit surface of a quad cage.
+        prefetch: Number of search candidates whose data is prefetched.
+    """
+
+    def __init__(self, vertices, faces, index="octree", proxies=False,
+                 limit_surface=False, prefetch=1):
+        vertices = np.ascontiguousarray(vertices, dtype=np.float32)
+        faces = np.ascontiguousarray(faces, dtype=np.int32)
+        self._query = _Query(vertices, faces, index, proxies, limit_surface, prefetch)
+
+    def find(self, points, max_dist=np.inf, threads=1):
+        """Find the closest points on the mesh of many positions.
+
+        Args:
+            points: Array of shape (N, 3) of query positions.
+            max_dist: Distance beyond which points are not searched.
+            threads: Number of threads sharing the queries, all hardware
+                threads if zero or less.
+
+        Returns:
+            Tuple of arrays (closest points of shape (N, 3), distances of shape
+            (N,), face ids of shape (N,)). Face ids are -1, closest points NaN
+            and distances infinite where no point is closer than max_dist.
+        """
+        points = np.ascontiguousarray(points, dtype=np.float32).reshape(-1, 3)
+        closest_points = np.empty_like(points)
+        distances = np.empty(len(points), dtype=np.float32)
+        face_ids = np.empty(len(points), dtype=np.int32)
+        self._query.find(points, closest_points, distances, face_ids,
+                         float(max_dist), threads)
+        return closest_points, distances, face_ids
+
+    def find_point(self, point, max_dist=np.inf):
+        """Find the closest point on the mesh of a single position.
+
+        Returns:
+            Tuple (closest point as a tuple of 3 floats, distance, face id).
+        """
+        x, y, z = point
+        return self._query.find_point(float(x), float(y), float(z), float(max_dist))
@@ -0,0 +1,466 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <ClosestPointQuery.h>
+#include <ParallelChunks.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// CPython extension module exposing cpom::ClosestPointQuery.
+///
+/// Arrays are passed through the buffer protocol, so that NumPy arrays, or any
+/// other C-contiguous buffer, are read and written in place. The GIL is released
+/// while building the index and while querying.
+
+static_assert(sizeof(Point) == 3 * sizeof(float), "Points must be packed float triples");
+
+/// Class holding a Py_buffer of 4-byte items, released when destroyed.
+class Buffer
+{
+public:
+    Buffer()
+    : m_isAcquired(false),
+      m_rowCount(0),
+      m_columnCount(0)
+    { }
+
+    ~Buffer()
+    {
+        if (m_isAcquired)
+            PyBuffer_Release(&m_view);
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer &operator=(const Buffer&) = delete;
+
+    /// \brief Acquire the C-contiguous buffer of an object.
+    ///
+    /// \param[in] object Object exposing the buffer.
+    /// \param[in] name Name of the argument, used in error messages.
+    /// \param[in] formats Struct format characters accepted for the items.
+    /// \param[in] columnCount Number of items per row, of one-dimensional buffers.
+    /// Rows of two-dimensional buffers are their second dimension.
+    /// \param[in] isWritable True to request a writable buffer.
+    ///
+    /// \return False with a Python exception set if the buffer is not suitable.
+    bool acquire(PyObject *object, const char *name, const char *formats,
+                 Py_ssize_t columnCount, bool isWritable)
+    {
+        const int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (isWritable ? PyBUF_WRITABLE : 0);
+        if (PyObject_GetBuffer(object, &m_view, flags) != 0)
+            return false;
+        m_isAcquired = true;
+
+        // Formats may be prefixed by the native byte order.
+        const char *format = m_view.format ? m_view.format : "B";
+        if (format[0] == '@' || format[0] == '=')
+            ++format;
+        if (m_view.itemsize != 4 || std::strlen(format) != 1 || !std::strchr(formats, format[0]))
+        {
+            PyErr_Format(PyExc_TypeError, "%s must hold 4-byte items of a format among '%s'",
+                         name, formats);
+            return false;
+        }
+        if (m_view.ndim > 2)
+        {
+            PyErr_Format(PyExc_ValueError, "%s must have one or two dimensions", name);
+            return false;
+        }
+        const Py_ssize_t itemCount = m_view.len / m_view.itemsize;
+        m_columnCount = m_view.ndim == 2 ? m_view.shape[1] : columnCount;
+        if (m_columnCount <= 0 || itemCount % m_columnCount != 0)
+        {
+            PyErr_Format(PyExc_ValueError, "%s must have rows of %zd items", name, columnCount);
+            return false;
+        }
+        m_rowCount = itemCount / m_columnCount;
+        return true;
+    }
+
+    void *data() const { return m_view.buf; }
+    /// Return true if the items are unsigned integers, of format 'I'.
+    bool isUnsigned() const
+    {
+        const char *format = m_view.format ? m_view.format : "B";
+        return format[std::strlen(format) - 1] == 'I';
+    }
+    Py_ssize_t rowCount() const { return m_rowCount; }
+    Py_ssize_t columnCount() const { return m_columnCount; }
+
+private:
+    Py_buffer m_view;
+    bool m_isAcquired;
+    Py_ssize_t m_rowCount;
+    Py_ssize_t m_columnCount;
+};
+
+/// Mesh reading its vertices and faces from buffers, each face having the same
+/// number of vertices.
+class BufferMesh : public Mesh
+{
+public:
+    BufferMesh(const Point *vertices, std::size_t vertexCount,
+               const std::int32_t *vertexIds, std::size_t faceCount, std::size_t faceSize)
+    : m_vertices(vertices),
+      m_vertexCount(vertexCount),
+      m_vertexIds(vertexIds),
+      m_faceCount(faceCount),
+      m_faceSize(faceSize)
+    { }
+
+    /// \brief Check that faces reference existing vertices.
+    ///
+    /// \throw std::invalid_argument in the case a vertex id is out of range.
+    ///
+    void validate() const
+    {
+        const auto isOutOfRange = [this](std::int32_t id)
+        {
+            return id < 0 || static_cast<std::size_t>(id) >= m_vertexCount;
+        };
+        if (std::any_of(m_vertexIds, m_vertexIds + m_faceCount * m_faceSize, isOutOfRange))
+            throw std::invalid_argument("Vertex id out of range");
+    }
+
+    virtual std::vector<Point> getVertices() const
+    {
+        return std::vector<Point>(m_vertices, m_vertices + m_vertexCount);
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces(m_faceCount);
+        for (std::size_t i = 0; i < m_faceCount; ++i)
+        {
+            const std::int32_t *ids = m_vertexIds + i * m_faceSize;
+            faces[i].vertexIds.assign(ids, ids + m_faceSize);
+        }
+        return faces;
+    }
+
+private:
+    const Point *m_vertices;
+    std::size_t m_vertexCount;
+    const std::int32_t *m_vertexIds;
+    std::size_t m_faceCount;
+    std::size_t m_faceSize;
+};
+
+/// Set the Python exception matching a C++ exception.
+void setPythonError(const std::exception_ptr &error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    catch (const std::bad_alloc &)
+    {
+        PyErr_NoMemory();
+    }
+    catch (const std::exception &e)
+    {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+    catch (...)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Unknown error");
+    }
+}
+
+/// Return the index type of a given name, or set a Python exception and return false.
+bool parseIndexType(const char *name, IndexType &indexType)
+{
+    if (!std::strcmp(name, "octree"))
+        indexType = IndexType::Octree;
+    else if (!std::strcmp(name, "bvh4"))
+        indexType = IndexType::WideBvh4;
+    else if (!std::strcmp(name, "bvh8"))
+        indexType = IndexType::WideBvh8;
+    else
+    {
+        PyErr_Format(PyExc_ValueError, "Unknown index type '%s'", name);
+        return false;
+    }
+    return true;
+}
+
+/// \brief Find the closest points of a range of query points, and scatter the results
+/// to the output arrays.
+void findRange(const ClosestPointQuery &query, const Point *queryPoints,
+               std::size_t first, std::size_t last, float maxDist,
+               Point *points, float *distances, std::int32_t *faceIds)
+{
+    // Results are gathered by blocks, bounding the temporary memory.
+    constexpr std::size_t blockSize = 1024;
+    ClosestPointQuery::Result results[blockSize];
+    for (std::size_t begin = first; begin < last; begin += blockSize)
+    {
+        const std::size_t count = std::min(blockSize, last - begin);
+        query.find(queryPoints + begin, count, maxDist, results);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            points[begin + i] = results[i].point;
+            distances[begin + i] = results[i].distance;
+            faceIds[begin + i] = results[i].faceId;
+        }
+    }
+}
+
+/// Type of the Python objects wrapping a ClosestPointQuery.
+struct QueryObject
+{
+    PyObject_HEAD
+    ClosestPointQuery *query;
+};
+
+PyObject *Query_new(PyTypeObject *type, PyObject *, PyObject *)
+{
+    QueryObject *self = reinterpret_cast<QueryObject *>(type->tp_alloc(type, 0));
+    if (self)
+        self->query = nullptr;
+    return reinterpret_cast<PyObject *>(self);
+}
+
+void Query_dealloc(QueryObject *self)
+{
+    delete self->query;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+int Query_init(QueryObject *self, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = { "vertices", "faces", "index", "proxies",
+                                       "limit_surface", "prefetch", nullptr };
+    PyObject *verticesObject = nullptr;
+    PyObject *facesObject = nullptr;
+    const char *indexName = "octree";
+    int useProxies = 0;
+    int isLimitSurface = 0;
+    unsigned int prefetchDistance = QueryOptions().prefetchDistance;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|sppI", const_cast<char **>(keywords),
+                                     &verticesObject, &facesObject, &indexName,
+                                     &useProxies, &isLimitSurface, &prefetchDistance))
+        return -1;
+
+    BuildOptions options;
+    if (!parseIndexType(indexName, options.indexType))
+        return -1;
+    options.useProxyBounds = useProxies != 0;
+    options.surfaceType = isLimitSurface ? SurfaceType::CatmullClarkLimit : SurfaceType::Cage;
+    QueryOptions queryOptions;
+    queryOptions.prefetchDistance = prefetchDistance;
+
+    Buffer vertices;
+    Buffer faces;
+    if (!vertices.acquire(verticesObject, "vertices", "f", 3, false) ||
+        !faces.acquire(facesObject, "faces", "iI", 3, false))
+        return -1;
+    if (faces.columnCount() != 3 && faces.columnCount() != 4)
+    {
+        PyErr_SetString(PyExc_ValueError, "faces must have 3 or 4 columns");
+        return -1;
+    }
+    // Unsigned ids are read as int32, which they must fit.
+    const std::uint32_t *unsignedIds = static_cast<const std::uint32_t *>(faces.data());
+    const std::size_t idCount = static_cast<std::size_t>(faces.rowCount() * faces.columnCount());
+    if (faces.isUnsigned() &&
+        std::any_of(unsignedIds, unsignedIds + idCount, [](std::uint32_t id)
+                    {
+                        return id > static_cast<std::uint32_t>(
+                                        std::numeric_limits<std::int32_t>::max());
+                    }))
+    {
+        PyErr_SetString(PyExc_ValueError, "faces must hold vertex ids of at most 2^31 - 1");
+        return -1;
+    }
+    const BufferMesh mesh(static_cast<const Point *>(vertices.data()), vertices.rowCount(),
+                          static_cast<const std::int32_t *>(faces.data()), faces.rowCount(),
+                          faces.columnCount());
+
+    ClosestPointQuery *query = nullptr;
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+        mesh.validate();
+        query = new ClosestPointQuery(mesh, options, queryOptions);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if (error)
+    {
+        setPythonError(error);
+        return -1;
+    }
+    delete self->query;
+    self->query = query;
+    return 0;
+}
+
+PyObject *Query_find(QueryObject *self, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = { "points", "closest_points", "distances", "face_ids",
+                                       "max_dist", "threads", nullptr };
+    PyObject *pointsObject = nullptr;
+    PyObject *closestObject = nullptr;
+    PyObject *distancesObject = nullptr;
+    PyObject *faceIdsObject = nullptr;
+    float maxDist = std::numeric_limits<float>::infinity();
+    int threadCount = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|fi", const_cast<char **>(keywords),
+                                     &pointsObject, &closestObject, &distancesObject,
+                                     &faceIdsObject, &maxDist, &threadCount))
+        return nullptr;
+    if (!self->query)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Query is not initialized");
+        return nullptr;
+    }
+
+    Buffer points;
+    Buffer closest;
+    Buffer distances;
+    Buffer faceIds;
+    if (!points.acquire(pointsObject, "points", "f", 3, false) ||
+        !closest.acquire(closestObject, "closest_points", "f", 3, true) ||
+        !distances.acquire(distancesObject, "distances", "f", 1, true) ||
+        !faceIds.acquire(faceIdsObject, "face_ids", "iI", 1, true))
+        return nullptr;
+    const Py_ssize_t count = points.rowCount();
+    if (points.columnCount() != 3 || closest.columnCount() != 3 ||
+        closest.rowCount() != count || distances.rowCount() != count ||
+        faceIds.rowCount() != count)
+    {
+        PyErr_SetString(PyExc_ValueError, "Output arrays must match the shape of points");
+        return nullptr;
+    }
+    if (threadCount < 0)
+        threadCount = 0;
+
+    const ClosestPointQuery &query = *self->query;
+    const Point *queryPoints = static_cast<const Point *>(points.data());
+    Point *closestPoints = static_cast<Point *>(closest.data());
+    float *closestDistances = static_cast<float *>(distances.data());
+    std::int32_t *closestFaceIds = static_cast<std::int32_t *>(faceIds.data());
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+        // Each thread queries a contiguous range, the first one on this thread.
+        forEachChunk(static_cast<std::size_t>(count), static_cast<unsigned>(threadCount),
+                     [&](std::size_t begin, std::size_t end)
+                     {
+                         findRange(query, queryPoints, begin, end, maxDist,
+                                   closestPoints, closestDistances, closestFaceIds);
+                     });
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if (error)
+    {
+        setPythonError(error);
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *Query_find_point(QueryObject *self, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = { "x", "y", "z", "max_dist", nullptr };
+    float x, y, z;
+    float maxDist = std::numeric_limits<float>::infinity();
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "fff|f", const_cast<char **>(keywords),
+                                     &x, &y, &z, &maxDist))
+        return nullptr;
+    if (!self->query)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Query is not initialized");
+        return nullptr;
+    }
+    ClosestPointQuery::Result result;
+    try
+    {
+        result = self->query->find(Point(x, y, z), maxDist);
+    }
+    catch (...)
+    {
+        setPythonError(std::current_exception());
+        return nullptr;
+    }
+    return Py_BuildValue("((fff)fi)", result.point.x, result.point.y, result.point.z,
+                         result.distance, result.faceId);
+}
+
+PyMethodDef queryMethods[] = {
+    { "find", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(Query_find)),
+      METH_VARARGS | METH_KEYWORDS,
+      "find(points, closest_points, distances, face_ids, max_dist=inf, threads=1)\n\n"
+      "Find the closest points of rows of float32 points, writing them, their distances\n"
+      "and their face ids, or -1 if none is closer than max_dist, to the output arrays.\n"
+      "threads <= 0 uses all hardware threads. The GIL is released meanwhile." },
+    { "find_point", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(Query_find_point)),
+      METH_VARARGS | METH_KEYWORDS,
+      "find_point(x, y, z, max_dist=inf) -> ((x, y, z), distance, face_id)\n\n"
+      "Find the closest point of a single position." },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+PyTypeObject queryType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+PyModuleDef moduleDef = { PyModuleDef_HEAD_INIT };
+
+} // anonymous namespace
+
+PyMODINIT_FUNC PyInit__cpom()
+{
+    queryType.tp_name = "cpom._cpom.Query";
+    queryType.tp_basicsize = sizeof(QueryObject);
+    queryType.tp_flags = Py_TPFLAGS_DEFAULT;
+    queryType.tp_doc = "Query(vertices, faces, index='octree', proxies=False, "
+                       "limit_surface=False, prefetch=1)\n\n"
+                       "Closest point query on a mesh of float32 vertex rows and int32 faces\n"
+                       "of 3 or 4 vertex ids per row, read in place.";
+    queryType.tp_new = Query_new;
+    queryType.tp_init = reinterpret_cast<initproc>(Query_init);
+    queryType.tp_dealloc = reinterpret_cast<destructor>(Query_dealloc);
+    queryType.tp_methods = queryMethods;
+    if (PyType_Ready(&queryType) < 0)
+        return nullptr;
+
+    moduleDef.m_name = "cpom._cpom";
+    moduleDef.m_doc = "Closest point queries on meshes.";
+    moduleDef.m_size = -1;
+    PyObject *module = PyModule_Create(&moduleDef);
+    if (!module)
+        return nullptr;
+    Py_INCREF(&queryType);
+    if (PyModule_AddObject(module, "Query", reinterpret_cast<PyObject *>(&queryType)) < 0)
+    {
+        Py_DECREF(&queryType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
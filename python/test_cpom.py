@@ -0,0 +1,97 @@
+"""Unit test of the cpom Python bindings."""
+
+import threading
+import unittest
+
+import numpy as np
+
+import cpom
+
+
+def plane_mesh(resolution):
+    """Return the vertices and quad faces of a unit square plane mesh."""
+    steps = np.linspace(0.0, 1.0, resolution + 1, dtype=np.float32)
+    x, y = np.meshgrid(steps, steps)
+    vertices = np.stack([x.ravel(), y.ravel(), np.zeros(x.size, np.float32)], axis=1)
+    ids = np.arange((resolution + 1) ** 2, dtype=np.int32).reshape(resolution + 1, -1)
+    faces = np.stack([ids[:-1, :-1].ravel(), ids[:-1, 1:].ravel(),
+                      ids[1:, 1:].ravel(), ids[1:, :-1].ravel()], axis=1)
+    return vertices, faces
+
+
+class ClosestPointQueryTest(unittest.TestCase):
+
+    def setUp(self):
+        self.vertices, self.faces = plane_mesh(20)
+        generator = np.random.default_rng(0)
+        self.points = generator.uniform(-0.2, 1.2, (1000, 3)).astype(np.float32)
+
+    def test_batch_matches_single_queries(self):
+        for index in ("octree", "bvh4", "bvh8"):
+            query = cpom.ClosestPointQuery(self.vertices, self.faces, index=index)
+            points, distances, face_ids = query.find(self.points)
+            for i in range(0, len(self.points), 97):
+                point, distance, face_id = query.find_point(self.points[i])
+                np.testing.assert_allclose(points[i], point, atol=1e-6)
+                self.assertAlmostEqual(distances[i], distance, places=6)
+                self.assertEqual(face_ids[i], face_id)
+
+    def test_closest_points_on_plane(self):
+        query = cpom.ClosestPointQuery(self.vertices, self.faces)
+        points, distances, _ = query.find(self.points)
+        expected = np.clip(self.points, 0.0, 1.0)
+        expected[:, 2] = 0.0
+        np.testing.assert_allclose(points, expected, atol=1e-5)
+        np.testing.assert_allclose(distances, np.linalg.norm(self.points - expected, axis=1),
+                                   atol=1e-5)
+
+    def test_parallel_queries_match_serial_queries(self):
+        query = cpom.ClosestPointQuery(self.vertices, self.faces, index="bvh4")
+        serial = query.find(self.points)
+        for threads in (2, 0):
+            parallel = query.find(self.points, threads=threads)
+            for serial_array, parallel_array in zip(serial, parallel):
+                np.testing.assert_array_equal(serial_array, parallel_array)
+
+    def test_queries_from_python_threads(self):
+        query = cpom.ClosestPointQuery(self.vertices, self.faces)
+        expected = query.find(self.points)[1]
+        results = [None] * 4
+
+        def run(i):
+            results[i] = query.find(self.points)[1]
+
+        threads = [threading.Thread(target=run, args=(i,)) for i in range(len(results))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for distances in results:
+            np.testing.assert_array_equal(distances, expected)
+
+    def test_max_dist(self):
+        query = cpom.ClosestPointQuery(self.vertices, self.faces)
+        points, distances, face_ids = query.find([[0.5, 0.5, 1.0]], max_dist=0.5)
+        self.assertEqual(face_ids[0], -1)
+        self.assertTrue(np.isinf(distances[0]))
+        self.assertTrue(np.isnan(points[0]).all())
+
+    def test_invalid_arguments(self):
+        with self.assertRaises(ValueError):
+            cpom.ClosestPointQuery(np.zeros((0, 3)), np.zeros((0, 3)))
+        with self.assertRaises(ValueError):
+            cpom.ClosestPointQuery(self.vertices, self.faces, index="kdtree")
+        with self.assertRaises(ValueError):
+            cpom.ClosestPointQuery(self.vertices, self.faces[:, :2])
+        for vertex_id in (len(self.vertices), 50000000, -1):
+            faces = self.faces.copy()
+            faces[3, 2] = vertex_id
+            with self.assertRaises(ValueError):
+                cpom.ClosestPointQuery(self.vertices, faces)
+        with self.assertRaises(ValueError):
+            cpom._Query(self.vertices, np.array([[0, 1, 2**31]], dtype=np.uint32),
+                        "octree", False, False, 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,25 @@
+#ifndef __BOUNDS_H__
+#define __BOUNDS_H__
+
+#include <Float3.h>
+
+namespace cpom
+{
+
+/// Type defining an Axis Aligned Bounding Cube.
+struct AABCube
+{
+    Point center;
+    float halfWidth;
+};
+
+/// Type defining an Axis Aligned Bounding Box.
+struct AABBox
+{
+    Point center;
+    Float3 halfWidth;
+};
+
+} //namespace cpom
+
+#endif // __BOUNDS_H__
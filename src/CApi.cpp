@@ -0,0 +1,299 @@
+#include <cpom.h>
+
+#include <ClosestPointQuery.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cpom;
+
+struct cpom_index
+{
+    std::shared_ptr<const MeshIndex> index;
+};
+
+struct cpom_query
+{
+    ClosestPointQuery query;
+};
+
+namespace
+{
+
+/// True if options of a given type hold a member, their caller knowing of it.
+#define CPOM_HAS_MEMBER(options, Type, member) \
+    ((options).struct_size >= offsetof(Type, member) + sizeof((options).member))
+
+/// Message of the last error of each thread.
+thread_local std::string lastErrorMessage;
+
+/// Record the message of an error and return its status.
+cpom_status fail(const cpom_status status, const char *message)
+{
+    lastErrorMessage = message;
+    return status;
+}
+
+/// Call a function, turning the exceptions it throws into a status.
+template<class Function>
+cpom_status guard(Function function)
+{
+    try
+    {
+        function();
+        return CPOM_OK;
+    }
+    catch (const std::invalid_argument &e)
+    {
+        return fail(CPOM_INVALID_ARGUMENT, e.what());
+    }
+    catch (const std::bad_alloc &)
+    {
+        return fail(CPOM_OUT_OF_MEMORY, "Out of memory");
+    }
+    catch (const std::exception &e)
+    {
+        return fail(CPOM_INTERNAL_ERROR, e.what());
+    }
+    catch (...)
+    {
+        return fail(CPOM_INTERNAL_ERROR, "Unknown error");
+    }
+}
+
+/// Mesh reading its vertices and faces from the buffers of the caller.
+class BufferMesh : public Mesh
+{
+public:
+    BufferMesh(const float *vertices, std::size_t vertexCount,
+               const std::int32_t *faceVertexIds, std::size_t faceCount,
+               const std::uint32_t *faceSizes, std::uint32_t faceSize)
+    : m_vertices(vertices),
+      m_vertexCount(vertexCount),
+      m_faceVertexIds(faceVertexIds),
+      m_faceCount(faceCount),
+      m_faceSizes(faceSizes),
+      m_faceSize(faceSize)
+    { }
+
+    /// \brief Check that all vertex ids are within the vertex buffer.
+    ///
+    /// \throw std::invalid_argument if a vertex id is out of range.
+    void validate() const
+    {
+        std::size_t idCount = 0;
+        for (std::size_t i = 0; i < m_faceCount; ++i)
+            idCount += getFaceSize(i);
+        const auto isOutOfRange = [this](std::int32_t id)
+        {
+            return id < 0 || static_cast<std::size_t>(id) >= m_vertexCount;
+        };
+        if (std::any_of(m_faceVertexIds, m_faceVertexIds + idCount, isOutOfRange))
+            throw std::invalid_argument("Vertex id out of range");
+    }
+
+    virtual std::vector<Point> getVertices() const
+    {
+        std::vector<Point> vertices(m_vertexCount);
+        for (std::size_t i = 0; i < m_vertexCount; ++i)
+            vertices[i] = Point(m_vertices[3*i], m_vertices[3*i + 1], m_vertices[3*i + 2]);
+        return vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces(m_faceCount);
+        const std::int32_t *ids = m_faceVertexIds;
+        for (std::size_t i = 0; i < m_faceCount; ++i)
+        {
+            const std::uint32_t faceSize = getFaceSize(i);
+            faces[i].vertexIds.assign(ids, ids + faceSize);
+            ids += faceSize;
+        }
+        return faces;
+    }
+
+private:
+    std::uint32_t getFaceSize(std::size_t faceIndex) const
+    {
+        return m_faceSizes ? m_faceSizes[faceIndex] : m_faceSize;
+    }
+
+    const float *m_vertices;
+    std::size_t m_vertexCount;
+    const std::int32_t *m_faceVertexIds;
+    std::size_t m_faceCount;
+    const std::uint32_t *m_faceSizes;
+    std::uint32_t m_faceSize;
+};
+
+/// Return the build options set by the caller, defaults for the members it does not know.
+BuildOptions convertBuildOptions(const cpom_build_options *options)
+{
+    BuildOptions result;
+    if (!options)
+        return result;
+    if (CPOM_HAS_MEMBER(*options, cpom_build_options, index_type))
+    {
+        switch (options->index_type)
+        {
+        case CPOM_INDEX_OCTREE: result.indexType = IndexType::Octree; break;
+        case CPOM_INDEX_WIDE_BVH4: result.indexType = IndexType::WideBvh4; break;
+        case CPOM_INDEX_WIDE_BVH8: result.indexType = IndexType::WideBvh8; break;
+        default: throw std::invalid_argument("Unknown index type");
+        }
+    }
+    if (CPOM_HAS_MEMBER(*options, cpom_build_options, surface_type))
+    {
+        switch (options->surface_type)
+        {
+        case CPOM_SURFACE_CAGE: result.surfaceType = SurfaceType::Cage; break;
+        case CPOM_SURFACE_CATMULL_CLARK_LIMIT: result.surfaceType = SurfaceType::CatmullClarkLimit; break;
+        default: throw std::invalid_argument("Unknown surface type");
+        }
+    }
+    if (CPOM_HAS_MEMBER(*options, cpom_build_options, reorder_for_locality))
+        result.reorderForLocality = options->reorder_for_locality != 0;
+    if (CPOM_HAS_MEMBER(*options, cpom_build_options, planar_quad_tolerance))
+        result.planarQuadTolerance = options->planar_quad_tolerance;
+    if (CPOM_HAS_MEMBER(*options, cpom_build_options, use_proxy_bounds))
+        result.useProxyBounds = options->use_proxy_bounds != 0;
+    if (CPOM_HAS_MEMBER(*options, cpom_build_options, use_huge_pages))
+        result.useHugePages = options->use_huge_pages != 0;
+    return result;
+}
+
+/// Return the query options set by the caller, defaults for the members it does not know.
+QueryOptions convertQueryOptions(const cpom_query_options *options)
+{
+    QueryOptions result;
+    if (options && CPOM_HAS_MEMBER(*options, cpom_query_options, prefetch_distance))
+        result.prefetchDistance = options->prefetch_distance;
+    return result;
+}
+
+#undef CPOM_HAS_MEMBER
+
+} // anonymous namespace
+
+uint32_t cpom_abi_version(void)
+{
+    return CPOM_ABI_VERSION;
+}
+
+const char *cpom_last_error_message(void)
+{
+    return lastErrorMessage.c_str();
+}
+
+void cpom_build_options_init(cpom_build_options *options)
+{
+    if (!options)
+        return;
+    const BuildOptions defaults;
+    options->struct_size = sizeof(cpom_build_options);
+    options->index_type = CPOM_INDEX_OCTREE;
+    options->surface_type = CPOM_SURFACE_CAGE;
+    options->reorder_for_locality = defaults.reorderForLocality ? 1 : 0;
+    options->planar_quad_tolerance = defaults.planarQuadTolerance;
+    options->use_proxy_bounds = defaults.useProxyBounds ? 1 : 0;
+    options->use_huge_pages = defaults.useHugePages ? 1 : 0;
+}
+
+void cpom_query_options_init(cpom_query_options *options)
+{
+    if (!options)
+        return;
+    options->struct_size = sizeof(cpom_query_options);
+    options->prefetch_distance = QueryOptions().prefetchDistance;
+}
+
+cpom_status cpom_index_create(const float *vertices, size_t vertex_count,
+                              const int32_t *face_vertex_ids, size_t face_count,
+                              const uint32_t *face_sizes, uint32_t face_size,
+                              const cpom_build_options *options, cpom_index **index)
+{
+    if (!index)
+        return fail(CPOM_INVALID_ARGUMENT, "Null output handle");
+    *index = nullptr;
+    if ((!vertices && vertex_count) || (!face_vertex_ids && face_count))
+        return fail(CPOM_INVALID_ARGUMENT, "Null buffer");
+    return guard([&]()
+    {
+        const BufferMesh mesh(vertices, vertex_count, face_vertex_ids, face_count,
+                              face_sizes, face_size);
+        mesh.validate();
+        std::unique_ptr<cpom_index> result(new cpom_index);
+        result->index = std::make_shared<const MeshIndex>(mesh, convertBuildOptions(options));
+        *index = result.release();
+    });
+}
+
+void cpom_index_destroy(cpom_index *index)
+{
+    delete index;
+}
+
+cpom_status cpom_query_create(const cpom_index *index, const cpom_query_options *options,
+                              cpom_query **query)
+{
+    if (!query)
+        return fail(CPOM_INVALID_ARGUMENT, "Null output handle");
+    *query = nullptr;
+    if (!index)
+        return fail(CPOM_INVALID_ARGUMENT, "Null index");
+    return guard([&]()
+    {
+        *query = new cpom_query{ ClosestPointQuery(index->index, convertQueryOptions(options)) };
+    });
+}
+
+void cpom_query_destroy(cpom_query *query)
+{
+    delete query;
+}
+
+cpom_status cpom_query_find(const cpom_query *query, const float *points, size_t count,
+                            float max_dist, float *closest_points, float *distances,
+                            int32_t *face_ids)
+{
+    if (!query)
+        return fail(CPOM_INVALID_ARGUMENT, "Null query");
+    if (!points && count)
+        return fail(CPOM_INVALID_ARGUMENT, "Null buffer");
+    return guard([&]()
+    {
+        // Points are gathered and results scattered by blocks, so that buffers of
+        // the caller need no particular alignment nor layout beyond float triples.
+        constexpr std::size_t blockSize = 256;
+        Point queryPoints[blockSize];
+        ClosestPointQuery::Result results[blockSize];
+        for (std::size_t begin = 0; begin < count; begin += blockSize)
+        {
+            const std::size_t blockCount = std::min(blockSize, count - begin);
+            const float *blockPoints = points + 3*begin;
+            for (std::size_t i = 0; i < blockCount; ++i)
+                queryPoints[i] = Point(blockPoints[3*i], blockPoints[3*i + 1], blockPoints[3*i + 2]);
+            query->query.find(queryPoints, blockCount, max_dist, results);
+            for (std::size_t i = 0; i < blockCount; ++i)
+            {
+                const std::size_t j = begin + i;
+                if (closest_points)
+                {
+                    closest_points[3*j] = results[i].point.x;
+                    closest_points[3*j + 1] = results[i].point.y;
+                    closest_points[3*j + 2] = results[i].point.z;
+                }
+                if (distances)
+                    distances[j] = results[i].distance;
+                if (face_ids)
+                    face_ids[j] = results[i].faceId;
+            }
+        }
+    });
+}
@@ -1,13 +1,26 @@
 #include <ClosestPointQuery.h>
 
+#include <CompactOctree.h>
 #include <Float3.h>
+#include <LocalityReorder.h>
+#include <MeshletStore.h>
 #include <OctreeNode.h>
+#include <ParallelChunks.h>
+#include <QueryTrace.h>
+#include <SubdivisionPatch.h>
+#include <TraceSpan.h>
+#include <WideBvh.h>
 
+#include <algorithm>
+#include <bitset>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <numeric>
-#include <queue>
 #include <stdexcept>
 #include <utility>
 
@@ -20,19 +33,91 @@ namespace
 constexpr float nan = std::numeric_limits<float>::quiet_NaN();
 constexpr float infinity = std::numeric_limits<float>::infinity();
 
-/// Type defining an Axis Aligned Bounding Box.
-struct AABBox
-{
-    Point center;
-    Float3 halfWidth;
-};
-
 // Type aliases
 using Extent = std::pair<Point, Point>;
 using ClosestPointSpec = std::pair<Point, float>;
 
+template<class T>
+using Allocator = PolymorphicAllocator<T>;
+template<class T>
+using Array = std::vector<T, Allocator<T>>;
+
 using OctreeElement = std::pair<const Face *, const AABBox>;
-using Node = OctreeNode<OctreeElement>;
+using Node = OctreeNode<OctreeElement, Allocator<OctreeElement>>;
+using FaceIndex = std::uint32_t;
+using MeshletIndex = std::uint32_t;
+using PatchIndex = std::uint32_t;
+using PartitionedSpace = CompactOctree<MeshletIndex, Allocator<MeshletIndex>>;
+template<int Width>
+using Hierarchy = WideBvh<MeshletIndex, Width, Allocator<MeshletIndex>>;
+
+/// Type holding the closest point found so far by a search.
+struct SearchResult
+{
+    Point point;
+    float sqrDistance;
+    int faceId;
+    /// \brief Lower bound of the squared distance to any face other than faceId.
+    ///
+    /// It is the distance to the second closest face tested, unless a node left
+    /// unvisited, or a face beyond the maximum search distance, may be closer.
+    float sqrRunnerUp;
+    /// Number of index nodes visited by the search.
+    std::uint32_t nodeCount;
+    /// Number of faces, or patches, whose closest point was computed by the search.
+    std::uint32_t faceCount;
+};
+
+constexpr SearchResult noResult = { Point(nan), infinity, -1, infinity, 0, 0 };
+
+/// Maximal number of Newton iterations refining the closest point on a patch.
+constexpr int maxNewtonIterations = 8;
+
+/// Parameter step under which Newton iterations on a patch have converged.
+constexpr float newtonTolerance = 1e-6f;
+
+/// Number of faces a cell holds at most when filled by 3 faces per level of depth.
+constexpr float maxOctreeFill = 3.0f;
+
+/// \brief Cost of visiting an octree node, in units of the cost of computing the
+/// closest point on a face, used by the cost models of the subdivision.
+///
+/// Visiting a node pops it from the search heap and pushes its children, and
+/// visiting a leaf loads meshlets likely out of cache: both weigh more than the
+/// faces a small leaf saves.
+constexpr float octreeNodeCost = 16.0f;
+
+/// Number of faces up to which cells are not split by the cost models.
+constexpr std::size_t minOctreeSplitFaces = 8;
+
+/// Size of the buffer on the stack holding the search heap of a query.
+constexpr std::size_t heapBufferSize = 8 * 1024;
+
+/// Size of a cache line, the granularity of prefetches.
+constexpr std::uintptr_t cacheLineSize = 64;
+
+/// Hint the processor to load the cache lines holding a range of memory.
+inline void prefetch(const void *address, const std::size_t size)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(address);
+    const std::uintptr_t firstLine = begin & ~(cacheLineSize - 1);
+    const std::uintptr_t lastLine = (begin + size - 1) & ~(cacheLineSize - 1);
+    for (std::uintptr_t line = firstLine; line <= lastLine; line += cacheLineSize)
+        __builtin_prefetch(reinterpret_cast<const void *>(line));
+#else
+    (void)address;
+    (void)size;
+#endif
+}
+
+/// Return the memory resource from which the index is allocated.
+inline MemoryResource &getIndexMemoryResource(const BuildOptions &options)
+{
+    if (options.indexMemoryResource)
+        return *options.indexMemoryResource;
+    return options.useHugePages ? getHugePageMemoryResource() : getDefaultMemoryResource();
+}
 
 // Function that tests if an Octree element intersects an AACube.
 inline bool intersect(const AABCube &cube, const OctreeElement &element)
@@ -185,7 +270,7 @@ ClosestPointSpec computeClosestPointOnTriangle(const Point &vertex0,
                     t2 = 1.0f;
                 else
                     t2 = num/denom;
-                s2 = 1 - s2;
+                s2 = 1.0f - t2;
             }
             else
             {
@@ -220,33 +305,375 @@ ClosestPointSpec computeClosestPointOnTriangle(const Point &vertex0,
     return ClosestPointSpec(closestPoint, sqrDistance);
 }
 
-/// \brief Return the closest point on the face.
+/// Return the closest point on a quad, split in two triangles along its first diagonal.
+inline ClosestPointSpec computeClosestPointOnQuad(const Point &vertex0,
+                                                  const Point &vertex1,
+                                                  const Point &vertex2,
+                                                  const Point &vertex3,
+                                                  const Point &fromPoint)
+{
+    const auto result1 = computeClosestPointOnTriangle(vertex0, vertex1, vertex2, fromPoint);
+    const auto result2 = computeClosestPointOnTriangle(vertex2, vertex3, vertex0, fromPoint);
+    return result2.second < result1.second ? result2 : result1;
+}
+
+/// Return the point of a segment closest to a specified position.
+inline Point computeClosestPointOnSegment(const Point &start,
+                                          const Point &end,
+                                          const Point &fromPoint)
+{
+    const Float3 edge = end - start;
+    const float sqrLength = edge.sqrLength();
+    const float t = sqrLength > 0.0f ? (fromPoint - start).dot(edge) / sqrLength : 0.0f;
+    return start + edge * std::min(std::max(t, 0.0f), 1.0f);
+}
+
+/// \brief Compute the point on a planar convex quad closest to a specified position.
+///
+/// The position is projected onto the plane through the center of the quad, normal
+/// to its diagonals. If the projection lies inside the quad, it is the closest
+/// point. Otherwise the closest point lies on an edge the projection is outside of,
+/// and the closest point on each such edge is computed instead.
+///
+/// \pre The quad must be planar and convex.
+///
+/// \param[in] vertex0 Coordinate of the first vertex.
+/// \param[in] vertex1 Coordinate of the second vertex.
+/// \param[in] vertex2 Coordinate of the third vertex.
+/// \param[in] vertex3 Coordinate of the fourth vertex.
+/// \param[in] fromPoint Coordinate from which we want to find the closest point.
+///
+/// \return Pair (coordinate, squared distance) for the closest point.
+///
+inline ClosestPointSpec computeClosestPointOnPlanarQuad(const Point &vertex0,
+                                                        const Point &vertex1,
+                                                        const Point &vertex2,
+                                                        const Point &vertex3,
+                                                        const Point &fromPoint)
+{
+    // Vertices turn counterclockwise around the normal: the projection is outside
+    // of the edges it sees clockwise. Offsets along the normal do not change the
+    // side, so the position is tested in place of its projection.
+    const Float3 normal = (vertex2 - vertex0).cross(vertex3 - vertex1);
+    const Point *vertices[4] = { &vertex0, &vertex1, &vertex2, &vertex3 };
+    bool isOutside[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const Point &start = *vertices[i];
+        const Point &end = *vertices[(i+1) % 4];
+        isOutside[i] = (end - start).cross(fromPoint - start).dot(normal) < 0.0f;
+    }
+    if (!(isOutside[0] || isOutside[1] || isOutside[2] || isOutside[3]))
+    {
+        const Point center = (vertex0 + vertex1 + vertex2 + vertex3) * 0.25f;
+        const Float3 offset = normal * (normal.dot(fromPoint - center) / normal.sqrLength());
+        return ClosestPointSpec(fromPoint - offset, offset.sqrLength());
+    }
+
+    ClosestPointSpec result(Point(nan), infinity);
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!isOutside[i])
+            continue;
+        const Point edgePoint = computeClosestPointOnSegment(*vertices[i], *vertices[(i+1) % 4],
+                                                             fromPoint);
+        const float sqrDistance = (fromPoint - edgePoint).sqrLength();
+        if (sqrDistance < result.second)
+            result = ClosestPointSpec(edgePoint, sqrDistance);
+    }
+    return result;
+}
+
+/// \brief Return the parameters (s, t) of a point of a triangle, such that
+/// point = vertex0 + s (vertex1 - vertex0) + t (vertex2 - vertex0).
+///
+/// \pre The vertices must not be collinear.
+inline std::pair<float, float> computeTriangleCoordinates(const Point &vertex0,
+                                                          const Point &vertex1,
+                                                          const Point &vertex2,
+                                                          const Point &point)
+{
+    const Float3 edge0 = vertex1 - vertex0;
+    const Float3 edge1 = vertex2 - vertex0;
+    const Float3 offset = point - vertex0;
+    const float a = edge0.dot(edge0);
+    const float b = edge0.dot(edge1);
+    const float c = edge1.dot(edge1);
+    const float d = edge0.dot(offset);
+    const float e = edge1.dot(offset);
+    const float det = a*c - b*b;
+    return std::make_pair((c*d - b*e) / det, (a*e - b*d) / det);
+}
+
+/// \brief Compute the point on a bicubic patch closest to a specified position.
 ///
-/// \pre The face must have 3 or 4 vertices.
+/// The parameters of the closest point on the two triangles spanned by the corners
+/// of the patch seed Newton iterations on the squared distance, clamped to the
+/// domain of the patch. A parameter on a side of the domain, that the gradient
+/// pushes outwards, stays there while the other one is refined along that side.
+/// Where the squared distance is not convex, Gauss-Newton steps are taken instead.
 ///
-/// \param[in] face Face on which to find the closest point.
-/// \param[in] vertices Sequence of vertices of the underlying mesh.
-/// \param[in] queryPoint Coordinate from which we want to find the closest point.
+/// \param[in] patch Patch on which the closest point is computed.
+/// \param[in] fromPoint Coordinate from which we want to find the closest point.
 ///
-/// \return Pair (coordinate, squared distance) for the closest point on the face.
+/// \return Pair (coordinate, squared distance) for the closest point.
 ///
-/// \throw std::invalid_argument if the face has an unsupported number of vertices.
+/// \throw std::invalid_argument if the corners of the patch are collinear.
 ///
-inline ClosestPointSpec computeClosestPointOnFace(const Face &face,
-                                                  const std::vector<Point> &vertices,
-                                                  const Point &queryPoint)
+ClosestPointSpec computeClosestPointOnPatch(const BicubicPatch &patch,
+                                            const Point &fromPoint)
 {
-    if (face.vertexIds.size() < 3 || face.vertexIds.size() > 4)
-        throw std::invalid_argument("Face has unsupported number of vertices");
-    const Point &v0 = vertices[face.vertexIds[0]];
-    const Point &v1 = vertices[face.vertexIds[1]];
-    const Point &v2 = vertices[face.vertexIds[2]];
-    const auto result1 = computeClosestPointOnTriangle(v0, v1, v2, queryPoint);
-    if (face.vertexIds.size() == 3)
-        return result1;
-    const Point &v3 = vertices[face.vertexIds[3]];
-    const auto result2 = computeClosestPointOnTriangle(v2, v3, v0, queryPoint);
-    return result2.second < result1.second ? result2 : result1;
+    const Point corner00 = evaluatePatch(patch, 0.0f, 0.0f).position;
+    const Point corner10 = evaluatePatch(patch, 1.0f, 0.0f).position;
+    const Point corner11 = evaluatePatch(patch, 1.0f, 1.0f).position;
+    const Point corner01 = evaluatePatch(patch, 0.0f, 1.0f).position;
+    const auto seed1 = computeClosestPointOnTriangle(corner00, corner10, corner11, fromPoint);
+    const auto seed2 = computeClosestPointOnTriangle(corner11, corner01, corner00, fromPoint);
+    float u, v;
+    if (seed1.second <= seed2.second)
+    {
+        const auto st = computeTriangleCoordinates(corner00, corner10, corner11, seed1.first);
+        u = st.first + st.second;
+        v = st.second;
+    }
+    else
+    {
+        const auto st = computeTriangleCoordinates(corner11, corner01, corner00, seed2.first);
+        u = 1.0f - st.first - st.second;
+        v = 1.0f - st.second;
+    }
+    const auto clampParameter = [](float t) { return std::min(std::max(t, 0.0f), 1.0f); };
+    u = clampParameter(u);
+    v = clampParameter(v);
+
+    // Steps may overshoot far from the seed: the closest sample is returned.
+    ClosestPointSpec best(Point(nan), infinity);
+    for (int iteration = 0; iteration <= maxNewtonIterations; ++iteration)
+    {
+        const PatchSample sample = evaluatePatch(patch, u, v);
+        const Float3 offset = sample.position - fromPoint;
+        const float sqrDistance = offset.sqrLength();
+        if (sqrDistance < best.second)
+            best = ClosestPointSpec(sample.position, sqrDistance);
+        if (iteration == maxNewtonIterations)
+            break;
+
+        const float gu = sample.du.dot(offset);
+        const float gv = sample.dv.dot(offset);
+        float huu = sample.du.dot(sample.du) + sample.duu.dot(offset);
+        float huv = sample.du.dot(sample.dv) + sample.duv.dot(offset);
+        float hvv = sample.dv.dot(sample.dv) + sample.dvv.dot(offset);
+        if (huu <= 0.0f || hvv <= 0.0f || huu*hvv - huv*huv <= 0.0f)
+        {
+            huu = sample.du.dot(sample.du);
+            huv = sample.du.dot(sample.dv);
+            hvv = sample.dv.dot(sample.dv);
+        }
+
+        const bool isUFixed = (u <= 0.0f && gu > 0.0f) || (u >= 1.0f && gu < 0.0f);
+        const bool isVFixed = (v <= 0.0f && gv > 0.0f) || (v >= 1.0f && gv < 0.0f);
+        float stepU = 0.0f;
+        float stepV = 0.0f;
+        if (!isUFixed && !isVFixed)
+        {
+            const float det = huu*hvv - huv*huv;
+            if (det <= 0.0f)
+                break;
+            stepU = (huv*gv - hvv*gu) / det;
+            stepV = (huv*gu - huu*gv) / det;
+        }
+        else if (!isUFixed && huu > 0.0f)
+        {
+            stepU = -gu / huu;
+        }
+        else if (!isVFixed && hvv > 0.0f)
+        {
+            stepV = -gv / hvv;
+        }
+
+        const float nextU = clampParameter(u + stepU);
+        const float nextV = clampParameter(v + stepV);
+        const bool hasConverged = std::abs(nextU - u) + std::abs(nextV - v) < newtonTolerance;
+        u = nextU;
+        v = nextV;
+        if (hasConverged)
+            break;
+    }
+    return best;
+}
+
+/// Kind of the faces of a mesh, selecting the specialization of the search.
+enum class FaceKind
+{
+    Triangles,
+    Quads,
+    Mixed,
+    /// Patches of a limit surface, instead of the faces of the mesh.
+    Patches
+};
+
+/// \brief Return the kind of faces of a mesh.
+///
+/// Meshes holding faces with an unsupported number of vertices are mixed, so that
+/// an error is raised when these faces are visited.
+inline FaceKind computeFaceKind(const std::vector<Face> &faces)
+{
+    const auto hasVertexCount = [](std::size_t vertexCount)
+    {
+        return [vertexCount](const Face &face) { return face.vertexIds.size() == vertexCount; };
+    };
+    if (std::all_of(faces.begin(), faces.end(), hasVertexCount(3)))
+        return FaceKind::Triangles;
+    if (std::all_of(faces.begin(), faces.end(), hasVertexCount(4)))
+        return FaceKind::Quads;
+    return FaceKind::Mixed;
+}
+
+/// \brief Closest point computation for meshes of triangles only.
+///
+/// Along with QuadFaces and MixedFaces, it specializes the search at compile time,
+/// so that the loops over the faces of leaves only branch on the face type for
+/// mixed meshes. The Planar member type is the policy used for the meshlets whose
+/// quads are all planar and convex.
+struct TriangleFaces
+{
+    using Planar = TriangleFaces;
+
+    static ClosestPointSpec computeClosestPoint(const MeshletFace &face,
+                                                const Point *vertices,
+                                                const Point &queryPoint)
+    {
+        return computeClosestPointOnTriangle(vertices[face.vertices[0]],
+                                             vertices[face.vertices[1]],
+                                             vertices[face.vertices[2]],
+                                             queryPoint);
+    }
+};
+
+/// Closest point computation for meshes of quadrilaterals only.
+template<bool areQuadsPlanar>
+struct QuadFaces
+{
+    using Planar = QuadFaces<true>;
+
+    static ClosestPointSpec computeClosestPoint(const MeshletFace &face,
+                                                const Point *vertices,
+                                                const Point &queryPoint)
+    {
+        const Point &v0 = vertices[face.vertices[0]];
+        const Point &v1 = vertices[face.vertices[1]];
+        const Point &v2 = vertices[face.vertices[2]];
+        const Point &v3 = vertices[face.vertices[3]];
+        return areQuadsPlanar ? computeClosestPointOnPlanarQuad(v0, v1, v2, v3, queryPoint)
+                              : computeClosestPointOnQuad(v0, v1, v2, v3, queryPoint);
+    }
+};
+
+/// \brief Closest point computation for meshes mixing faces of any number of vertices.
+///
+/// \throw std::invalid_argument if a face has an unsupported number of vertices.
+///
+template<bool areQuadsPlanar>
+struct MixedFaces
+{
+    using Planar = MixedFaces<true>;
+
+    static ClosestPointSpec computeClosestPoint(const MeshletFace &face,
+                                                const Point *vertices,
+                                                const Point &queryPoint)
+    {
+        if (face.isUnsupported())
+            throw std::invalid_argument("Face has unsupported number of vertices");
+        if (face.isTriangle())
+            return TriangleFaces::computeClosestPoint(face, vertices, queryPoint);
+        return QuadFaces<areQuadsPlanar>::computeClosestPoint(face, vertices, queryPoint);
+    }
+};
+
+/// \brief Closest point computation for the patches of limit surfaces.
+///
+/// Leaves of the index then reference patches instead of meshlets, which the
+/// visit of leaf elements is specialized for.
+struct LimitPatches
+{ };
+
+/// \brief Return the normal of a face, of twice its area for triangles.
+///
+/// Faces with an unsupported number of vertices have a null normal.
+inline Float3 computeFaceNormal(const MeshletFace &face, const Point *vertices)
+{
+    if (face.isUnsupported())
+        return Float3(0.0f);
+    const Point &v0 = vertices[face.vertices[0]];
+    const Point &v1 = vertices[face.vertices[1]];
+    const Point &v2 = vertices[face.vertices[2]];
+    return face.isTriangle() ? (v1 - v0).cross(v2 - v0)
+                             : (v2 - v0).cross(vertices[face.vertices[3]] - v1);
+}
+
+/// Return the normal of a patch at its center.
+inline Float3 computePatchNormal(const BicubicPatch &patch)
+{
+    const PatchSample center = evaluatePatch(patch, 0.5f, 0.5f);
+    return center.du.cross(center.dv);
+}
+
+/// Type of a FaceFilter prepared for the search.
+struct SearchFilter
+{
+    /// True if face normals are checked against the direction.
+    bool hasDirection;
+    /// Unit direction of the filter.
+    Float3 direction;
+    /// Cosine and sine of the maximum angle, in [0, pi).
+    float cosMaxAngle;
+    float sinMaxAngle;
+    /// Mask of the groups accepted.
+    std::uint64_t groupMask;
+    /// Predicate of the face filter, or null if empty.
+    const std::function<bool(int)> *predicate;
+};
+
+/// \brief Return the filter prepared for the search, false if it accepts all faces.
+///
+/// The filter refers to the predicate of faceFilter, which must outlive the search.
+inline bool prepareFilter(const FaceFilter &faceFilter, SearchFilter &filter)
+{
+    constexpr float pi = 3.14159265f;
+    const float length = faceFilter.direction.length();
+    const float maxAngle = std::max(faceFilter.maxAngle, 0.0f);
+    filter.hasDirection = length > 0.0f && faceFilter.maxAngle < pi;
+    filter.direction = filter.hasDirection ? faceFilter.direction / length : Float3(0.0f);
+    filter.cosMaxAngle = std::cos(maxAngle);
+    filter.sinMaxAngle = std::sin(maxAngle);
+    filter.groupMask = faceFilter.groupMask;
+    filter.predicate = faceFilter.predicate ? &faceFilter.predicate : nullptr;
+    return filter.hasDirection || filter.groupMask != ~std::uint64_t(0) || filter.predicate;
+}
+
+/// Return true if a group mask holds a group.
+inline bool hasGroup(const std::uint64_t groupMask, const unsigned group)
+{
+    return (groupMask >> group) & 1u;
+}
+
+/// \brief Return true if a filter accepts a face of a given group.
+///
+/// The normal, of any length, and the id of the face are only computed by
+/// getNormal and getFaceId if the checks before them pass.
+template<class GetNormal, class GetFaceId>
+inline bool isAccepted(const SearchFilter &filter, const unsigned group,
+                       const GetNormal &getNormal, const GetFaceId &getFaceId)
+{
+    if (!hasGroup(filter.groupMask, group))
+        return false;
+    if (filter.hasDirection)
+    {
+        const Float3 normal = getNormal();
+        if (normal.dot(filter.direction) < filter.cosMaxAngle * normal.length())
+            return false;
+    }
+    return !filter.predicate || (*filter.predicate)(getFaceId());
 }
 
 /// Grow a given extent to include a given point and returns the result.
@@ -282,6 +709,134 @@ inline AABBox computeBounds(const Extent &extent)
     return bounds;
 }
 
+/// Return the bounding box of the vertices of a face.
+inline AABBox computeFaceBounds(const Face &face, const std::vector<Point> &vertices)
+{
+    const auto growFaceExtent = [&vertices](const Extent &extent,
+                                            const int vertexId)
+    {
+        return growExtent(extent, vertices[vertexId]);
+    };
+    const Extent faceExtent = std::accumulate(face.vertexIds.begin(),
+                                              face.vertexIds.end(),
+                                              Extent(Point(infinity), Point(-infinity)),
+                                              growFaceExtent);
+    return computeBounds(faceExtent);
+}
+
+/// Return the bounding box of the control points of a patch, which bound the patch.
+inline AABBox computePatchBounds(const BicubicPatch &patch)
+{
+    const Point *controlPoints = &patch.controlPoints[0][0];
+    return computeBounds(std::accumulate(controlPoints, controlPoints + 16,
+                                         Extent(Point(infinity), Point(-infinity)),
+                                         growExtent));
+}
+
+/// Return true if a cube and a region of space overlap.
+inline bool overlaps(const AABCube &cube, const OctreeDepthLimit &region)
+{
+    const Point cubeMin = cube.center - Float3(cube.halfWidth);
+    const Point cubeMax = cube.center + Float3(cube.halfWidth);
+    return (cubeMin.x <= region.max.x && region.min.x <= cubeMax.x &&
+            cubeMin.y <= region.max.y && region.min.y <= cubeMax.y &&
+            cubeMin.z <= region.max.z && region.min.z <= cubeMax.z);
+}
+
+/// Return the depth at which a cell is no longer split.
+inline int computeMaxDepth(const AABCube &bounds, const BuildOptions &options)
+{
+    int maxDepth = -1;
+    for (const OctreeDepthLimit &limit : options.octreeDepthLimits)
+    {
+        if (overlaps(bounds, limit))
+            maxDepth = std::max(maxDepth, limit.maxDepth);
+    }
+    return maxDepth < 0 ? options.maxOctreeDepth : maxDepth;
+}
+
+/// \brief Return true if splitting a cell is expected to make queries cheaper.
+///
+/// A query visiting the cell tests all its faces if it is kept as a leaf. Once
+/// split, it visits each child with a probability given by the ratio of their
+/// surface areas, 1/4, or of their volumes, 1/8, then tests the faces of that
+/// child. Faces overlapping several children are tested in each of them, so
+/// splitting a cell whose faces are not separated by the split costs more.
+///
+/// \param[in] subdivision Cost model, other than OctreeSubdivision::Fill.
+/// \param[in] faceCount Number of faces of the cell.
+/// \param[in] childFaceCounts Number of faces each child would hold.
+///
+inline bool isSplitBeneficial(const OctreeSubdivision subdivision,
+                              const std::size_t faceCount,
+                              const std::size_t (&childFaceCounts)[8])
+{
+    if (faceCount <= minOctreeSplitFaces)
+        return false;
+    const float childProbability = subdivision == OctreeSubdivision::VolumeCost ? 0.125f
+                                                                                : 0.25f;
+    float splitCost = 0.0f;
+    for (const std::size_t childFaceCount : childFaceCounts)
+    {
+        if (childFaceCount > 0)
+            splitCost += childProbability * (octreeNodeCost + childFaceCount);
+    }
+    return splitCost < static_cast<float>(faceCount);
+}
+
+/// \brief Type of the proxy of the surface in an octree node.
+///
+/// The faces of the node lie in a slab, between two planes of a common normal.
+/// Along with the cube of the node, it bounds the distance to the faces from below
+/// much more tightly than the cube alone where the surface is flat. A vertex of one
+/// of the faces bounds the distance from above.
+struct NodeProxy
+{
+    /// Unit normal of the planes.
+    Float3 normal;
+    /// Offsets of the planes along the normal.
+    float minOffset;
+    float maxOffset;
+    /// Vertex of a face of the node.
+    Point vertex;
+};
+
+/// \brief Type of a cone bounding the normals of the faces of an octree node.
+///
+/// Normals lie within the half angle of the axis.
+struct NormalCone
+{
+    /// Unit axis of the cone.
+    Float3 axis;
+    float cosHalfAngle;
+    float sinHalfAngle;
+};
+
+/// \brief Return true if a node whose normals lie in a cone may hold faces accepted
+/// by a filter.
+///
+/// Normals of the cone are at least as far from the filter direction as its axis,
+/// minus its half angle: the node holds no face accepted unless the axis lies within
+/// the half angle plus the maximum angle of the direction.
+inline bool mayHoldAcceptedFaces(const NormalCone &cone, const SearchFilter &filter)
+{
+    // Any axis does once the sum of the angles reaches pi.
+    if (cone.cosHalfAngle <= -filter.cosMaxAngle)
+        return true;
+    return cone.axis.dot(filter.direction) >=
+           cone.cosHalfAngle * filter.cosMaxAngle - cone.sinHalfAngle * filter.sinMaxAngle;
+}
+
+/// \brief Return an upper bound of the squared distance to the faces of a node proxy.
+///
+/// The distance to the vertex is slightly enlarged, so that rounding errors do not
+/// let it drop below the lower bound of the node holding the closest point.
+inline float computeSqrUpperBound(const Point &queryPoint, const NodeProxy &proxy)
+{
+    constexpr float relativeMargin = 1e-5f;
+    return (queryPoint - proxy.vertex).sqrLength() * (1.0f + relativeMargin);
+}
+
 /// Return the squared distance to the closest point on a bounding cube.
 inline float computeSqrDistanceToBounds(const Point &queryPoint,
                                         const AABCube &bounds)
@@ -292,178 +847,1599 @@ inline float computeSqrDistanceToBounds(const Point &queryPoint,
                   std::max(d.z, 0.0f)).sqrLength();
 }
 
-} // anonymous namespace
-
-struct ClosestPointQuery::Impl
+/// \brief Return a lower bound of the squared distance to the part of a node cube
+/// within the slab of its proxy.
+///
+/// For any point x of both, the offset from the position to x splits into a part
+/// along the normal, at least the distance d to the slab, and a part from the
+/// position moved onto the slab to x, at least the distance to the cube from there.
+/// The squared distance is thus at least d^2 plus the squared distance from the moved
+/// position to the cube.
+inline float computeSqrDistanceToProxy(const Point &queryPoint,
+                                       const AABCube &bounds,
+                                       const NodeProxy &proxy)
 {
-    std::vector<Point> m_vertices;
-    std::vector<Face> m_faces;
-    std::unique_ptr<Node> m_partitionedSpace;
+    const float offset = proxy.normal.dot(queryPoint);
+    const float slabOffset = std::min(std::max(offset, proxy.minOffset), proxy.maxOffset);
+    const float distance = offset - slabOffset;
+    const Point slabPoint = queryPoint - proxy.normal * distance;
+    return distance * distance + computeSqrDistanceToBounds(slabPoint, bounds);
+}
 
-    Impl(const Mesh &m);
-    void partitionSpace();
-    Point processPartitionedSpace(const Point&, float) const;
-    Point processMesh(const Point&, float) const;
-};
+/// \brief Compute the squared distances to the eight children cubes of a node.
+///
+/// Children are a regular subdivision of the parent cube: along each axis a child
+/// is either in the lower or the upper half, so only two clamped distances per axis
+/// are needed. They are combined in a single 8-lane pass that compilers vectorize.
+/// Lanes of children that do not exist are set to infinity.
+///
+/// \param[in] queryPoint Coordinate from which distances are computed.
+/// \param[in] parentBounds Bounds of the parent node.
+/// \param[in] childMask Mask of existing children, bit i being set if child i exists.
+/// \param[out] sqrDistances Squared distances to each child, indexed like children.
+///
+inline void computeChildrenSqrDistances(const Point &queryPoint,
+                                        const AABCube &parentBounds,
+                                        const unsigned childMask,
+                                        float sqrDistances[8])
+{
+    const float childHalfWidth = parentBounds.halfWidth * 0.5f;
+    const Float3 offset = queryPoint - parentBounds.center;
 
-ClosestPointQuery::ClosestPointQuery(const Mesh &m)
-: m_impl(new ClosestPointQuery::Impl(m) )
-{ }
+    // Squared clamped distance along one axis to the lower and upper child slabs.
+    const auto sqrAxisDistance = [childHalfWidth](const float axisOffset,
+                                                  const float side)
+    {
+        const float d = std::max(std::abs(axisOffset - side * childHalfWidth) -
+                                 childHalfWidth, 0.0f);
+        return d*d;
+    };
+    const float x[2] = { sqrAxisDistance(offset.x, -1.0f), sqrAxisDistance(offset.x, 1.0f) };
+    const float y[2] = { sqrAxisDistance(offset.y, -1.0f), sqrAxisDistance(offset.y, 1.0f) };
+    const float z[2] = { sqrAxisDistance(offset.z, -1.0f), sqrAxisDistance(offset.z, 1.0f) };
 
-ClosestPointQuery::~ClosestPointQuery() = default;
+    // Child i is on the upper side of x, y, z when bit 0, 1, 2 of i is set.
+    const float laneX[8] = { x[0], x[1], x[0], x[1], x[0], x[1], x[0], x[1] };
+    const float laneY[8] = { y[0], y[0], y[1], y[1], y[0], y[0], y[1], y[1] };
+    const float laneZ[8] = { z[0], z[0], z[0], z[0], z[1], z[1], z[1], z[1] };
+    for (int i = 0; i < 8; ++i)
+    {
+        const float sqrDistance = laneX[i] + laneY[i] + laneZ[i];
+        sqrDistances[i] = (childMask & (1u << i)) ? sqrDistance : infinity;
+    }
+}
 
-Point ClosestPointQuery::operator() (const Point& queryPoint, float maxDist) const
+/// \brief Compute the squared distances to the children boxes of a hierarchy node.
+///
+/// Boxes are stored as a structure of arrays, so that the loop over children
+/// is vectorized. Unused children have empty boxes, hence an infinite distance.
+///
+/// \param[in] queryPoint Coordinate from which distances are computed.
+/// \param[in] node Node of the hierarchy.
+/// \param[out] sqrDistances Squared distances to each child.
+///
+template<int Width>
+inline void computeChildrenSqrDistances(const Point &queryPoint,
+                                        const typename Hierarchy<Width>::Node &node,
+                                        float sqrDistances[Width])
 {
-    if (m_impl->m_partitionedSpace)
-        return m_impl->processPartitionedSpace(queryPoint, maxDist*maxDist);
-    return m_impl->processMesh(queryPoint, maxDist*maxDist);
+    for (int i = 0; i < Width; ++i)
+    {
+        const float dx = std::max(std::max(node.minX[i] - queryPoint.x,
+                                           queryPoint.x - node.maxX[i]), 0.0f);
+        const float dy = std::max(std::max(node.minY[i] - queryPoint.y,
+                                           queryPoint.y - node.maxY[i]), 0.0f);
+        const float dz = std::max(std::max(node.minZ[i] - queryPoint.z,
+                                           queryPoint.z - node.maxZ[i]), 0.0f);
+        sqrDistances[i] = dx*dx + dy*dy + dz*dz;
+    }
 }
 
-ClosestPointQuery::Impl::Impl(const Mesh &m)
-: m_vertices(m.getVertices()),
-  m_faces(m.getFaces())
+/// \brief Update a search result with the closest point on a face, if closer and
+/// within sqrMaxDist, or its runner-up distance otherwise.
+///
+/// The id of the face is only read when needed: a face stored in several leaves
+/// is not its own runner-up.
+template<class GetFaceId>
+inline void updateResult(const ClosestPointSpec &faceClosest,
+                         const float sqrMaxDist,
+                         GetFaceId getFaceId,
+                         SearchResult &result)
 {
-    if (m_vertices.empty())
+    if (faceClosest.second < sqrMaxDist && faceClosest.second < result.sqrDistance)
     {
-        throw std::invalid_argument("Empty mesh");
+        result.sqrRunnerUp = std::min(result.sqrRunnerUp, result.sqrDistance);
+        result.point = faceClosest.first;
+        result.sqrDistance = faceClosest.second;
+        result.faceId = getFaceId();
     }
-
-    constexpr int minSpacePartitioningFaces = 32;
-    if (m_faces.size() >= minSpacePartitioningFaces)
+    else if (faceClosest.second < result.sqrRunnerUp &&
+             (faceClosest.second != result.sqrDistance || getFaceId() != result.faceId))
     {
-        partitionSpace();
+        result.sqrRunnerUp = faceClosest.second;
     }
 }
 
-/// Iterator through all faces and find closest point on face.
-inline Point ClosestPointQuery::Impl::processMesh(const Point& queryPoint,
-                                                  const float sqrMaxDist) const
-{
-    const auto &vertices = m_vertices;
-    const auto reduceClosestPointOnFace = [&](const ClosestPointSpec &inputClosest,
-                                              const Face &face)
-    {
-        // Compute the closest point on this face and return the closest of this
-        // or the input, respecting sqrMaxDist.
-        const auto faceClosest = computeClosestPointOnFace(face, vertices, queryPoint);
-        return faceClosest.second < sqrMaxDist && faceClosest.second < inputClosest.second ?
-            faceClosest : inputClosest;
-    };
-    return std::accumulate(m_faces.begin(),
-                           m_faces.end(),
-                           ClosestPointSpec(Point(nan), infinity),
-                           reduceClosestPointOnFace).first;
+/// \brief Return the distance a query point may move while the face found stays the
+/// closest, up to a tolerance, or stays farther than the maximum search distance if
+/// none was found.
+///
+/// The distance to any face changes by at most the distance moved. The face found
+/// thus stays closer than any other, up to the tolerance, as long as the query
+/// moves by less than half the gap between their distances plus the tolerance,
+/// and within the maximum search distance as long as it moves by less than the
+/// margin left. The radius is slightly shrunk to absorb rounding errors.
+inline float computeSafeRadius(const SearchResult &result, const float maxDist,
+                               const float tolerance)
+{
+    constexpr float relativeMargin = 1e-5f;
+    const float runnerUpDistance = std::sqrt(result.sqrRunnerUp);
+    float radius;
+    if (result.faceId < 0)
+    {
+        radius = runnerUpDistance > maxDist ? runnerUpDistance - maxDist : 0.0f;
+    }
+    else
+    {
+        const float distance = std::sqrt(result.sqrDistance);
+        radius = std::min(0.5f * (runnerUpDistance - distance + tolerance),
+                          maxDist - distance);
+    }
+    return std::max(radius - relativeMargin * (runnerUpDistance < infinity ? runnerUpDistance
+                                                                            : 0.0f), 0.0f);
 }
 
-/// Partition space and sort faces into partitions.
-void ClosestPointQuery::Impl::partitionSpace()
+/// \brief Return the squared distance beyond which index nodes are pruned until a
+/// face is found, infinity to prune none.
+///
+/// See QueryOptions::noFacePruningFactor. Factors below 1 are taken as 1, so that
+/// no face within the maximum search distance is missed.
+inline float computeSqrPruningDist(const float maxDist, const float factor)
 {
-    // Compute the extent of the space taken by all vertices.
-    Extent meshExtent = std::accumulate(m_vertices.begin(),
-                                        m_vertices.end(),
-                                        Extent(Point(infinity), Point(-infinity)),
-                                        growExtent);
+    if (!(factor > 0.0f))
+        return infinity;
+    const float pruningDist = maxDist * std::max(factor, 1.0f);
+    return pruningDist * pruningDist;
+}
 
-    // Construct the root octree node bounding the mesh.
-    m_partitionedSpace = std::unique_ptr<Node>(new Node( computeCubicBounds(meshExtent) ));
-    auto& rootNode = *m_partitionedSpace;
+} // anonymous namespace
 
-    // Function that inserts a face into the octree.
-    const auto &vertices = m_vertices;
-    const auto insertFace = [&vertices, &rootNode](const Face &face)
+struct MeshIndex::Impl
+{
+    /// \brief Type of a position along the path from the root of the index to a
+    /// query point.
+    ///
+    /// Batch queries advance it by one node each time they visit a node for the
+    /// previous query point, prefetching the nodes it reaches.
+    struct PathCursor
     {
-        const auto growFaceExtent = [&vertices](const Extent &extent,
-                                                const int vertexId)
-        {
-            return growExtent(extent, vertices[vertexId]);
-        };
-        // Compute extent of face vertices.
-        Extent faceExtent = std::accumulate(face.vertexIds.begin(),
-                                            face.vertexIds.end(),
-                                            Extent(Point(infinity), Point(-infinity)),
-                                            growFaceExtent);
-        // Insert this face into the octree.
-        rootNode.insert(OctreeElement(&face, computeBounds(faceExtent)),
-                        intersect);
+        Point point;
+        /// Index of the octree node, or hierarchy reference, reached.
+        std::uint32_t ref;
+        /// Number of elements of the hierarchy leaf reached, if any.
+        std::uint32_t elementCount;
+        /// Bounds of the octree node reached.
+        AABCube bounds;
+        bool isDone;
     };
-    // Insert all faces into the octree.
-    std::for_each(m_faces.begin(), m_faces.end(), insertFace);
+
+    MeshletStore m_meshlets;
+    /// Proxies of the octree nodes, indexed like nodes, if built.
+    Array<NodeProxy> m_nodeProxies;
+    /// Cones bounding the normals of the octree nodes, indexed like nodes, if built.
+    Array<NormalCone> m_nodeCones;
+    /// Masks of the groups of the faces below each octree node, indexed like nodes,
+    /// or below each child of hierarchy nodes, indexed by node * Width + slot, if
+    /// faces have groups.
+    Array<std::uint64_t> m_nodeGroupMasks;
+    /// Groups of the patches, indexed like patches, if faces have groups.
+    Array<std::uint8_t> m_patchGroups;
+    /// Patches of the limit surface, indexed in place of meshlets if not empty.
+    Array<BicubicPatch> m_patches;
+    /// Cage faces of the patches, indexed like patches.
+    Array<std::uint32_t> m_patchFaceIds;
+    PartitionedSpace m_partitionedSpace;
+    Hierarchy<4> m_hierarchy4;
+    Hierarchy<8> m_hierarchy8;
+    FaceKind m_faceKind;
+    /// Depth of the deepest octree cells allowed by the build options.
+    int m_maxOctreeDepth;
+    /// Number of faces of the mesh, and of distinct vertices they use, each stored
+    /// once or more in meshlets.
+    std::size_t m_meshFaceCount;
+    std::size_t m_meshVertexCount;
+
+    Impl(const Mesh &m, const BuildOptions &options);
+    MemoryFootprint getMemoryFootprint() const;
+    IndexLayout getLayout() const;
+    template<int Width> void addHierarchyLayout(const Hierarchy<Width>&, IndexLayout&) const;
+    template<class Elements> void addLeafLayout(const Elements&, std::uint32_t, std::uint32_t,
+                                                IndexLeaf, IndexLayout&) const;
+    void partitionSpace(const std::vector<Face>&, const std::vector<Point>&,
+                        const BuildOptions&, MeshletBuilder&, MemoryResource&,
+                        MemoryResource&);
+    template<int Width> Hierarchy<Width> buildHierarchy(const std::vector<Face>&,
+                                                        const std::vector<Point>&,
+                                                        MeshletBuilder&,
+                                                        MemoryResource&,
+                                                        MemoryResource&) const;
+    void buildNodeProxies();
+    Float3 accumulateNodeNormals(std::uint32_t, std::vector<Float3>&) const;
+    void extendProxy(std::uint32_t, NodeProxy&) const;
+    void buildNormalCones();
+    void extendNormalCone(std::uint32_t, NormalCone&) const;
+    std::uint64_t getElementGroupMask(std::uint32_t) const;
+    std::uint64_t accumulateGroupMasks(std::uint32_t);
+    template<int Width> void buildGroupMasks(const Hierarchy<Width>&);
+    template<int Width> Hierarchy<Width> buildPatchHierarchy(MemoryResource&,
+                                                             MemoryResource&) const;
+    inline void prefetchMeshlet(MeshletIndex) const;
+    template<class Faces> inline void prefetchElement(std::uint32_t) const;
+    inline void prefetchNodeData(std::uint32_t) const;
+    template<int Width> inline void prefetchRef(const Hierarchy<Width>&, std::uint32_t,
+                                                std::uint32_t) const;
+    void advancePath(PathCursor&) const;
+    template<int Width, class Faces> void advancePath(const Hierarchy<Width>&,
+                                                      PathCursor&) const;
+    template<class Faces> inline void visitElement(std::uint32_t, const Point&, float,
+                                                   const SearchFilter*, SearchResult&) const;
+    template<class Faces> inline void visitMeshlet(MeshletIndex, const Point&, float,
+                                                   const SearchFilter*, SearchResult&) const;
+    template<class Faces> inline void visitFaces(const Meshlet&, const Point&, float,
+                                                 const SearchFilter*, SearchResult&) const;
+    SearchResult process(const Point&, float, float, const SearchFilter*, unsigned,
+                         const Point*) const;
+    template<class Faces> SearchResult processIndex(const Point&, float, float,
+                                                    const SearchFilter*, unsigned,
+                                                    const Point*) const;
+    template<class Faces> SearchResult processPartitionedSpace(const Point&, float, float,
+                                                               const SearchFilter*, unsigned,
+                                                               const Point*) const;
+    template<int Width, class Faces> SearchResult processHierarchy(const Hierarchy<Width>&,
+                                                                   const Point&, float, float,
+                                                                   const SearchFilter*,
+                                                                   unsigned,
+                                                                   const Point*) const;
+    template<class Faces> SearchResult processMesh(const Point&, float,
+                                                   const SearchFilter*) const;
+};
+
+MeshIndex::MeshIndex(const Mesh &m, const BuildOptions &options)
+: m_impl(new MeshIndex::Impl(m, options) )
+{ }
+
+MeshIndex::~MeshIndex() = default;
+
+MemoryFootprint MeshIndex::getMemoryFootprint() const
+{
+    MemoryFootprint footprint = m_impl->getMemoryFootprint();
+    footprint.objects += sizeof(MeshIndex);
+    return footprint;
 }
 
-/// Walk partitioned space and return the closest point on face.
-inline Point ClosestPointQuery::Impl::processPartitionedSpace(const Point& queryPoint,
-                                                              const float sqrMaxDist) const
+IndexLayout MeshIndex::getLayout() const
 {
-    // Initialize the result.
-    auto result = ClosestPointSpec(Point(nan), infinity);
+    return m_impl->getLayout();
+}
 
-    // Initialize a heap whose top is the node closest to queryPoint.
-    using HeapEntry = std::pair<std::reference_wrapper<const Node>, float>;
-    const auto heapCompare = [&queryPoint](const HeapEntry &a, const HeapEntry &b)
-    {
-        return (a.second > b.second);
-    };
-    using HeapContainer = std::vector<HeapEntry>;
-    using HeapCompareType = decltype(heapCompare);
-    using Heap = std::priority_queue< HeapEntry,
-                                      HeapContainer,
-                                      HeapCompareType >;
-    Heap heap(heapCompare);
-
-    // Prepare octree visitor functions.
-    const auto &vertices = m_vertices;
-    // When visiting an element (face)..
-    const auto visitElement = [&](const OctreeElement &element)
-    {
-        // .. compute the closest point to it and update the global result,
-        // respecting sqrMaxDist.
-        assert(element.first);
-        const auto &face = *(element.first);
-        const auto faceClosest = computeClosestPointOnFace(face, vertices, queryPoint);
-        if (faceClosest.second < sqrMaxDist && faceClosest.second < result.second)
-            result = faceClosest;
-    };
+ClosestPointQuery::ClosestPointQuery(const Mesh &m, const BuildOptions &options,
+                                     const QueryOptions &queryOptions)
+: m_index(std::make_shared<const MeshIndex>(m, options)),
+  m_queryOptions(queryOptions)
+{ }
 
-    // When visiting an octree child..
-    const auto visitChild = [&queryPoint, &heap, &result](Node const &child)
+ClosestPointQuery::ClosestPointQuery(std::shared_ptr<const MeshIndex> index,
+                                     const QueryOptions &queryOptions)
+: m_index(std::move(index)),
+  m_queryOptions(queryOptions)
+{
+    if (!m_index)
     {
-        // ..if the child is closer than the closest point currently found..
-        const float nodeSqrDist = computeSqrDistanceToBounds( queryPoint,
-                                                              child.getBounds() );
-        if (nodeSqrDist < result.second)
-        {
-            //.. then add it to the heap.
-            heap.push( HeapEntry(child, nodeSqrDist) );
-        }
-    };
+        throw std::invalid_argument("Null index");
+    }
+}
 
-    // Initialize the heap with the octree root.
-    const auto &rootNode = *m_partitionedSpace;
-    const float rootSqrDist = computeSqrDistanceToBounds( queryPoint,
-                                                          rootNode.getBounds() );
-    heap.push( HeapEntry(std::cref(rootNode), rootSqrDist) );
+Point ClosestPointQuery::operator() (const Point& queryPoint, float maxDist) const
+{
+    return find(queryPoint, maxDist).point;
+}
 
-    // Do a Best First Search over the octree:
-    // while the heap has nodes and the top one is closer than the current result,
-    while (!heap.empty() && heap.top().second < result.second)
-    {
-        // Eat the top of the heap.
-        const Node &node = heap.top().first.get();
-        heap.pop();
+ClosestPointQuery::Result ClosestPointQuery::find(const Point& queryPoint, float maxDist) const
+{
+    return find(queryPoint, maxDist, FaceFilter());
+}
 
-        if (node.isLeaf())
-        {
-            // If it's a leaf, visit the elements (faces).
-            node.accept(visitElement);
-        }
-        else
-        {
-            // Otherwise, visit the children nodes.
-            node.accept(visitChild);
+ClosestPointQuery::Result ClosestPointQuery::find(const Point& queryPoint, float maxDist,
+                                                  const FaceFilter &faceFilter) const
+{
+    if (m_queryOptions.traceRecorder)
+        m_queryOptions.traceRecorder->record(&queryPoint, 1, maxDist);
+    SearchFilter filter;
+    const bool isFiltered = prepareFilter(faceFilter, filter);
+    const float sqrPruningDist = computeSqrPruningDist(maxDist,
+                                                       m_queryOptions.noFacePruningFactor);
+    const SearchResult result = m_index->m_impl->process(queryPoint, maxDist*maxDist,
+                                                         sqrPruningDist,
+                                                         isFiltered ? &filter : nullptr,
+                                                         m_queryOptions.prefetchDistance,
+                                                         nullptr);
+    return Result{ result.point, std::sqrt(result.sqrDistance), result.faceId,
+                   computeSafeRadius(result, maxDist, m_queryOptions.safeRadiusTolerance) };
+}
+
+void ClosestPointQuery::find(const Point *queryPoints, std::size_t count, float maxDist,
+                             Result *results) const
+{
+    Statistics statistics;
+    find(queryPoints, count, maxDist, results, statistics);
+}
+
+void ClosestPointQuery::find(const Point *queryPoints, std::size_t count, float maxDist,
+                             Result *results, Statistics &statistics) const
+{
+    find(queryPoints, count, maxDist, FaceFilter(), results, statistics);
+}
+
+void ClosestPointQuery::find(const Point *queryPoints, std::size_t count, float maxDist,
+                             Result *results, unsigned threadCount) const
+{
+    forEachChunk(count, threadCount,
+                 [this, queryPoints, maxDist, results](std::size_t begin, std::size_t end)
+                 {
+                     find(queryPoints + begin, end - begin, maxDist, results + begin);
+                 });
+}
+
+void ClosestPointQuery::find(const Point *queryPoints, std::size_t count, float maxDist,
+                             const FaceFilter &faceFilter, Result *results,
+                             Statistics &statistics) const
+{
+    TraceSpan span("find batch", count);
+    if (m_queryOptions.traceRecorder)
+        m_queryOptions.traceRecorder->record(queryPoints, count, maxDist);
+    const float sqrMaxDist = maxDist*maxDist;
+    const float sqrPruningDist = computeSqrPruningDist(maxDist,
+                                                       m_queryOptions.noFacePruningFactor);
+    SearchFilter filter;
+    const SearchFilter *filterUsed = prepareFilter(faceFilter, filter) ? &filter : nullptr;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Point *nextQueryPoint = (i + 1 < count) ? &queryPoints[i + 1] : nullptr;
+        const SearchResult result = m_index->m_impl->process(queryPoints[i], sqrMaxDist,
+                                                             sqrPruningDist, filterUsed,
+                                                             m_queryOptions.prefetchDistance,
+                                                             nextQueryPoint);
+        results[i] = Result{ result.point, std::sqrt(result.sqrDistance), result.faceId,
+                             computeSafeRadius(result, maxDist,
+                                               m_queryOptions.safeRadiusTolerance) };
+        statistics.nodeCount += result.nodeCount;
+        statistics.faceCount += result.faceCount;
+    }
+    statistics.queryCount += count;
+}
+
+MeshIndex::Impl::Impl(const Mesh &m, const BuildOptions &options)
+: m_meshlets(getIndexMemoryResource(options)),
+  m_nodeProxies(getIndexMemoryResource(options)),
+  m_nodeCones(getIndexMemoryResource(options)),
+  m_nodeGroupMasks(getIndexMemoryResource(options)),
+  m_patchGroups(getIndexMemoryResource(options)),
+  m_patches(getIndexMemoryResource(options)),
+  m_patchFaceIds(getIndexMemoryResource(options)),
+  m_partitionedSpace(Allocator<MeshletIndex>(getIndexMemoryResource(options))),
+  m_hierarchy4(Allocator<MeshletIndex>(getIndexMemoryResource(options))),
+  m_hierarchy8(Allocator<MeshletIndex>(getIndexMemoryResource(options))),
+  m_faceKind(FaceKind::Mixed),
+  m_maxOctreeDepth(options.maxOctreeDepth),
+  m_meshFaceCount(0),
+  m_meshVertexCount(0)
+{
+    TraceSpan buildSpan("build index");
+
+    // The mesh is only needed while building: queries only read meshlets.
+    TraceSpan copySpan("copy mesh");
+    std::vector<Point> vertices(m.getVertices());
+    std::vector<Face> faces(m.getFaces());
+    copySpan.end();
+    if (vertices.empty())
+    {
+        throw std::invalid_argument("Empty mesh");
+    }
+    const bool hasGroups = !options.faceGroups.empty();
+    if (hasGroups && options.faceGroups.size() != faces.size())
+    {
+        throw std::invalid_argument("Face groups not indexed like faces");
+    }
+    if (hasGroups && *std::max_element(options.faceGroups.begin(),
+                                       options.faceGroups.end()) >= 64)
+    {
+        throw std::invalid_argument("Face group above 63");
+    }
+
+    // Temporary data is drawn from an arena, released in one shot once built.
+    // Element lists of octree nodes grow while inserting faces: a pool on top of
+    // the arena reuses the blocks they leave behind.
+    MonotonicBuffer buildArena(getDefaultMemoryResource(), 1024 * 1024);
+    PoolResource buildPool(buildArena);
+    MemoryResource &scratch = options.buildMemoryResource ? *options.buildMemoryResource
+                                                          : buildPool;
+    MemoryResource &indexResource = getIndexMemoryResource(options);
+
+    // Small meshes are processed face by face, in their original order.
+    constexpr int minSpacePartitioningFaces = 32;
+    const bool isPartitioned = faces.size() >= minSpacePartitioningFaces;
+
+    // Limit surfaces index the patches of each face of the cage, in its original order.
+    if (options.surfaceType == SurfaceType::CatmullClarkLimit)
+    {
+        if (!(options.limitSurfaceTolerance > 0.0f))
+        {
+            throw std::invalid_argument("Limit surface tolerance not positive");
+        }
+        m_faceKind = FaceKind::Patches;
+        m_meshFaceCount = faces.size();
+        TraceSpan patchSpan("build patches", faces.size());
+        buildCatmullClarkPatches(faces, vertices, options.limitSurfaceTolerance, m_patches,
+                                 m_patchFaceIds, scratch);
+        if (hasGroups)
+        {
+            m_patchGroups.resize(m_patches.size());
+            for (std::size_t i = 0; i < m_patches.size(); ++i)
+                m_patchGroups[i] = options.faceGroups[m_patchFaceIds[i]];
+        }
+        patchSpan.end();
+        if (m_patches.size() < minSpacePartitioningFaces)
+            return;
+        TraceSpan hierarchySpan("build hierarchy");
+        if (options.indexType == IndexType::WideBvh8)
+            m_hierarchy8 = buildPatchHierarchy<8>(indexResource, scratch);
+        else
+            m_hierarchy4 = buildPatchHierarchy<4>(indexResource, scratch);
+        if (hasGroups && !m_hierarchy8.empty())
+            buildGroupMasks(m_hierarchy8);
+        if (hasGroups && !m_hierarchy4.empty())
+            buildGroupMasks(m_hierarchy4);
+        return;
+    }
+
+    m_faceKind = computeFaceKind(faces);
+
+    // Count the vertices used by faces, to tell the copies made by meshlets.
+    {
+        Array<std::uint8_t> isUsed(vertices.size(), 0, scratch);
+        for (const Face &face : faces)
+            for (const int vertexId : face.vertexIds)
+                isUsed[vertexId] = 1;
+        m_meshFaceCount = faces.size();
+        m_meshVertexCount = static_cast<std::size_t>(std::count(isUsed.begin(), isUsed.end(), 1));
+    }
+
+    // Reordered faces keep track of their original index to report it in results.
+    Array<FaceIndex> faceIds(scratch);
+    if (isPartitioned && options.reorderForLocality)
+    {
+        TraceSpan reorderSpan("reorder for locality", faces.size());
+        faceIds = reorderForLocality(faces, vertices, scratch);
+    }
+    MeshletBuilder meshletBuilder(faces, vertices, m_meshlets,
+                                  faceIds.empty() ? nullptr : faceIds.data(), scratch,
+                                  options.planarQuadTolerance,
+                                  hasGroups ? options.faceGroups.data() : nullptr);
+
+    if (!isPartitioned)
+    {
+        // Store all faces in meshlets, to be processed in order.
+        Array<FaceIndex> faceIndices(faces.size(), 0, scratch);
+        std::iota(faceIndices.begin(), faceIndices.end(), 0);
+        meshletBuilder.add(faceIndices.data(), faceIndices.size());
+    }
+    else
+    {
+        switch (options.indexType)
+        {
+        case IndexType::Octree:
+            partitionSpace(faces, vertices, options, meshletBuilder, indexResource, scratch);
+            break;
+        case IndexType::WideBvh4:
+        {
+            TraceSpan hierarchySpan("build hierarchy", faces.size());
+            m_hierarchy4 = buildHierarchy<4>(faces, vertices, meshletBuilder,
+                                             indexResource, scratch);
+            break;
+        }
+        case IndexType::WideBvh8:
+        {
+            TraceSpan hierarchySpan("build hierarchy", faces.size());
+            m_hierarchy8 = buildHierarchy<8>(faces, vertices, meshletBuilder,
+                                             indexResource, scratch);
+            break;
+        }
+        }
+    }
+    TraceSpan finishSpan("finish meshlets");
+    meshletBuilder.finish();
+    finishSpan.end();
+
+    // Proxies are computed from the meshlets of the leaves, once all are stored.
+    if (options.useProxyBounds && !m_partitionedSpace.empty())
+    {
+        TraceSpan proxySpan("build proxies");
+        buildNodeProxies();
+    }
+    if (options.useNormalCones && !m_partitionedSpace.empty())
+    {
+        TraceSpan coneSpan("build normal cones");
+        buildNormalCones();
+    }
+
+    // So are the group masks of nodes, from those of the meshlets.
+    if (hasGroups)
+    {
+        TraceSpan groupSpan("build group masks");
+        if (!m_partitionedSpace.empty())
+        {
+            m_nodeGroupMasks.assign(m_partitionedSpace.getNodes().size(), 0);
+            accumulateGroupMasks(0);
+        }
+        if (!m_hierarchy4.empty())
+            buildGroupMasks(m_hierarchy4);
+        if (!m_hierarchy8.empty())
+            buildGroupMasks(m_hierarchy8);
+    }
+}
+
+/// Return the bytes taken by the arrays of the index, and by the index itself.
+MemoryFootprint MeshIndex::Impl::getMemoryFootprint() const
+{
+    MemoryFootprint footprint;
+    footprint.vertices = m_meshlets.getVertexBytes();
+    footprint.faces = m_meshlets.getFaceBytes();
+    footprint.meshlets = m_meshlets.getMeshletBytes();
+    footprint.patches = m_patches.capacity() * sizeof(BicubicPatch) +
+                        m_patchFaceIds.capacity() * sizeof(std::uint32_t);
+    footprint.nodes = m_partitionedSpace.getNodes().capacity() * sizeof(PartitionedSpace::Node) +
+                      m_hierarchy4.getNodes().capacity() * sizeof(Hierarchy<4>::Node) +
+                      m_hierarchy8.getNodes().capacity() * sizeof(Hierarchy<8>::Node);
+    footprint.leafElements = (m_partitionedSpace.getElements().capacity() +
+                              m_hierarchy4.getElements().capacity() +
+                              m_hierarchy8.getElements().capacity()) * sizeof(MeshletIndex);
+    footprint.proxies = m_nodeProxies.capacity() * sizeof(NodeProxy);
+    footprint.normalCones = m_nodeCones.capacity() * sizeof(NormalCone);
+    footprint.groups = m_meshlets.getGroupBytes() +
+                       m_nodeGroupMasks.capacity() * sizeof(std::uint64_t) +
+                       m_patchGroups.capacity() * sizeof(std::uint8_t);
+    footprint.objects = sizeof(Impl);
+
+    // Each vertex and face is stored at least once in meshlets, unless the mesh
+    // holds faces with an unsupported number of vertices.
+    const std::size_t vertexCopies = m_meshlets.getVertexCount();
+    const std::size_t faceCopies = m_meshlets.getFaceCount();
+    if (vertexCopies > m_meshVertexCount)
+        footprint.duplicatedVertices = (vertexCopies - m_meshVertexCount) * sizeof(Point);
+    if (faceCopies > m_meshFaceCount)
+    {
+        footprint.duplicatedFaces = (faceCopies - m_meshFaceCount) *
+                                    (sizeof(MeshletFace) + sizeof(std::uint32_t));
+    }
+    return footprint;
+}
+
+/// Walk the octree or hierarchy of the index to describe its nodes and leaves.
+IndexLayout MeshIndex::Impl::getLayout() const
+{
+    IndexLayout layout;
+    layout.faceLeafCounts.assign(m_meshFaceCount, 0);
+
+    if (!m_hierarchy4.empty())
+        addHierarchyLayout(m_hierarchy4, layout);
+    if (!m_hierarchy8.empty())
+        addHierarchyLayout(m_hierarchy8, layout);
+    if (m_partitionedSpace.empty())
+        return layout;
+
+    // Walk the octree depth first, deriving the bounds of children from their parent.
+    layout.maxDepth = static_cast<unsigned>(m_maxOctreeDepth);
+    struct PendingNode
+    {
+        std::uint32_t index;
+        AABCube bounds;
+        unsigned depth;
+    };
+    std::vector<PendingNode> pending(1, PendingNode{0, m_partitionedSpace.getBounds(), 0});
+    while (!pending.empty())
+    {
+        const PendingNode pendingNode = pending.back();
+        pending.pop_back();
+        if (layout.levelNodeCounts.size() <= pendingNode.depth)
+            layout.levelNodeCounts.resize(pendingNode.depth + 1, 0);
+        ++layout.levelNodeCounts[pendingNode.depth];
+
+        const auto &node = m_partitionedSpace.getNode(pendingNode.index);
+        if (node.isLeaf())
+        {
+            const AABCube &bounds = pendingNode.bounds;
+            const IndexLeaf leaf = { bounds.center - Float3(bounds.halfWidth),
+                                     bounds.center + Float3(bounds.halfWidth),
+                                     pendingNode.depth, 0, 0 };
+            addLeafLayout(m_partitionedSpace, node.getFirstElement(), node.getElementCount(),
+                          leaf, layout);
+            continue;
+        }
+        // Existing children are stored contiguously; push them in reverse order so
+        // that leaves are listed in the order they are stored.
+        std::uint32_t childNodeIndex = node.getFirstChild() +
+            static_cast<std::uint32_t>(std::bitset<8>(node.getChildMask()).count());
+        for (int childIndex = 7; childIndex >= 0; --childIndex)
+        {
+            if (node.getChildMask() & (1u << childIndex))
+            {
+                pending.push_back(PendingNode{--childNodeIndex,
+                                              Node::getChildBounds(pendingNode.bounds, childIndex),
+                                              pendingNode.depth + 1});
+            }
+        }
+    }
+    return layout;
+}
+
+/// Describe the nodes and leaves of a hierarchy, the bounds of each leaf being its
+/// box in its parent node.
+template<int Width>
+void MeshIndex::Impl::addHierarchyLayout(const Hierarchy<Width> &hierarchy,
+                                         IndexLayout &layout) const
+{
+    // Children nodes are stored after their parent, and leaf elements in the order
+    // of the nodes and slots referencing them: a single pass in node order lists
+    // leaves in the order they are stored.
+    const auto &nodes = hierarchy.getNodes();
+    std::vector<unsigned> depths(nodes.size(), 0);
+    layout.levelNodeCounts.assign(1, 1);
+    for (std::uint32_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+    {
+        const auto &node = nodes[nodeIndex];
+        const unsigned childDepth = depths[nodeIndex] + 1;
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            // Unused slots have empty bounds.
+            if (node.minX[slot] > node.maxX[slot])
+                continue;
+            if (layout.levelNodeCounts.size() <= childDepth)
+                layout.levelNodeCounts.resize(childDepth + 1, 0);
+            ++layout.levelNodeCounts[childDepth];
+
+            const std::uint32_t index = Hierarchy<Width>::getRefIndex(node.child[slot]);
+            if (!Hierarchy<Width>::isLeafRef(node.child[slot]))
+            {
+                depths[index] = childDepth;
+                continue;
+            }
+            const IndexLeaf leaf = { Point(node.minX[slot], node.minY[slot], node.minZ[slot]),
+                                     Point(node.maxX[slot], node.maxY[slot], node.maxZ[slot]),
+                                     childDepth, 0, 0 };
+            addLeafLayout(hierarchy, index, node.elementCount[slot], leaf, layout);
+        }
+    }
+}
+
+/// Count the faces, or patches, of a range of leaf elements, and append the leaf
+/// holding them to a layout.
+template<class Elements>
+void MeshIndex::Impl::addLeafLayout(const Elements &elements,
+                                    const std::uint32_t firstElement,
+                                    const std::uint32_t elementCount,
+                                    IndexLeaf leaf,
+                                    IndexLayout &layout) const
+{
+    if (!m_patches.empty())
+    {
+        // Several patches of a face may share the leaf, which stores the face once.
+        std::vector<std::uint32_t> faceIds;
+        for (std::uint32_t i = firstElement; i < firstElement + elementCount; ++i)
+            faceIds.push_back(m_patchFaceIds[elements.getElement(i)]);
+        std::sort(faceIds.begin(), faceIds.end());
+        faceIds.erase(std::unique(faceIds.begin(), faceIds.end()), faceIds.end());
+        for (const std::uint32_t faceId : faceIds)
+            ++layout.faceLeafCounts[faceId];
+        leaf.faceCount = elementCount;
+        layout.leaves.push_back(leaf);
+        return;
+    }
+    for (std::uint32_t i = firstElement; i < firstElement + elementCount; ++i)
+    {
+        const std::uint32_t element = elements.getElement(i);
+        const Meshlet &meshlet = m_meshlets.getMeshlet(element);
+        const std::uint32_t *faceIds = m_meshlets.getFaceIds(meshlet);
+        for (std::uint32_t f = 0; f < meshlet.faceCount; ++f)
+            ++layout.faceLeafCounts[faceIds[f]];
+        leaf.faceCount += meshlet.faceCount;
+        ++leaf.meshletCount;
+    }
+    layout.leaves.push_back(leaf);
+}
+
+/// Prefetch the vertices and faces of a meshlet.
+inline void MeshIndex::Impl::prefetchMeshlet(const MeshletIndex meshletIndex) const
+{
+    const Meshlet &meshlet = m_meshlets.getMeshlet(meshletIndex);
+    prefetch(m_meshlets.getVertices(meshlet), meshlet.vertexCount * sizeof(Point));
+    prefetch(m_meshlets.getFaces(meshlet), meshlet.faceCount * sizeof(MeshletFace));
+}
+
+/// Prefetch the data of an element of a leaf, a meshlet by default.
+template<class Faces>
+inline void MeshIndex::Impl::prefetchElement(const std::uint32_t element) const
+{
+    prefetchMeshlet(element);
+}
+
+/// Prefetch the control points of a patch.
+template<>
+inline void MeshIndex::Impl::prefetchElement<LimitPatches>(const std::uint32_t element) const
+{
+    prefetch(&m_patches[element], sizeof(BicubicPatch));
+}
+
+/// Prefetch the data read when visiting an octree node: the children of an inner
+/// node, or the meshlets of a leaf.
+inline void MeshIndex::Impl::prefetchNodeData(const std::uint32_t nodeIndex) const
+{
+    const auto &node = m_partitionedSpace.getNode(nodeIndex);
+    if (node.isLeaf())
+    {
+        const std::uint32_t firstElement = node.getFirstElement();
+        const std::uint32_t lastElement = firstElement + node.getElementCount();
+        for (std::uint32_t i = firstElement; i < lastElement; ++i)
+            prefetchMeshlet(m_partitionedSpace.getElement(i));
+    }
+    else
+    {
+        const std::size_t childCount = std::bitset<8>(node.getChildMask()).count();
+        prefetch(&m_partitionedSpace.getNode(node.getFirstChild()),
+                 childCount * sizeof(PartitionedSpace::Node));
+    }
+}
+
+/// Prefetch the node, or the leaf elements, designated by a hierarchy reference.
+template<int Width>
+inline void MeshIndex::Impl::prefetchRef(const Hierarchy<Width> &hierarchy,
+                                         const std::uint32_t ref,
+                                         const std::uint32_t elementCount) const
+{
+    const std::uint32_t index = Hierarchy<Width>::getRefIndex(ref);
+    if (Hierarchy<Width>::isLeafRef(ref))
+        prefetch(&hierarchy.getElement(index), elementCount * sizeof(MeshletIndex));
+    else
+        prefetch(&hierarchy.getNode(index), sizeof(typename Hierarchy<Width>::Node));
+}
+
+/// Move a cursor one node down the octree, towards the child containing its point,
+/// and prefetch the data of that node.
+void MeshIndex::Impl::advancePath(PathCursor &cursor) const
+{
+    if (cursor.isDone)
+        return;
+    const auto &node = m_partitionedSpace.getNode(cursor.ref);
+    if (node.isLeaf())
+    {
+        cursor.isDone = true;
+        return;
+    }
+    const Point &center = cursor.bounds.center;
+    const int childIndex = (cursor.point.x > center.x ? 1 : 0) |
+                           (cursor.point.y > center.y ? 2 : 0) |
+                           (cursor.point.z > center.z ? 4 : 0);
+    const unsigned childMask = node.getChildMask();
+    if (!(childMask & (1u << childIndex)))
+    {
+        // The point lies in an empty cell: its query will visit neighbour cells.
+        cursor.isDone = true;
+        return;
+    }
+    // Existing children are stored contiguously, in child index order.
+    const unsigned lowerChildMask = childMask & ((1u << childIndex) - 1);
+    cursor.ref = node.getFirstChild() +
+                 static_cast<std::uint32_t>(std::bitset<8>(lowerChildMask).count());
+    cursor.bounds = Node::getChildBounds(cursor.bounds, childIndex);
+    prefetchNodeData(cursor.ref);
+}
+
+/// Move a cursor one node down the hierarchy, towards the child closest to its
+/// point, and prefetch the data of that node.
+template<int Width, class Faces>
+void MeshIndex::Impl::advancePath(const Hierarchy<Width> &hierarchy,
+                                  PathCursor &cursor) const
+{
+    if (cursor.isDone)
+        return;
+    const std::uint32_t index = Hierarchy<Width>::getRefIndex(cursor.ref);
+    if (Hierarchy<Width>::isLeafRef(cursor.ref))
+    {
+        for (std::uint32_t i = index; i < index + cursor.elementCount; ++i)
+            prefetchElement<Faces>(hierarchy.getElement(i));
+        cursor.isDone = true;
+        return;
+    }
+    const auto &node = hierarchy.getNode(index);
+    float childSqrDistances[Width];
+    computeChildrenSqrDistances<Width>(cursor.point, node, childSqrDistances);
+    const int slot = static_cast<int>(std::min_element(childSqrDistances,
+                                                       childSqrDistances + Width) -
+                                      childSqrDistances);
+    cursor.ref = node.child[slot];
+    cursor.elementCount = node.elementCount[slot];
+    prefetchRef(hierarchy, cursor.ref, cursor.elementCount);
+}
+
+/// Compute the closest point on an element of a leaf, a meshlet by default, and
+/// update the result if closer, respecting sqrMaxDist and the filter, if any.
+template<class Faces>
+inline void MeshIndex::Impl::visitElement(const std::uint32_t element,
+                                          const Point& queryPoint,
+                                          const float sqrMaxDist,
+                                          const SearchFilter *filter,
+                                          SearchResult &result) const
+{
+    visitMeshlet<Faces>(element, queryPoint, sqrMaxDist, filter, result);
+}
+
+/// Compute the closest point on a patch, reported with the id of its cage face.
+template<>
+inline void MeshIndex::Impl::visitElement<LimitPatches>(const std::uint32_t element,
+                                                        const Point& queryPoint,
+                                                        const float sqrMaxDist,
+                                                        const SearchFilter *filter,
+                                                        SearchResult &result) const
+{
+    const unsigned group = m_patchGroups.empty() ? 0u : m_patchGroups[element];
+    if (filter && !isAccepted(*filter, group,
+                              [this, element]() { return computePatchNormal(m_patches[element]); },
+                              [this, element]()
+                              { return static_cast<int>(m_patchFaceIds[element]); }))
+        return;
+    const auto patchClosest = computeClosestPointOnPatch(m_patches[element], queryPoint);
+    ++result.faceCount;
+    updateResult(patchClosest, sqrMaxDist,
+                 [this, element]() { return static_cast<int>(m_patchFaceIds[element]); },
+                 result);
+}
+
+/// Compute the closest point on the faces of a meshlet and update the result if
+/// closer, respecting sqrMaxDist and the filter, if any.
+template<class Faces>
+inline void MeshIndex::Impl::visitMeshlet(const MeshletIndex meshletIndex,
+                                          const Point& queryPoint,
+                                          const float sqrMaxDist,
+                                          const SearchFilter *filter,
+                                          SearchResult &result) const
+{
+    if (filter && !(m_meshlets.getGroupMask(meshletIndex) & filter->groupMask))
+        return;
+    const Meshlet &meshlet = m_meshlets.getMeshlet(meshletIndex);
+    if (meshlet.hasPlanarQuads)
+        visitFaces<typename Faces::Planar>(meshlet, queryPoint, sqrMaxDist, filter, result);
+    else
+        visitFaces<Faces>(meshlet, queryPoint, sqrMaxDist, filter, result);
+}
+
+/// \brief Compute the closest point on the faces of a meshlet with a given face policy.
+///
+/// Faces rejected by the filter are skipped, as if they were not in the mesh.
+template<class Faces>
+inline void MeshIndex::Impl::visitFaces(const Meshlet &meshlet,
+                                        const Point& queryPoint,
+                                        const float sqrMaxDist,
+                                        const SearchFilter *filter,
+                                        SearchResult &result) const
+{
+    const Point *vertices = m_meshlets.getVertices(meshlet);
+    const MeshletFace *faces = m_meshlets.getFaces(meshlet);
+    const std::uint8_t *groups = m_meshlets.getFaceGroups(meshlet);
+    for (int i = 0; i < meshlet.faceCount; ++i)
+    {
+        const auto getFaceId = [this, &meshlet, i]()
+        {
+            return static_cast<int>(m_meshlets.getFaceIds(meshlet)[i]);
+        };
+        if (filter && !isAccepted(*filter, groups ? groups[i] : 0u,
+                                  [faces, vertices, i]()
+                                  {
+                                      return computeFaceNormal(faces[i], vertices);
+                                  },
+                                  getFaceId))
+            continue;
+        ++result.faceCount;
+        const auto faceClosest = Faces::computeClosestPoint(faces[i], vertices, queryPoint);
+        updateResult(faceClosest, sqrMaxDist, getFaceId, result);
+    }
+}
+
+/// \brief Find the closest point with the search specialized for the faces of the mesh.
+///
+/// Until a face is found, index nodes farther than sqrt(sqrPruningDist) are pruned.
+/// If nextQueryPoint is set, the nodes on its path are prefetched meanwhile.
+SearchResult MeshIndex::Impl::process(const Point& queryPoint,
+                                      const float sqrMaxDist,
+                                      const float sqrPruningDist,
+                                      const SearchFilter *filter,
+                                      const unsigned prefetchDistance,
+                                      const Point *nextQueryPoint) const
+{
+    switch (m_faceKind)
+    {
+    case FaceKind::Triangles:
+        return processIndex<TriangleFaces>(queryPoint, sqrMaxDist, sqrPruningDist, filter,
+                                           prefetchDistance, nextQueryPoint);
+    case FaceKind::Quads:
+        return processIndex<QuadFaces<false>>(queryPoint, sqrMaxDist, sqrPruningDist, filter,
+                                              prefetchDistance, nextQueryPoint);
+    case FaceKind::Patches:
+        return processIndex<LimitPatches>(queryPoint, sqrMaxDist, sqrPruningDist, filter,
+                                          prefetchDistance, nextQueryPoint);
+    case FaceKind::Mixed:
+        break;
+    }
+    return processIndex<MixedFaces<false>>(queryPoint, sqrMaxDist, sqrPruningDist, filter,
+                                           prefetchDistance, nextQueryPoint);
+}
+
+/// Find the closest point with the index built.
+template<class Faces>
+SearchResult MeshIndex::Impl::processIndex(const Point& queryPoint,
+                                           const float sqrMaxDist,
+                                           const float sqrPruningDist,
+                                           const SearchFilter *filter,
+                                           const unsigned prefetchDistance,
+                                           const Point *nextQueryPoint) const
+{
+    if (!m_partitionedSpace.empty())
+        return processPartitionedSpace<Faces>(queryPoint, sqrMaxDist, sqrPruningDist, filter,
+                                              prefetchDistance, nextQueryPoint);
+    if (!m_hierarchy4.empty())
+        return processHierarchy<4, Faces>(m_hierarchy4, queryPoint, sqrMaxDist,
+                                          sqrPruningDist, filter, prefetchDistance,
+                                          nextQueryPoint);
+    if (!m_hierarchy8.empty())
+        return processHierarchy<8, Faces>(m_hierarchy8, queryPoint, sqrMaxDist,
+                                          sqrPruningDist, filter, prefetchDistance,
+                                          nextQueryPoint);
+    return processMesh<Faces>(queryPoint, sqrMaxDist, filter);
+}
+
+/// Iterator through all faces and find closest point on face.
+template<class Faces>
+inline SearchResult MeshIndex::Impl::processMesh(const Point& queryPoint,
+                                                 const float sqrMaxDist,
+                                                 const SearchFilter *filter) const
+{
+    SearchResult result = noResult;
+    const std::size_t elementCount = m_patches.empty() ? m_meshlets.size()
+                                                       : m_patches.size();
+    for (std::uint32_t i = 0; i < elementCount; ++i)
+    {
+        visitElement<Faces>(i, queryPoint, sqrMaxDist, filter, result);
+    }
+    return result;
+}
+
+/// Partition space and sort faces into partitions.
+void MeshIndex::Impl::partitionSpace(const std::vector<Face> &faces,
+                                     const std::vector<Point> &vertices,
+                                     const BuildOptions &options,
+                                     MeshletBuilder &meshletBuilder,
+                                     MemoryResource &indexResource,
+                                     MemoryResource &scratch)
+{
+    // Compute the extent of the space taken by all vertices.
+    TraceSpan extentSpan("compute extent", vertices.size());
+    Extent meshExtent = std::accumulate(vertices.begin(),
+                                        vertices.end(),
+                                        Extent(Point(infinity), Point(-infinity)),
+                                        growExtent);
+    extentSpan.end();
+
+    // Construct the root octree node bounding the mesh.
+    const AABCube rootBounds = computeCubicBounds(meshExtent);
+    Node rootNode{Allocator<OctreeElement>(scratch)};
+
+    // Insert all faces into the root, kept as a leaf..
+    TraceSpan insertSpan("insert faces", faces.size());
+    for (const Face &face : faces)
+    {
+        rootNode.insert(OctreeElement(&face, computeFaceBounds(face, vertices)),
+                        rootBounds,
+                        intersect,
+                        0);
+    }
+    insertSpan.end();
+
+    // .. then split cells top-down, knowing how their faces spread among children.
+    for (const OctreeDepthLimit &limit : options.octreeDepthLimits)
+        m_maxOctreeDepth = std::max(m_maxOctreeDepth, limit.maxDepth);
+    const auto shouldSubdivide = [&options](const AABCube &bounds,
+                                            const int depth,
+                                            const std::size_t faceCount,
+                                            const std::size_t (&childFaceCounts)[8])
+    {
+        if (depth >= computeMaxDepth(bounds, options))
+            return false;
+        if (options.octreeSubdivision == OctreeSubdivision::Fill)
+            return faceCount / static_cast<float>(1 + depth) > maxOctreeFill;
+        return isSplitBeneficial(options.octreeSubdivision, faceCount, childFaceCounts);
+    };
+    TraceSpan subdivideSpan("subdivide octree", faces.size());
+    rootNode.subdivide(rootBounds, intersect, shouldSubdivide);
+    subdivideSpan.end();
+
+    // Flatten the octree into its compact form, the faces of each leaf being
+    // stored in meshlets.
+    TraceSpan flattenSpan("flatten octree");
+    const Face *firstFace = faces.data();
+    Array<FaceIndex> faceIndices(scratch);
+    m_partitionedSpace = PartitionedSpace(rootNode, rootBounds,
+        [firstFace, &faceIndices, &meshletBuilder](const Node::ElementList &elements,
+                                                   PartitionedSpace::ElementList &meshletIndices)
+        {
+            faceIndices.resize(elements.size());
+            std::transform(elements.begin(), elements.end(), faceIndices.begin(),
+                [firstFace](const OctreeElement &element)
+                {
+                    return static_cast<FaceIndex>(element.first - firstFace);
+                });
+            const auto meshletRange = meshletBuilder.add(faceIndices.data(), faceIndices.size());
+            for (MeshletIndex i = meshletRange.first; i < meshletRange.second; ++i)
+                meshletIndices.push_back(i);
+        },
+        Allocator<MeshletIndex>(indexResource),
+        Allocator<MeshletIndex>(scratch));
+}
+
+/// Build a hierarchy over all faces, the faces of each leaf being stored in a meshlet.
+template<int Width>
+Hierarchy<Width> MeshIndex::Impl::buildHierarchy(const std::vector<Face> &faces,
+                                                 const std::vector<Point> &vertices,
+                                                 MeshletBuilder &meshletBuilder,
+                                                 MemoryResource &indexResource,
+                                                 MemoryResource &scratch) const
+{
+    Array<FaceIndex> faceIndices(faces.size(), 0, scratch);
+    Array<AABBox> faceBounds(faces.size(), AABBox(), scratch);
+    for (FaceIndex i = 0; i < faces.size(); ++i)
+    {
+        faceIndices[i] = i;
+        faceBounds[i] = computeFaceBounds(faces[i], vertices);
+    }
+    return Hierarchy<Width>(faceIndices, faceBounds,
+        [&meshletBuilder](const Array<FaceIndex> &leafFaceIndices,
+                          typename Hierarchy<Width>::ElementList &meshletIndices)
+        {
+            const auto meshletRange = meshletBuilder.add(leafFaceIndices.data(),
+                                                         leafFaceIndices.size());
+            for (MeshletIndex i = meshletRange.first; i < meshletRange.second; ++i)
+                meshletIndices.push_back(i);
+        },
+        Allocator<MeshletIndex>(indexResource),
+        Allocator<MeshletIndex>(scratch));
+}
+
+/// \brief Compute the proxies of all octree nodes.
+///
+/// The normal of a node is the mean normal of its faces, weighted by their area.
+/// Faces overlapping several cells are accounted in each of them.
+void MeshIndex::Impl::buildNodeProxies()
+{
+    const NodeProxy emptyProxy = { Float3(0.0f), infinity, -infinity, Point(nan) };
+    m_nodeProxies.assign(m_partitionedSpace.getNodes().size(), emptyProxy);
+    std::vector<Float3> normals(m_nodeProxies.size());
+    accumulateNodeNormals(0, normals);
+
+    // Offsets are padded to absorb the rounding errors of queries, relative to the
+    // size of the mesh.
+    const AABCube &rootBounds = m_partitionedSpace.getBounds();
+    const float extent = rootBounds.center.abs().dot(Float3(1.0f)) + 3.0f * rootBounds.halfWidth;
+    const float margin = 1e-6f * extent;
+    for (std::uint32_t i = 0; i < m_nodeProxies.size(); ++i)
+    {
+        NodeProxy &proxy = m_nodeProxies[i];
+        const float length = normals[i].length();
+        proxy.normal = length > 0.0f ? normals[i] / length : Float3(1.0f, 0.0f, 0.0f);
+        extendProxy(i, proxy);
+        proxy.minOffset -= margin;
+        proxy.maxOffset += margin;
+    }
+}
+
+/// Sum the area-weighted normals of the faces below a node and below each of its
+/// descendants, into normals indexed like nodes, and return the sum.
+Float3 MeshIndex::Impl::accumulateNodeNormals(const std::uint32_t nodeIndex,
+                                              std::vector<Float3> &normals) const
+{
+    const auto &node = m_partitionedSpace.getNode(nodeIndex);
+    Float3 normal(0.0f);
+    if (node.isLeaf())
+    {
+        const std::uint32_t firstElement = node.getFirstElement();
+        const std::uint32_t lastElement = firstElement + node.getElementCount();
+        for (std::uint32_t i = firstElement; i < lastElement; ++i)
+        {
+            const Meshlet &meshlet = m_meshlets.getMeshlet(m_partitionedSpace.getElement(i));
+            const Point *vertices = m_meshlets.getVertices(meshlet);
+            const MeshletFace *faces = m_meshlets.getFaces(meshlet);
+            for (int f = 0; f < meshlet.faceCount; ++f)
+                normal = normal + computeFaceNormal(faces[f], vertices);
+        }
+    }
+    else
+    {
+        const std::uint32_t firstChild = node.getFirstChild();
+        const std::size_t childCount = std::bitset<8>(node.getChildMask()).count();
+        for (std::uint32_t child = firstChild; child < firstChild + childCount; ++child)
+            normal = normal + accumulateNodeNormals(child, normals);
+    }
+    normals[nodeIndex] = normal;
+    return normal;
+}
+
+/// Extend the slab of a proxy to hold the vertices of the faces below a node, and
+/// pick its vertex among them.
+void MeshIndex::Impl::extendProxy(const std::uint32_t nodeIndex, NodeProxy &proxy) const
+{
+    const auto &node = m_partitionedSpace.getNode(nodeIndex);
+    if (!node.isLeaf())
+    {
+        const std::uint32_t firstChild = node.getFirstChild();
+        const std::size_t childCount = std::bitset<8>(node.getChildMask()).count();
+        for (std::uint32_t child = firstChild; child < firstChild + childCount; ++child)
+            extendProxy(child, proxy);
+        return;
+    }
+    const std::uint32_t firstElement = node.getFirstElement();
+    const std::uint32_t lastElement = firstElement + node.getElementCount();
+    for (std::uint32_t i = firstElement; i < lastElement; ++i)
+    {
+        const Meshlet &meshlet = m_meshlets.getMeshlet(m_partitionedSpace.getElement(i));
+        const Point *vertices = m_meshlets.getVertices(meshlet);
+        if (meshlet.vertexCount > 0 && std::isnan(proxy.vertex.x))
+            proxy.vertex = vertices[0];
+        for (int v = 0; v < meshlet.vertexCount; ++v)
+        {
+            const float offset = proxy.normal.dot(vertices[v]);
+            proxy.minOffset = std::min(proxy.minOffset, offset);
+            proxy.maxOffset = std::max(proxy.maxOffset, offset);
+        }
+    }
+}
+
+/// \brief Compute the normal cones of all octree nodes.
+///
+/// The axis of a node is the mean normal of its faces, weighted by their area, and
+/// its half angle the widest angle between the axis and the normal of a face.
+void MeshIndex::Impl::buildNormalCones()
+{
+    // Half angles are padded to absorb the rounding errors of queries.
+    constexpr float pi = 3.14159265f;
+    constexpr float angleMargin = 1e-3f;
+    m_nodeCones.assign(m_partitionedSpace.getNodes().size(),
+                       NormalCone{ Float3(1.0f, 0.0f, 0.0f), 1.0f, 0.0f });
+    std::vector<Float3> normals(m_nodeCones.size());
+    accumulateNodeNormals(0, normals);
+    for (std::uint32_t i = 0; i < m_nodeCones.size(); ++i)
+    {
+        NormalCone &cone = m_nodeCones[i];
+        const float length = normals[i].length();
+        if (length > 0.0f)
+            cone.axis = normals[i] / length;
+        else
+            cone.cosHalfAngle = -1.0f;
+        extendNormalCone(i, cone);
+        const float halfAngle = std::min(std::acos(std::max(cone.cosHalfAngle, -1.0f)) + angleMargin,
+                                         pi);
+        cone.cosHalfAngle = std::cos(halfAngle);
+        cone.sinHalfAngle = std::sin(halfAngle);
+    }
+}
+
+/// Widen a cone to hold the normals of the faces below a node.
+void MeshIndex::Impl::extendNormalCone(const std::uint32_t nodeIndex, NormalCone &cone) const
+{
+    const auto &node = m_partitionedSpace.getNode(nodeIndex);
+    if (!node.isLeaf())
+    {
+        const std::uint32_t firstChild = node.getFirstChild();
+        const std::size_t childCount = std::bitset<8>(node.getChildMask()).count();
+        for (std::uint32_t child = firstChild; child < firstChild + childCount; ++child)
+            extendNormalCone(child, cone);
+        return;
+    }
+    const std::uint32_t firstElement = node.getFirstElement();
+    const std::uint32_t lastElement = firstElement + node.getElementCount();
+    for (std::uint32_t i = firstElement; i < lastElement; ++i)
+    {
+        const Meshlet &meshlet = m_meshlets.getMeshlet(m_partitionedSpace.getElement(i));
+        const Point *vertices = m_meshlets.getVertices(meshlet);
+        const MeshletFace *faces = m_meshlets.getFaces(meshlet);
+        for (int f = 0; f < meshlet.faceCount; ++f)
+        {
+            const Float3 normal = computeFaceNormal(faces[f], vertices);
+            const float length = normal.length();
+            if (length > 0.0f)
+                cone.cosHalfAngle = std::min(cone.cosHalfAngle, cone.axis.dot(normal) / length);
+        }
+    }
+}
+
+/// Return the mask of the groups of the faces of a leaf element.
+std::uint64_t MeshIndex::Impl::getElementGroupMask(const std::uint32_t element) const
+{
+    if (m_patches.empty())
+        return m_meshlets.getGroupMask(element);
+    return std::uint64_t(1) << (m_patchGroups.empty() ? 0u : m_patchGroups[element]);
+}
+
+/// Compute the group masks of a node and of its descendants, and return the mask
+/// of the node.
+std::uint64_t MeshIndex::Impl::accumulateGroupMasks(const std::uint32_t nodeIndex)
+{
+    const auto &node = m_partitionedSpace.getNode(nodeIndex);
+    std::uint64_t groupMask = 0;
+    if (node.isLeaf())
+    {
+        const std::uint32_t firstElement = node.getFirstElement();
+        const std::uint32_t lastElement = firstElement + node.getElementCount();
+        for (std::uint32_t i = firstElement; i < lastElement; ++i)
+            groupMask |= getElementGroupMask(m_partitionedSpace.getElement(i));
+    }
+    else
+    {
+        const std::uint32_t firstChild = node.getFirstChild();
+        const std::size_t childCount = std::bitset<8>(node.getChildMask()).count();
+        for (std::uint32_t child = firstChild; child < firstChild + childCount; ++child)
+            groupMask |= accumulateGroupMasks(child);
+    }
+    m_nodeGroupMasks[nodeIndex] = groupMask;
+    return groupMask;
+}
+
+/// Compute the group masks of the children of all hierarchy nodes.
+template<int Width>
+void MeshIndex::Impl::buildGroupMasks(const Hierarchy<Width> &hierarchy)
+{
+    // Children nodes are stored after their parent: walking nodes backwards, those
+    // of the children of a node are known before it.
+    const auto &nodes = hierarchy.getNodes();
+    m_nodeGroupMasks.assign(nodes.size() * Width, 0);
+    for (std::size_t nodeIndex = nodes.size(); nodeIndex-- > 0;)
+    {
+        const auto &node = nodes[nodeIndex];
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            // Unused slots have empty bounds, and no group.
+            if (node.minX[slot] > node.maxX[slot])
+                continue;
+            std::uint64_t &groupMask = m_nodeGroupMasks[nodeIndex * Width + slot];
+            const std::uint32_t index = Hierarchy<Width>::getRefIndex(node.child[slot]);
+            if (!Hierarchy<Width>::isLeafRef(node.child[slot]))
+            {
+                for (int childSlot = 0; childSlot < Width; ++childSlot)
+                    groupMask |= m_nodeGroupMasks[index * Width + childSlot];
+                continue;
+            }
+            for (std::uint32_t i = index; i < index + node.elementCount[slot]; ++i)
+                groupMask |= getElementGroupMask(hierarchy.getElement(i));
+        }
+    }
+}
+
+/// Build a hierarchy over all patches, bounded by their control points.
+template<int Width>
+Hierarchy<Width> MeshIndex::Impl::buildPatchHierarchy(MemoryResource &indexResource,
+                                                      MemoryResource &scratch) const
+{
+    Array<PatchIndex> patchIndices(m_patches.size(), 0, scratch);
+    Array<AABBox> patchBounds(m_patches.size(), AABBox(), scratch);
+    for (PatchIndex i = 0; i < m_patches.size(); ++i)
+    {
+        patchIndices[i] = i;
+        patchBounds[i] = computePatchBounds(m_patches[i]);
+    }
+    return Hierarchy<Width>(patchIndices, patchBounds,
+        [](const Array<PatchIndex> &leafPatchIndices,
+           typename Hierarchy<Width>::ElementList &elements)
+        {
+            elements.insert(elements.end(), leafPatchIndices.begin(), leafPatchIndices.end());
+        },
+        Allocator<PatchIndex>(indexResource),
+        Allocator<PatchIndex>(scratch));
+}
+
+/// \brief Walk partitioned space and return the closest point on face.
+///
+/// If nextQueryPoint is set, the nodes on its path are prefetched meanwhile.
+template<class Faces>
+inline SearchResult MeshIndex::Impl::processPartitionedSpace(const Point& queryPoint,
+                                                             const float sqrMaxDist,
+                                                             const float sqrPruningDist,
+                                                             const SearchFilter *filter,
+                                                             const unsigned prefetchDistance,
+                                                             const Point *nextQueryPoint) const
+{
+    // Initialize the result. Until a face is found, nodes are pruned at the
+    // pruning distance.
+    SearchResult result = noResult;
+    const auto getSqrBound = [&result, sqrPruningDist]()
+    {
+        return std::min(result.sqrDistance, sqrPruningDist);
+    };
+
+    // Initialize a heap whose top is the node closest to queryPoint.
+    // Nodes do not store their bounds, so entries carry them along. The heap is
+    // kept in an array, so that the entries likely to be visited next, at its
+    // beginning, can be prefetched.
+    struct HeapEntry
+    {
+        std::uint32_t nodeIndex;
+        float sqrDist;
+        AABCube bounds;
+    };
+    const auto heapCompare = [](const HeapEntry &a, const HeapEntry &b)
+    {
+        return (a.sqrDist > b.sqrDist);
+    };
+
+    // Heap entries are drawn from a buffer on the stack, only queries visiting
+    // many nodes allocating more memory.
+    alignas(std::max_align_t) char heapBuffer[heapBufferSize];
+    MonotonicBuffer heapMemory(heapBuffer, sizeof(heapBuffer));
+    Array<HeapEntry> heap{Allocator<HeapEntry>(heapMemory)};
+    heap.reserve(heapBufferSize / (4 * sizeof(HeapEntry)));
+
+    // Initialize the heap with the octree root. With proxies, nodes are bounded
+    // by their slab as well, and their vertices bound the result from above,
+    // unless filtered out. With cones or group masks, nodes holding no face
+    // accepted are skipped.
+    const bool hasProxies = !m_nodeProxies.empty();
+    const bool hasUpperBounds = hasProxies && !filter;
+    const bool hasCones = filter && filter->hasDirection && !m_nodeCones.empty();
+    const bool hasGroupMasks = filter && !m_nodeGroupMasks.empty();
+    const auto isFilteredOut = [this, filter, hasCones, hasGroupMasks](std::uint32_t nodeIndex)
+    {
+        return (hasCones && !mayHoldAcceptedFaces(m_nodeCones[nodeIndex], *filter)) ||
+               (hasGroupMasks && !(m_nodeGroupMasks[nodeIndex] & filter->groupMask));
+    };
+    if (isFilteredOut(0))
+        return result;
+    float sqrUpperBound = infinity;
+    const auto &rootBounds = m_partitionedSpace.getBounds();
+    float rootSqrDist = computeSqrDistanceToBounds( queryPoint, rootBounds );
+    if (hasProxies)
+    {
+        rootSqrDist = std::max(rootSqrDist, computeSqrDistanceToProxy(queryPoint, rootBounds,
+                                                                      m_nodeProxies[0]));
+        if (hasUpperBounds)
+            sqrUpperBound = computeSqrUpperBound(queryPoint, m_nodeProxies[0]);
+    }
+    heap.push_back( HeapEntry{0, rootSqrDist, rootBounds} );
+
+    // Start the path to the next query point from the root.
+    const bool isPrefetching = prefetchDistance > 0;
+    PathCursor nextPath = { Point(), 0, 0, rootBounds, true };
+    if (nextQueryPoint && isPrefetching)
+    {
+        nextPath.point = *nextQueryPoint;
+        nextPath.isDone = false;
+    }
+
+    // Do a Best First Search over the octree:
+    // while the heap has nodes and the top one is closer than the current result,
+    // and not farther than the closest vertex of a proxy,
+    while (!heap.empty() && heap.front().sqrDist < getSqrBound() &&
+           heap.front().sqrDist <= sqrUpperBound)
+    {
+        // Eat the top of the heap.
+        std::pop_heap(heap.begin(), heap.end(), heapCompare);
+        const HeapEntry entry = heap.back();
+        heap.pop_back();
+        ++result.nodeCount;
+        const auto &node = m_partitionedSpace.getNode(entry.nodeIndex);
+
+        // Fetch ahead the data of the next candidates and of the next query.
+        const std::size_t prefetchCount = std::min<std::size_t>(prefetchDistance,
+                                                                heap.size());
+        for (std::size_t i = 0; i < prefetchCount; ++i)
+            prefetchNodeData(heap[i].nodeIndex);
+        advancePath(nextPath);
+
+        if (node.isLeaf())
+        {
+            // If it's a leaf, visit the elements (meshlets).
+            const std::uint32_t firstElement = node.getFirstElement();
+            const std::uint32_t lastElement = firstElement + node.getElementCount();
+            for (std::uint32_t i = firstElement; i < lastElement; ++i)
+            {
+                visitElement<Faces>(m_partitionedSpace.getElement(i), queryPoint,
+                                    sqrMaxDist, filter, result);
+            }
+            continue;
+        }
+
+        // Otherwise, compute the distances to all children at once..
+        float childSqrDistances[8];
+        const unsigned childMask = node.getChildMask();
+        computeChildrenSqrDistances(queryPoint, entry.bounds, childMask,
+                                    childSqrDistances);
+
+        // ..and add to the heap the children closer than the current result.
+        // Existing children are stored contiguously, in child index order, so
+        // they are all prefetched at once as some are likely visited soon.
+        if (isPrefetching)
+            prefetchNodeData(entry.nodeIndex);
+        std::uint32_t childNodeIndex = node.getFirstChild();
+        for (int childIndex = 0; childIndex < 8; ++childIndex)
+        {
+            if (!(childMask & (1u << childIndex)))
+                continue;
+
+            // Children holding no face accepted by the filter are skipped, and do
+            // not bound the runner-up either.
+            if (isFilteredOut(childNodeIndex))
+            {
+                ++childNodeIndex;
+                continue;
+            }
+            float childSqrDist = childSqrDistances[childIndex];
+            if (hasProxies && childSqrDist < getSqrBound())
+            {
+                const NodeProxy &proxy = m_nodeProxies[childNodeIndex];
+                const AABCube childBounds = Node::getChildBounds(entry.bounds, childIndex);
+                childSqrDist = std::max(childSqrDist,
+                                        computeSqrDistanceToProxy(queryPoint, childBounds, proxy));
+                if (hasUpperBounds)
+                    sqrUpperBound = std::min(sqrUpperBound, computeSqrUpperBound(queryPoint, proxy));
+            }
+            if (childSqrDist < getSqrBound() && childSqrDist <= sqrUpperBound)
+            {
+                heap.push_back( HeapEntry{childNodeIndex,
+                                          childSqrDist,
+                                          Node::getChildBounds(entry.bounds, childIndex)} );
+                std::push_heap(heap.begin(), heap.end(), heapCompare);
+            }
+            else
+            {
+                // Faces of pruned children bound the runner-up from below.
+                result.sqrRunnerUp = std::min(result.sqrRunnerUp, childSqrDist);
+            }
+            ++childNodeIndex;
+        }
+    }
+
+    // So do those of the nodes left in the heap, the closest being on top.
+    if (!heap.empty())
+        result.sqrRunnerUp = std::min(result.sqrRunnerUp, heap.front().sqrDist);
+    return result;
+}
+
+/// \brief Walk the hierarchy and return the closest point on face.
+///
+/// If nextQueryPoint is set, the nodes on its path are prefetched meanwhile.
+template<int Width, class Faces>
+SearchResult MeshIndex::Impl::processHierarchy(const Hierarchy<Width> &hierarchy,
+                                               const Point& queryPoint,
+                                               const float sqrMaxDist,
+                                               const float sqrPruningDist,
+                                               const SearchFilter *filter,
+                                               const unsigned prefetchDistance,
+                                               const Point *nextQueryPoint) const
+{
+    // Initialize the result, nodes being pruned as for the octree.
+    SearchResult result = noResult;
+    const auto getSqrBound = [&result, sqrPruningDist]()
+    {
+        return std::min(result.sqrDistance, sqrPruningDist);
+    };
+
+    // Initialize a heap whose top is the node or leaf closest to queryPoint,
+    // kept in an array as for the octree.
+    struct HeapEntry
+    {
+        std::uint32_t ref;
+        std::uint32_t elementCount;
+        float sqrDist;
+    };
+    const auto heapCompare = [](const HeapEntry &a, const HeapEntry &b)
+    {
+        return (a.sqrDist > b.sqrDist);
+    };
+
+    // Heap entries are drawn from a buffer on the stack, as for the octree.
+    alignas(std::max_align_t) char heapBuffer[heapBufferSize];
+    MonotonicBuffer heapMemory(heapBuffer, sizeof(heapBuffer));
+    Array<HeapEntry> heap{Allocator<HeapEntry>(heapMemory)};
+    heap.reserve(heapBufferSize / (4 * sizeof(HeapEntry)));
+
+    // Initialize the heap with the root node. With group masks, children holding
+    // no group accepted are skipped.
+    heap.push_back( HeapEntry{0, 0, 0.0f} );
+    const bool hasGroupMasks = filter && !m_nodeGroupMasks.empty();
+
+    // Start the path to the next query point from the root.
+    const bool isPrefetching = prefetchDistance > 0;
+    PathCursor nextPath = { Point(), 0, 0, AABCube(), true };
+    if (nextQueryPoint && isPrefetching)
+    {
+        nextPath.point = *nextQueryPoint;
+        nextPath.isDone = false;
+    }
+
+    // Do a Best First Search over the hierarchy:
+    // while the heap has entries and the top one is closer than the current result,
+    while (!heap.empty() && heap.front().sqrDist < getSqrBound())
+    {
+        // Eat the top of the heap.
+        std::pop_heap(heap.begin(), heap.end(), heapCompare);
+        const HeapEntry entry = heap.back();
+        heap.pop_back();
+        ++result.nodeCount;
+
+        // Fetch ahead the nodes and meshlets of the next candidates, and the path
+        // of the next query. Nodes are wider than octree nodes, and most children
+        // pushed are never visited, so they are not prefetched when pushed.
+        const std::size_t prefetchCount = std::min<std::size_t>(prefetchDistance,
+                                                                heap.size());
+        for (std::size_t i = 0; i < prefetchCount; ++i)
+        {
+            const std::uint32_t candidateIndex = Hierarchy<Width>::getRefIndex(heap[i].ref);
+            if (!Hierarchy<Width>::isLeafRef(heap[i].ref))
+            {
+                prefetch(&hierarchy.getNode(candidateIndex),
+                         sizeof(typename Hierarchy<Width>::Node));
+                continue;
+            }
+            for (std::uint32_t e = candidateIndex;
+                 e < candidateIndex + heap[i].elementCount; ++e)
+                prefetchElement<Faces>(hierarchy.getElement(e));
+        }
+        advancePath<Width, Faces>(hierarchy, nextPath);
+
+        const std::uint32_t index = Hierarchy<Width>::getRefIndex(entry.ref);
+        if (Hierarchy<Width>::isLeafRef(entry.ref))
+        {
+            // If it's a leaf, visit its meshlet holding a packet of faces, or its patches.
+            for (std::uint32_t i = index; i < index + entry.elementCount; ++i)
+            {
+                visitElement<Faces>(hierarchy.getElement(i), queryPoint, sqrMaxDist, filter,
+                                    result);
+            }
+            continue;
+        }
+
+        // Otherwise, compute the distances to all children boxes at once..
+        const auto &node = hierarchy.getNode(index);
+        float childSqrDistances[Width];
+        computeChildrenSqrDistances<Width>(queryPoint, node, childSqrDistances);
+
+        // ..and add to the heap the children closer than the current result.
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            if (hasGroupMasks && !(m_nodeGroupMasks[index * Width + slot] & filter->groupMask))
+                continue;
+            if (childSqrDistances[slot] < getSqrBound())
+            {
+                heap.push_back( HeapEntry{node.child[slot],
+                                          node.elementCount[slot],
+                                          childSqrDistances[slot]} );
+                std::push_heap(heap.begin(), heap.end(), heapCompare);
+            }
+            else
+            {
+                // Faces of pruned children bound the runner-up from below.
+                result.sqrRunnerUp = std::min(result.sqrRunnerUp, childSqrDistances[slot]);
+            }
         }
     }
 
-    return result.first;
+    // So do those of the entries left in the heap, the closest being on top.
+    if (!heap.empty())
+        result.sqrRunnerUp = std::min(result.sqrRunnerUp, heap.front().sqrDist);
+    return result;
 }
 
 } // namespace cpom
@@ -0,0 +1,266 @@
+#ifndef __COMPACTOCTREE_H__
+#define __COMPACTOCTREE_H__
+
+#include "OctreeNode.h"
+
+#include <bitset>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cpom
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// DECLARATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+/// \brief Class defining a read-only octree flattened from a tree of OctreeNode.
+///
+/// Nodes are stored in a single array, the existing children of a node being
+/// contiguous and the blocks of children laid out in depth-first order, so that
+/// each subtree and the elements of its leaves occupy a compact range of memory.
+/// Elements of all leaves are stored in a single array as well, each leaf
+/// referencing a contiguous range of it; leaves follow the Z-order curve of the
+/// octree cells.
+///
+/// Nodes do not store their bounds: only the root bounds are kept and the bounds
+/// of a child are derived from its parent with OctreeNode::getChildBounds()
+/// while traversing.
+///
+/// Both arrays are allocated once, with their exact size, with an Allocator.
+///
+/// Example usage can be found in the unit test CompactOctree.ut.cpp.
+template<class T, class Allocator = std::allocator<T>>
+class CompactOctree
+{
+public:
+    /// Type of a node, packed in 8 bytes.
+    class Node
+    {
+    public:
+        /// Return true if this node is a leaf.
+        inline bool isLeaf() const;
+
+        /// Return a mask of the existing children nodes, bit i being set if child i exists.
+        inline unsigned getChildMask() const;
+
+        /// Return the index of the first existing child in the node array.
+        inline std::uint32_t getFirstChild() const;
+
+        /// Return the index of the first element of a leaf in the element array.
+        inline std::uint32_t getFirstElement() const;
+
+        /// Return the number of elements of a leaf.
+        inline std::uint32_t getElementCount() const;
+
+    private:
+        friend class CompactOctree;
+
+        // Index of the first child for nodes, of the first element for leaves.
+        std::uint32_t m_offset;
+        // Children mask in the low byte; element count in the upper bytes for leaves.
+        std::uint32_t m_info;
+    };
+
+    /// Type of the allocator of nodes.
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+
+    /// Type of the array of nodes.
+    using NodeList = std::vector<Node, NodeAllocator>;
+
+    /// Type of the array of elements.
+    using ElementList = std::vector<T, Allocator>;
+
+    /// Construct an empty CompactOctree.
+    explicit CompactOctree(const Allocator &allocator = Allocator());
+
+    /// \brief Construct a CompactOctree by flattening a tree of OctreeNode.
+    ///
+    /// \param[in] root Root node of the tree to flatten.
+    /// \param[in] bounds Axis Aligned Bounding Cube of the root node.
+    /// \param[in] convertLeaf Function converting the elements of a leaf of the
+    /// source tree, given as an OctreeNode::ElementList, and appending them to the
+    /// ElementList passed as second argument.
+    /// \param[in] allocator Allocator of the nodes and elements of the octree.
+    /// \param[in] scratchAllocator Allocator of the arrays filled while flattening.
+    ///
+    template<class U, class UAllocator, class ConvertLeaf>
+    CompactOctree(const OctreeNode<U, UAllocator> &root,
+                  const AABCube &bounds,
+                  ConvertLeaf convertLeaf,
+                  const Allocator &allocator = Allocator(),
+                  const Allocator &scratchAllocator = Allocator());
+
+    /// Return true if the octree has no node.
+    inline bool empty() const;
+
+    /// Return the Axis Aligned Bounding Cube of the root node.
+    inline const AABCube &getBounds() const;
+
+    /// Return the node at a given index, the root node having index 0.
+    inline const Node &getNode(std::uint32_t index) const;
+
+    /// Return the element at a given index.
+    inline const T &getElement(std::uint32_t index) const;
+
+    /// Return all the nodes.
+    inline const NodeList &getNodes() const;
+
+    /// Return the elements of all leaves.
+    inline const ElementList &getElements() const;
+
+private:
+    NodeList m_nodes;
+    ElementList m_elements;
+    AABCube m_bounds;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// DEFINITION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+template<class T, class Allocator>
+bool CompactOctree<T, Allocator>::Node::isLeaf() const
+{
+    return getChildMask() == 0;
+}
+
+template<class T, class Allocator>
+unsigned CompactOctree<T, Allocator>::Node::getChildMask() const
+{
+    return m_info & 0xFFu;
+}
+
+template<class T, class Allocator>
+std::uint32_t CompactOctree<T, Allocator>::Node::getFirstChild() const
+{
+    assert(!isLeaf());
+    return m_offset;
+}
+
+template<class T, class Allocator>
+std::uint32_t CompactOctree<T, Allocator>::Node::getFirstElement() const
+{
+    assert(isLeaf());
+    return m_offset;
+}
+
+template<class T, class Allocator>
+std::uint32_t CompactOctree<T, Allocator>::Node::getElementCount() const
+{
+    assert(isLeaf());
+    return m_info >> 8;
+}
+
+template<class T, class Allocator>
+CompactOctree<T, Allocator>::CompactOctree(const Allocator &allocator)
+: m_nodes(NodeAllocator(allocator)),
+  m_elements(allocator),
+  m_bounds()
+{ }
+
+template<class T, class Allocator>
+template<class U, class UAllocator, class ConvertLeaf>
+CompactOctree<T, Allocator>::CompactOctree(const OctreeNode<U, UAllocator> &root,
+                                           const AABCube &bounds,
+                                           ConvertLeaf convertLeaf,
+                                           const Allocator &allocator,
+                                           const Allocator &scratchAllocator)
+: m_nodes(NodeAllocator(allocator)),
+  m_elements(allocator),
+  m_bounds(bounds)
+{
+    using SourceNode = OctreeNode<U, UAllocator>;
+    using PendingNode = std::pair<const SourceNode *, std::uint32_t>;
+    using PendingAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<PendingNode>;
+
+    NodeList nodes{NodeAllocator(scratchAllocator)};
+    ElementList elements(scratchAllocator);
+
+    // Walk the source tree depth first: the children of a node are appended
+    // contiguously when the node is written, then visited in child index order.
+    std::vector<PendingNode, PendingAllocator> pending{PendingAllocator(scratchAllocator)};
+    nodes.push_back(Node());
+    pending.emplace_back(&root, 0);
+    while (!pending.empty())
+    {
+        const SourceNode &sourceNode = *pending.back().first;
+        const std::uint32_t nodeIndex = pending.back().second;
+        pending.pop_back();
+
+        if (sourceNode.isLeaf())
+        {
+            const auto firstElement = static_cast<std::uint32_t>(elements.size());
+            convertLeaf(sourceNode.getElements(), elements);
+            const auto elementCount = static_cast<std::uint32_t>(elements.size()) - firstElement;
+            assert(elementCount < (1u << 24));
+            nodes[nodeIndex].m_offset = firstElement;
+            nodes[nodeIndex].m_info = elementCount << 8;
+            continue;
+        }
+
+        const auto firstChild = static_cast<std::uint32_t>(nodes.size());
+        nodes[nodeIndex].m_offset = firstChild;
+        nodes[nodeIndex].m_info = sourceNode.getChildMask();
+        const auto childCount = static_cast<std::uint32_t>(
+            std::bitset<8>(sourceNode.getChildMask()).count());
+        nodes.resize(firstChild + childCount);
+
+        // Push children in reverse order so that the first one is visited next.
+        std::uint32_t childNodeIndex = firstChild + childCount;
+        for (int childIndex = 7; childIndex >= 0; --childIndex)
+        {
+            if (const SourceNode *child = sourceNode.getChild(childIndex))
+                pending.emplace_back(child, --childNodeIndex);
+        }
+    }
+
+    // Copy the arrays to their final storage.
+    m_nodes.assign(nodes.begin(), nodes.end());
+    m_elements.assign(elements.begin(), elements.end());
+}
+
+template<class T, class Allocator>
+bool CompactOctree<T, Allocator>::empty() const
+{
+    return m_nodes.empty();
+}
+
+template<class T, class Allocator>
+const AABCube &CompactOctree<T, Allocator>::getBounds() const
+{
+    return m_bounds;
+}
+
+template<class T, class Allocator>
+const typename CompactOctree<T, Allocator>::Node &CompactOctree<T, Allocator>::getNode(std::uint32_t index) const
+{
+    assert(index < m_nodes.size());
+    return m_nodes[index];
+}
+
+template<class T, class Allocator>
+const T &CompactOctree<T, Allocator>::getElement(std::uint32_t index) const
+{
+    assert(index < m_elements.size());
+    return m_elements[index];
+}
+
+template<class T, class Allocator>
+const typename CompactOctree<T, Allocator>::NodeList &CompactOctree<T, Allocator>::getNodes() const
+{
+    return m_nodes;
+}
+
+template<class T, class Allocator>
+const typename CompactOctree<T, Allocator>::ElementList &CompactOctree<T, Allocator>::getElements() const
+{
+    return m_elements;
+}
+
+} //namespace cpom
+
+#endif // __COMPACTOCTREE_H__
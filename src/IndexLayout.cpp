@@ -0,0 +1,39 @@
+#include <IndexLayout.h>
+
+#include <ostream>
+#include <stdexcept>
+
+namespace cpom
+{
+
+void writeLeafBoxes(std::ostream &out, const IndexLayout &layout)
+{
+    // Corner i takes the upper coordinate along x, y and z for bits 0, 1 and 2.
+    static const int quads[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 },
+                                     { 0, 1, 5, 4 }, { 2, 6, 7, 3 },
+                                     { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+    std::size_t firstVertex = 1;
+    for (std::size_t l = 0; l < layout.leaves.size(); ++l)
+    {
+        const IndexLeaf &leaf = layout.leaves[l];
+        out << "g leaf" << l << '\n';
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            out << "v " << (corner & 1 ? leaf.max.x : leaf.min.x)
+                << ' ' << (corner & 2 ? leaf.max.y : leaf.min.y)
+                << ' ' << (corner & 4 ? leaf.max.z : leaf.min.z) << '\n';
+        }
+        for (const auto &quad : quads)
+        {
+            out << 'f';
+            for (const int corner : quad)
+                out << ' ' << firstVertex + corner;
+            out << '\n';
+        }
+        firstVertex += 8;
+    }
+    if (!out)
+        throw std::invalid_argument("Failed to write leaf boxes");
+}
+
+} // namespace cpom
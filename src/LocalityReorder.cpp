@@ -0,0 +1,142 @@
+#include <LocalityReorder.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+namespace cpom
+{
+
+namespace
+{
+
+constexpr float infinity = std::numeric_limits<float>::infinity();
+
+/// Spread the 10 lower bits of a value so that they are 3 bits apart.
+inline std::uint32_t spreadBits(std::uint32_t value)
+{
+    value &= 0x3FFu;
+    value = (value | (value << 16)) & 0x030000FFu;
+    value = (value | (value <<  8)) & 0x0300F00Fu;
+    value = (value | (value <<  4)) & 0x030C30C3u;
+    value = (value | (value <<  2)) & 0x09249249u;
+    return value;
+}
+
+template<class T>
+using ScratchArray = std::vector<T, PolymorphicAllocator<T>>;
+
+/// \brief Permute a sequence in place, so that element i becomes the element order[i].
+///
+/// Elements are moved along the cycles of the permutation, so that elements
+/// owning memory, like faces, are not copied.
+template<class T>
+void permute(std::vector<T> &sequence,
+             const ScratchArray<std::uint32_t> &order,
+             MemoryResource &scratch)
+{
+    assert(sequence.size() == order.size());
+    ScratchArray<bool> isPlaced(sequence.size(), false, scratch);
+    for (std::size_t first = 0; first < sequence.size(); ++first)
+    {
+        if (isPlaced[first])
+            continue;
+        T element = std::move(sequence[first]);
+        std::size_t i = first;
+        while (order[i] != first)
+        {
+            sequence[i] = std::move(sequence[order[i]]);
+            isPlaced[i] = true;
+            i = order[i];
+        }
+        sequence[i] = std::move(element);
+        isPlaced[i] = true;
+    }
+}
+
+/// Quantize a coordinate on 10 bits within [lower, upper].
+inline std::uint32_t quantize(float coordinate, float lower, float upper)
+{
+    const float extent = upper - lower;
+    if (!(extent > 0.0f))
+        return 0;
+    const float normalized = std::min(std::max((coordinate - lower) / extent, 0.0f), 1.0f);
+    return static_cast<std::uint32_t>(normalized * 1023.0f);
+}
+
+} // anonymous namespace
+
+std::uint32_t computeMortonCode(const Point &point, const Point &lower, const Point &upper)
+{
+    return spreadBits(quantize(point.x, lower.x, upper.x)) |
+           spreadBits(quantize(point.y, lower.y, upper.y)) << 1 |
+           spreadBits(quantize(point.z, lower.z, upper.z)) << 2;
+}
+
+std::vector<std::uint32_t, PolymorphicAllocator<std::uint32_t>>
+reorderForLocality(std::vector<Face> &faces,
+                   std::vector<Point> &vertices,
+                   MemoryResource &scratch)
+{
+    // Compute the center of the extent of each face, and the extent of all centers.
+    ScratchArray<Point> centers(faces.size(), Point(), scratch);
+    Point lower(infinity);
+    Point upper(-infinity);
+    for (std::size_t i = 0; i < faces.size(); ++i)
+    {
+        Point faceLower(infinity);
+        Point faceUpper(-infinity);
+        for (const int vertexId: faces[i].vertexIds)
+        {
+            const Point &v = vertices[vertexId];
+            faceLower = Point(std::min(faceLower.x, v.x), std::min(faceLower.y, v.y),
+                              std::min(faceLower.z, v.z));
+            faceUpper = Point(std::max(faceUpper.x, v.x), std::max(faceUpper.y, v.y),
+                              std::max(faceUpper.z, v.z));
+        }
+        centers[i] = faces[i].vertexIds.empty() ? Point(0.0f) : (faceLower + faceUpper) * 0.5f;
+        lower = Point(std::min(lower.x, centers[i].x), std::min(lower.y, centers[i].y),
+                      std::min(lower.z, centers[i].z));
+        upper = Point(std::max(upper.x, centers[i].x), std::max(upper.y, centers[i].y),
+                      std::max(upper.z, centers[i].z));
+    }
+
+    // Sort faces along the Z-order curve.
+    ScratchArray<std::uint32_t> codes(faces.size(), 0, scratch);
+    for (std::size_t i = 0; i < faces.size(); ++i)
+        codes[i] = computeMortonCode(centers[i], lower, upper);
+    ScratchArray<std::uint32_t> faceOrder(faces.size(), 0, scratch);
+    std::iota(faceOrder.begin(), faceOrder.end(), 0);
+    std::stable_sort(faceOrder.begin(), faceOrder.end(),
+                     [&codes](std::uint32_t a, std::uint32_t b) { return codes[a] < codes[b]; });
+    permute(faces, faceOrder, scratch);
+
+    // Renumber vertices by first use, keeping unused vertices last.
+    constexpr int unused = -1;
+    ScratchArray<int> newVertexIds(vertices.size(), unused, scratch);
+    ScratchArray<std::uint32_t> vertexOrder(scratch);
+    vertexOrder.reserve(vertices.size());
+    for (Face &face: faces)
+    {
+        for (int &vertexId: face.vertexIds)
+        {
+            if (newVertexIds[vertexId] == unused)
+            {
+                newVertexIds[vertexId] = static_cast<int>(vertexOrder.size());
+                vertexOrder.push_back(static_cast<std::uint32_t>(vertexId));
+            }
+            vertexId = newVertexIds[vertexId];
+        }
+    }
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        if (newVertexIds[i] == unused)
+            vertexOrder.push_back(static_cast<std::uint32_t>(i));
+    }
+    permute(vertices, vertexOrder, scratch);
+
+    return faceOrder;
+}
+
+} // namespace cpom
@@ -0,0 +1,46 @@
+#ifndef __LOCALITYREORDER_H__
+#define __LOCALITYREORDER_H__
+
+#include <Float3.h>
+#include <MemoryResource.h>
+#include <Mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cpom
+{
+
+/// \brief Return the Morton code of a point within an extent.
+///
+/// Coordinates are quantized on 10 bits per axis, and their bits interleaved
+/// so that sorting codes orders points along a Z-order space-filling curve.
+///
+/// \param[in] point Coordinate to encode.
+/// \param[in] lower Lower corner of the extent.
+/// \param[in] upper Upper corner of the extent.
+///
+std::uint32_t computeMortonCode(const Point &point, const Point &lower, const Point &upper);
+
+/// \brief Reorder faces and vertices of a mesh to improve memory locality.
+///
+/// Faces are sorted along a Z-order curve of their centers, then vertices are
+/// renumbered in the order they are first used by faces. Vertices used by no face
+/// are kept after all others.
+///
+/// Both sequences are permuted in place.
+///
+/// \param[in,out] faces Faces to reorder, their vertex ids being remapped.
+/// \param[in,out] vertices Vertices to reorder.
+/// \param[in] scratch Memory resource of temporary arrays and of the result.
+///
+/// \return For each reordered face, its index in the original sequence of faces.
+///
+std::vector<std::uint32_t, PolymorphicAllocator<std::uint32_t>>
+reorderForLocality(std::vector<Face> &faces,
+                   std::vector<Point> &vertices,
+                   MemoryResource &scratch = getDefaultMemoryResource());
+
+} // namespace cpom
+
+#endif // __LOCALITYREORDER_H__
@@ -0,0 +1,302 @@
+#include <MemoryResource.h>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace cpom
+{
+
+namespace
+{
+
+/// MemoryResource using the global operators new and delete.
+class NewDeleteResource : public MemoryResource
+{
+public:
+    virtual void *allocate(std::size_t bytes, std::size_t alignment)
+    {
+        // Blocks of the global operator new are aligned for any fundamental type.
+        if (alignment > alignof(std::max_align_t))
+            throw std::bad_alloc();
+        return ::operator new(bytes);
+    }
+
+    virtual void deallocate(void *p, std::size_t, std::size_t)
+    {
+        ::operator delete(p);
+    }
+};
+
+/// MemoryResource mapping large blocks in huge pages, see getHugePageMemoryResource().
+class HugePageResource : public MemoryResource
+{
+public:
+    virtual void *allocate(std::size_t bytes, std::size_t alignment)
+    {
+#if defined(__linux__)
+        if (bytes >= minHugePageBlockSize && alignment <= hugePageSize)
+        {
+            const std::size_t size = roundUp(bytes);
+
+            // Explicit huge pages are only available when reserved by the system.
+            void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED)
+                return p;
+
+            // Otherwise map a range aligned on huge pages, trimming the excess,
+            // and advise the kernel to back it with transparent huge pages.
+            char *mapping = static_cast<char *>(mmap(nullptr, size + hugePageSize,
+                                                     PROT_READ | PROT_WRITE,
+                                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (mapping == MAP_FAILED)
+                throw std::bad_alloc();
+            const auto address = reinterpret_cast<std::uintptr_t>(mapping);
+            const std::size_t head = (hugePageSize - address % hugePageSize) % hugePageSize;
+            if (head)
+                munmap(mapping, head);
+            if (hugePageSize - head)
+                munmap(mapping + head + size, hugePageSize - head);
+            madvise(mapping + head, size, MADV_HUGEPAGE);
+            return mapping + head;
+        }
+#endif
+        return getDefaultMemoryResource().allocate(bytes, alignment);
+    }
+
+    virtual void deallocate(void *p, std::size_t bytes, std::size_t alignment)
+    {
+#if defined(__linux__)
+        if (bytes >= minHugePageBlockSize && alignment <= hugePageSize)
+        {
+            munmap(p, roundUp(bytes));
+            return;
+        }
+#endif
+        getDefaultMemoryResource().deallocate(p, bytes, alignment);
+    }
+
+private:
+    static constexpr std::size_t hugePageSize = 2 * 1024 * 1024;
+    static constexpr std::size_t minHugePageBlockSize = 1024 * 1024;
+
+    /// Return a size rounded up to a multiple of the huge page size.
+    static std::size_t roundUp(std::size_t bytes)
+    {
+        return (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+    }
+};
+
+/// Return p rounded up to a multiple of a power of two alignment.
+inline char *alignUp(char *p, std::size_t alignment)
+{
+    const auto address = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((alignment - address % alignment) % alignment);
+}
+
+} // anonymous namespace
+
+MemoryResource &getDefaultMemoryResource()
+{
+    static NewDeleteResource resource;
+    return resource;
+}
+
+MemoryResource &getHugePageMemoryResource()
+{
+    static HugePageResource resource;
+    return resource;
+}
+
+/// Header of a chunk, stored at its beginning and linking to the previous chunk.
+struct MonotonicBuffer::Chunk
+{
+    Chunk *previous;
+    std::size_t size;
+};
+
+MonotonicBuffer::MonotonicBuffer(MemoryResource &upstream, std::size_t initialChunkSize)
+: m_upstream(upstream),
+  m_chunks(nullptr),
+  m_chunkCount(0),
+  m_nextChunkSize(std::max(initialChunkSize, 2 * sizeof(Chunk))),
+  m_initialBuffer(nullptr),
+  m_initialBufferSize(0),
+  m_current(nullptr),
+  m_end(nullptr)
+{ }
+
+MonotonicBuffer::MonotonicBuffer(void *buffer, std::size_t bufferSize, MemoryResource &upstream)
+: m_upstream(upstream),
+  m_chunks(nullptr),
+  m_chunkCount(0),
+  m_nextChunkSize(std::max(2 * bufferSize, 2 * sizeof(Chunk))),
+  m_initialBuffer(buffer),
+  m_initialBufferSize(bufferSize),
+  m_current(static_cast<char *>(buffer)),
+  m_end(static_cast<char *>(buffer) + bufferSize)
+{ }
+
+MonotonicBuffer::~MonotonicBuffer()
+{
+    release();
+}
+
+void *MonotonicBuffer::allocate(std::size_t bytes, std::size_t alignment)
+{
+    char *p = m_current ? alignUp(m_current, alignment) : nullptr;
+    if (!p || p > m_end || static_cast<std::size_t>(m_end - p) < bytes)
+    {
+        // Allocate a new chunk large enough for the block and its alignment.
+        const std::size_t minChunkSize = sizeof(Chunk) + alignment + bytes;
+        const std::size_t chunkSize = std::max(m_nextChunkSize, minChunkSize);
+        void *memory = m_upstream.allocate(chunkSize, alignof(std::max_align_t));
+        Chunk *chunk = static_cast<Chunk *>(memory);
+        chunk->previous = m_chunks;
+        chunk->size = chunkSize;
+        m_chunks = chunk;
+        ++m_chunkCount;
+        m_nextChunkSize = 2 * chunkSize;
+        m_current = static_cast<char *>(memory) + sizeof(Chunk);
+        m_end = static_cast<char *>(memory) + chunkSize;
+        p = alignUp(m_current, alignment);
+    }
+    m_current = p + bytes;
+    return p;
+}
+
+void MonotonicBuffer::release()
+{
+    while (m_chunks)
+    {
+        Chunk *previous = m_chunks->previous;
+        m_upstream.deallocate(m_chunks, m_chunks->size, alignof(std::max_align_t));
+        m_chunks = previous;
+    }
+    m_chunkCount = 0;
+    m_current = static_cast<char *>(m_initialBuffer);
+    m_end = static_cast<char *>(m_initialBuffer) + m_initialBufferSize;
+}
+
+constexpr std::size_t PoolResource::maxPooledBlockSize;
+constexpr int PoolResource::poolCount;
+
+/// Header of a pooled block, linking it to the next one.
+struct PoolResource::FreeBlock
+{
+    FreeBlock *next;
+};
+
+namespace
+{
+
+/// Size of the smallest pooled block.
+constexpr std::size_t minPooledBlockSize = 16;
+
+/// Size of the slabs carved into pooled blocks.
+constexpr std::size_t slabSize = 64 * 1024;
+
+/// Size of the header of slabs, keeping the blocks that follow it aligned.
+constexpr std::size_t slabHeaderSize = alignof(std::max_align_t) > sizeof(void *) ?
+                                       alignof(std::max_align_t) : sizeof(void *);
+
+/// Return the size of the blocks of a pool.
+inline std::size_t getPoolBlockSize(int poolIndex)
+{
+    return minPooledBlockSize << poolIndex;
+}
+
+/// Return the number of blocks in the slabs of a pool.
+inline std::size_t getSlabBlockCount(int poolIndex)
+{
+    return std::max<std::size_t>((slabSize - slabHeaderSize) / getPoolBlockSize(poolIndex), 1);
+}
+
+} // anonymous namespace
+
+PoolResource::PoolResource(MemoryResource &upstream)
+: m_upstream(upstream),
+  m_freeBlocks(),
+  m_slabs()
+{
+    static_assert(minPooledBlockSize << (poolCount-1) >= maxPooledBlockSize,
+                  "Not enough pools for the largest pooled block");
+}
+
+PoolResource::~PoolResource()
+{
+    release();
+}
+
+int PoolResource::getPoolIndex(std::size_t bytes, std::size_t alignment)
+{
+    if (bytes > maxPooledBlockSize || alignment > alignof(std::max_align_t))
+        return -1;
+    int poolIndex = 0;
+    while (getPoolBlockSize(poolIndex) < bytes)
+        ++poolIndex;
+    return poolIndex;
+}
+
+void *PoolResource::allocate(std::size_t bytes, std::size_t alignment)
+{
+    const int poolIndex = getPoolIndex(bytes, alignment);
+    if (poolIndex < 0)
+        return m_upstream.allocate(bytes, alignment);
+
+    if (!m_freeBlocks[poolIndex])
+    {
+        // Carve a new slab into free blocks, the slab header linking to the
+        // previous slab of the pool.
+        const std::size_t blockSize = getPoolBlockSize(poolIndex);
+        const std::size_t blockCount = getSlabBlockCount(poolIndex);
+        char *slab = static_cast<char *>(m_upstream.allocate(slabHeaderSize + blockCount * blockSize,
+                                                             alignof(std::max_align_t)));
+        FreeBlock *header = reinterpret_cast<FreeBlock *>(slab);
+        header->next = m_slabs[poolIndex];
+        m_slabs[poolIndex] = header;
+        for (std::size_t i = blockCount; i > 0; --i)
+        {
+            FreeBlock *block = reinterpret_cast<FreeBlock *>(slab + slabHeaderSize + (i-1) * blockSize);
+            block->next = m_freeBlocks[poolIndex];
+            m_freeBlocks[poolIndex] = block;
+        }
+    }
+
+    FreeBlock *block = m_freeBlocks[poolIndex];
+    m_freeBlocks[poolIndex] = block->next;
+    return block;
+}
+
+void PoolResource::deallocate(void *p, std::size_t bytes, std::size_t alignment)
+{
+    const int poolIndex = getPoolIndex(bytes, alignment);
+    if (poolIndex < 0)
+    {
+        m_upstream.deallocate(p, bytes, alignment);
+        return;
+    }
+    FreeBlock *block = static_cast<FreeBlock *>(p);
+    block->next = m_freeBlocks[poolIndex];
+    m_freeBlocks[poolIndex] = block;
+}
+
+void PoolResource::release()
+{
+    for (int poolIndex = 0; poolIndex < poolCount; ++poolIndex)
+    {
+        const std::size_t slabBytes = slabHeaderSize +
+                                      getSlabBlockCount(poolIndex) * getPoolBlockSize(poolIndex);
+        while (FreeBlock *slab = m_slabs[poolIndex])
+        {
+            m_slabs[poolIndex] = slab->next;
+            m_upstream.deallocate(slab, slabBytes, alignof(std::max_align_t));
+        }
+        m_freeBlocks[poolIndex] = nullptr;
+    }
+}
+
+} // namespace cpom
@@ -0,0 +1,186 @@
+#include <MeshletStore.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cpom
+{
+
+constexpr std::uint8_t MeshletFace::noVertex;
+constexpr int MeshletStore::maxVertices;
+
+namespace
+{
+
+constexpr std::uint32_t noMeshlet = std::numeric_limits<std::uint32_t>::max();
+
+/// \brief Return true if a quad is convex, and planar within a tolerance.
+///
+/// \param[in] vertices Coordinates of the four vertices, in order.
+/// \param[in] tolerance Maximal distance of the vertices to the mean plane,
+/// relative to the length of the longest diagonal.
+///
+bool isPlanarConvexQuad(const Point *vertices[4], const float tolerance)
+{
+    const Float3 diagonal0 = *vertices[2] - *vertices[0];
+    const Float3 diagonal1 = *vertices[3] - *vertices[1];
+    const Float3 normal = diagonal0.cross(diagonal1);
+    const float normalLength = normal.length();
+    if (!(normalLength > 0.0f))
+        return false;
+
+    // Each vertex must be close to the plane through the center of the quad.
+    const Point center = (*vertices[0] + *vertices[1] + *vertices[2] + *vertices[3]) * 0.25f;
+    const float maxHeight = tolerance * std::sqrt(std::max(diagonal0.sqrLength(),
+                                                           diagonal1.sqrLength()));
+    for (int i = 0; i < 4; ++i)
+    {
+        if (std::abs((*vertices[i] - center).dot(normal)) > maxHeight * normalLength)
+            return false;
+    }
+
+    // Each corner must turn in the same direction, around the normal.
+    for (int i = 0; i < 4; ++i)
+    {
+        const Float3 edge0 = *vertices[(i+1) % 4] - *vertices[i];
+        const Float3 edge1 = *vertices[(i+2) % 4] - *vertices[(i+1) % 4];
+        if (!(edge0.cross(edge1).dot(normal) > 0.0f))
+            return false;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+MeshletStore::MeshletStore(MemoryResource &resource)
+: m_meshlets(resource),
+  m_vertices(resource),
+  m_faces(resource),
+  m_faceIds(resource),
+  m_faceGroups(resource),
+  m_groupMasks(resource)
+{ }
+
+MeshletBuilder::MeshletBuilder(const std::vector<Face> &faces,
+                               const std::vector<Point> &vertices,
+                               MeshletStore &store,
+                               const std::uint32_t *faceIds,
+                               MemoryResource &scratch,
+                               float planarQuadTolerance,
+                               const std::uint8_t *faceGroups)
+: m_faces(faces),
+  m_vertices(vertices),
+  m_store(store),
+  m_faceIds(faceIds),
+  m_planarQuadTolerance(planarQuadTolerance),
+  m_faceGroups(faceGroups),
+  m_meshlets(scratch),
+  m_meshletVertices(scratch),
+  m_meshletFaces(scratch),
+  m_meshletFaceIds(scratch),
+  m_meshletFaceGroups(scratch),
+  m_groupMasks(scratch),
+  m_vertexMeshlet(vertices.size(), noMeshlet, scratch),
+  m_vertexLocalIndex(vertices.size(), 0, scratch)
+{
+    assert(store.size() == 0);
+}
+
+std::pair<std::uint32_t, std::uint32_t>
+MeshletBuilder::add(const std::uint32_t *faceIndices, std::size_t faceCount)
+{
+    auto &meshlets = m_meshlets;
+    const auto firstMeshlet = static_cast<std::uint32_t>(meshlets.size());
+
+    // Start a new, empty meshlet.
+    const auto startMeshlet = [this, &meshlets]()
+    {
+        Meshlet meshlet;
+        meshlet.firstVertex = static_cast<std::uint32_t>(m_meshletVertices.size());
+        meshlet.firstFace = static_cast<std::uint32_t>(m_meshletFaces.size());
+        meshlet.vertexCount = 0;
+        meshlet.hasPlanarQuads = m_planarQuadTolerance >= 0.0f;
+        meshlet.faceCount = 0;
+        meshlets.push_back(meshlet);
+        if (m_faceGroups)
+            m_groupMasks.push_back(0);
+    };
+
+    for (std::size_t i = 0; i < faceCount; ++i)
+    {
+        const std::uint32_t faceIndex = faceIndices[i];
+        assert(faceIndex < m_faces.size());
+        const auto &vertexIds = m_faces[faceIndex].vertexIds;
+        const bool isSupported = vertexIds.size() == 3 || vertexIds.size() == 4;
+
+        // Count the vertices of this face missing from the current meshlet,
+        // and start a new one if they do not fit.
+        int missingVertices = 0;
+        const auto currentMeshlet = static_cast<std::uint32_t>(meshlets.size()) - 1;
+        if (isSupported)
+        {
+            for (const int vertexId: vertexIds)
+            {
+                if (meshlets.size() == firstMeshlet || m_vertexMeshlet[vertexId] != currentMeshlet)
+                    ++missingVertices;
+            }
+        }
+        if (meshlets.size() == firstMeshlet ||
+            meshlets.back().vertexCount + missingVertices > MeshletStore::maxVertices ||
+            meshlets.back().faceCount == std::numeric_limits<std::uint16_t>::max())
+        {
+            startMeshlet();
+        }
+
+        // Add the face, copying the vertices not in the meshlet yet.
+        Meshlet &meshlet = meshlets.back();
+        const auto meshletIndex = static_cast<std::uint32_t>(meshlets.size()) - 1;
+        MeshletFace face = {{ MeshletFace::noVertex, MeshletFace::noVertex,
+                              MeshletFace::noVertex, MeshletFace::noVertex }};
+        if (isSupported)
+        {
+            for (std::size_t v = 0; v < vertexIds.size(); ++v)
+            {
+                const int vertexId = vertexIds[v];
+                if (m_vertexMeshlet[vertexId] != meshletIndex)
+                {
+                    m_vertexMeshlet[vertexId] = meshletIndex;
+                    m_vertexLocalIndex[vertexId] = static_cast<std::uint8_t>(meshlet.vertexCount++);
+                    m_meshletVertices.push_back(m_vertices[vertexId]);
+                }
+                face.vertices[v] = m_vertexLocalIndex[vertexId];
+            }
+        }
+        if (vertexIds.size() == 4 && meshlet.hasPlanarQuads)
+        {
+            const Point *quadVertices[4] = { &m_vertices[vertexIds[0]], &m_vertices[vertexIds[1]],
+                                             &m_vertices[vertexIds[2]], &m_vertices[vertexIds[3]] };
+            meshlet.hasPlanarQuads = isPlanarConvexQuad(quadVertices, m_planarQuadTolerance);
+        }
+        const std::uint32_t faceId = m_faceIds ? m_faceIds[faceIndex] : faceIndex;
+        m_meshletFaces.push_back(face);
+        m_meshletFaceIds.push_back(faceId);
+        if (m_faceGroups)
+        {
+            assert(m_faceGroups[faceId] < 64);
+            m_meshletFaceGroups.push_back(m_faceGroups[faceId]);
+            m_groupMasks.back() |= std::uint64_t(1) << m_faceGroups[faceId];
+        }
+        ++meshlet.faceCount;
+    }
+
+    return std::make_pair(firstMeshlet, static_cast<std::uint32_t>(meshlets.size()));
+}
+
+void MeshletBuilder::finish()
+{
+    m_store.m_meshlets.assign(m_meshlets.begin(), m_meshlets.end());
+    m_store.m_vertices.assign(m_meshletVertices.begin(), m_meshletVertices.end());
+    m_store.m_faces.assign(m_meshletFaces.begin(), m_meshletFaces.end());
+    m_store.m_faceIds.assign(m_meshletFaceIds.begin(), m_meshletFaceIds.end());
+    m_store.m_faceGroups.assign(m_meshletFaceGroups.begin(), m_meshletFaceGroups.end());
+    m_store.m_groupMasks.assign(m_groupMasks.begin(), m_groupMasks.end());
+}
+
+} // namespace cpom
@@ -0,0 +1,229 @@
+#ifndef __MESHLETSTORE_H__
+#define __MESHLETSTORE_H__
+
+#include <Float3.h>
+#include <MemoryResource.h>
+#include <Mesh.h>
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cpom
+{
+
+/// Type of a meshlet face, made of indices into the vertex block of its meshlet.
+struct MeshletFace
+{
+    /// Index used for the fourth vertex of triangles, and all vertices of
+    /// faces with an unsupported number of vertices.
+    static constexpr std::uint8_t noVertex = 0xFF;
+
+    std::uint8_t vertices[4];
+
+    /// Return true if the face is a triangle.
+    bool isTriangle() const { return vertices[3] == noVertex; }
+
+    /// Return true if the face has an unsupported number of vertices.
+    bool isUnsupported() const { return vertices[0] == noVertex; }
+};
+
+/// \brief Type of a meshlet: a block of faces with their own copy of the vertices they use.
+///
+/// Evaluating a meshlet only reads two contiguous runs of memory, its vertices
+/// and its faces, instead of gathering vertices from the whole mesh.
+struct Meshlet
+{
+    std::uint32_t firstVertex;
+    std::uint32_t firstFace;
+    std::uint8_t vertexCount;
+    /// True if all the quads of the meshlet are planar and convex.
+    bool hasPlanarQuads;
+    std::uint16_t faceCount;
+};
+
+/// \brief Class holding the meshlets of all the leaves of a spatial index.
+///
+/// Meshlets are filled by a MeshletBuilder.
+class MeshletStore
+{
+public:
+    /// Maximal number of vertices in a meshlet, indices being stored on 8 bits.
+    static constexpr int maxVertices = MeshletFace::noVertex;
+
+    /// \brief Construct an empty store.
+    ///
+    /// \param[in] resource Memory resource from which the meshlets are allocated.
+    ///
+    /// \post A reference to resource is maintained.
+    ///
+    explicit MeshletStore(MemoryResource &resource = getDefaultMemoryResource());
+
+    /// Return the number of meshlets.
+    std::uint32_t size() const { return static_cast<std::uint32_t>(m_meshlets.size()); }
+
+    /// Return the meshlet at a given index.
+    const Meshlet &getMeshlet(std::uint32_t index) const
+    {
+        assert(index < m_meshlets.size());
+        return m_meshlets[index];
+    }
+
+    /// Return the vertex block of a meshlet.
+    const Point *getVertices(const Meshlet &meshlet) const
+    {
+        return m_vertices.data() + meshlet.firstVertex;
+    }
+
+    /// Return the faces of a meshlet.
+    const MeshletFace *getFaces(const Meshlet &meshlet) const
+    {
+        return m_faces.data() + meshlet.firstFace;
+    }
+
+    /// Return the ids of the faces of a meshlet, indexed like getFaces().
+    const std::uint32_t *getFaceIds(const Meshlet &meshlet) const
+    {
+        return m_faceIds.data() + meshlet.firstFace;
+    }
+
+    /// Return the groups of the faces of a meshlet, indexed like getFaces(), null
+    /// if faces have no group.
+    const std::uint8_t *getFaceGroups(const Meshlet &meshlet) const
+    {
+        return m_faceGroups.empty() ? nullptr : m_faceGroups.data() + meshlet.firstFace;
+    }
+
+    /// \brief Return the mask of the groups of the faces of a meshlet, bit g being
+    /// set for group g.
+    ///
+    /// Faces without group are in group 0.
+    std::uint64_t getGroupMask(std::uint32_t index) const
+    {
+        assert(index < m_meshlets.size());
+        return m_groupMasks.empty() ? 1u : m_groupMasks[index];
+    }
+
+    /// Return the number of vertices of all meshlets, counting each copy.
+    std::size_t getVertexCount() const { return m_vertices.size(); }
+
+    /// Return the number of faces of all meshlets, counting each copy.
+    std::size_t getFaceCount() const { return m_faces.size(); }
+
+    /// Return the bytes allocated for the meshlet headers.
+    std::size_t getMeshletBytes() const { return m_meshlets.capacity() * sizeof(Meshlet); }
+
+    /// Return the bytes allocated for the vertex blocks.
+    std::size_t getVertexBytes() const { return m_vertices.capacity() * sizeof(Point); }
+
+    /// Return the bytes allocated for the faces and their ids.
+    std::size_t getFaceBytes() const
+    {
+        return m_faces.capacity() * sizeof(MeshletFace) +
+               m_faceIds.capacity() * sizeof(std::uint32_t);
+    }
+
+    /// Return the bytes allocated for the groups of the faces and their masks.
+    std::size_t getGroupBytes() const
+    {
+        return m_faceGroups.capacity() * sizeof(std::uint8_t) +
+               m_groupMasks.capacity() * sizeof(std::uint64_t);
+    }
+
+private:
+    friend class MeshletBuilder;
+
+    template<class T>
+    using Array = std::vector<T, PolymorphicAllocator<T>>;
+
+    Array<Meshlet> m_meshlets;
+    Array<Point> m_vertices;
+    Array<MeshletFace> m_faces;
+    Array<std::uint32_t> m_faceIds;
+    Array<std::uint8_t> m_faceGroups;
+    /// Masks of the groups of the faces of each meshlet, empty if faces have no group.
+    Array<std::uint64_t> m_groupMasks;
+};
+
+/// \brief Class building the meshlets made of faces of a mesh into a MeshletStore.
+///
+/// Meshlets are accumulated in arrays drawn from a scratch memory resource, and
+/// copied to the store, with their exact size, by finish().
+class MeshletBuilder
+{
+public:
+    /// \brief Construct a builder for the faces of a mesh.
+    ///
+    /// \pre The store must be empty.
+    ///
+    /// \param[in] faces Faces of the mesh.
+    /// \param[in] vertices Vertices of the mesh.
+    /// \param[in,out] store Store where meshlets are written by finish().
+    /// \param[in] faceIds Id stored for each face, indexed like faces. If null,
+    /// the id of a face is its index.
+    /// \param[in] scratch Memory resource of the arrays filled while building.
+    /// \param[in] planarQuadTolerance Tolerance under which quads are planar, relative
+    /// to their size, see Meshlet::hasPlanarQuads. Negative to flag no meshlet.
+    /// \param[in] faceGroups Group of each face, in [0, 64), indexed by the id stored
+    /// for it. If null, faces have no group.
+    ///
+    /// \post References to faces, vertices, store, faceIds, scratch and faceGroups
+    /// are maintained.
+    ///
+    MeshletBuilder(const std::vector<Face> &faces,
+                   const std::vector<Point> &vertices,
+                   MeshletStore &store,
+                   const std::uint32_t *faceIds = nullptr,
+                   MemoryResource &scratch = getDefaultMemoryResource(),
+                   float planarQuadTolerance = -1.0f,
+                   const std::uint8_t *faceGroups = nullptr);
+
+    /// \brief Append meshlets holding a set of faces.
+    ///
+    /// Faces are split in as many meshlets as needed to keep at most
+    /// MeshletStore::maxVertices vertices per meshlet.
+    ///
+    /// \param[in] faceIndices Indices of the faces in the mesh.
+    /// \param[in] faceCount Number of faces.
+    ///
+    /// \return Range [first, last) of the indices of the appended meshlets.
+    ///
+    std::pair<std::uint32_t, std::uint32_t> add(const std::uint32_t *faceIndices,
+                                                std::size_t faceCount);
+
+    /// \brief Append meshlets holding a set of faces.
+    ///
+    /// \param[in] faceIndices Indices of the faces in the mesh.
+    ///
+    /// \return Range [first, last) of the indices of the appended meshlets.
+    ///
+    std::pair<std::uint32_t, std::uint32_t> add(const std::vector<std::uint32_t> &faceIndices)
+    {
+        return add(faceIndices.data(), faceIndices.size());
+    }
+
+    /// Copy all the meshlets appended so far to the store.
+    void finish();
+
+private:
+    const std::vector<Face> &m_faces;
+    const std::vector<Point> &m_vertices;
+    MeshletStore &m_store;
+    const std::uint32_t *m_faceIds;
+    float m_planarQuadTolerance;
+    const std::uint8_t *m_faceGroups;
+    MeshletStore::Array<Meshlet> m_meshlets;
+    MeshletStore::Array<Point> m_meshletVertices;
+    MeshletStore::Array<MeshletFace> m_meshletFaces;
+    MeshletStore::Array<std::uint32_t> m_meshletFaceIds;
+    MeshletStore::Array<std::uint8_t> m_meshletFaceGroups;
+    MeshletStore::Array<std::uint64_t> m_groupMasks;
+    // For each mesh vertex, the last meshlet it was copied to and its index there.
+    MeshletStore::Array<std::uint32_t> m_vertexMeshlet;
+    MeshletStore::Array<std::uint8_t> m_vertexLocalIndex;
+};
+
+} // namespace cpom
+
+#endif // __MESHLETSTORE_H__
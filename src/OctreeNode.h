@@ -1,10 +1,12 @@
 #ifndef __OCTREENODE_H__
 #define __OCTREENODE_H__
 
-#include <Float3.h>
+#include "Bounds.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -16,32 +18,46 @@ namespace cpom
 // DECLARATION SECTION
 ////////////////////////////////////////////////////////////////////////////////
 
-/// Type defining an Axis Aligned Bounding Cube.
-struct AABCube
-{
-    Point center;
-    float halfWidth;
-};
-
 /// \brief Class defining an octree node that holds data of type T.
 ///
 /// An octree is modeled by a tree of OctreeNode.
 /// Leaves contain a number of elements of type T.
 /// The octree can be traversed through visitor functions.
 ///
+/// Nodes do not store their bounds: they are fully determined by the bounds
+/// of the root node and the path of child indices, see getChildBounds().
+///
+/// Children nodes and element lists are allocated with an Allocator, so that a
+/// whole tree can be drawn from an arena.
+///
 /// Example usage can be found in the unit test OctreeNode.ut.cpp.
-template<class T>
+template<class T, class Allocator = std::allocator<T>>
 class OctreeNode
 {
 public:
-    /// Construct an OctreeNode with supplied Axis Aligned Bouding Cube.
-    inline OctreeNode(const AABCube &bounds);
+    /// Type of the list of elements held by a node.
+    using ElementList = std::vector<T, Allocator>;
+
+    /// Construct an empty OctreeNode, whose children and elements use a given allocator.
+    inline explicit OctreeNode(const Allocator &allocator = Allocator());
+
+    /// Destructor, destroying all children nodes.
+    ~OctreeNode();
+
+    OctreeNode(const OctreeNode &) = delete;
+    OctreeNode &operator=(const OctreeNode &) = delete;
 
     using Intersect = std::function<bool(const AABCube &, T&)>;
 
+    /// \brief Function deciding whether a leaf is split, given its bounds, its depth,
+    /// its number of elements and the number of elements each child would hold.
+    using ShouldSubdivide = std::function<bool(const AABCube &, int, std::size_t,
+                                               const std::size_t (&)[8])>;
+
     /// \brief Insert an element in the tree.
     ///
     /// \param[in] element Element to be inserted in the tree.
+    /// \param[in] bounds Axis Aligned Bounding Cube of this node.
     /// \param[in] intersect Function to test intersection between an element
     /// and a node bounds.
     /// \param[in] maxDepth Maximal depth to grow the tree under this node.
@@ -50,31 +66,61 @@ public:
     ///
     template<typename _T>
     void insert(_T &&element,
+                const AABCube &bounds,
                 Intersect intersect,
                 int maxDepth=10,
                 float maxFill=3.0);
 
+    /// \brief Split this leaf, then its children, as long as a function tells to.
+    ///
+    /// Unlike insert(), which splits leaves as elements arrive, all elements are
+    /// known when a leaf is considered, so that the decision can account for how
+    /// they would be spread among children, and duplicated.
+    ///
+    /// \param[in] bounds Axis Aligned Bounding Cube of this node.
+    /// \param[in] intersect Function to test intersection between an element
+    /// and a node bounds.
+    /// \param[in] shouldSubdivide Function deciding whether a leaf is split.
+    /// \param[in] depth Depth of this node.
+    ///
+    void subdivide(const AABCube &bounds,
+                   Intersect intersect,
+                   ShouldSubdivide shouldSubdivide,
+                   int depth=0);
+
     /// Accept and call a visitor function on all existing children nodes.
     inline void accept(std::function<void(const OctreeNode &)> visitChildren) const;
 
     /// Accept and call a visitor function on all elements of this node.
     inline void accept(std::function<void(const T &)> visitElement) const;
 
-    /// Return a reference to the Axis Aligned Bounding Cube of the tree.
-    inline const AABCube &getBounds() const;
-
     /// Return true if this node is a leaf.
     inline bool isLeaf() const;
 
+    /// Return a mask of the existing children nodes, bit i being set if child i exists.
+    inline unsigned getChildMask() const;
+
+    /// Return the child node at a given index, or nullptr if it does not exist.
+    inline const OctreeNode *getChild(int index) const;
+
+    /// Return the elements held by this node.
+    inline const ElementList &getElements() const;
+
+    /// Return the Axis Aligned Bounding Cube of the child at a given index
+    /// of a node with the supplied bounds.
+    static inline AABCube getChildBounds(const AABCube &bounds, int index);
+
 private:
-    inline AABCube getChildBounds(int) const;
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<OctreeNode>;
+    using NodeAllocatorTraits = std::allocator_traits<NodeAllocator>;
 
     template<typename _T>
-    void walkInsert(_T &&, Intersect, int, int, float);
+    void walkInsert(_T &&, const AABCube &, Intersect, int, int, float);
+    void walkSubdivide(const AABCube &, const Intersect &, const ShouldSubdivide &, int);
 
-	std::vector<T> m_elements;
-    std::unique_ptr<OctreeNode> m_children[8];
-    AABCube m_bounds;
+    ElementList m_elements;
+    OctreeNode *m_children[8];
+    std::uint8_t m_childMask;
     bool m_isLeaf;
 };
 
@@ -82,28 +128,56 @@ private:
 // DEFINITION SECTION
 ////////////////////////////////////////////////////////////////////////////////
 
-template<class T>
-OctreeNode<T>::OctreeNode(const AABCube &bounds)
-: m_children{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr },
-  m_bounds(bounds),
+template<class T, class Allocator>
+OctreeNode<T, Allocator>::OctreeNode(const Allocator &allocator)
+: m_elements(allocator),
+  m_children{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr },
+  m_childMask(0),
   m_isLeaf(true)
 { }
 
-template<class T>
-bool OctreeNode<T>::isLeaf() const
+template<class T, class Allocator>
+OctreeNode<T, Allocator>::~OctreeNode()
+{
+    NodeAllocator nodeAllocator(m_elements.get_allocator());
+    for (auto &child: m_children)
+    {
+        if (child)
+        {
+            NodeAllocatorTraits::destroy(nodeAllocator, child);
+            NodeAllocatorTraits::deallocate(nodeAllocator, child, 1);
+        }
+    }
+}
+
+template<class T, class Allocator>
+bool OctreeNode<T, Allocator>::isLeaf() const
 {
     return m_isLeaf;
 }
 
-template<class T>
-const AABCube &OctreeNode<T>::getBounds() const
+template<class T, class Allocator>
+unsigned OctreeNode<T, Allocator>::getChildMask() const
 {
-    return m_bounds;
+    return m_childMask;
 }
 
+template<class T, class Allocator>
+const OctreeNode<T, Allocator> *OctreeNode<T, Allocator>::getChild(int index) const
+{
+    assert(index >= 0 && index < 8);
+    return m_children[index];
+}
 
-template<class T>
-void OctreeNode<T>::accept(std::function<void(const OctreeNode &)> visitChild) const
+template<class T, class Allocator>
+const typename OctreeNode<T, Allocator>::ElementList &OctreeNode<T, Allocator>::getElements() const
+{
+    return m_elements;
+}
+
+
+template<class T, class Allocator>
+void OctreeNode<T, Allocator>::accept(std::function<void(const OctreeNode &)> visitChild) const
 {
     for (auto &child: m_children)
     {
@@ -111,38 +185,41 @@ void OctreeNode<T>::accept(std::function<void(const OctreeNode &)> visitChild) c
     }
 }
 
-template<class T>
-void OctreeNode<T>::accept(std::function<void(const T &)> visitElement) const
+template<class T, class Allocator>
+void OctreeNode<T, Allocator>::accept(std::function<void(const T &)> visitElement) const
 {
     std::for_each(m_elements.begin(), m_elements.end(), visitElement);
 }
 
-template<class T>
+template<class T, class Allocator>
 template<class _T>
-void OctreeNode<T>::insert(_T &&element,    
+void OctreeNode<T, Allocator>::insert(_T &&element,
+                           const AABCube &bounds,
                            Intersect intersect,
                            int maxDepth,
                            float maxFill)
 {
-    return walkInsert(std::forward<_T>(element), intersect, 0, maxDepth, maxFill);
+    return walkInsert(std::forward<_T>(element), bounds, intersect, 0, maxDepth, maxFill);
 }
 
-/// Returns the Axis Aligned Bounding Cube of a child node.
-template<class T>
-AABCube OctreeNode<T>::getChildBounds(int index) const
+template<class T, class Allocator>
+void OctreeNode<T, Allocator>::subdivide(const AABCube &bounds,
+                                         Intersect intersect,
+                                         ShouldSubdivide shouldSubdivide,
+                                         int depth)
 {
-    assert(index >= 0 && index < 8);
+    walkSubdivide(bounds, intersect, shouldSubdivide, depth);
+}
 
-    // If child exists, return its bounds.
-    if (m_children[index])
-    {
-        return m_children[index]->m_bounds;
-    }
+/// Returns the Axis Aligned Bounding Cube of a child node, computed from its parent.
+template<class T, class Allocator>
+AABCube OctreeNode<T, Allocator>::getChildBounds(const AABCube &bounds, int index)
+{
+    assert(index >= 0 && index < 8);
 
-    // Otherwise, compute them from the current parent node.
     AABCube childBounds;
-    childBounds.halfWidth = m_bounds.halfWidth * 0.5f;
-    childBounds.center = m_bounds.center;
+    childBounds.halfWidth = bounds.halfWidth * 0.5f;
+    childBounds.center = bounds.center;
     childBounds.center.x += ( (index & 1) ? 1.0f : -1.0f ) * childBounds.halfWidth;
     childBounds.center.y += ( (index & 2) ? 1.0f : -1.0f ) * childBounds.halfWidth;
     childBounds.center.z += ( (index & 4) ? 1.0f : -1.0f ) * childBounds.halfWidth;
@@ -150,9 +227,10 @@ AABCube OctreeNode<T>::getChildBounds(int index) const
 }
 
 /// Recursive walk through the tree for insertion purpose.
-template<class T>
+template<class T, class Allocator>
 template<typename _T>
-void OctreeNode<T>::walkInsert(_T &&element,
+void OctreeNode<T, Allocator>::walkInsert(_T &&element,
+                               const AABCube &bounds,
                                Intersect intersect,
                                int depth,
                                int maxDepth,
@@ -171,10 +249,10 @@ void OctreeNode<T>::walkInsert(_T &&element,
             // .. and push elements to children.
             while (!m_elements.empty())
             {
-                walkInsert(std::move(m_elements.back()), intersect, depth, maxDepth, maxFill);
+                walkInsert(std::move(m_elements.back()), bounds, intersect, depth, maxDepth, maxFill);
                 m_elements.pop_back();
             }
-            walkInsert(std::forward<T>(element), intersect, depth, maxDepth, maxFill);
+            walkInsert(std::forward<T>(element), bounds, intersect, depth, maxDepth, maxFill);
     	}
         else
         {
@@ -188,20 +266,98 @@ void OctreeNode<T>::walkInsert(_T &&element,
     int childIndex = 0;
     for (auto &child: m_children)
     {
-        const auto childBounds(getChildBounds(childIndex));
+        const auto childBounds(getChildBounds(bounds, childIndex));
         if (intersect(childBounds, element))
         {
             // Create child if needed.
             if (!child)
             {
-                child = std::unique_ptr<OctreeNode>( new OctreeNode(childBounds) );
-                assert(child);
+                NodeAllocator nodeAllocator(m_elements.get_allocator());
+                child = NodeAllocatorTraits::allocate(nodeAllocator, 1);
+                NodeAllocatorTraits::construct(nodeAllocator, child, m_elements.get_allocator());
+                m_childMask |= 1u << childIndex;
             }
             // Walk down the tree under this child.
-            child->walkInsert(std::forward<T>(element), intersect, depth+1, maxDepth, maxFill);
+            child->walkInsert(std::forward<T>(element), childBounds, intersect, depth+1, maxDepth, maxFill);
+        }
+        ++childIndex;
+    }
+}
+
+/// Recursive walk through the tree for subdivision purpose.
+template<class T, class Allocator>
+void OctreeNode<T, Allocator>::walkSubdivide(const AABCube &bounds,
+                                             const Intersect &intersect,
+                                             const ShouldSubdivide &shouldSubdivide,
+                                             int depth)
+{
+    if (!isLeaf())
+    {
+        int childIndex = 0;
+        for (auto &child: m_children)
+        {
+            if (child)
+                child->walkSubdivide(getChildBounds(bounds, childIndex), intersect,
+                                     shouldSubdivide, depth+1);
+            ++childIndex;
+        }
+        return;
+    }
+
+    // Locate the children overlapped by each element, and count them per child.
+    using MaskAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::uint8_t>;
+    std::vector<std::uint8_t, MaskAllocator> childMasks(m_elements.size(), 0,
+                                                         MaskAllocator(m_elements.get_allocator()));
+    std::size_t childCounts[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    for (int childIndex = 0; childIndex < 8; ++childIndex)
+    {
+        const auto childBounds(getChildBounds(bounds, childIndex));
+        for (std::size_t i = 0; i < m_elements.size(); ++i)
+        {
+            if (intersect(childBounds, m_elements[i]))
+            {
+                childMasks[i] |= 1u << childIndex;
+                ++childCounts[childIndex];
+            }
+        }
+    }
+    if (!shouldSubdivide(bounds, depth, m_elements.size(), childCounts))
+        return;
+
+    // Subdivide this leaf, and push elements to the children they overlap..
+    m_isLeaf = false;
+    NodeAllocator nodeAllocator(m_elements.get_allocator());
+    int childIndex = 0;
+    for (auto &child: m_children)
+    {
+        if (childCounts[childIndex] > 0)
+        {
+            child = NodeAllocatorTraits::allocate(nodeAllocator, 1);
+            NodeAllocatorTraits::construct(nodeAllocator, child, m_elements.get_allocator());
+            m_childMask |= 1u << childIndex;
+            child->m_elements.reserve(childCounts[childIndex]);
+            for (std::size_t i = 0; i < m_elements.size(); ++i)
+            {
+                if (childMasks[i] & (1u << childIndex))
+                    child->m_elements.push_back(m_elements[i]);
+            }
         }
         ++childIndex;
     }
+    m_elements.clear();
+    m_elements.shrink_to_fit();
+    childMasks.clear();
+    childMasks.shrink_to_fit();
+
+    // .. then walk down the tree under each child.
+    childIndex = 0;
+    for (auto &child: m_children)
+    {
+        if (child)
+            child->walkSubdivide(getChildBounds(bounds, childIndex), intersect,
+                                 shouldSubdivide, depth+1);
+        ++childIndex;
+    }
 }
 
 } //namespace cpom
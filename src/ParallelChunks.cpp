@@ -0,0 +1,59 @@
+#include <ParallelChunks.h>
+
+#include <TraceSpan.h>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace cpom
+{
+
+void forEachChunk(const std::size_t count, const unsigned threadCount,
+                  const std::function<void(std::size_t begin, std::size_t end)> &task)
+{
+    const std::size_t threadsUsed = threadCount ? threadCount
+                                                : std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t chunkCount = std::min<std::size_t>(threadsUsed,
+                                                         std::max<std::size_t>(count, 1));
+    std::vector<std::exception_ptr> errors(chunkCount);
+    const auto processChunk = [&](const std::size_t chunk)
+    {
+        try
+        {
+            const std::size_t begin = count * chunk / chunkCount;
+            const std::size_t end = count * (chunk + 1) / chunkCount;
+            TraceSpan span("find chunk", end - begin);
+            task(begin, end);
+        }
+        catch (...)
+        {
+            errors[chunk] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunkCount - 1);
+    try
+    {
+        for (std::size_t chunk = 1; chunk < chunkCount; ++chunk)
+            threads.emplace_back(processChunk, chunk);
+    }
+    catch (...)
+    {
+        // Threads that could not start leave their chunks to the calling thread.
+        for (std::size_t chunk = threads.size() + 1; chunk < chunkCount; ++chunk)
+            processChunk(chunk);
+    }
+    processChunk(0);
+    for (std::thread &thread : threads)
+        thread.join();
+    for (const std::exception_ptr &error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+} // namespace cpom
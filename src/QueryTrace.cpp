@@ -0,0 +1,266 @@
+#include <QueryTrace.h>
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+namespace cpom
+{
+
+namespace
+{
+
+/// Magic number starting mesh files, followed by their version.
+constexpr char meshMagic[8] = { 'C', 'P', 'O', 'M', 'M', 'S', 'H', '\0' };
+
+/// Magic number starting trace files, followed by their version.
+constexpr char traceMagic[8] = { 'C', 'P', 'O', 'M', 'T', 'R', 'C', '\0' };
+
+/// Version of the mesh and trace formats.
+constexpr std::uint32_t formatVersion = 1;
+
+/// Size of the buffer of records, written when full.
+constexpr std::size_t recordBufferSize = 64 * 1024;
+
+/// \brief Fowler-Noll-Vo hash, 64-bit FNV-1a variant.
+class Fnv1aHash
+{
+public:
+    void add(const void *data, std::size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            m_hash ^= bytes[i];
+            m_hash *= 0x100000001b3ull;
+        }
+    }
+
+    std::uint64_t get() const { return m_hash; }
+
+private:
+    std::uint64_t m_hash = 0xcbf29ce484222325ull;
+};
+
+template<class T>
+void write(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T>
+void writeArray(std::ostream &out, const T *values, std::size_t count)
+{
+    out.write(reinterpret_cast<const char*>(values),
+              static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+template<class T>
+T read(std::istream &in)
+{
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(T)))
+        throw std::invalid_argument("Unexpected end of file");
+    return value;
+}
+
+template<class T>
+void readArray(std::istream &in, T *values, std::size_t count)
+{
+    if (!in.read(reinterpret_cast<char*>(values), static_cast<std::streamsize>(count * sizeof(T))))
+        throw std::invalid_argument("Unexpected end of file");
+}
+
+/// Append the bytes of a value to a buffer.
+template<class T>
+void append(std::vector<char> &buffer, const T &value)
+{
+    const char *bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+/// Read a magic number and a version, throw if they are not the expected ones.
+void readHeader(std::istream &in, const char (&magic)[8])
+{
+    char header[8];
+    readArray(in, header, 8);
+    if (std::memcmp(header, magic, 8))
+        throw std::invalid_argument("Unknown file format");
+    if (read<std::uint32_t>(in) != formatVersion)
+        throw std::invalid_argument("Unsupported file format version");
+}
+
+/// \brief Read a count of items, throw if it cannot fit in the rest of the stream.
+///
+/// This prevents corrupted counts from causing huge allocations.
+std::size_t readCount(std::istream &in, std::size_t itemSize)
+{
+    const std::uint64_t count = read<std::uint64_t>(in);
+    const std::istream::pos_type position = in.tellg();
+    if (position != std::istream::pos_type(-1))
+    {
+        in.seekg(0, std::ios::end);
+        const std::uint64_t remaining = static_cast<std::uint64_t>(in.tellg() - position);
+        in.seekg(position);
+        if (count > remaining / itemSize)
+            throw std::invalid_argument("Unexpected end of file");
+    }
+    return static_cast<std::size_t>(count);
+}
+
+} // anonymous namespace
+
+std::uint64_t computeMeshFingerprint(const Mesh &m)
+{
+    Fnv1aHash hash;
+    const std::vector<Point> vertices(m.getVertices());
+    for (const Point &vertex : vertices)
+    {
+        const float coordinates[3] = { vertex.x, vertex.y, vertex.z };
+        hash.add(coordinates, sizeof(coordinates));
+    }
+    const std::vector<Face> faces(m.getFaces());
+    for (const Face &face : faces)
+    {
+        const std::uint32_t size = static_cast<std::uint32_t>(face.vertexIds.size());
+        hash.add(&size, sizeof(size));
+        for (const int id : face.vertexIds)
+        {
+            const std::int32_t vertexId = id;
+            hash.add(&vertexId, sizeof(vertexId));
+        }
+    }
+    return hash.get();
+}
+
+void writeMesh(std::ostream &out, const Mesh &m)
+{
+    const std::vector<Point> vertices(m.getVertices());
+    const std::vector<Face> faces(m.getFaces());
+
+    writeArray(out, meshMagic, 8);
+    write(out, formatVersion);
+    write<std::uint64_t>(out, vertices.size());
+    for (const Point &vertex : vertices)
+    {
+        const float coordinates[3] = { vertex.x, vertex.y, vertex.z };
+        writeArray(out, coordinates, 3);
+    }
+    write<std::uint64_t>(out, faces.size());
+    for (const Face &face : faces)
+    {
+        write(out, static_cast<std::uint32_t>(face.vertexIds.size()));
+        for (const int id : face.vertexIds)
+            write(out, static_cast<std::int32_t>(id));
+    }
+    if (!out)
+        throw std::invalid_argument("Failed to write mesh");
+}
+
+MeshData readMesh(std::istream &in)
+{
+    readHeader(in, meshMagic);
+    MeshData mesh;
+    mesh.vertices.resize(readCount(in, 3 * sizeof(float)));
+    for (Point &vertex : mesh.vertices)
+    {
+        float coordinates[3];
+        readArray(in, coordinates, 3);
+        vertex = Point(coordinates[0], coordinates[1], coordinates[2]);
+    }
+    mesh.faces.resize(readCount(in, sizeof(std::uint32_t)));
+    for (Face &face : mesh.faces)
+    {
+        const std::uint32_t size = read<std::uint32_t>(in);
+        if (size > 4)
+            throw std::invalid_argument("Face with too many vertices");
+        std::int32_t ids[4];
+        readArray(in, ids, size);
+        for (std::uint32_t k = 0; k < size; ++k)
+        {
+            if (ids[k] < 0 || static_cast<std::size_t>(ids[k]) >= mesh.vertices.size())
+                throw std::invalid_argument("Vertex id out of range");
+        }
+        face.vertexIds.assign(ids, ids + size);
+    }
+    return mesh;
+}
+
+QueryTraceRecorder::QueryTraceRecorder(std::ostream &out, const Mesh &m)
+: m_out(out)
+{
+    m_buffer.reserve(recordBufferSize);
+    writeArray(m_out, traceMagic, 8);
+    write(m_out, formatVersion);
+    write(m_out, computeMeshFingerprint(m));
+    if (!m_out)
+        throw std::invalid_argument("Failed to write trace");
+}
+
+QueryTraceRecorder::~QueryTraceRecorder()
+{
+    flush();
+}
+
+void QueryTraceRecorder::record(const Point *queryPoints, std::size_t count, float maxDist)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Large batches are split in records of at most 2^32-1 points.
+    do
+    {
+        const std::uint32_t recordCount = static_cast<std::uint32_t>(
+            std::min<std::size_t>(count, std::numeric_limits<std::uint32_t>::max()));
+        const std::size_t recordSize = sizeof(std::uint32_t) + sizeof(float) +
+                                       recordCount * 3 * sizeof(float);
+        if (m_buffer.size() + recordSize > recordBufferSize)
+            writeBuffer();
+        append(m_buffer, recordCount);
+        append(m_buffer, maxDist);
+        for (std::uint32_t i = 0; i < recordCount; ++i)
+        {
+            append(m_buffer, queryPoints[i].x);
+            append(m_buffer, queryPoints[i].y);
+            append(m_buffer, queryPoints[i].z);
+        }
+        queryPoints += recordCount;
+        count -= recordCount;
+    } while (count > 0);
+}
+
+void QueryTraceRecorder::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    writeBuffer();
+    m_out.flush();
+}
+
+void QueryTraceRecorder::writeBuffer()
+{
+    writeArray(m_out, m_buffer.data(), m_buffer.size());
+    m_buffer.clear();
+}
+
+QueryTrace readQueryTrace(std::istream &in)
+{
+    readHeader(in, traceMagic);
+    QueryTrace trace;
+    trace.meshFingerprint = read<std::uint64_t>(in);
+    while (in.peek() != std::istream::traits_type::eof())
+    {
+        const std::uint32_t count = read<std::uint32_t>(in);
+        const float maxDist = read<float>(in);
+        trace.calls.push_back(QueryTrace::Call{ trace.points.size(), count, maxDist });
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            float coordinates[3];
+            readArray(in, coordinates, 3);
+            trace.points.push_back(Point(coordinates[0], coordinates[1], coordinates[2]));
+        }
+    }
+    return trace;
+}
+
+} // namespace cpom
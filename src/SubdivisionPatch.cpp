@@ -0,0 +1,652 @@
+#include <SubdivisionPatch.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace cpom
+{
+
+namespace
+{
+
+template<class T>
+using ScratchArray = std::vector<T, PolymorphicAllocator<T>>;
+
+/// Evaluate the uniform cubic B-spline basis functions and their derivatives at t.
+inline void evaluateBasis(const float t, float basis[4], float d1[4], float d2[4])
+{
+    const float s = 1.0f - t;
+    basis[0] = s*s*s / 6.0f;
+    basis[1] = (3.0f*t*t*t - 6.0f*t*t + 4.0f) / 6.0f;
+    basis[2] = (-3.0f*t*t*t + 3.0f*t*t + 3.0f*t + 1.0f) / 6.0f;
+    basis[3] = t*t*t / 6.0f;
+    d1[0] = -0.5f*s*s;
+    d1[1] = 1.5f*t*t - 2.0f*t;
+    d1[2] = -1.5f*t*t + t + 0.5f;
+    d1[3] = 0.5f*t*t;
+    d2[0] = s;
+    d2[1] = 3.0f*t - 2.0f;
+    d2[2] = -3.0f*t + 1.0f;
+    d2[3] = t;
+}
+
+/// Depth under which faces next to an extraordinary vertex are no longer subdivided.
+constexpr int maxSubdivisionDepth = 16;
+
+/// Type of the faces sharing a vertex with a face, the first one, in local vertex ids.
+struct LocalMesh
+{
+    explicit LocalMesh(MemoryResource &scratch)
+    : vertices(scratch),
+      faces(scratch)
+    {}
+
+    ScratchArray<Point> vertices;
+    ScratchArray<std::array<int, 4>> faces;
+};
+
+/// Subdivision rule of a vertex.
+enum class VertexKind
+{
+    /// Vertex surrounded by a fan of faces.
+    Interior,
+    /// Vertex on the boundary, following the cubic B-spline curve of the boundary.
+    Boundary,
+    /// Corner of a single face, or non-manifold vertex, which stays in place.
+    Fixed
+};
+
+/// Type describing the faces around a vertex of the first face of a local mesh.
+struct VertexRing
+{
+    VertexKind kind;
+    /// Number of faces around the vertex.
+    int faceCount;
+    /// Whether the limit surface around the vertex is a uniform B-spline surface.
+    bool isRegular;
+    /// Sum of the distinct vertices sharing an edge with the vertex.
+    Point edgeSum;
+    /// Sum of the vertices opposite the vertex in its faces.
+    Point diagonalSum;
+    /// Sum of the centers of its faces.
+    Point centerSum;
+    /// Sum of its two neighbours along the boundary.
+    Point boundarySum;
+};
+
+/// Return the center of a face of a local mesh.
+inline Point computeFaceCenter(const LocalMesh &mesh, const std::array<int, 4> &face)
+{
+    return (mesh.vertices[face[0]] + mesh.vertices[face[1]] +
+            mesh.vertices[face[2]] + mesh.vertices[face[3]]) * 0.25f;
+}
+
+/// \brief Describe the faces around a vertex of a local mesh.
+///
+/// All faces around the vertex must be in the local mesh, edges held by a single
+/// of them then being on the boundary of the cage.
+VertexRing computeVertexRing(const LocalMesh &mesh, const int vertex,
+                             MemoryResource &scratch)
+{
+    VertexRing ring = { VertexKind::Fixed, 0, false, Point(0.0f), Point(0.0f),
+                        Point(0.0f), Point(0.0f) };
+    // Neighbours sharing an edge with the vertex, and the number of faces holding it.
+    ScratchArray<std::pair<int, int>> neighbours(scratch);
+    const auto addNeighbour = [&neighbours](const int neighbour)
+    {
+        for (auto &entry : neighbours)
+        {
+            if (entry.first == neighbour)
+            {
+                ++entry.second;
+                return;
+            }
+        }
+        neighbours.emplace_back(neighbour, 1);
+    };
+    for (const auto &face : mesh.faces)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            if (face[k] != vertex)
+                continue;
+            ++ring.faceCount;
+            ring.diagonalSum = ring.diagonalSum + mesh.vertices[face[(k+2) % 4]];
+            ring.centerSum = ring.centerSum + computeFaceCenter(mesh, face);
+            addNeighbour(face[(k+1) % 4]);
+            addNeighbour(face[(k+3) % 4]);
+        }
+    }
+
+    int boundaryEdgeCount = 0;
+    bool isManifold = true;
+    for (const auto &entry : neighbours)
+    {
+        const Point &neighbour = mesh.vertices[entry.first];
+        ring.edgeSum = ring.edgeSum + neighbour;
+        if (entry.second == 1)
+        {
+            ring.boundarySum = ring.boundarySum + neighbour;
+            ++boundaryEdgeCount;
+        }
+        isManifold = isManifold && entry.second <= 2;
+    }
+
+    if (isManifold && boundaryEdgeCount == 0 && ring.faceCount >= 3)
+    {
+        ring.kind = VertexKind::Interior;
+        ring.isRegular = ring.faceCount == 4;
+    }
+    else if (isManifold && boundaryEdgeCount == 2 && ring.faceCount >= 2)
+    {
+        ring.kind = VertexKind::Boundary;
+        ring.isRegular = ring.faceCount == 2;
+    }
+    else
+    {
+        ring.isRegular = isManifold && boundaryEdgeCount == 2 && ring.faceCount == 1;
+    }
+    return ring;
+}
+
+/// \brief Return the position of a vertex after one Catmull-Clark step.
+///
+/// Interior vertices of valence n move to (Q + 2 R + (n-3) v) / n, Q being the
+/// average of their face centers, and R the average of their edge midpoints.
+/// Boundary vertices move to (a + 6 v + b) / 8, a and b being their neighbours
+/// along the boundary.
+Point computeVertexPoint(const Point &vertex, const VertexRing &ring)
+{
+    const float n = static_cast<float>(ring.faceCount);
+    switch (ring.kind)
+    {
+    case VertexKind::Interior:
+    {
+        const Point edgeMidpoints = (vertex * n + ring.edgeSum) * (0.5f / n);
+        return (ring.centerSum / n + edgeMidpoints * 2.0f + vertex * (n - 3.0f)) / n;
+    }
+    case VertexKind::Boundary:
+        return (ring.boundarySum + vertex * 6.0f) / 8.0f;
+    case VertexKind::Fixed:
+        break;
+    }
+    return vertex;
+}
+
+/// \brief Return the limit position of a vertex.
+///
+/// Interior vertices of valence n move to (n^2 v + 4 sum(e) + sum(f)) / (n (n+5)),
+/// e being their edge neighbours and f the opposite vertices of their faces.
+/// Boundary vertices move to (a + 4 v + b) / 6, the limit of the boundary curve.
+Point computeLimitPoint(const Point &vertex, const VertexRing &ring)
+{
+    const float n = static_cast<float>(ring.faceCount);
+    switch (ring.kind)
+    {
+    case VertexKind::Interior:
+        return (vertex * (n*n) + ring.edgeSum * 4.0f + ring.diagonalSum) / (n * (n + 5.0f));
+    case VertexKind::Boundary:
+        return (ring.boundarySum + vertex * 4.0f) / 6.0f;
+    case VertexKind::Fixed:
+        break;
+    }
+    return vertex;
+}
+
+/// \brief Return the face on the other side of the edge from a to b.
+///
+/// \param[out] quad Vertices of that face, starting with (b, a): quad[2] is then
+/// the neighbour of a, and quad[3] the neighbour of b.
+///
+/// \return False if the edge is on the boundary.
+bool findFaceAcross(const LocalMesh &mesh, const int a, const int b, int quad[4])
+{
+    for (const auto &face : mesh.faces)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            if (face[k] != b || face[(k+1) % 4] != a)
+                continue;
+            for (int i = 0; i < 4; ++i)
+                quad[i] = face[(k + i) % 4];
+            return true;
+        }
+    }
+    return false;
+}
+
+/// \brief Gather the 4x4 control points of the first face of a local mesh, whose
+/// vertices are all regular, from its 1-ring.
+///
+/// Sides of the 1-ring missing on the boundary are mirrored, phantom points being
+/// 2 p1 - p2 for the row p1 inside and the row p2 beyond it. Subdividing the
+/// B-spline patch then applies the boundary rules of Catmull-Clark to its control
+/// points, so that the patch is exactly the limit surface.
+///
+/// \return False if the 1-ring is inconsistent, the face not being regular.
+bool gatherRegularPatch(const LocalMesh &mesh, BicubicPatch &patch)
+{
+    const auto &v = mesh.faces[0];
+    // Grid of vertex ids indexed [u][v], the face covering cells [1, 2] x [1, 2],
+    // -1 for phantom points.
+    int grid[4][4];
+    for (auto &column : grid)
+        std::fill(column, column + 4, -1);
+    grid[1][1] = v[0];
+    grid[2][1] = v[1];
+    grid[2][2] = v[2];
+    grid[1][2] = v[3];
+
+    // Sides below, right of, above and left of the face.
+    int quad[4];
+    bool hasSide[4];
+    if ((hasSide[0] = findFaceAcross(mesh, v[0], v[1], quad)))
+    {
+        grid[1][0] = quad[2];
+        grid[2][0] = quad[3];
+    }
+    if ((hasSide[1] = findFaceAcross(mesh, v[1], v[2], quad)))
+    {
+        grid[3][1] = quad[2];
+        grid[3][2] = quad[3];
+    }
+    if ((hasSide[2] = findFaceAcross(mesh, v[2], v[3], quad)))
+    {
+        grid[2][3] = quad[2];
+        grid[1][3] = quad[3];
+    }
+    if ((hasSide[3] = findFaceAcross(mesh, v[3], v[0], quad)))
+    {
+        grid[0][2] = quad[2];
+        grid[0][1] = quad[3];
+    }
+
+    // Corners are in the diagonal faces, across the edges of the side faces, which
+    // must close the ring of four faces around interior vertices.
+    if (hasSide[0] && hasSide[3])
+    {
+        if (!findFaceAcross(mesh, v[0], grid[1][0], quad) || quad[2] != grid[0][1])
+            return false;
+        grid[0][0] = quad[3];
+    }
+    if (hasSide[1] && hasSide[0])
+    {
+        if (!findFaceAcross(mesh, v[1], grid[3][1], quad) || quad[2] != grid[2][0])
+            return false;
+        grid[3][0] = quad[3];
+    }
+    if (hasSide[2] && hasSide[1])
+    {
+        if (!findFaceAcross(mesh, v[2], grid[2][3], quad) || quad[2] != grid[3][2])
+            return false;
+        grid[3][3] = quad[3];
+    }
+    if (hasSide[3] && hasSide[2])
+    {
+        if (!findFaceAcross(mesh, v[3], grid[0][2], quad) || quad[2] != grid[1][3])
+            return false;
+        grid[0][3] = quad[3];
+    }
+
+    Point points[4][4];
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            if (grid[i][j] >= 0)
+                points[i][j] = mesh.vertices[grid[i][j]];
+
+    // Mirror missing sides, then missing corners along their row if it exists, or
+    // else along their column, mirrored or not.
+    for (int t = 1; t < 3; ++t)
+    {
+        if (!hasSide[0])
+            points[t][0] = points[t][1] * 2.0f - points[t][2];
+        if (!hasSide[1])
+            points[3][t] = points[2][t] * 2.0f - points[1][t];
+        if (!hasSide[2])
+            points[t][3] = points[t][2] * 2.0f - points[t][1];
+        if (!hasSide[3])
+            points[0][t] = points[1][t] * 2.0f - points[2][t];
+    }
+    for (const int i : { 0, 3 })
+    {
+        const int inner = i == 0 ? 1 : 2;
+        const int opposite = 3 - inner;
+        const int columnSide = i == 0 ? 3 : 1;
+        for (const int j : { 0, 3 })
+        {
+            const int rowSide = j == 0 ? 0 : 2;
+            if (hasSide[rowSide] && hasSide[columnSide])
+                continue;
+            if (hasSide[rowSide])
+            {
+                points[i][j] = points[inner][j] * 2.0f - points[opposite][j];
+            }
+            else
+            {
+                const int innerRow = j == 0 ? 1 : 2;
+                points[i][j] = points[i][innerRow] * 2.0f - points[i][3 - innerRow];
+            }
+        }
+    }
+
+    for (int j = 0; j < 4; ++j)
+        for (int i = 0; i < 4; ++i)
+            patch.controlPoints[j][i] = points[i][j];
+    return true;
+}
+
+/// \brief Express the bilinear patch interpolating four corners as a B-spline patch.
+///
+/// Uniform cubic B-splines reproduce linear functions when their control points
+/// sample them at parameters -1, 0, 1 and 2, so the bilinear interpolation of the
+/// corners is extrapolated there.
+void makeBilinearPatch(const Point &p00, const Point &p10, const Point &p11,
+                       const Point &p01, BicubicPatch &patch)
+{
+    for (int j = 0; j < 4; ++j)
+    {
+        const float v = static_cast<float>(j - 1);
+        for (int i = 0; i < 4; ++i)
+        {
+            const float u = static_cast<float>(i - 1);
+            patch.controlPoints[j][i] = p00 * ((1.0f-u) * (1.0f-v)) + p10 * (u * (1.0f-v)) +
+                                        p11 * (u * v) + p01 * ((1.0f-u) * v);
+        }
+    }
+}
+
+/// Return the diagonal of the bounding box of the vertices of a local mesh.
+float computeDiagonal(const LocalMesh &mesh)
+{
+    Point lower = mesh.vertices[0];
+    Point upper = mesh.vertices[0];
+    for (const Point &vertex : mesh.vertices)
+    {
+        lower = Point(std::min(lower.x, vertex.x), std::min(lower.y, vertex.y),
+                      std::min(lower.z, vertex.z));
+        upper = Point(std::max(upper.x, vertex.x), std::max(upper.y, vertex.y),
+                      std::max(upper.z, vertex.z));
+    }
+    return (upper - lower).length();
+}
+
+/// \brief Subdivide a local mesh once, keeping the children of its faces at the
+/// vertices of its first face, those of the first face coming first.
+///
+/// The faces around these children are then all in the subdivided mesh: edge
+/// points are only computed for the edges touching the first face.
+void subdivideLocalMesh(const LocalMesh &mesh, const VertexRing rings[4],
+                        LocalMesh &subdivided, MemoryResource &scratch)
+{
+    const auto &first = mesh.faces[0];
+    const auto findCorner = [&first](const int vertex)
+    {
+        return static_cast<int>(std::find(first.begin(), first.end(), vertex) - first.begin());
+    };
+
+    // Edges touching the first face, with the number of faces holding them and the
+    // sum of their centers.
+    struct Edge
+    {
+        int a;
+        int b;
+        int faceCount;
+        Point centerSum;
+    };
+    ScratchArray<Edge> edges(scratch);
+    const auto findEdge = [&edges](const int a, const int b)
+    {
+        const int lower = std::min(a, b);
+        const int upper = std::max(a, b);
+        for (std::size_t e = 0; e < edges.size(); ++e)
+            if (edges[e].a == lower && edges[e].b == upper)
+                return static_cast<int>(e);
+        return -1;
+    };
+    for (const auto &face : mesh.faces)
+    {
+        const Point center = computeFaceCenter(mesh, face);
+        for (int k = 0; k < 4; ++k)
+        {
+            const int a = face[k];
+            const int b = face[(k+1) % 4];
+            if (findCorner(a) == 4 && findCorner(b) == 4)
+                continue;
+            int e = findEdge(a, b);
+            if (e < 0)
+            {
+                e = static_cast<int>(edges.size());
+                edges.push_back(Edge{ std::min(a, b), std::max(a, b), 0, Point(0.0f) });
+            }
+            ++edges[e].faceCount;
+            edges[e].centerSum = edges[e].centerSum + center;
+        }
+    }
+
+    // Face points, then edge points, then vertex points of the first face.
+    const int firstEdgePoint = static_cast<int>(mesh.faces.size());
+    const int firstVertexPoint = firstEdgePoint + static_cast<int>(edges.size());
+    subdivided.vertices.clear();
+    for (const auto &face : mesh.faces)
+        subdivided.vertices.push_back(computeFaceCenter(mesh, face));
+    for (const Edge &edge : edges)
+    {
+        const Point ends = mesh.vertices[edge.a] + mesh.vertices[edge.b];
+        subdivided.vertices.push_back(edge.faceCount == 2 ? (ends + edge.centerSum) * 0.25f
+                                                          : ends * 0.5f);
+    }
+    for (int k = 0; k < 4; ++k)
+        subdivided.vertices.push_back(computeVertexPoint(mesh.vertices[first[k]], rings[k]));
+
+    subdivided.faces.clear();
+    for (std::size_t f = 0; f < mesh.faces.size(); ++f)
+    {
+        const auto &face = mesh.faces[f];
+        for (int k = 0; k < 4; ++k)
+        {
+            const int corner = findCorner(face[k]);
+            if (corner == 4)
+                continue;
+            subdivided.faces.push_back({ { firstVertexPoint + corner,
+                                           firstEdgePoint + findEdge(face[k], face[(k+1) % 4]),
+                                           static_cast<int>(f),
+                                           firstEdgePoint + findEdge(face[(k+3) % 4], face[k]) } });
+        }
+    }
+}
+
+/// \brief Gather the faces of a mesh sharing a vertex with one of them, into a
+/// local mesh starting with that face.
+void gatherLocalMesh(const LocalMesh &mesh, const std::size_t faceIndex,
+                     LocalMesh &local, MemoryResource &scratch)
+{
+    const auto &center = mesh.faces[faceIndex];
+    ScratchArray<int> localIds(mesh.vertices.size(), -1, scratch);
+    local.vertices.clear();
+    local.faces.clear();
+    const auto addFace = [&](const std::array<int, 4> &face)
+    {
+        std::array<int, 4> localFace;
+        for (int k = 0; k < 4; ++k)
+        {
+            int &localId = localIds[face[k]];
+            if (localId < 0)
+            {
+                localId = static_cast<int>(local.vertices.size());
+                local.vertices.push_back(mesh.vertices[face[k]]);
+            }
+            localFace[k] = localId;
+        }
+        local.faces.push_back(localFace);
+    };
+    addFace(center);
+    for (std::size_t f = 0; f < mesh.faces.size(); ++f)
+    {
+        const auto &face = mesh.faces[f];
+        const bool isNeighbour = std::any_of(face.begin(), face.end(), [&center](int vertex)
+        {
+            return std::find(center.begin(), center.end(), vertex) != center.end();
+        });
+        if (f != faceIndex && isNeighbour)
+            addFace(face);
+    }
+}
+
+/// \brief Append the patches of the first face of a local mesh, subdividing it
+/// while it is not regular and its 1-ring is larger than maxDiagonal.
+void buildLocalPatches(const LocalMesh &mesh, const float maxDiagonal, const int depth,
+                       const std::uint32_t faceId,
+                       std::vector<BicubicPatch, PolymorphicAllocator<BicubicPatch>> &patches,
+                       std::vector<std::uint32_t, PolymorphicAllocator<std::uint32_t>> &faceIds,
+                       MemoryResource &scratch)
+{
+    const auto &first = mesh.faces[0];
+    VertexRing rings[4];
+    bool isRegular = true;
+    for (int k = 0; k < 4; ++k)
+    {
+        rings[k] = computeVertexRing(mesh, first[k], scratch);
+        isRegular = isRegular && rings[k].isRegular;
+    }
+
+    BicubicPatch patch;
+    if (!(isRegular && gatherRegularPatch(mesh, patch)))
+    {
+        if (depth < maxSubdivisionDepth && computeDiagonal(mesh) > maxDiagonal)
+        {
+            LocalMesh subdivided(scratch);
+            subdivideLocalMesh(mesh, rings, subdivided, scratch);
+            LocalMesh child(scratch);
+            for (std::size_t k = 0; k < 4; ++k)
+            {
+                gatherLocalMesh(subdivided, k, child, scratch);
+                buildLocalPatches(child, maxDiagonal, depth + 1, faceId, patches, faceIds,
+                                  scratch);
+            }
+            return;
+        }
+        makeBilinearPatch(computeLimitPoint(mesh.vertices[first[0]], rings[0]),
+                          computeLimitPoint(mesh.vertices[first[1]], rings[1]),
+                          computeLimitPoint(mesh.vertices[first[2]], rings[2]),
+                          computeLimitPoint(mesh.vertices[first[3]], rings[3]),
+                          patch);
+    }
+    patches.push_back(patch);
+    faceIds.push_back(faceId);
+}
+
+} // anonymous namespace
+
+PatchSample evaluatePatch(const BicubicPatch &patch, const float u, const float v)
+{
+    float bu[4], du[4], duu[4];
+    float bv[4], dv[4], dvv[4];
+    evaluateBasis(u, bu, du, duu);
+    evaluateBasis(v, bv, dv, dvv);
+
+    PatchSample sample = { Point(0.0f), Float3(0.0f), Float3(0.0f),
+                           Float3(0.0f), Float3(0.0f), Float3(0.0f) };
+    for (int j = 0; j < 4; ++j)
+    {
+        // Combine each row along u first, then weight rows along v.
+        Point row(0.0f);
+        Float3 rowDu(0.0f);
+        Float3 rowDuu(0.0f);
+        for (int i = 0; i < 4; ++i)
+        {
+            const Point &p = patch.controlPoints[j][i];
+            row = row + p * bu[i];
+            rowDu = rowDu + p * du[i];
+            rowDuu = rowDuu + p * duu[i];
+        }
+        sample.position = sample.position + row * bv[j];
+        sample.du = sample.du + rowDu * bv[j];
+        sample.dv = sample.dv + row * dv[j];
+        sample.duu = sample.duu + rowDuu * bv[j];
+        sample.duv = sample.duv + rowDu * dv[j];
+        sample.dvv = sample.dvv + row * dvv[j];
+    }
+    return sample;
+}
+
+void buildCatmullClarkPatches(const std::vector<Face> &faces,
+                              const std::vector<Point> &vertices,
+                              const float tolerance,
+                              std::vector<BicubicPatch, PolymorphicAllocator<BicubicPatch>> &patches,
+                              std::vector<std::uint32_t, PolymorphicAllocator<std::uint32_t>> &faceIds,
+                              MemoryResource &scratch)
+{
+    // Faces around each vertex, the faces of vertex v being in
+    // vertexFaces[firstVertexFaces[v], firstVertexFaces[v+1]).
+    ScratchArray<std::uint32_t> firstVertexFaces(vertices.size() + 1, 0, scratch);
+    for (const Face &face : faces)
+    {
+        if (face.vertexIds.size() != 4)
+            throw std::invalid_argument("Limit surfaces require a cage of quads");
+        for (const int vertexId : face.vertexIds)
+            ++firstVertexFaces[vertexId + 1];
+    }
+    for (std::size_t v = 0; v < vertices.size(); ++v)
+        firstVertexFaces[v + 1] += firstVertexFaces[v];
+    ScratchArray<std::uint32_t> vertexFaces(firstVertexFaces[vertices.size()], 0, scratch);
+    {
+        ScratchArray<std::uint32_t> nextFaces(firstVertexFaces.begin(),
+                                              firstVertexFaces.end() - 1, scratch);
+        for (std::uint32_t f = 0; f < faces.size(); ++f)
+            for (const int vertexId : faces[f].vertexIds)
+                vertexFaces[nextFaces[vertexId]++] = f;
+    }
+
+    patches.clear();
+    faceIds.clear();
+    patches.reserve(faces.size());
+    faceIds.reserve(faces.size());
+    // Local ids of the vertices of the cage, -1 outside the current local mesh.
+    ScratchArray<int> localIds(vertices.size(), -1, scratch);
+    ScratchArray<int> globalIds(scratch);
+    ScratchArray<std::uint32_t> lastNeighbourOf(faces.size(), ~std::uint32_t(0), scratch);
+    LocalMesh mesh(scratch);
+    for (std::uint32_t f = 0; f < faces.size(); ++f)
+    {
+        // Gather the faces sharing a vertex with the face, the face first.
+        mesh.vertices.clear();
+        mesh.faces.clear();
+        globalIds.clear();
+        const auto addFace = [&](const std::uint32_t faceId)
+        {
+            std::array<int, 4> localFace;
+            for (int k = 0; k < 4; ++k)
+            {
+                const int vertexId = faces[faceId].vertexIds[k];
+                if (localIds[vertexId] < 0)
+                {
+                    localIds[vertexId] = static_cast<int>(mesh.vertices.size());
+                    mesh.vertices.push_back(vertices[vertexId]);
+                    globalIds.push_back(vertexId);
+                }
+                localFace[k] = localIds[vertexId];
+            }
+            mesh.faces.push_back(localFace);
+            lastNeighbourOf[faceId] = f;
+        };
+        addFace(f);
+        for (const int vertexId : faces[f].vertexIds)
+        {
+            const std::uint32_t end = firstVertexFaces[vertexId + 1];
+            for (std::uint32_t i = firstVertexFaces[vertexId]; i < end; ++i)
+            {
+                if (lastNeighbourOf[vertexFaces[i]] != f)
+                    addFace(vertexFaces[i]);
+            }
+        }
+        buildLocalPatches(mesh, tolerance * computeDiagonal(mesh), 0, f, patches, faceIds,
+                          scratch);
+        for (const int vertexId : globalIds)
+            localIds[vertexId] = -1;
+    }
+}
+
+} // namespace cpom
@@ -0,0 +1,72 @@
+#ifndef __SUBDIVISIONPATCH_H__
+#define __SUBDIVISIONPATCH_H__
+
+#include <Float3.h>
+#include <MemoryResource.h>
+#include <Mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cpom
+{
+
+/// \brief Type of a uniform bicubic B-spline patch.
+///
+/// The patch is parameterized over [0, 1] x [0, 1] and lies within the convex
+/// hull of its control points.
+struct BicubicPatch
+{
+    /// Control points, indexed [v][u].
+    Point controlPoints[4][4];
+};
+
+/// Type holding a position on a patch and its partial derivatives.
+struct PatchSample
+{
+    Point position;
+    Float3 du;
+    Float3 dv;
+    Float3 duu;
+    Float3 duv;
+    Float3 dvv;
+};
+
+/// Evaluate the position and the derivatives of a patch at parameters (u, v).
+PatchSample evaluatePatch(const BicubicPatch &patch, float u, float v);
+
+/// \brief Build the patches of the Catmull-Clark limit surface of a quad cage.
+///
+/// Faces whose vertices are all regular, interior with four faces around them, on
+/// the boundary with two, or corners of a single face, are exactly the bicubic
+/// B-spline patch of their 1-ring. Boundary sides of the 1-ring are mirrored, which
+/// reproduces the boundary rules: the boundary is the cubic B-spline curve of the
+/// boundary vertices, and corners are interpolated. Other faces, next to an
+/// extraordinary vertex or to a non-manifold one, are subdivided around it, their
+/// regular children being exact patches, until the 1-ring of the last child is
+/// smaller than tolerance times the 1-ring of the face. That child is then
+/// approximated by the bilinear patch through the limit positions of its corners,
+/// off the limit surface by at most the size of its 1-ring.
+///
+/// \param[in] faces Faces of the cage, all quads sharing a consistent orientation.
+/// \param[in] vertices Vertices of the cage.
+/// \param[in] tolerance Size of the 1-ring under which faces are no longer
+/// subdivided, relative to the 1-ring of their cage face.
+/// \param[out] patches Patches built, those of each face following each other, faces
+/// in their original order.
+/// \param[out] faceIds Face of each patch, indexed like patches.
+/// \param[in] scratch Memory resource of temporary arrays.
+///
+/// \throw std::invalid_argument if a face is not a quad, Loop subdivision of
+/// triangles not being supported.
+///
+void buildCatmullClarkPatches(const std::vector<Face> &faces,
+                              const std::vector<Point> &vertices,
+                              float tolerance,
+                              std::vector<BicubicPatch, PolymorphicAllocator<BicubicPatch>> &patches,
+                              std::vector<std::uint32_t, PolymorphicAllocator<std::uint32_t>> &faceIds,
+                              MemoryResource &scratch = getDefaultMemoryResource());
+
+} // namespace cpom
+
+#endif // __SUBDIVISIONPATCH_H__
@@ -0,0 +1,56 @@
+#ifndef __TRACESPAN_H__
+#define __TRACESPAN_H__
+
+#include <Tracing.h>
+
+#include <cstdint>
+
+namespace cpom
+{
+
+#if defined(CPOM_ENABLE_TRACING)
+
+/// \brief Span of time recorded from its construction to its end, if tracing is started.
+///
+/// Spans name string literals, which must outlive the recording.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, std::uint64_t count = noCount);
+
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan &operator=(const TraceSpan&) = delete;
+
+    /// End the span before the end of its scope.
+    void end();
+
+    /// Count meaning that the span has none.
+    static constexpr std::uint64_t noCount = ~std::uint64_t(0);
+
+private:
+    const char *m_name;
+    std::uint64_t m_count;
+    std::int64_t m_start;
+};
+
+#else
+
+/// Span compiled out, tracing being disabled.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *, std::uint64_t = 0) { }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan &operator=(const TraceSpan&) = delete;
+
+    void end() { }
+};
+
+#endif
+
+} // namespace cpom
+
+#endif // __TRACESPAN_H__
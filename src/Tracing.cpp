@@ -0,0 +1,179 @@
+#include <TraceSpan.h>
+
+#include <ostream>
+
+#if defined(CPOM_ENABLE_TRACING)
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace cpom
+{
+
+#if defined(CPOM_ENABLE_TRACING)
+
+namespace
+{
+
+/// Type holding a span recorded.
+struct TraceEvent
+{
+    const char *name;
+    std::uint64_t count;
+    std::uint32_t threadId;
+    /// Start and duration in nanoseconds, from the first use of tracing.
+    std::int64_t start;
+    std::int64_t duration;
+};
+
+/// Whether spans are recorded, read by each span without locking.
+std::atomic<bool> isTracing(false);
+
+/// \brief Ring buffer of the spans recorded by all threads.
+class TraceBuffer
+{
+public:
+    void reset(std::size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.clear();
+        m_events.reserve(capacity);
+        m_capacity = capacity;
+        m_next = 0;
+    }
+
+    void push(const TraceEvent &event)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_capacity == 0)
+            return;
+        if (m_events.size() < m_capacity)
+            m_events.push_back(event);
+        else
+            m_events[m_next] = event;
+        m_next = (m_next + 1) % m_capacity;
+    }
+
+    /// Return the spans recorded, oldest first.
+    std::vector<TraceEvent> getEvents()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_events.size() < m_capacity)
+            return m_events;
+        std::vector<TraceEvent> events(m_events.begin() + m_next, m_events.end());
+        events.insert(events.end(), m_events.begin(), m_events.begin() + m_next);
+        return events;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<TraceEvent> m_events;
+    std::size_t m_capacity = 0;
+    std::size_t m_next = 0;
+};
+
+TraceBuffer &getTraceBuffer()
+{
+    static TraceBuffer buffer;
+    return buffer;
+}
+
+/// Return the nanoseconds elapsed since the first call.
+std::int64_t getTime()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+/// Return a small id of the calling thread, numbering threads in order of first use.
+std::uint32_t getThreadId()
+{
+    static std::atomic<std::uint32_t> nextThreadId(0);
+    thread_local const std::uint32_t threadId = nextThreadId++;
+    return threadId;
+}
+
+} // anonymous namespace
+
+TraceSpan::TraceSpan(const char *name, std::uint64_t count)
+: m_name(name),
+  m_count(count),
+  m_start(isTracing.load(std::memory_order_relaxed) ? getTime() : -1)
+{ }
+
+void TraceSpan::end()
+{
+    if (m_start < 0)
+        return;
+    const std::int64_t now = getTime();
+    getTraceBuffer().push(TraceEvent{ m_name, m_count, getThreadId(), m_start, now - m_start });
+    m_start = -1;
+}
+
+bool isTracingAvailable()
+{
+    return true;
+}
+
+void startTracing(std::size_t capacity)
+{
+    getTime();
+    getTraceBuffer().reset(capacity);
+    isTracing.store(true);
+}
+
+void stopTracing()
+{
+    isTracing.store(false);
+}
+
+void writeTraceEvents(std::ostream &out)
+{
+    // Timestamps are in microseconds, with nanosecond precision.
+    const auto writeMicroseconds = [&out](std::int64_t nanoseconds)
+    {
+        out << nanoseconds / 1000 << '.';
+        const std::int64_t fraction = nanoseconds % 1000;
+        out << fraction / 100 << (fraction / 10) % 10 << fraction % 10;
+    };
+    out << "{\"traceEvents\":[";
+    const char *separator = "\n";
+    for (const TraceEvent &event : getTraceBuffer().getEvents())
+    {
+        out << separator << "{\"name\":\"" << event.name << "\",\"cat\":\"cpom\",\"ph\":\"X\","
+            << "\"pid\":1,\"tid\":" << event.threadId << ",\"ts\":";
+        writeMicroseconds(event.start);
+        out << ",\"dur\":";
+        writeMicroseconds(event.duration);
+        if (event.count != TraceSpan::noCount)
+            out << ",\"args\":{\"count\":" << event.count << "}";
+        out << "}";
+        separator = ",\n";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+#else
+
+bool isTracingAvailable()
+{
+    return false;
+}
+
+void startTracing(std::size_t)
+{ }
+
+void stopTracing()
+{ }
+
+void writeTraceEvents(std::ostream &out)
+{
+    out << "{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+#endif
+
+} // namespace cpom
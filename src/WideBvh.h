@@ -0,0 +1,354 @@
+#ifndef __WIDEBVH_H__
+#define __WIDEBVH_H__
+
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cpom
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// DECLARATION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+/// \brief Class defining a bounding volume hierarchy with Width children per node.
+///
+/// Each node stores the bounding boxes of its children as a structure of arrays,
+/// so that the distances to all of them are evaluated in a single SIMD pass.
+/// Each element is referenced by exactly one leaf; leaves hold packets of at most
+/// Width elements, stored contiguously. The elements of a leaf may be converted to
+/// another representation when constructing the hierarchy.
+///
+/// Nodes and elements are allocated once, with their exact size, with an Allocator.
+///
+/// Example usage can be found in the unit test WideBvh.ut.cpp.
+template<class T, int Width, class Allocator = std::allocator<T>>
+class WideBvh
+{
+public:
+    static_assert(Width >= 2 && Width <= 16, "Unsupported WideBvh width");
+
+    /// Maximal number of source elements in a leaf.
+    static constexpr int leafCapacity = Width;
+
+    /// \brief Type of a node holding the bounds of up to Width children.
+    ///
+    /// Unused child slots have empty bounds (min = +inf, max = -inf) so that
+    /// their distance to any point is infinite.
+    struct Node
+    {
+        float minX[Width];
+        float minY[Width];
+        float minZ[Width];
+        float maxX[Width];
+        float maxY[Width];
+        float maxZ[Width];
+        /// Reference to each child, see isLeafRef() and getRefIndex().
+        std::uint32_t child[Width];
+        /// Number of stored elements of each leaf child, 0 for other children.
+        std::uint8_t elementCount[Width];
+    };
+
+    /// Return true if a child reference designates a leaf.
+    static inline bool isLeafRef(std::uint32_t ref);
+
+    /// Return the node index, or first element index for leaves, of a child reference.
+    static inline std::uint32_t getRefIndex(std::uint32_t ref);
+
+    /// Type of the allocator of nodes.
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+
+    /// Type of the array of nodes.
+    using NodeList = std::vector<Node, NodeAllocator>;
+
+    /// Type of the array of elements.
+    using ElementList = std::vector<T, Allocator>;
+
+    /// Construct an empty WideBvh.
+    explicit WideBvh(const Allocator &allocator = Allocator());
+
+    /// \brief Construct a WideBvh over a set of elements.
+    ///
+    /// \param[in] elements Elements to store in the hierarchy.
+    /// \param[in] bounds Bounds of each element, indexed like elements.
+    ///
+    WideBvh(const std::vector<T> &elements, const std::vector<AABBox> &bounds);
+
+    /// \brief Construct a WideBvh over a set of elements, converting leaves.
+    ///
+    /// \param[in] elements Elements to partition in the hierarchy.
+    /// \param[in] bounds Bounds of each element, indexed like elements.
+    /// \param[in] convertLeaf Function converting the elements of a leaf, given as
+    /// a std::vector<U> with an allocator rebound from Allocator, and appending at
+    /// most 255 elements to the ElementList passed as second argument.
+    /// \param[in] allocator Allocator of the nodes and elements of the hierarchy.
+    /// \param[in] scratchAllocator Allocator of the arrays filled while building.
+    ///
+    template<class U, class UAllocator, class BoundsAllocator, class ConvertLeaf>
+    WideBvh(const std::vector<U, UAllocator> &elements,
+            const std::vector<AABBox, BoundsAllocator> &bounds,
+            ConvertLeaf convertLeaf,
+            const Allocator &allocator = Allocator(),
+            const Allocator &scratchAllocator = Allocator());
+
+    /// Return true if the hierarchy has no node.
+    inline bool empty() const;
+
+    /// Return the node at a given index, the root node having index 0.
+    inline const Node &getNode(std::uint32_t index) const;
+
+    /// Return the element at a given index.
+    inline const T &getElement(std::uint32_t index) const;
+
+    /// Return all the nodes.
+    inline const NodeList &getNodes() const;
+
+    /// Return the elements of all leaves.
+    inline const ElementList &getElements() const;
+
+private:
+    using Range = std::pair<std::uint32_t, std::uint32_t>;
+    template<class U>
+    using ScratchList = std::vector<U, typename std::allocator_traits<Allocator>::template rebind_alloc<U>>;
+
+    template<class BoundsList>
+    static std::uint32_t build(Range, ScratchList<std::uint32_t> &, const ScratchList<Point> &,
+                               const BoundsList &, NodeList &);
+
+    static void identity(const ScratchList<T> &elements, ElementList &output)
+    {
+        output.insert(output.end(), elements.begin(), elements.end());
+    }
+
+    static constexpr std::uint32_t leafFlag = 1u << 31;
+
+    NodeList m_nodes;
+    ElementList m_elements;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// DEFINITION SECTION
+////////////////////////////////////////////////////////////////////////////////
+
+template<class T, int Width, class Allocator>
+constexpr int WideBvh<T, Width, Allocator>::leafCapacity;
+
+template<class T, int Width, class Allocator>
+constexpr std::uint32_t WideBvh<T, Width, Allocator>::leafFlag;
+
+template<class T, int Width, class Allocator>
+bool WideBvh<T, Width, Allocator>::isLeafRef(std::uint32_t ref)
+{
+    return (ref & leafFlag) != 0;
+}
+
+template<class T, int Width, class Allocator>
+std::uint32_t WideBvh<T, Width, Allocator>::getRefIndex(std::uint32_t ref)
+{
+    return ref & ~leafFlag;
+}
+
+template<class T, int Width, class Allocator>
+WideBvh<T, Width, Allocator>::WideBvh(const Allocator &allocator)
+: m_nodes(NodeAllocator(allocator)),
+  m_elements(allocator)
+{ }
+
+template<class T, int Width, class Allocator>
+WideBvh<T, Width, Allocator>::WideBvh(const std::vector<T> &elements,
+                                      const std::vector<AABBox> &bounds)
+: WideBvh(elements, bounds, identity)
+{ }
+
+template<class T, int Width, class Allocator>
+template<class U, class UAllocator, class BoundsAllocator, class ConvertLeaf>
+WideBvh<T, Width, Allocator>::WideBvh(const std::vector<U, UAllocator> &elements,
+                                      const std::vector<AABBox, BoundsAllocator> &bounds,
+                                      ConvertLeaf convertLeaf,
+                                      const Allocator &allocator,
+                                      const Allocator &scratchAllocator)
+: m_nodes(NodeAllocator(allocator)),
+  m_elements(allocator)
+{
+    assert(elements.size() == bounds.size());
+    assert(elements.size() < leafFlag);
+    if (elements.empty())
+        return;
+
+    ScratchList<Point> centers(bounds.size(), Point(), scratchAllocator);
+    std::transform(bounds.begin(), bounds.end(), centers.begin(),
+                   [](const AABBox &box) { return box.center; });
+    ScratchList<std::uint32_t> order(elements.size(), 0, scratchAllocator);
+    for (std::uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    NodeList nodes{NodeAllocator(scratchAllocator)};
+    build(Range(0, static_cast<std::uint32_t>(order.size())), order, centers, bounds, nodes);
+
+    // Leaves reference a range of order: convert their elements and store them
+    // in the order of the nodes referencing them.
+    ElementList convertedElements(scratchAllocator);
+    ScratchList<U> leafElements(scratchAllocator);
+    leafElements.reserve(leafCapacity);
+    for (auto &node: nodes)
+    {
+        for (int slot = 0; slot < Width; ++slot)
+        {
+            if (!isLeafRef(node.child[slot]))
+                continue;
+            const std::uint32_t first = getRefIndex(node.child[slot]);
+            leafElements.clear();
+            for (std::uint32_t i = first; i < first + node.elementCount[slot]; ++i)
+                leafElements.push_back(elements[order[i]]);
+            const auto firstConverted = static_cast<std::uint32_t>(convertedElements.size());
+            convertLeaf(leafElements, convertedElements);
+            const auto convertedCount = convertedElements.size() - firstConverted;
+            assert(convertedCount <= 0xFF);
+            node.child[slot] = firstConverted | leafFlag;
+            node.elementCount[slot] = static_cast<std::uint8_t>(convertedCount);
+        }
+    }
+
+    // Copy the arrays to their final storage.
+    m_nodes.assign(nodes.begin(), nodes.end());
+    m_elements.assign(convertedElements.begin(), convertedElements.end());
+}
+
+/// Recursively build the node covering a range of elements and return its index.
+template<class T, int Width, class Allocator>
+template<class BoundsList>
+std::uint32_t WideBvh<T, Width, Allocator>::build(Range range,
+                                                  ScratchList<std::uint32_t> &order,
+                                                  const ScratchList<Point> &centers,
+                                                  const BoundsList &bounds,
+                                                  NodeList &nodes)
+{
+    const auto rangeSize = [](const Range &r) { return r.second - r.first; };
+
+    // Split the range in up to Width parts, always splitting the largest part
+    // at the median of element centers along the axis where they spread most.
+    Range parts[Width] = { range };
+    int partCount = 1;
+    while (partCount < Width)
+    {
+        auto largest = std::max_element(parts, parts + partCount,
+            [&](const Range &a, const Range &b) { return rangeSize(a) < rangeSize(b); });
+        if (rangeSize(*largest) <= static_cast<std::uint32_t>(leafCapacity))
+            break;
+
+        Point lower(std::numeric_limits<float>::infinity());
+        Point upper(-std::numeric_limits<float>::infinity());
+        for (std::uint32_t i = largest->first; i < largest->second; ++i)
+        {
+            const Point &c = centers[order[i]];
+            lower = Point(std::min(lower.x, c.x), std::min(lower.y, c.y), std::min(lower.z, c.z));
+            upper = Point(std::max(upper.x, c.x), std::max(upper.y, c.y), std::max(upper.z, c.z));
+        }
+        const Float3 spread = upper - lower;
+        const int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 :
+                         spread.y >= spread.z ? 1 : 2;
+        const auto coordinate = [axis](const Point &p)
+        {
+            return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+        };
+
+        const std::uint32_t middle = largest->first + rangeSize(*largest) / 2;
+        std::nth_element(order.begin() + largest->first,
+                         order.begin() + middle,
+                         order.begin() + largest->second,
+                         [&](std::uint32_t a, std::uint32_t b)
+                         {
+                             return coordinate(centers[a]) < coordinate(centers[b]);
+                         });
+        const Range upperPart(middle, largest->second);
+        largest->second = middle;
+        parts[partCount++] = upperPart;
+    }
+
+    // Reserve the node before building children, which appends more nodes.
+    const std::uint32_t nodeIndex = static_cast<std::uint32_t>(nodes.size());
+    nodes.push_back(Node());
+    for (int slot = 0; slot < Width; ++slot)
+    {
+        Point lower(std::numeric_limits<float>::infinity());
+        Point upper(-std::numeric_limits<float>::infinity());
+        std::uint32_t ref = 0;
+        std::uint8_t elementCount = 0;
+        if (slot < partCount)
+        {
+            const Range &part = parts[slot];
+            for (std::uint32_t i = part.first; i < part.second; ++i)
+            {
+                const AABBox &box = bounds[order[i]];
+                const Point boxLower = box.center - box.halfWidth;
+                const Point boxUpper = box.center + box.halfWidth;
+                lower = Point(std::min(lower.x, boxLower.x), std::min(lower.y, boxLower.y),
+                              std::min(lower.z, boxLower.z));
+                upper = Point(std::max(upper.x, boxUpper.x), std::max(upper.y, boxUpper.y),
+                              std::max(upper.z, boxUpper.z));
+            }
+            if (rangeSize(part) <= static_cast<std::uint32_t>(leafCapacity))
+            {
+                ref = part.first | leafFlag;
+                elementCount = static_cast<std::uint8_t>(rangeSize(part));
+            }
+            else
+            {
+                ref = build(part, order, centers, bounds, nodes);
+            }
+        }
+        Node &node = nodes[nodeIndex];
+        node.minX[slot] = lower.x;
+        node.minY[slot] = lower.y;
+        node.minZ[slot] = lower.z;
+        node.maxX[slot] = upper.x;
+        node.maxY[slot] = upper.y;
+        node.maxZ[slot] = upper.z;
+        node.child[slot] = ref;
+        node.elementCount[slot] = elementCount;
+    }
+    return nodeIndex;
+}
+
+template<class T, int Width, class Allocator>
+bool WideBvh<T, Width, Allocator>::empty() const
+{
+    return m_nodes.empty();
+}
+
+template<class T, int Width, class Allocator>
+const typename WideBvh<T, Width, Allocator>::Node &WideBvh<T, Width, Allocator>::getNode(std::uint32_t index) const
+{
+    assert(index < m_nodes.size());
+    return m_nodes[index];
+}
+
+template<class T, int Width, class Allocator>
+const T &WideBvh<T, Width, Allocator>::getElement(std::uint32_t index) const
+{
+    assert(index < m_elements.size());
+    return m_elements[index];
+}
+
+template<class T, int Width, class Allocator>
+const typename WideBvh<T, Width, Allocator>::NodeList &WideBvh<T, Width, Allocator>::getNodes() const
+{
+    return m_nodes;
+}
+
+template<class T, int Width, class Allocator>
+const typename WideBvh<T, Width, Allocator>::ElementList &WideBvh<T, Width, Allocator>::getElements() const
+{
+    return m_elements;
+}
+
+} //namespace cpom
+
+#endif // __WIDEBVH_H__
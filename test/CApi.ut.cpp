@@ -0,0 +1,274 @@
+#include <cpom.h>
+#include <ClosestPointQuery.h>
+#include <catch.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for the C interface declared in cpom.h.
+
+/// Grid of R*R quads over the unit square, as flat buffers.
+template<int R>
+struct StubPlaneBuffers
+{
+    StubPlaneBuffers()
+    {
+        for (int y = 0; y <= R; ++y)
+        {
+            for (int x = 0; x <= R; ++x)
+            {
+                vertices.push_back(static_cast<float>(x) / R);
+                vertices.push_back(static_cast<float>(y) / R);
+                vertices.push_back(0.0f);
+            }
+        }
+        for (int y = 0; y < R; ++y)
+        {
+            for (int x = 0; x < R; ++x)
+            {
+                const int v = x + y * (R+1);
+                for (const int id : { v, v + 1, v + R + 2, v + R + 1 })
+                    faceVertexIds.push_back(id);
+            }
+        }
+    }
+
+    std::vector<float> vertices;
+    std::vector<std::int32_t> faceVertexIds;
+};
+
+/// Mesh of the same grid, for comparison with the C++ interface.
+template<int R>
+class StubPlaneMesh : public Mesh
+{
+public:
+    virtual std::vector<Point> getVertices() const
+    {
+        std::vector<Point> points;
+        for (std::size_t i = 0; i < m_buffers.vertices.size(); i += 3)
+        {
+            points.push_back(Point(m_buffers.vertices[i], m_buffers.vertices[i+1],
+                                   m_buffers.vertices[i+2]));
+        }
+        return points;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces(R * R);
+        for (std::size_t f = 0; f < faces.size(); ++f)
+        {
+            faces[f].vertexIds.assign(m_buffers.faceVertexIds.begin() + 4*f,
+                                      m_buffers.faceVertexIds.begin() + 4*f + 4);
+        }
+        return faces;
+    }
+
+private:
+    StubPlaneBuffers<R> m_buffers;
+};
+
+SCENARIO( "Closest points through the C interface", "[CApi]" )
+{
+    GIVEN( "A plane of quads indexed through the C interface" )
+    {
+        constexpr int r = 16;
+        const StubPlaneBuffers<r> plane;
+        cpom_build_options options;
+        cpom_build_options_init(&options);
+        cpom_index *index = nullptr;
+        REQUIRE( cpom_index_create(plane.vertices.data(), plane.vertices.size() / 3,
+                                   plane.faceVertexIds.data(), r * r, nullptr, 4,
+                                   &options, &index) == CPOM_OK );
+        REQUIRE( index != nullptr );
+        cpom_query *query = nullptr;
+        REQUIRE( cpom_query_create(index, nullptr, &query) == CPOM_OK );
+
+        std::vector<float> points;
+        for (int i = 0; i < 600; ++i)
+        {
+            points.push_back(std::fmod(i * 0.137f, 1.4f) - 0.2f);
+            points.push_back(std::fmod(i * 0.291f, 1.4f) - 0.2f);
+            points.push_back(std::fmod(i * 0.053f, 0.6f) - 0.3f);
+        }
+        const std::size_t count = points.size() / 3;
+
+        WHEN( "Finding the closest points of a batch of positions" )
+        {
+            std::vector<float> closestPoints(points.size());
+            std::vector<float> distances(count);
+            std::vector<std::int32_t> faceIds(count);
+            REQUIRE( cpom_query_find(query, points.data(), count,
+                                     std::numeric_limits<float>::infinity(),
+                                     closestPoints.data(), distances.data(),
+                                     faceIds.data()) == CPOM_OK );
+
+            THEN( "Results are those of the C++ interface" )
+            {
+                const ClosestPointQuery reference(StubPlaneMesh<r>{});
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const Point position(points[3*i], points[3*i+1], points[3*i+2]);
+                    const auto expected = reference.find(position,
+                                                         std::numeric_limits<float>::infinity());
+                    CAPTURE( position );
+                    REQUIRE( Point(closestPoints[3*i], closestPoints[3*i+1],
+                                   closestPoints[3*i+2]).equalsTo(expected.point) );
+                    REQUIRE( distances[i] == expected.distance );
+                    REQUIRE( faceIds[i] == expected.faceId );
+                }
+            }
+        }
+        WHEN( "Finding the closest points within a distance, only asking for face ids" )
+        {
+            std::vector<std::int32_t> faceIds(count);
+            REQUIRE( cpom_query_find(query, points.data(), count, 0.1f,
+                                     nullptr, nullptr, faceIds.data()) == CPOM_OK );
+
+            THEN( "Positions farther from the plane have no face" )
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const bool isOverPlane = points[3*i] >= 0.0f && points[3*i] <= 1.0f &&
+                                             points[3*i+1] >= 0.0f && points[3*i+1] <= 1.0f;
+                    const float height = std::abs(points[3*i+2]);
+                    if (isOverPlane && height < 0.099f)
+                        REQUIRE( faceIds[i] >= 0 );
+                    else if (height > 0.101f)
+                        REQUIRE( faceIds[i] == -1 );
+                }
+            }
+        }
+        WHEN( "Destroying the index before the query" )
+        {
+            cpom_index_destroy(index);
+            index = nullptr;
+
+            THEN( "The query still finds closest points" )
+            {
+                const float position[3] = { 0.5f, 0.5f, 1.0f };
+                float closestPoint[3];
+                REQUIRE( cpom_query_find(query, position, 1, 2.0f, closestPoint,
+                                         nullptr, nullptr) == CPOM_OK );
+                REQUIRE( Point(closestPoint[0], closestPoint[1], closestPoint[2])
+                         .equalsTo(Point(0.5f, 0.5f, 0.0f)) );
+            }
+        }
+
+        cpom_query_destroy(query);
+        cpom_index_destroy(index);
+    }
+
+    GIVEN( "A mesh of a triangle and a quad with explicit face sizes" )
+    {
+        const float vertices[] = { 0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,
+                                   0.0f, 1.0f, 0.0f,  2.0f, 0.0f, 0.0f };
+        const std::int32_t faceVertexIds[] = { 1, 4, 2,  0, 1, 2, 3 };
+        const std::uint32_t faceSizes[] = { 3, 4 };
+        cpom_index *index = nullptr;
+        REQUIRE( cpom_index_create(vertices, 5, faceVertexIds, 2, faceSizes, 0,
+                                   nullptr, &index) == CPOM_OK );
+        cpom_query *query = nullptr;
+        REQUIRE( cpom_query_create(index, nullptr, &query) == CPOM_OK );
+
+        WHEN( "Finding the closest points over each face" )
+        {
+            const float points[] = { 1.2f, 0.1f, 0.5f,  0.5f, 0.5f, -0.5f };
+            float distances[2];
+            std::int32_t faceIds[2];
+            REQUIRE( cpom_query_find(query, points, 2, 10.0f, nullptr, distances,
+                                     faceIds) == CPOM_OK );
+
+            THEN( "Each face is found at its index" )
+            {
+                REQUIRE( faceIds[0] == 0 );
+                REQUIRE( faceIds[1] == 1 );
+                REQUIRE( distances[0] == Approx(0.5f) );
+                REQUIRE( distances[1] == Approx(0.5f) );
+            }
+        }
+
+        cpom_query_destroy(query);
+        cpom_index_destroy(index);
+    }
+}
+
+SCENARIO( "Errors reported by the C interface", "[CApi]" )
+{
+    const float vertices[] = { 0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f };
+
+    GIVEN( "A face referring to a vertex out of range" )
+    {
+        const std::int32_t faceVertexIds[] = { 0, 1, 3 };
+
+        WHEN( "Creating an index" )
+        {
+            cpom_index *index = reinterpret_cast<cpom_index*>(&index);
+            const cpom_status status = cpom_index_create(vertices, 3, faceVertexIds, 1,
+                                                         nullptr, 3, nullptr, &index);
+
+            THEN( "An invalid argument is reported, with a message" )
+            {
+                REQUIRE( status == CPOM_INVALID_ARGUMENT );
+                REQUIRE( index == nullptr );
+                REQUIRE( std::strlen(cpom_last_error_message()) > 0 );
+            }
+        }
+    }
+    GIVEN( "Options with an unknown index type" )
+    {
+        const std::int32_t faceVertexIds[] = { 0, 1, 2 };
+        cpom_build_options options;
+        cpom_build_options_init(&options);
+        options.index_type = 42;
+
+        WHEN( "Creating an index" )
+        {
+            cpom_index *index = nullptr;
+            THEN( "An invalid argument is reported" )
+            {
+                REQUIRE( cpom_index_create(vertices, 3, faceVertexIds, 1, nullptr, 3,
+                                           &options, &index) == CPOM_INVALID_ARGUMENT );
+                REQUIRE( index == nullptr );
+            }
+        }
+        WHEN( "Creating an index with options from an older caller, unaware of the index type" )
+        {
+            options.struct_size = sizeof(options.struct_size);
+            cpom_index *index = nullptr;
+            THEN( "The default index type is used" )
+            {
+                REQUIRE( cpom_index_create(vertices, 3, faceVertexIds, 1, nullptr, 3,
+                                           &options, &index) == CPOM_OK );
+                cpom_index_destroy(index);
+            }
+        }
+    }
+    GIVEN( "Null handles" )
+    {
+        THEN( "Queries and searches report invalid arguments" )
+        {
+            cpom_query *query = nullptr;
+            REQUIRE( cpom_query_create(nullptr, nullptr, &query) == CPOM_INVALID_ARGUMENT );
+            REQUIRE( query == nullptr );
+            const float point[3] = { 0.0f, 0.0f, 0.0f };
+            REQUIRE( cpom_query_find(nullptr, point, 1, 1.0f, nullptr, nullptr, nullptr) ==
+                     CPOM_INVALID_ARGUMENT );
+            cpom_index_destroy(nullptr);
+            cpom_query_destroy(nullptr);
+        }
+    }
+    THEN( "The ABI version of the library is the one of the header" )
+    {
+        REQUIRE( cpom_abi_version() == CPOM_ABI_VERSION );
+    }
+}
+
+} // anonymous namespace
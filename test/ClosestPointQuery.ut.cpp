@@ -1,7 +1,12 @@
 #include "ClosestPointQuery.h"
+#include "QueryTrace.h"
 #include "catch.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <memory>
+#include <vector>
 
 using namespace cpom;
 
@@ -300,6 +305,37 @@ SCENARIO( "Single Triangle Mesh", "[Mesh]" )
 }
 //! [Single Triangle Mesh]
 
+SCENARIO( "Obtuse triangle seen beyond a short side", "[Mesh]" )
+{
+    GIVEN( "An obtuse triangle, listed from each of its vertices" )
+    {
+        const Point vertices[] = { Point(0.0f, 0.0f, 0.0f), Point(1.0f, 0.1f, 0.0f),
+                                   Point(2.0f, 0.0f, 0.0f) };
+
+        WHEN( "Evaluating the query with a position off its plane, beyond its short side" )
+        {
+            const Point position(2.0f, 0.5f, -0.3f);
+
+            THEN( "The closest point lies on that side, whatever the first vertex" )
+            {
+                // The closest point falls in each region of the triangle parameters
+                // around its sides, depending on the first vertex.
+                for (int first = 0; first < 3; ++first)
+                {
+                    MeshData mesh;
+                    for (int v = 0; v < 3; ++v)
+                        mesh.vertices.push_back(vertices[(first + v) % 3]);
+                    mesh.faces.push_back({ { 0, 1, 2 } });
+                    const auto result = ClosestPointQuery(mesh).find(position, infinity);
+                    CAPTURE( first );
+                    REQUIRE( result.point.equalsTo(Point(1.9504950f, 0.0049505f, 0.0f), 1e-5f) );
+                    REQUIRE( result.distance == Approx(0.5809690f) );
+                }
+            }
+        }
+    }
+}
+
 SCENARIO( "Single Quadrilateral Mesh", "[Mesh]" )
 {
     GIVEN( "A mesh with a single quadrilateral and a ClosestPointQuery on it" )
@@ -560,6 +596,1211 @@ SCENARIO( "Dense plane mesh", "[Mesh]")
     }
 }
 
+SCENARIO( "Dense plane mesh with each index type", "[Mesh]")
+{
+    GIVEN( "A plane mesh with ten thousand quad faces and a ClosestPointQuery on it per index type" )
+    {
+        StubDensePlaneMesh<100> stubDensePlaneMesh;
+        const IndexType indexTypes[] = { IndexType::Octree,
+                                         IndexType::WideBvh4,
+                                         IndexType::WideBvh8 };
+        std::vector< std::unique_ptr<ClosestPointQuery> > queries;
+        for (const auto indexType: indexTypes)
+        {
+            BuildOptions options;
+            options.indexType = indexType;
+            queries.emplace_back( new ClosestPointQuery(stubDensePlaneMesh, options) );
+        }
+
+        WHEN( "Evaluating the queries with a position at the centroid of the plane" )
+        {
+            const Point position( Point(0.5f, 0.5f, 0.5f) );
+            THEN( "The same position is returned" )
+            {
+                for (const auto &query: queries)
+                {
+                    const Point closestPoint = (*query)(position, infinity);
+                    CAPTURE( closestPoint );
+                    REQUIRE( closestPoint.equalsTo(position) );
+                }
+            }
+        }
+
+        WHEN( "Evaluating the queries with a position far from the plane" )
+        {
+            const Point position( Point(0.75f, 1.0f, 0.0f) );
+            const Point expectedClosestPoint( Point(0.75f, 0.5f, 0.5f) );
+            THEN( "The expected position is returned" )
+            {
+                for (const auto &query: queries)
+                {
+                    const Point closestPoint = (*query)(position, infinity);
+                    CAPTURE( closestPoint );
+                    REQUIRE( closestPoint.equalsTo(expectedClosestPoint, 1e-6f) );
+                }
+            }
+        }
+
+        WHEN( "Evaluating the queries with a position beyond max distance from the plane" )
+        {
+            const Point position( Point(0.75f, 1.0f, 0.0f) );
+            THEN( "The returned points have NaNs" )
+            {
+                for (const auto &query: queries)
+                {
+                    const Point closestPoint = (*query)(position, 0.1f);
+                    CAPTURE( closestPoint );
+                    REQUIRE( closestPoint.hasNan() );
+                }
+            }
+            THEN( "Searches pruned at 4 times max distance stop there, testing no face" )
+            {
+                QueryOptions queryOptions;
+                queryOptions.noFacePruningFactor = 4.0f;
+                for (const auto &query: queries)
+                {
+                    const ClosestPointQuery prunedQuery(query->getIndex(), queryOptions);
+                    ClosestPointQuery::Result result;
+                    ClosestPointQuery::Statistics statistics;
+                    prunedQuery.find(&position, 1, 0.1f, &result, statistics);
+                    REQUIRE( result.faceId == -1 );
+                    REQUIRE( statistics.faceCount == 0 );
+                    REQUIRE( statistics.nodeCount < 10 );
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Index allocated from memory resources", "[Mesh]")
+{
+    GIVEN( "A plane mesh with ten thousand quad faces and arenas for the index and the build" )
+    {
+        StubDensePlaneMesh<100> stubDensePlaneMesh;
+        MonotonicBuffer indexArena;
+        MonotonicBuffer buildArena;
+
+        WHEN( "Constructing a ClosestPointQuery per index type with them" )
+        {
+            const IndexType indexTypes[] = { IndexType::Octree,
+                                             IndexType::WideBvh4,
+                                             IndexType::WideBvh8 };
+            std::vector< std::unique_ptr<ClosestPointQuery> > queries;
+            for (const auto indexType: indexTypes)
+            {
+                BuildOptions options;
+                options.indexType = indexType;
+                options.indexMemoryResource = &indexArena;
+                options.buildMemoryResource = &buildArena;
+                queries.emplace_back( new ClosestPointQuery(stubDensePlaneMesh, options) );
+            }
+
+            THEN( "Memory is drawn from the arenas" )
+            {
+                REQUIRE( indexArena.getChunkCount() > 0 );
+                REQUIRE( buildArena.getChunkCount() > 0 );
+            }
+            THEN( "The queries return the expected positions" )
+            {
+                const Point position( Point(0.75f, 1.0f, 0.0f) );
+                const Point expectedClosestPoint( Point(0.75f, 0.5f, 0.5f) );
+                for (const auto &query: queries)
+                {
+                    const Point closestPoint = (*query)(position, infinity);
+                    CAPTURE( closestPoint );
+                    REQUIRE( closestPoint.equalsTo(expectedClosestPoint, 1e-6f) );
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Memory footprint of indices", "[Mesh]")
+{
+    GIVEN( "A plane mesh with ten thousand quad faces" )
+    {
+        constexpr int resolution = 100;
+        StubDensePlaneMesh<resolution> stubDensePlaneMesh;
+        const std::size_t vertexCount = (resolution+1) * (resolution+1);
+        const std::size_t faceCount = resolution * resolution;
+
+        WHEN( "Constructing a ClosestPointQuery per index type" )
+        {
+            THEN( "Their footprint holds each vertex and face at least once, in leaves of nodes" )
+            {
+                for (const auto indexType: { IndexType::Octree, IndexType::WideBvh4,
+                                             IndexType::WideBvh8 })
+                {
+                    BuildOptions options;
+                    options.indexType = indexType;
+                    const ClosestPointQuery query(stubDensePlaneMesh, options);
+                    const MemoryFootprint footprint = query.getMemoryFootprint();
+                    CAPTURE( static_cast<int>(indexType) );
+                    REQUIRE( footprint.vertices >= vertexCount * sizeof(Point) );
+                    REQUIRE( footprint.duplicatedVertices <=
+                             footprint.vertices - vertexCount * sizeof(Point) );
+                    REQUIRE( footprint.faces >= faceCount * 2 * sizeof(std::uint32_t) );
+                    REQUIRE( footprint.duplicatedFaces < footprint.faces );
+                    REQUIRE( footprint.meshlets > 0 );
+                    REQUIRE( footprint.nodes > 0 );
+                    REQUIRE( footprint.leafElements > 0 );
+                    REQUIRE( footprint.proxies == 0 );
+                    REQUIRE( footprint.normalCones == 0 );
+                    REQUIRE( footprint.groups == 0 );
+                    REQUIRE( footprint.patches == 0 );
+                    REQUIRE( footprint.objects > 0 );
+                    REQUIRE( footprint.getTotal() ==
+                             footprint.vertices + footprint.faces + footprint.meshlets +
+                             footprint.nodes + footprint.leafElements + footprint.objects );
+                    if (indexType != IndexType::Octree)
+                        REQUIRE( footprint.duplicatedFaces == 0 );
+                }
+            }
+        }
+        WHEN( "Constructing a ClosestPointQuery with an octree bounded by proxies" )
+        {
+            BuildOptions options;
+            options.useProxyBounds = true;
+            const ClosestPointQuery query(stubDensePlaneMesh, options);
+
+            THEN( "Proxies are accounted for, and shared by queries of the same index" )
+            {
+                REQUIRE( query.getMemoryFootprint().proxies > 0 );
+                REQUIRE( query.getMemoryFootprint().normalCones == 0 );
+                const ClosestPointQuery sharingQuery(query.getIndex());
+                REQUIRE( sharingQuery.getMemoryFootprint().getTotal() ==
+                         query.getMemoryFootprint().getTotal() );
+            }
+        }
+    }
+    GIVEN( "A plane mesh with 16 quad faces, processed without index" )
+    {
+        StubDensePlaneMesh<4> stubDensePlaneMesh;
+        const ClosestPointQuery query(stubDensePlaneMesh);
+
+        THEN( "Its footprint has no node and no duplication" )
+        {
+            const MemoryFootprint footprint = query.getMemoryFootprint();
+            REQUIRE( footprint.vertices == 25 * sizeof(Point) );
+            REQUIRE( footprint.nodes == 0 );
+            REQUIRE( footprint.leafElements == 0 );
+            REQUIRE( footprint.duplicatedVertices == 0 );
+            REQUIRE( footprint.duplicatedFaces == 0 );
+        }
+    }
+}
+
+SCENARIO( "Face ids reported by queries", "[Mesh]")
+{
+    GIVEN( "A mesh with apart triangles and a ClosestPointQuery on it" )
+    {
+        class StubDualTriangleMesh : public Mesh
+        {
+        public:
+            virtual std::vector<Point> getVertices() const
+            {
+                return { Point(0.0f, 0.0f, -1.0f),
+                         Point(1.0f, 0.0f, -1.0f),
+                         Point(0.0f, 1.0f, -1.0f),
+                         Point(0.0f, 0.0f, +1.0f),
+                         Point(1.0f, 0.0f, +1.0f),
+                         Point(0.0f, 1.0f, +1.0f) };
+            }
+
+            virtual std::vector<Face> getFaces() const
+            {
+                return { { { 0, 1, 2} }, { { 3, 4, 5} } };
+            }
+        };
+        StubDualTriangleMesh stubDualTriangleMesh;
+        const ClosestPointQuery query(stubDualTriangleMesh);
+
+        WHEN( "Finding the closest point from a position near the second triangle" )
+        {
+            const auto result = query.find(Point(0.0f, 0.0f, 1.5f), infinity);
+
+            THEN( "The second face and its distance are returned" )
+            {
+                REQUIRE( result.faceId == 1 );
+                REQUIRE( result.distance == Approx(0.5f) );
+                REQUIRE( result.point.equalsTo(Point(0.0f, 0.0f, 1.0f)) );
+            }
+        }
+
+        WHEN( "Finding the closest point beyond max distance" )
+        {
+            const auto result = query.find(Point(0.0f, 0.0f, 1.5f), 0.1f);
+
+            THEN( "No face is returned" )
+            {
+                REQUIRE( result.faceId == -1 );
+                REQUIRE( result.distance == infinity );
+                REQUIRE( result.point.hasNan() );
+            }
+        }
+    }
+
+    GIVEN( "A plane mesh with ten thousand quad faces and a ClosestPointQuery on it per build option" )
+    {
+        constexpr int resolution = 100;
+        StubDensePlaneMesh<resolution> stubDensePlaneMesh;
+        const IndexType indexTypes[] = { IndexType::Octree,
+                                         IndexType::WideBvh4,
+                                         IndexType::WideBvh8 };
+        std::vector< std::unique_ptr<ClosestPointQuery> > queries;
+        for (const auto indexType: indexTypes)
+        {
+            for (const bool reorderForLocality: { false, true })
+            {
+                BuildOptions options;
+                options.indexType = indexType;
+                options.reorderForLocality = reorderForLocality;
+                queries.emplace_back( new ClosestPointQuery(stubDensePlaneMesh, options) );
+            }
+        }
+
+        WHEN( "Finding the closest points from the centers of faces" )
+        {
+            THEN( "The original index of these faces is returned" )
+            {
+                const int cells[][2] = { {0, 0}, {37, 58}, {99, 1}, {50, 50}, {99, 99} };
+                for (const auto &cell: cells)
+                {
+                    const float x = (cell[0] + 0.5f) / resolution;
+                    const float y = (cell[1] + 0.5f) / resolution;
+                    const Point position(x, y, y);
+                    const int expectedFaceId =
+                        static_cast<int>(stubDensePlaneMesh.faceIndex(cell[0], cell[1]));
+                    for (const auto &query: queries)
+                    {
+                        const auto result = query->find(position, infinity);
+                        CAPTURE( position );
+                        REQUIRE( result.faceId == expectedFaceId );
+                        REQUIRE( result.point.equalsTo(position, 1e-6f) );
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Index shared by several queries", "[Mesh]")
+{
+    GIVEN( "A plane mesh with 2500 quad faces and an index built on it" )
+    {
+        constexpr int resolution = 50;
+        StubDensePlaneMesh<resolution> stubDensePlaneMesh;
+        auto index = std::make_shared<const MeshIndex>(stubDensePlaneMesh);
+
+        WHEN( "Creating queries from the index, from another query and by copy" )
+        {
+            QueryOptions noPrefetch;
+            noPrefetch.prefetchDistance = 0;
+            const ClosestPointQuery query(index);
+            const ClosestPointQuery otherQuery(query.getIndex(), noPrefetch);
+            const ClosestPointQuery copiedQuery(otherQuery);
+            index.reset();
+
+            THEN( "They all search the same index, which outlives its first owner" )
+            {
+                REQUIRE( query.getIndex().use_count() == 3 );
+                REQUIRE( otherQuery.getIndex() == query.getIndex() );
+                REQUIRE( copiedQuery.getIndex() == query.getIndex() );
+                REQUIRE( otherQuery.getQueryOptions().prefetchDistance == 0 );
+                REQUIRE( copiedQuery.getQueryOptions().prefetchDistance == 0 );
+            }
+            THEN( "They return the same results" )
+            {
+                const Point position(0.3f, 0.7f, 0.8f);
+                const auto result = query.find(position, infinity);
+                REQUIRE( result.faceId >= 0 );
+                REQUIRE( otherQuery.find(position, infinity).faceId == result.faceId );
+                REQUIRE( copiedQuery.find(position, infinity).faceId == result.faceId );
+                REQUIRE( copiedQuery.find(position, infinity).point == result.point );
+            }
+        }
+
+        WHEN( "Creating a query without index" )
+        {
+            THEN( "An exception is thrown" )
+            {
+                REQUIRE_THROWS( ClosestPointQuery(std::shared_ptr<const MeshIndex>()) );
+            }
+        }
+    }
+}
+
+SCENARIO( "Batch queries", "[Mesh]")
+{
+    GIVEN( "A plane mesh with 2500 quad faces and ClosestPointQuery objects on it per index and prefetch distance" )
+    {
+        constexpr int resolution = 50;
+        StubDensePlaneMesh<resolution> stubDensePlaneMesh;
+        const IndexType indexTypes[] = { IndexType::Octree,
+                                         IndexType::WideBvh4,
+                                         IndexType::WideBvh8 };
+        std::vector<ClosestPointQuery> queries;
+        for (const auto indexType: indexTypes)
+        {
+            BuildOptions options;
+            options.indexType = indexType;
+            const auto index = std::make_shared<const MeshIndex>(stubDensePlaneMesh, options);
+            for (const unsigned prefetchDistance: { 0u, 4u })
+            {
+                QueryOptions queryOptions;
+                queryOptions.prefetchDistance = prefetchDistance;
+                queries.emplace_back(index, queryOptions);
+            }
+        }
+
+        // Points scattered around the plane, near and far from it.
+        std::vector<Point> queryPoints;
+        for (int i = 0; i < 100; ++i)
+        {
+            const float x = static_cast<float>((i * 37) % 101) / 100.0f;
+            const float y = static_cast<float>((i * 61) % 103) / 102.0f;
+            const float offset = static_cast<float>(i % 7) * 0.05f;
+            queryPoints.push_back(Point(x, y - offset, y + offset));
+        }
+
+        WHEN( "Finding the closest points of all points in a batch" )
+        {
+            THEN( "The results are the ones of queries made one by one" )
+            {
+                for (const float maxDist: { infinity, 0.1f })
+                {
+                    for (const auto &query: queries)
+                    {
+                        std::vector<ClosestPointQuery::Result> results(queryPoints.size());
+                        query.find(queryPoints.data(), queryPoints.size(), maxDist,
+                                   results.data());
+                        for (std::size_t i = 0; i < queryPoints.size(); ++i)
+                        {
+                            const auto expected = query.find(queryPoints[i], maxDist);
+                            CAPTURE( queryPoints[i] );
+                            CAPTURE( maxDist );
+                            REQUIRE( results[i].faceId == expected.faceId );
+                            REQUIRE( results[i].distance == expected.distance );
+                            if (expected.faceId >= 0)
+                                REQUIRE( results[i].point == expected.point );
+                        }
+                    }
+                }
+            }
+        }
+        WHEN( "Finding the closest points of all points in a batch split among threads" )
+        {
+            THEN( "The results are the ones of a single batch, whatever the number of threads" )
+            {
+                for (const auto &query: queries)
+                {
+                    std::vector<ClosestPointQuery::Result> expected(queryPoints.size());
+                    query.find(queryPoints.data(), queryPoints.size(), infinity,
+                               expected.data());
+                    for (const unsigned threadCount: { 1u, 3u, 0u, 1000u })
+                    {
+                        std::vector<ClosestPointQuery::Result> results(queryPoints.size());
+                        query.find(queryPoints.data(), queryPoints.size(), infinity,
+                                   results.data(), threadCount);
+                        CAPTURE( threadCount );
+                        for (std::size_t i = 0; i < queryPoints.size(); ++i)
+                        {
+                            REQUIRE( results[i].faceId == expected[i].faceId );
+                            REQUIRE( results[i].distance == expected[i].distance );
+                            REQUIRE( results[i].point == expected[i].point );
+                        }
+                    }
+                }
+            }
+        }
+        WHEN( "Finding the closest points of all points in two batches, counting the work done" )
+        {
+            THEN( "Counts add up, each query visiting nodes and testing faces" )
+            {
+                const std::size_t faceCount = resolution * resolution;
+                const std::size_t half = queryPoints.size() / 2;
+                for (const auto &query: queries)
+                {
+                    std::vector<ClosestPointQuery::Result> results(queryPoints.size());
+                    ClosestPointQuery::Statistics statistics;
+                    query.find(queryPoints.data(), half, infinity, results.data(), statistics);
+                    const ClosestPointQuery::Statistics firstStatistics = statistics;
+                    query.find(queryPoints.data() + half, queryPoints.size() - half, infinity,
+                               results.data() + half, statistics);
+                    REQUIRE( firstStatistics.queryCount == half );
+                    REQUIRE( statistics.queryCount == queryPoints.size() );
+                    REQUIRE( statistics.nodeCount > firstStatistics.nodeCount );
+                    REQUIRE( statistics.faceCount > firstStatistics.faceCount );
+                    REQUIRE( statistics.nodeCount >= queryPoints.size() );
+                    REQUIRE( statistics.faceCount >= queryPoints.size() );
+                    REQUIRE( statistics.faceCount < queryPoints.size() * faceCount );
+                }
+            }
+        }
+    }
+}
+
+/// Dense plane whose quads are split in two triangles, all of them or every other one.
+template<int R>
+class StubSplitPlaneMesh : public StubDensePlaneMesh<R>
+{
+public:
+    explicit StubSplitPlaneMesh(bool splitAll)
+    : m_splitAll(splitAll)
+    { }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces;
+        bool isSplit = true;
+        for (const auto &quad: StubDensePlaneMesh<R>::getFaces())
+        {
+            const auto &v = quad.vertexIds;
+            if (isSplit)
+            {
+                faces.push_back({{ v[0], v[1], v[2] }});
+                faces.push_back({{ v[2], v[3], v[0] }});
+            }
+            else
+            {
+                faces.push_back(quad);
+            }
+            isSplit = m_splitAll || !isSplit;
+        }
+        return faces;
+    }
+
+private:
+    bool m_splitAll;
+};
+
+SCENARIO( "Meshes of triangles, quads or both", "[Mesh]")
+{
+    GIVEN( "A plane mesh made of quads, of triangles and of both, and ClosestPointQuery objects on them" )
+    {
+        constexpr int resolution = 20;
+        const StubDensePlaneMesh<resolution> quadMesh;
+        const StubSplitPlaneMesh<resolution> triangleMesh(true);
+        const StubSplitPlaneMesh<resolution> mixedMesh(false);
+        std::vector<ClosestPointQuery> queries;
+        for (const auto indexType: { IndexType::Octree, IndexType::WideBvh4 })
+        {
+            BuildOptions options;
+            options.indexType = indexType;
+            for (const Mesh *mesh: { static_cast<const Mesh *>(&quadMesh),
+                                     static_cast<const Mesh *>(&triangleMesh),
+                                     static_cast<const Mesh *>(&mixedMesh) })
+                queries.emplace_back(*mesh, options);
+        }
+
+        WHEN( "Finding the closest points from positions around the plane" )
+        {
+            THEN( "The same distances are returned for all meshes" )
+            {
+                const Point positions[] = { Point(0.5f, 0.5f, 0.5f),
+                                            Point(0.23f, 0.4f, 0.6f),
+                                            Point(-0.3f, 1.2f, 0.1f),
+                                            Point(0.81f, 0.07f, -0.2f) };
+                for (const auto &position: positions)
+                {
+                    const float expectedDistance = queries.front().find(position, infinity).distance;
+                    for (const auto &query: queries)
+                    {
+                        CAPTURE( position );
+                        REQUIRE( std::abs(query.find(position, infinity).distance -
+                                          expectedDistance) < 1e-6f );
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// \brief Plane mesh of R*R quads whose inner vertices are moved by a pseudo-random offset.
+///
+/// The offset is in the plane, keeping quads planar and convex, or along the normal.
+template<int R>
+class StubJitteredPlaneMesh : public StubDensePlaneMesh<R>
+{
+public:
+    explicit StubJitteredPlaneMesh(bool isInPlane)
+    : m_isInPlane(isInPlane)
+    { }
+
+    virtual std::vector<Point> getVertices() const
+    {
+        std::vector<Point> vertices = StubDensePlaneMesh<R>::getVertices();
+        const float maxOffset = 0.3f / R;
+        for (int y = 1; y < R; ++y)
+        {
+            for (int x = 1; x < R; ++x)
+            {
+                const float u = static_cast<float>((x * 7 + y * 13) % 11) / 10.0f - 0.5f;
+                const float v = static_cast<float>((x * 5 + y * 3) % 7) / 6.0f - 0.5f;
+                const Point offset = m_isInPlane ? Point(u, v, v) : Point(0.0f, -u, u);
+                vertices[this->vertexIndex(x, y)] = vertices[this->vertexIndex(x, y)] +
+                                                    offset * maxOffset;
+            }
+        }
+        return vertices;
+    }
+
+private:
+    bool m_isInPlane;
+};
+
+SCENARIO( "Closest points on planar quads", "[Mesh]")
+{
+    GIVEN( "Planar and non-planar quad meshes, and ClosestPointQuery objects on them splitting quads or not" )
+    {
+        constexpr int resolution = 20;
+        const StubJitteredPlaneMesh<resolution> planarMesh(true);
+        const StubJitteredPlaneMesh<resolution> nonPlanarMesh(false);
+
+        WHEN( "Finding the closest points from positions around the meshes" )
+        {
+            THEN( "Quads are not split in two triangles only when it does not change the results" )
+            {
+                for (const Mesh *mesh: { static_cast<const Mesh *>(&planarMesh),
+                                         static_cast<const Mesh *>(&nonPlanarMesh) })
+                {
+                    BuildOptions planarOptions;
+                    planarOptions.planarQuadTolerance = 1e-5f;
+                    const ClosestPointQuery splitQuery(*mesh);
+                    const ClosestPointQuery query(*mesh, planarOptions);
+                    for (int i = 0; i < 200; ++i)
+                    {
+                        const float x = static_cast<float>((i * 37) % 101) / 80.0f - 0.1f;
+                        const float y = static_cast<float>((i * 61) % 103) / 82.0f - 0.1f;
+                        const float offset = static_cast<float>(i % 5 - 2) * 0.01f;
+                        const Point position(x, y - offset, y + offset);
+                        const auto expected = splitQuery.find(position, infinity);
+                        const auto result = query.find(position, infinity);
+                        CAPTURE( position );
+                        REQUIRE( std::abs(result.distance - expected.distance) < 1e-6f );
+                    }
+                }
+            }
+        }
+    }
+    GIVEN( "Skewed and kite-shaped convex planar quads, in tilted planes" )
+    {
+        // Quads are drawn in the xy plane, then mapped onto planes through origin.
+        const Point quads[][4] = { { Point(0.0f, 0.0f, 0.0f), Point(1.0f, 0.1f, 0.0f),
+                                     Point(2.0f, 0.0f, 0.0f), Point(5.0f, -5.0f, 0.0f) },
+                                   { Point(0.0f, 0.0f, 0.0f), Point(1.0f, -0.3f, 0.0f),
+                                     Point(3.0f, 0.0f, 0.0f), Point(1.0f, 0.3f, 0.0f) },
+                                   { Point(0.0f, 0.0f, 0.0f), Point(4.0f, 0.0f, 0.0f),
+                                     Point(4.5f, 0.5f, 0.0f), Point(-3.0f, 0.5f, 0.0f) } };
+        const Float3 axes[][2] = { { Float3(1.0f, 0.0f, 0.0f), Float3(0.0f, 1.0f, 0.0f) },
+                                   { Float3(0.8f, 0.0f, 0.6f), Float3(0.0f, 1.0f, 0.0f) },
+                                   { Float3(0.6f, 0.0f, -0.8f), Float3(0.0f, 0.6f, 0.8f) } };
+
+        WHEN( "Finding the closest points from positions projecting outside of the quads" )
+        {
+            THEN( "They are those found by splitting quads in two triangles" )
+            {
+                BuildOptions planarOptions;
+                planarOptions.planarQuadTolerance = 1e-5f;
+                for (const auto &quad: quads)
+                {
+                    for (const auto &axis: axes)
+                    {
+                        MeshData mesh;
+                        for (const Point &vertex: quad)
+                            mesh.vertices.push_back(axis[0] * vertex.x + axis[1] * vertex.y);
+                        mesh.faces.push_back({ { 0, 1, 2, 3 } });
+                        const ClosestPointQuery splitQuery(mesh);
+                        const ClosestPointQuery query(mesh, planarOptions);
+
+                        // Positions lie past each edge and each corner, off the plane.
+                        const Float3 normal = axis[0].cross(axis[1]);
+                        const Point center = (mesh.vertices[0] + mesh.vertices[1] +
+                                              mesh.vertices[2] + mesh.vertices[3]) * 0.25f;
+                        std::vector<Point> positions;
+                        for (int v = 0; v < 4; ++v)
+                        {
+                            const Point &start = mesh.vertices[v];
+                            const Point &end = mesh.vertices[(v+1) % 4];
+                            const Float3 edge = end - start;
+                            const Float3 edgeNormal = edge.cross(normal) / edge.length();
+                            const Float3 cornerDirection = (start - center) /
+                                                           (start - center).length();
+                            for (const float step: { 0.1f, 0.5f, 2.0f })
+                            {
+                                for (const float height: { -0.3f, 0.0f, 0.3f })
+                                {
+                                    positions.push_back((start + end) * 0.5f +
+                                                        edgeNormal * step + normal * height);
+                                    positions.push_back(start + edge * 0.2f +
+                                                        edgeNormal * step + normal * height);
+                                    positions.push_back(start + cornerDirection * step +
+                                                        normal * height);
+                                }
+                            }
+                        }
+                        for (const Point &position: positions)
+                        {
+                            const auto expected = splitQuery.find(position, infinity);
+                            const auto result = query.find(position, infinity);
+                            CAPTURE( position );
+                            REQUIRE( result.distance == Approx(expected.distance).epsilon(1e-5) );
+                            REQUIRE( result.point.equalsTo(expected.point, 1e-4f) );
+                        }
+                    }
+                }
+
+                // A position past the long edge of the skewed quad, on the side of
+                // its first triangle.
+                MeshData mesh;
+                mesh.vertices.assign(quads[0], quads[0] + 4);
+                mesh.faces.push_back({ { 0, 1, 2, 3 } });
+                const ClosestPointQuery query(mesh, planarOptions);
+                const auto result = query.find(Point(4.0f, 0.1f, 0.0f), infinity);
+                REQUIRE( result.distance == Approx(1.766f).epsilon(1e-3) );
+                REQUIRE( result.point.equalsTo(Point(2.485f, -0.809f, 0.0f), 1e-3f) );
+            }
+        }
+    }
+}
+
+SCENARIO( "Octree nodes bounded by proxies", "[Mesh]")
+{
+    GIVEN( "Flat and bumpy plane meshes, and ClosestPointQuery objects on them with and without proxies" )
+    {
+        constexpr int resolution = 40;
+        const StubDensePlaneMesh<resolution> flatMesh;
+        const StubJitteredPlaneMesh<resolution> bumpyMesh(false);
+
+        WHEN( "Finding the closest points from positions near and far from the meshes" )
+        {
+            THEN( "Proxies do not change the results" )
+            {
+                for (const Mesh *mesh: { static_cast<const Mesh *>(&flatMesh),
+                                         static_cast<const Mesh *>(&bumpyMesh) })
+                {
+                    BuildOptions options;
+                    options.useProxyBounds = true;
+                    const ClosestPointQuery proxyQuery(*mesh, options);
+                    const ClosestPointQuery query(*mesh);
+                    for (int i = 0; i < 200; ++i)
+                    {
+                        const float x = static_cast<float>((i * 37) % 101) / 80.0f - 0.1f;
+                        const float y = static_cast<float>((i * 61) % 103) / 82.0f - 0.1f;
+                        const float offset = static_cast<float>(i % 9 - 4) * static_cast<float>(i % 4) * 0.1f;
+                        const Point position(x, y - offset, y + offset);
+                        const auto expected = query.find(position, infinity);
+                        const auto result = proxyQuery.find(position, infinity);
+                        CAPTURE( position );
+                        REQUIRE( result.distance == expected.distance );
+                        REQUIRE( result.point.equalsTo(expected.point, 1e-6f) );
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Octree subdivision rules", "[Mesh]")
+{
+    GIVEN( "A bumpy plane mesh, and ClosestPointQuery objects on it per subdivision rule" )
+    {
+        constexpr int resolution = 40;
+        const StubJitteredPlaneMesh<resolution> bumpyMesh(false);
+        std::vector<BuildOptions> optionSets(4);
+        optionSets[0].octreeSubdivision = OctreeSubdivision::Fill;
+        optionSets[1].octreeSubdivision = OctreeSubdivision::SurfaceAreaCost;
+        optionSets[2].octreeSubdivision = OctreeSubdivision::VolumeCost;
+        optionSets[3].maxOctreeDepth = 2;
+        optionSets[3].octreeDepthLimits.push_back({ Point(0.0f), Point(0.25f), 8 });
+
+        WHEN( "Finding the closest points from positions near and far from the mesh" )
+        {
+            THEN( "The subdivision does not change the results" )
+            {
+                const ClosestPointQuery query(bumpyMesh);
+                for (const BuildOptions &options: optionSets)
+                {
+                    const ClosestPointQuery subdividedQuery(bumpyMesh, options);
+                    for (int i = 0; i < 200; ++i)
+                    {
+                        const float x = static_cast<float>((i * 37) % 101) / 80.0f - 0.1f;
+                        const float y = static_cast<float>((i * 61) % 103) / 82.0f - 0.1f;
+                        const float offset = static_cast<float>(i % 9 - 4) * static_cast<float>(i % 4) * 0.1f;
+                        const Point position(x, y - offset, y + offset);
+                        const auto expected = query.find(position, infinity);
+                        const auto result = subdividedQuery.find(position, infinity);
+                        CAPTURE( position );
+                        REQUIRE( result.distance == expected.distance );
+                        REQUIRE( result.point.equalsTo(expected.point, 1e-6f) );
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Safe radius of query results", "[Mesh]")
+{
+    GIVEN( "A bumpy plane mesh, and ClosestPointQuery objects on it per index" )
+    {
+        constexpr int resolution = 20;
+        const StubJitteredPlaneMesh<resolution> bumpyMesh(false);
+        std::vector<BuildOptions> optionSets(5);
+        optionSets[1].useProxyBounds = true;
+        optionSets[2].indexType = IndexType::WideBvh4;
+        optionSets[3].indexType = IndexType::WideBvh8;
+        optionSets[4].surfaceType = SurfaceType::CatmullClarkLimit;
+        const Float3 directions[] = { Float3(1.0f, 0.0f, 0.0f), Float3(0.0f, -1.0f, 0.0f),
+                                      Float3(0.0f, 0.0f, 1.0f), Float3(0.0f, -1.0f, 1.0f),
+                                      Float3(-1.0f, 1.0f, 1.0f) };
+
+        WHEN( "Moving query points by less than their safe radius" )
+        {
+            THEN( "The same face is found" )
+            {
+                std::size_t safeQueryCount = 0;
+                std::size_t queryCount = 0;
+                for (const BuildOptions &options: optionSets)
+                {
+                    const ClosestPointQuery query(bumpyMesh, options);
+                    for (int i = 0; i < 100; ++i)
+                    {
+                        const float x = static_cast<float>((i * 37) % 101) / 80.0f - 0.1f;
+                        const float y = static_cast<float>((i * 61) % 103) / 82.0f - 0.1f;
+                        const float offset = static_cast<float>(i % 9 - 4) * static_cast<float>(i % 4) * 0.02f;
+                        const Point position(x, y - offset, y + offset);
+                        const auto result = query.find(position, infinity);
+                        ++queryCount;
+                        if (result.safeRadius > 0.0f)
+                            ++safeQueryCount;
+                        for (const Float3 &direction: directions)
+                        {
+                            const float distance = 0.99f * std::min(result.safeRadius, 1.0f);
+                            const Point movedPosition = position + direction / direction.length() * distance;
+                            CAPTURE( position );
+                            CAPTURE( movedPosition );
+                            REQUIRE( query.find(movedPosition, infinity).faceId == result.faceId );
+                        }
+                    }
+                }
+                REQUIRE( safeQueryCount > queryCount / 2 );
+            }
+        }
+
+        WHEN( "Querying with a tolerance" )
+        {
+            QueryOptions queryOptions;
+            queryOptions.safeRadiusTolerance = 0.01f;
+            const ClosestPointQuery query(bumpyMesh);
+            const ClosestPointQuery tolerantQuery(query.getIndex(), queryOptions);
+            THEN( "Radii grow by half the tolerance" )
+            {
+                for (int i = 0; i < 100; ++i)
+                {
+                    const Point position(0.01f * i, 0.005f * i, 0.006f * i);
+                    const auto result = query.find(position, infinity);
+                    const auto tolerantResult = tolerantQuery.find(position, infinity);
+                    CAPTURE( position );
+                    REQUIRE( tolerantResult.faceId == result.faceId );
+                    REQUIRE( tolerantResult.safeRadius >= result.safeRadius + 0.00499f );
+                }
+            }
+        }
+
+        WHEN( "Moving query points finding no face by less than their safe radius" )
+        {
+            const ClosestPointQuery query(bumpyMesh);
+            const Point position(0.5f, 1.0f, 0.0f);
+            const auto result = query.find(position, 0.2f);
+            THEN( "No face is found either" )
+            {
+                REQUIRE( result.faceId == -1 );
+                REQUIRE( result.safeRadius > 0.45f );
+                REQUIRE( result.safeRadius < 0.51f );
+                const Point movedPosition = position + Float3(0.0f, -1.0f, 1.0f) *
+                                            (0.99f * result.safeRadius / std::sqrt(2.0f));
+                REQUIRE( query.find(movedPosition, 0.2f).faceId == -1 );
+            }
+        }
+
+        WHEN( "Moving query points farther than the pruning distance by less than their safe radius" )
+        {
+            QueryOptions queryOptions;
+            queryOptions.noFacePruningFactor = 4.0f;
+            const ClosestPointQuery query(bumpyMesh, BuildOptions(), queryOptions);
+            const Point position(0.5f, 2.0f, -1.0f);
+            const auto result = query.find(position, 0.1f);
+            THEN( "No face is found either, the radius stopping at the nodes pruned" )
+            {
+                REQUIRE( result.faceId == -1 );
+                REQUIRE( result.safeRadius > 0.29f );
+                REQUIRE( result.safeRadius < 2.0f );
+                const Point movedPosition = position + Float3(0.0f, -1.0f, 1.0f) *
+                                            (0.99f * result.safeRadius / std::sqrt(2.0f));
+                REQUIRE( query.find(movedPosition, 0.1f).faceId == -1 );
+            }
+        }
+    }
+}
+
+/// \brief Thin shell made of two plane meshes of R*R quads, facing away from each other.
+///
+/// Faces of the first plane come first, with the normal (0, -1, 1) of the plane
+/// mesh, and those of the second plane, offset by the thickness, face the other way.
+template<int R>
+class StubShellMesh : public StubDensePlaneMesh<R>
+{
+public:
+    static constexpr float thickness = 0.1f;
+
+    virtual std::vector<Point> getVertices() const
+    {
+        std::vector<Point> vertices = StubDensePlaneMesh<R>::getVertices();
+        const std::size_t planeVertexCount = vertices.size();
+        const Float3 offset = Float3(0.0f, 1.0f, -1.0f) * (thickness / std::sqrt(2.0f));
+        for (std::size_t v = 0; v < planeVertexCount; ++v)
+            vertices.push_back(vertices[v] + offset);
+        return vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces = StubDensePlaneMesh<R>::getFaces();
+        const std::size_t planeFaceCount = faces.size();
+        const int planeVertexCount = (R+1) * (R+1);
+        for (std::size_t f = 0; f < planeFaceCount; ++f)
+        {
+            Face face = faces[f];
+            std::reverse(face.vertexIds.begin(), face.vertexIds.end());
+            for (int &vertexId : face.vertexIds)
+                vertexId += planeVertexCount;
+            faces.push_back(face);
+        }
+        return faces;
+    }
+};
+
+SCENARIO( "Closest points on faces filtered by their normal", "[Mesh]")
+{
+    GIVEN( "A thin shell, and ClosestPointQuery objects on it per index" )
+    {
+        constexpr int resolution = 30;
+        const StubShellMesh<resolution> shellMesh;
+        const ClosestPointQuery frontQuery(StubDensePlaneMesh<resolution>{});
+        std::vector<BuildOptions> optionSets(5);
+        optionSets[1].useNormalCones = true;
+        optionSets[2].useProxyBounds = true;
+        optionSets[2].useNormalCones = true;
+        optionSets[3].indexType = IndexType::WideBvh4;
+        optionSets[4].indexType = IndexType::WideBvh8;
+        FaceFilter frontFilter;
+        frontFilter.direction = Float3(0.0f, -1.0f, 1.0f);
+
+        WHEN( "Finding the closest points on the faces oriented like the front plane" )
+        {
+            THEN( "They are the closest points on the front plane, from both sides of the shell" )
+            {
+                for (const BuildOptions &options: optionSets)
+                {
+                    const ClosestPointQuery query(shellMesh, options);
+                    for (int i = 0; i < 100; ++i)
+                    {
+                        const float x = static_cast<float>((i * 37) % 101) / 80.0f - 0.1f;
+                        const float y = static_cast<float>((i * 61) % 103) / 82.0f - 0.1f;
+                        const float offset = static_cast<float>(i % 9 - 4) * 0.1f;
+                        const Point position(x, y - offset, y + offset);
+                        const auto expected = frontQuery.find(position, infinity);
+                        const auto result = query.find(position, infinity, frontFilter);
+                        CAPTURE( position );
+                        REQUIRE( result.faceId < resolution * resolution );
+                        REQUIRE( result.point.equalsTo(expected.point, 1e-6f) );
+                        REQUIRE( result.distance == Approx(expected.distance) );
+                        REQUIRE( query.find(position, infinity, FaceFilter()).faceId ==
+                                 query.find(position, infinity).faceId );
+                    }
+                }
+            }
+        }
+
+        WHEN( "Finding them from behind the shell, with and without normal cones" )
+        {
+            std::vector<Point> positions;
+            for (int i = 0; i < 100; ++i)
+            {
+                const float x = static_cast<float>((i * 37) % 101) / 101.0f;
+                const float y = static_cast<float>((i * 61) % 103) / 103.0f;
+                positions.push_back(Point(x, y + 0.2f, y - 0.2f));
+            }
+            std::vector<ClosestPointQuery::Result> results(positions.size());
+            ClosestPointQuery::Statistics statistics;
+            const ClosestPointQuery query(shellMesh);
+            query.find(positions.data(), positions.size(), infinity, frontFilter,
+                       results.data(), statistics);
+            BuildOptions options;
+            options.useNormalCones = true;
+            std::vector<ClosestPointQuery::Result> coneResults(positions.size());
+            ClosestPointQuery::Statistics coneStatistics;
+            const ClosestPointQuery coneQuery(shellMesh, options);
+            coneQuery.find(positions.data(), positions.size(), infinity, frontFilter,
+                           coneResults.data(), coneStatistics);
+
+            THEN( "Cones skip the nodes of the back plane, finding the same faces" )
+            {
+                for (std::size_t i = 0; i < positions.size(); ++i)
+                {
+                    REQUIRE( results[i].faceId < resolution * resolution );
+                    REQUIRE( coneResults[i].faceId == results[i].faceId );
+                }
+                REQUIRE( coneStatistics.nodeCount < statistics.nodeCount );
+                REQUIRE( coneQuery.getMemoryFootprint().normalCones > 0 );
+            }
+        }
+    }
+    GIVEN( "A plane mesh, and ClosestPointQuery objects on its faces and on its limit surface" )
+    {
+        const StubDensePlaneMesh<20> mesh;
+        BuildOptions limitOptions;
+        limitOptions.surfaceType = SurfaceType::CatmullClarkLimit;
+        BuildOptions coneOptions;
+        coneOptions.useNormalCones = true;
+        const Point position(0.4f, 0.6f, 0.3f);
+        const float angle = 1.0471976f;
+        FaceFilter filter;
+        filter.direction = Float3(std::sin(angle), -std::cos(angle) / std::sqrt(2.0f),
+                                  std::cos(angle) / std::sqrt(2.0f));
+
+        WHEN( "Filtering faces by a direction 60 degrees away from their normal" )
+        {
+            THEN( "No face is found within 50 degrees of it, and the closest one within 70" )
+            {
+                for (const BuildOptions &options: { BuildOptions(), coneOptions, limitOptions })
+                {
+                    const ClosestPointQuery query(mesh, options);
+                    const auto expected = query.find(position, infinity);
+                    filter.maxAngle = 0.87266463f;
+                    REQUIRE( query.find(position, infinity, filter).faceId == -1 );
+                    filter.maxAngle = 1.22173048f;
+                    REQUIRE( query.find(position, infinity, filter).faceId == expected.faceId );
+                    filter.direction = filter.direction * -1.0f;
+                    filter.maxAngle = 1.57079633f;
+                    REQUIRE( query.find(position, infinity, filter).faceId == -1 );
+                    filter.direction = filter.direction * -1.0f;
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Closest points on groups of faces", "[Mesh]")
+{
+    GIVEN( "A plane mesh split in 3 x 3 groups of faces, and ClosestPointQuery objects on it per index" )
+    {
+        constexpr int resolution = 30;
+        const StubDensePlaneMesh<resolution> mesh;
+        std::vector<std::uint8_t> faceGroups(resolution * resolution);
+        for (int faceId = 0; faceId < resolution * resolution; ++faceId)
+            faceGroups[faceId] = static_cast<std::uint8_t>((faceId % resolution) / 10 +
+                                                           (faceId / resolution) / 10 * 3);
+        std::vector<BuildOptions> optionSets(4);
+        optionSets[1].useProxyBounds = true;
+        optionSets[2].indexType = IndexType::WideBvh4;
+        optionSets[3].indexType = IndexType::WideBvh8;
+
+        // The faces of the central group alone make a mesh of their own.
+        constexpr int group = 4;
+        MeshData groupMesh;
+        groupMesh.vertices = mesh.getVertices();
+        std::vector<int> groupFaceIds;
+        for (int faceId = 0; faceId < resolution * resolution; ++faceId)
+        {
+            if (faceGroups[faceId] != group)
+                continue;
+            groupMesh.faces.push_back(mesh.getFaces()[faceId]);
+            groupFaceIds.push_back(faceId);
+        }
+        FaceFilter groupFilter;
+        groupFilter.groupMask = std::uint64_t(1) << group;
+
+        std::vector<Point> positions;
+        for (int i = 0; i < 100; ++i)
+        {
+            const float x = static_cast<float>((i * 37) % 101) / 80.0f - 0.1f;
+            const float y = static_cast<float>((i * 61) % 103) / 82.0f - 0.1f;
+            const float offset = static_cast<float>(i % 9 - 4) * 0.1f;
+            positions.push_back(Point(x, y - offset, y + offset));
+        }
+
+        WHEN( "Finding the closest points on the faces of a group" )
+        {
+            THEN( "They are those on a mesh of the group alone, found for similar work" )
+            {
+                for (BuildOptions options: optionSets)
+                {
+                    const ClosestPointQuery groupQuery(groupMesh, options);
+                    options.faceGroups = faceGroups;
+                    const ClosestPointQuery query(mesh, options);
+                    std::vector<ClosestPointQuery::Result> results(positions.size());
+                    std::vector<ClosestPointQuery::Result> groupResults(positions.size());
+                    ClosestPointQuery::Statistics statistics;
+                    ClosestPointQuery::Statistics groupStatistics;
+                    query.find(positions.data(), positions.size(), infinity, groupFilter,
+                               results.data(), statistics);
+                    groupQuery.find(positions.data(), positions.size(), infinity, FaceFilter(),
+                                    groupResults.data(), groupStatistics);
+                    for (std::size_t i = 0; i < positions.size(); ++i)
+                    {
+                        CAPTURE( positions[i] );
+                        REQUIRE( faceGroups[results[i].faceId] == group );
+                        REQUIRE( results[i].point.equalsTo(groupResults[i].point, 1e-6f) );
+                        REQUIRE( results[i].distance == Approx(groupResults[i].distance) );
+                    }
+                    CAPTURE( static_cast<int>(options.indexType) );
+                    REQUIRE( statistics.faceCount <= 2 * groupStatistics.faceCount );
+                    REQUIRE( query.getMemoryFootprint().groups > 0 );
+                }
+            }
+        }
+
+        WHEN( "Finding them with a predicate on face ids instead" )
+        {
+            FaceFilter predicateFilter;
+            predicateFilter.predicate = [&faceGroups](int faceId)
+            {
+                return faceGroups[faceId] == group;
+            };
+
+            THEN( "The same points are found, but without pruning nodes" )
+            {
+                for (BuildOptions options: optionSets)
+                {
+                    const ClosestPointQuery predicateQuery(mesh, options);
+                    options.faceGroups = faceGroups;
+                    const ClosestPointQuery query(mesh, options);
+                    std::vector<ClosestPointQuery::Result> results(positions.size());
+                    std::vector<ClosestPointQuery::Result> predicateResults(positions.size());
+                    ClosestPointQuery::Statistics statistics;
+                    ClosestPointQuery::Statistics predicateStatistics;
+                    query.find(positions.data(), positions.size(), infinity, groupFilter,
+                               results.data(), statistics);
+                    predicateQuery.find(positions.data(), positions.size(), infinity,
+                                        predicateFilter, predicateResults.data(),
+                                        predicateStatistics);
+                    for (std::size_t i = 0; i < positions.size(); ++i)
+                        REQUIRE( predicateResults[i].faceId == results[i].faceId );
+                    CAPTURE( static_cast<int>(options.indexType) );
+                    REQUIRE( statistics.nodeCount < predicateStatistics.nodeCount );
+                }
+            }
+        }
+
+        WHEN( "Masking out all groups, or the group of all faces of an index without groups" )
+        {
+            THEN( "No face is found" )
+            {
+                BuildOptions options;
+                options.faceGroups = faceGroups;
+                const ClosestPointQuery query(mesh, options);
+                const ClosestPointQuery noGroupQuery(mesh);
+                FaceFilter filter;
+                filter.groupMask = 0;
+                REQUIRE( query.find(Point(0.5f), infinity, filter).faceId == -1 );
+                filter.groupMask = ~std::uint64_t(1);
+                REQUIRE( noGroupQuery.find(Point(0.5f), infinity, filter).faceId == -1 );
+                filter.groupMask = 1;
+                REQUIRE( noGroupQuery.find(Point(0.5f), infinity, filter).faceId ==
+                         noGroupQuery.find(Point(0.5f), infinity).faceId );
+                REQUIRE( noGroupQuery.getMemoryFootprint().groups == 0 );
+            }
+        }
+
+        WHEN( "Finding the closest points on the limit surface patches of a group" )
+        {
+            THEN( "They lie on the patches of the group" )
+            {
+                BuildOptions options;
+                options.surfaceType = SurfaceType::CatmullClarkLimit;
+                options.faceGroups = faceGroups;
+                const ClosestPointQuery query(mesh, options);
+                for (const Point &position: positions)
+                {
+                    const auto result = query.find(position, infinity, groupFilter);
+                    CAPTURE( position );
+                    REQUIRE( result.faceId >= 0 );
+                    REQUIRE( faceGroups[result.faceId] == group );
+                }
+            }
+        }
+
+        WHEN( "Building an index with invalid groups" )
+        {
+            THEN( "An exception is thrown" )
+            {
+                BuildOptions options;
+                options.faceGroups = faceGroups;
+                options.faceGroups.pop_back();
+                REQUIRE_THROWS_AS( ClosestPointQuery(mesh, options), std::invalid_argument );
+                options.faceGroups = faceGroups;
+                options.faceGroups[0] = 64;
+                REQUIRE_THROWS_AS( ClosestPointQuery(mesh, options), std::invalid_argument );
+            }
+        }
+    }
+}
+
+SCENARIO( "Closest points on the limit surface of a plane cage", "[Mesh]")
+{
+    GIVEN( "Plane meshes, and ClosestPointQuery objects on their faces and on their limit surfaces" )
+    {
+        const StubDensePlaneMesh<4> smallMesh;
+        const StubDensePlaneMesh<20> mesh;
+
+        WHEN( "Finding the closest points from positions around the meshes" )
+        {
+            THEN( "The limit surface of a uniform plane cage is the plane itself" )
+            {
+                for (const Mesh *planeMesh: { static_cast<const Mesh *>(&smallMesh),
+                                              static_cast<const Mesh *>(&mesh) })
+                {
+                    const ClosestPointQuery cageQuery(*planeMesh);
+                    for (const IndexType indexType : { IndexType::Octree, IndexType::WideBvh4,
+                                                       IndexType::WideBvh8 })
+                    {
+                        BuildOptions options;
+                        options.indexType = indexType;
+                        options.surfaceType = SurfaceType::CatmullClarkLimit;
+                        const ClosestPointQuery query(*planeMesh, options);
+                        for (int i = 0; i < 50; ++i)
+                        {
+                            const float x = static_cast<float>((i * 37) % 101) / 80.0f - 0.1f;
+                            const float y = static_cast<float>((i * 61) % 103) / 82.0f - 0.1f;
+                            const float offset = static_cast<float>(i % 5 - 2) * 0.05f;
+                            const Point position(x, y - offset, y + offset);
+                            const auto expected = cageQuery.find(position, infinity);
+                            const auto result = query.find(position, infinity);
+                            CAPTURE( position );
+                            REQUIRE( std::abs(result.distance - expected.distance) < 1e-5f );
+                            REQUIRE( result.point.equalsTo(expected.point, 1e-4f) );
+                        }
+                    }
+                }
+            }
+        }
+
+        WHEN( "Building a query on the limit surface with a tolerance not positive" )
+        {
+            BuildOptions options;
+            options.surfaceType = SurfaceType::CatmullClarkLimit;
+            options.limitSurfaceTolerance = 0.0f;
+
+            THEN( "An exception is thrown" )
+            {
+                REQUIRE_THROWS_AS( ClosestPointQuery(mesh, options), std::invalid_argument );
+            }
+        }
+    }
+}
+
 SCENARIO( "Dense plane mesh with lots of queries", "[.MeshBenchmark]")
 {
     GIVEN( "A plane mesh with 4 quad faces and a ClosestPointQuery on it" )
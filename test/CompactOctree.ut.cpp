@@ -0,0 +1,105 @@
+#include <../src/CompactOctree.h>
+#include <catch.hpp>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for cpom::CompactOctree.
+
+/// Return true if a point is inside an Axis-Aligned Bounding Cube.
+bool intersect(const AABCube &cube, const Point &point)
+{
+    const auto distances( (cube.center-point).abs() );
+    return (distances.x <= cube.halfWidth &&
+            distances.y <= cube.halfWidth &&
+            distances.z <= cube.halfWidth);
+}
+
+/// Identity conversion of leaf elements when flattening.
+void convert(const std::vector<Point> &points, std::vector<Point> &output)
+{
+    output.insert(output.end(), points.begin(), points.end());
+}
+
+SCENARIO( "Compact octree", "[Octree]" )
+{
+    using Node = OctreeNode<Point>;
+    using CompactTree = CompactOctree<Point>;
+
+    GIVEN( "A root node holding a single point" )
+    {
+        const AABCube bounds{ Point(0.0f), 0.5f };
+        Node rootNode;
+        rootNode.insert( Point(0.25f), bounds, intersect );
+
+        WHEN( "Flattening it" )
+        {
+            const CompactTree tree(rootNode, bounds, convert);
+
+            THEN( "The tree has a single leaf holding the point" )
+            {
+                REQUIRE( tree.getNodes().size() == 1 );
+                REQUIRE( tree.getNode(0).isLeaf() );
+                REQUIRE( tree.getNode(0).getElementCount() == 1 );
+                REQUIRE( tree.getElement(tree.getNode(0).getFirstElement()) == Point(0.25f) );
+            }
+            THEN( "The root bounds are kept" )
+            {
+                REQUIRE( tree.getBounds().center == bounds.center );
+                REQUIRE( tree.getBounds().halfWidth == bounds.halfWidth );
+            }
+        }
+    }
+
+    GIVEN( "A root node with a point in each corner" )
+    {
+        const AABCube bounds{ Point(0.0f), 2.0f };
+        Node rootNode;
+        Point points[8] = { {-1, -1, -1},
+                            {+1, -1, -1},
+                            {-1, +1, -1},
+                            {+1, +1, -1},
+                            {-1, -1, +1},
+                            {+1, -1, +1},
+                            {-1, +1, +1},
+                            {+1, +1, +1} };
+        constexpr int maxDepth = 10;
+        constexpr float maxFill = 1.0;
+        for (auto &point: points)
+        {
+            rootNode.insert(point, bounds, intersect, maxDepth, maxFill);
+        }
+
+        WHEN( "Flattening it" )
+        {
+            const CompactTree tree(rootNode, bounds, convert);
+            const auto &root = tree.getNode(0);
+
+            THEN( "The root has 8 contiguous leaf children" )
+            {
+                REQUIRE( !root.isLeaf() );
+                REQUIRE( root.getChildMask() == 0xFFu );
+                REQUIRE( tree.getNodes().size() == 9 );
+                REQUIRE( tree.getElements().size() == 8 );
+                for (std::uint32_t i = 0; i < 8; ++i)
+                {
+                    REQUIRE( tree.getNode(root.getFirstChild() + i).isLeaf() );
+                }
+            }
+            THEN( "Each child holds the point at the center of its derived bounds" )
+            {
+                for (int i = 0; i < 8; ++i)
+                {
+                    const auto &child = tree.getNode(root.getFirstChild() + i);
+                    const AABCube childBounds = Node::getChildBounds(tree.getBounds(), i);
+                    REQUIRE( child.getElementCount() == 1 );
+                    REQUIRE( tree.getElement(child.getFirstElement()).equalsTo(childBounds.center) );
+                }
+            }
+        }
+    }
+}
+
+} // anonymous namespace
@@ -0,0 +1,261 @@
+#include <IndexLayout.h>
+#include <MeshIndex.h>
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for cpom::MeshIndex::getLayout() and cpom::writeLeafBoxes().
+
+/// Plane of R*R quads, enough for the index to partition space if R > 5.
+template<int R>
+class StubGridMesh : public Mesh
+{
+public:
+    virtual std::vector<Point> getVertices() const
+    {
+        std::vector<Point> vertices;
+        for (int y = 0; y <= R; ++y)
+            for (int x = 0; x <= R; ++x)
+                vertices.push_back(Point(static_cast<float>(x), static_cast<float>(y), 0.0f));
+        return vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces;
+        for (int y = 0; y < R; ++y)
+        {
+            for (int x = 0; x < R; ++x)
+            {
+                const int v = x + y * (R+1);
+                faces.push_back({ { v, v + 1, v + R + 2, v + R + 1 } });
+            }
+        }
+        return faces;
+    }
+};
+
+/// Return the number of faces stored by all the leaves of a layout.
+std::size_t countStoredFaces(const IndexLayout &layout)
+{
+    std::size_t count = 0;
+    for (const IndexLeaf &leaf : layout.leaves)
+        count += leaf.faceCount;
+    return count;
+}
+
+SCENARIO( "Layout of indices", "[IndexLayout]" )
+{
+    GIVEN( "A plane mesh of 400 quads indexed by an octree" )
+    {
+        const MeshIndex index(StubGridMesh<20>{});
+        const IndexLayout layout = index.getLayout();
+
+        THEN( "Each face is stored by at least one leaf, and leaves are cells of the root cube" )
+        {
+            REQUIRE( layout.maxDepth > 0 );
+            REQUIRE( layout.levelNodeCounts.size() > 1 );
+            REQUIRE( layout.levelNodeCounts[0] == 1 );
+            REQUIRE( layout.faceLeafCounts.size() == 400 );
+            REQUIRE( *std::min_element(layout.faceLeafCounts.begin(),
+                                       layout.faceLeafCounts.end()) >= 1 );
+            REQUIRE( std::accumulate(layout.faceLeafCounts.begin(), layout.faceLeafCounts.end(),
+                                     std::size_t(0)) == countStoredFaces(layout) );
+            REQUIRE( layout.leaves.size() <
+                     std::accumulate(layout.levelNodeCounts.begin(),
+                                     layout.levelNodeCounts.end(), std::size_t(0)) );
+            const IndexLeaf &firstLeaf = layout.leaves.front();
+            const float rootWidth = (firstLeaf.max.x - firstLeaf.min.x) * (1 << firstLeaf.depth);
+            REQUIRE( rootWidth >= 20.0f );
+            for (const IndexLeaf &leaf : layout.leaves)
+            {
+                REQUIRE( leaf.depth > 0 );
+                REQUIRE( leaf.depth <= layout.maxDepth );
+                REQUIRE( leaf.meshletCount >= 1 );
+                const Float3 size = leaf.max - leaf.min;
+                REQUIRE( size.x * (1 << leaf.depth) == Approx(rootWidth) );
+                REQUIRE( size.x == size.y );
+                REQUIRE( size.x == size.z );
+            }
+        }
+    }
+    GIVEN( "A plane mesh of 400 quads indexed by a hierarchy" )
+    {
+        BuildOptions options;
+        options.indexType = IndexType::WideBvh4;
+        const MeshIndex index(StubGridMesh<20>{}, options);
+        const IndexLayout layout = index.getLayout();
+
+        THEN( "Each face is stored by exactly one leaf, of at most 4 faces" )
+        {
+            REQUIRE( layout.maxDepth == 0 );
+            REQUIRE( layout.levelNodeCounts[0] == 1 );
+            REQUIRE( layout.faceLeafCounts == std::vector<std::uint32_t>(400, 1) );
+            REQUIRE( countStoredFaces(layout) == 400 );
+            for (const IndexLeaf &leaf : layout.leaves)
+            {
+                REQUIRE( leaf.depth > 0 );
+                REQUIRE( leaf.faceCount >= 1 );
+                REQUIRE( leaf.faceCount <= 4 );
+                REQUIRE( leaf.meshletCount == 1 );
+                REQUIRE( leaf.max.x - leaf.min.x >= 1.0f );
+                REQUIRE( leaf.max.y - leaf.min.y >= 1.0f );
+                REQUIRE( leaf.max.z == leaf.min.z );
+            }
+        }
+    }
+    GIVEN( "A plane mesh of 16 quads, processed without index" )
+    {
+        const MeshIndex index(StubGridMesh<4>{});
+        const IndexLayout layout = index.getLayout();
+
+        THEN( "The layout has no node and no leaf" )
+        {
+            REQUIRE( layout.levelNodeCounts.empty() );
+            REQUIRE( layout.leaves.empty() );
+            REQUIRE( layout.faceLeafCounts == std::vector<std::uint32_t>(16, 0) );
+        }
+    }
+}
+
+/// Fan of N triangles around a vertex, all of them meeting in every cell around it.
+template<int N>
+class StubFanMesh : public Mesh
+{
+public:
+    virtual std::vector<Point> getVertices() const
+    {
+        std::vector<Point> vertices(1, Point(0.0f));
+        for (int i = 0; i < N; ++i)
+        {
+            const float angle = 6.2831853f * static_cast<float>(i) / N;
+            vertices.push_back(Point(std::cos(angle), std::sin(angle), 0.0f));
+        }
+        return vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces;
+        for (int i = 0; i < N; ++i)
+            faces.push_back({ { 0, 1 + i, 1 + (i + 1) % N } });
+        return faces;
+    }
+};
+
+/// Return the depth of the deepest leaf of a layout.
+unsigned getDeepestLeaf(const IndexLayout &layout)
+{
+    unsigned depth = 0;
+    for (const IndexLeaf &leaf : layout.leaves)
+        depth = std::max(depth, leaf.depth);
+    return depth;
+}
+
+SCENARIO( "Subdivision of octrees", "[IndexLayout]" )
+{
+    GIVEN( "A fan of 64 triangles around a vertex" )
+    {
+        const StubFanMesh<64> mesh;
+        BuildOptions options;
+
+        WHEN( "Indexing it by filling cells" )
+        {
+            options.octreeSubdivision = OctreeSubdivision::Fill;
+            const IndexLayout layout = MeshIndex(mesh, options).getLayout();
+            THEN( "Cells around the vertex are split down to the maximal depth" )
+            {
+                REQUIRE( getDeepestLeaf(layout) == layout.maxDepth );
+            }
+        }
+        WHEN( "Indexing it by a cost model" )
+        {
+            options.octreeSubdivision = OctreeSubdivision::SurfaceAreaCost;
+            const IndexLayout layout = MeshIndex(mesh, options).getLayout();
+            THEN( "Cells whose faces all meet at the vertex are kept as leaves" )
+            {
+                REQUIRE( getDeepestLeaf(layout) < 4 );
+                REQUIRE( countStoredFaces(layout) < 4 * 64 );
+            }
+        }
+    }
+    GIVEN( "A plane mesh of 400 quads" )
+    {
+        const StubGridMesh<20> mesh;
+
+        WHEN( "Indexing it with a low maximal depth, but in a corner region" )
+        {
+            BuildOptions options;
+            options.octreeSubdivision = OctreeSubdivision::Fill;
+            options.maxOctreeDepth = 2;
+            options.octreeDepthLimits.push_back({ Point(0.0f), Point(2.0f), 5 });
+            const IndexLayout layout = MeshIndex(mesh, options).getLayout();
+            THEN( "Only leaves in the cell of depth 2 overlapping the region are deeper than the maximal depth" )
+            {
+                REQUIRE( layout.maxDepth == 5 );
+                REQUIRE( getDeepestLeaf(layout) > 2 );
+                for (const IndexLeaf &leaf : layout.leaves)
+                {
+                    const bool isInRegionCell = leaf.min.x < 5.0f && leaf.min.y < 5.0f;
+                    CAPTURE( leaf.min );
+                    CAPTURE( leaf.depth );
+                    REQUIRE( leaf.depth <= (isInRegionCell ? 5u : 2u) );
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Export of leaf boxes", "[IndexLayout]" )
+{
+    GIVEN( "A layout of two leaves" )
+    {
+        IndexLayout layout;
+        layout.leaves.push_back(IndexLeaf{ Point(0.0f), Point(1.0f), 1, 3, 1 });
+        layout.leaves.push_back(IndexLeaf{ Point(1.0f), Point(2.0f), 1, 5, 1 });
+
+        WHEN( "Writing their boxes" )
+        {
+            std::ostringstream stream;
+            writeLeafBoxes(stream, layout);
+
+            THEN( "Each box is a group of 8 vertices and 6 quads" )
+            {
+                std::istringstream lines(stream.str());
+                std::string line;
+                std::vector<std::string> groups;
+                int vertexCount = 0;
+                int faceCount = 0;
+                std::string lastFace;
+                while (std::getline(lines, line))
+                {
+                    if (line.compare(0, 2, "g ") == 0)
+                        groups.push_back(line);
+                    else if (line.compare(0, 2, "v ") == 0)
+                        ++vertexCount;
+                    else if (line.compare(0, 2, "f ") == 0)
+                    {
+                        ++faceCount;
+                        lastFace = line;
+                    }
+                }
+                REQUIRE( groups == std::vector<std::string>({ "g leaf0", "g leaf1" }) );
+                REQUIRE( vertexCount == 16 );
+                REQUIRE( faceCount == 12 );
+                REQUIRE( lastFace == "f 10 12 16 14" );
+            }
+        }
+    }
+}
+
+} // anonymous namespace
@@ -0,0 +1,92 @@
+#include <../src/LocalityReorder.h>
+#include <catch.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for cpom::reorderForLocality.
+
+SCENARIO( "Morton codes", "[Reorder]" )
+{
+    GIVEN( "The unit cube extent" )
+    {
+        const Point lower(0.0f);
+        const Point upper(1.0f);
+
+        THEN( "Corners have the lowest and highest codes" )
+        {
+            REQUIRE( computeMortonCode(lower, lower, upper) == 0u );
+            REQUIRE( computeMortonCode(upper, lower, upper) == (1u << 30) - 1 );
+        }
+        THEN( "Bits of x, y and z are interleaved in this order" )
+        {
+            REQUIRE( computeMortonCode(Point(1.0f, 0.0f, 0.0f), lower, upper) == 0x09249249u );
+            REQUIRE( computeMortonCode(Point(0.0f, 1.0f, 0.0f), lower, upper) == 0x09249249u << 1 );
+            REQUIRE( computeMortonCode(Point(0.0f, 0.0f, 1.0f), lower, upper) == 0x09249249u << 2 );
+        }
+    }
+}
+
+SCENARIO( "Locality reorder", "[Reorder]" )
+{
+    GIVEN( "A row of triangles in reverse spatial order and an unused vertex" )
+    {
+        constexpr int triangleCount = 16;
+        std::vector<Point> vertices;
+        std::vector<Face> faces;
+        vertices.push_back(Point(-1.0f));
+        for (int i = 0; i < triangleCount; ++i)
+        {
+            const float x = static_cast<float>(triangleCount - 1 - i);
+            const int first = static_cast<int>(vertices.size());
+            vertices.push_back(Point(x, 0.0f, 0.0f));
+            vertices.push_back(Point(x + 0.5f, 0.0f, 0.0f));
+            vertices.push_back(Point(x, 0.5f, 0.0f));
+            faces.push_back({ { first, first+1, first+2 } });
+        }
+        const std::vector<Point> originalVertices(vertices);
+        const std::vector<Face> originalFaces(faces);
+
+        WHEN( "Reordering them" )
+        {
+            const auto faceIds = reorderForLocality(faces, vertices);
+
+            THEN( "Face ids are a permutation of the original face indices" )
+            {
+                REQUIRE( faceIds.size() == originalFaces.size() );
+                std::vector<std::uint32_t> sortedIds(faceIds.begin(), faceIds.end());
+                std::sort(sortedIds.begin(), sortedIds.end());
+                for (std::uint32_t i = 0; i < sortedIds.size(); ++i)
+                    REQUIRE( sortedIds[i] == i );
+            }
+            THEN( "Faces keep their geometry" )
+            {
+                REQUIRE( vertices.size() == originalVertices.size() );
+                for (std::size_t i = 0; i < faces.size(); ++i)
+                {
+                    const Face &originalFace = originalFaces[faceIds[i]];
+                    REQUIRE( faces[i].vertexIds.size() == originalFace.vertexIds.size() );
+                    for (std::size_t v = 0; v < faces[i].vertexIds.size(); ++v)
+                        REQUIRE( vertices[faces[i].vertexIds[v]] ==
+                                 originalVertices[originalFace.vertexIds[v]] );
+                }
+            }
+            THEN( "Faces are sorted along the curve and vertices by first use" )
+            {
+                for (std::size_t i = 0; i < faces.size(); ++i)
+                {
+                    REQUIRE( faceIds[i] == triangleCount - 1 - i );
+                    REQUIRE( faces[i].vertexIds[0] == static_cast<int>(3 * i) );
+                }
+                REQUIRE( vertices.back() == Point(-1.0f) );
+            }
+        }
+    }
+}
+
+} // anonymous namespace
@@ -0,0 +1,223 @@
+#include <MemoryResource.h>
+#include <catch.hpp>
+
+#include <cstdint>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for the memory resources and cpom::PolymorphicAllocator.
+
+/// MemoryResource counting the blocks allocated from the default resource.
+class CountingResource : public MemoryResource
+{
+public:
+    virtual void *allocate(std::size_t bytes, std::size_t alignment)
+    {
+        ++allocationCount;
+        return getDefaultMemoryResource().allocate(bytes, alignment);
+    }
+
+    virtual void deallocate(void *p, std::size_t bytes, std::size_t alignment)
+    {
+        ++deallocationCount;
+        getDefaultMemoryResource().deallocate(p, bytes, alignment);
+    }
+
+    int allocationCount = 0;
+    int deallocationCount = 0;
+};
+
+SCENARIO( "Monotonic buffer", "[Memory]" )
+{
+    GIVEN( "A MonotonicBuffer drawing chunks from a counting resource" )
+    {
+        CountingResource upstream;
+        MonotonicBuffer buffer(upstream, 1024);
+
+        WHEN( "Allocating many small blocks with various alignments" )
+        {
+            bool isAligned = true;
+            for (int i = 0; i < 1000; ++i)
+            {
+                const std::size_t alignment = std::size_t(1) << (i % 5);
+                const auto address = reinterpret_cast<std::uintptr_t>(buffer.allocate(3, alignment));
+                isAligned &= address % alignment == 0;
+            }
+
+            THEN( "Blocks are aligned" )
+            {
+                REQUIRE( isAligned );
+            }
+            THEN( "Few chunks are allocated from upstream" )
+            {
+                REQUIRE( upstream.allocationCount == static_cast<int>(buffer.getChunkCount()) );
+                REQUIRE( buffer.getChunkCount() <= 5 );
+            }
+            THEN( "Releasing the buffer returns all chunks upstream" )
+            {
+                buffer.release();
+                REQUIRE( buffer.getChunkCount() == 0 );
+                REQUIRE( upstream.deallocationCount == upstream.allocationCount );
+            }
+        }
+
+        WHEN( "Allocating a block larger than a chunk" )
+        {
+            void *p = buffer.allocate(10000, 8);
+
+            THEN( "A chunk large enough is allocated" )
+            {
+                REQUIRE( p != nullptr );
+                REQUIRE( upstream.allocationCount == 1 );
+            }
+        }
+    }
+
+    GIVEN( "A MonotonicBuffer starting with a buffer on the stack" )
+    {
+        CountingResource upstream;
+        alignas(std::max_align_t) char stackBuffer[256];
+        MonotonicBuffer buffer(stackBuffer, sizeof(stackBuffer), upstream);
+
+        WHEN( "Allocating blocks fitting in the buffer" )
+        {
+            void *p = buffer.allocate(200, 8);
+
+            THEN( "Nothing is allocated from upstream" )
+            {
+                REQUIRE( p == static_cast<void *>(stackBuffer) );
+                REQUIRE( upstream.allocationCount == 0 );
+            }
+        }
+
+        WHEN( "Allocating blocks exceeding the buffer" )
+        {
+            buffer.allocate(200, 8);
+            void *p = buffer.allocate(200, 8);
+
+            THEN( "A chunk is allocated from upstream" )
+            {
+                REQUIRE( p != nullptr );
+                REQUIRE( upstream.allocationCount == 1 );
+            }
+        }
+    }
+}
+
+SCENARIO( "Pool resource", "[Memory]" )
+{
+    GIVEN( "A PoolResource drawing from a counting resource" )
+    {
+        CountingResource upstream;
+        PoolResource pool(upstream);
+
+        WHEN( "Deallocating a small block and allocating one of the same size class" )
+        {
+            void *p = pool.allocate(24, 8);
+            pool.deallocate(p, 24, 8);
+            void *q = pool.allocate(32, 8);
+
+            THEN( "The block is reused" )
+            {
+                REQUIRE( q == p );
+                REQUIRE( upstream.allocationCount == 1 );
+            }
+        }
+
+        WHEN( "Allocating many small blocks" )
+        {
+            bool isAligned = true;
+            for (int i = 0; i < 1000; ++i)
+            {
+                const auto address = reinterpret_cast<std::uintptr_t>(pool.allocate(16, 16));
+                isAligned &= address % 16 == 0;
+            }
+
+            THEN( "They are carved from a few slabs" )
+            {
+                REQUIRE( isAligned );
+                REQUIRE( upstream.allocationCount == 1 );
+            }
+            THEN( "Releasing the pool returns all slabs upstream" )
+            {
+                pool.release();
+                REQUIRE( upstream.deallocationCount == upstream.allocationCount );
+            }
+        }
+
+        WHEN( "Allocating and deallocating a large block" )
+        {
+            void *p = pool.allocate(PoolResource::maxPooledBlockSize + 1, 8);
+            pool.deallocate(p, PoolResource::maxPooledBlockSize + 1, 8);
+
+            THEN( "It is passed to the upstream resource" )
+            {
+                REQUIRE( upstream.allocationCount == 1 );
+                REQUIRE( upstream.deallocationCount == 1 );
+            }
+        }
+    }
+}
+
+SCENARIO( "Huge page resource", "[Memory]" )
+{
+    GIVEN( "The huge page memory resource" )
+    {
+        MemoryResource &resource = getHugePageMemoryResource();
+
+        WHEN( "Allocating a large block" )
+        {
+            constexpr std::size_t size = 3 * 1024 * 1024;
+            char *p = static_cast<char *>(resource.allocate(size, 64));
+
+            THEN( "The whole block is writable" )
+            {
+                REQUIRE( p != nullptr );
+                REQUIRE( reinterpret_cast<std::uintptr_t>(p) % 64 == 0 );
+                p[0] = 1;
+                p[size-1] = 1;
+                REQUIRE( p[0] + p[size-1] == 2 );
+            }
+            resource.deallocate(p, size, 64);
+        }
+
+        WHEN( "Allocating a small block" )
+        {
+            void *p = resource.allocate(100, 8);
+
+            THEN( "It is allocated" )
+            {
+                REQUIRE( p != nullptr );
+            }
+            resource.deallocate(p, 100, 8);
+        }
+    }
+}
+
+SCENARIO( "Polymorphic allocator", "[Memory]" )
+{
+    GIVEN( "A vector using a counting resource" )
+    {
+        CountingResource resource;
+        std::vector<int, PolymorphicAllocator<int>> values{PolymorphicAllocator<int>(resource)};
+
+        WHEN( "Growing and destroying it" )
+        {
+            for (int i = 0; i < 100; ++i)
+                values.push_back(i);
+            values = std::vector<int, PolymorphicAllocator<int>>{PolymorphicAllocator<int>(resource)};
+
+            THEN( "All memory is allocated from and returned to the resource" )
+            {
+                REQUIRE( resource.allocationCount > 0 );
+                REQUIRE( resource.deallocationCount == resource.allocationCount );
+            }
+        }
+    }
+}
+
+} // anonymous namespace
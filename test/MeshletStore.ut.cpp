@@ -0,0 +1,197 @@
+#include <../src/MeshletStore.h>
+#include <catch.hpp>
+
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for cpom::MeshletStore and cpom::MeshletBuilder.
+
+SCENARIO( "Meshlets", "[Meshlet]" )
+{
+    GIVEN( "Two adjacent triangles, a quad and a pentagon" )
+    {
+        const std::vector<Point> vertices = { Point(0.0f, 0.0f, 0.0f),
+                                              Point(1.0f, 0.0f, 0.0f),
+                                              Point(0.0f, 1.0f, 0.0f),
+                                              Point(1.0f, 1.0f, 0.0f),
+                                              Point(2.0f, 0.0f, 0.0f),
+                                              Point(2.0f, 1.0f, 0.0f) };
+        const std::vector<Face> faces = { { { 0, 1, 2 } },
+                                          { { 1, 3, 2 } },
+                                          { { 1, 4, 5, 3 } },
+                                          { { 0, 1, 4, 5, 3 } } };
+        MeshletStore store;
+        MeshletBuilder builder(faces, vertices, store);
+
+        WHEN( "Adding the two triangles" )
+        {
+            const auto range = builder.add({ 0, 1 });
+            builder.finish();
+
+            THEN( "A single meshlet holds them, sharing vertices" )
+            {
+                REQUIRE( range.first == 0 );
+                REQUIRE( range.second == 1 );
+                const Meshlet &meshlet = store.getMeshlet(0);
+                REQUIRE( meshlet.faceCount == 2 );
+                REQUIRE( meshlet.vertexCount == 4 );
+            }
+            THEN( "Faces are triangles referencing the copied vertices" )
+            {
+                const Meshlet &meshlet = store.getMeshlet(0);
+                const Point *meshletVertices = store.getVertices(meshlet);
+                const MeshletFace *meshletFaces = store.getFaces(meshlet);
+                for (int f = 0; f < 2; ++f)
+                {
+                    REQUIRE( meshletFaces[f].isTriangle() );
+                    REQUIRE( !meshletFaces[f].isUnsupported() );
+                    for (int v = 0; v < 3; ++v)
+                    {
+                        const int vertexId = faces[f].vertexIds[v];
+                        REQUIRE( meshletVertices[meshletFaces[f].vertices[v]] == vertices[vertexId] );
+                    }
+                }
+            }
+        }
+
+        WHEN( "Adding the quad and the pentagon after the triangles" )
+        {
+            builder.add({ 0, 1 });
+            const auto range = builder.add({ 2, 3 });
+            builder.finish();
+
+            THEN( "A new meshlet holds them" )
+            {
+                REQUIRE( range.first == 1 );
+                REQUIRE( range.second == 2 );
+                REQUIRE( store.getMeshlet(1).faceCount == 2 );
+                REQUIRE( store.getMeshlet(1).vertexCount == 4 );
+            }
+            THEN( "The quad is a supported face and the pentagon is not" )
+            {
+                const MeshletFace *meshletFaces = store.getFaces(store.getMeshlet(1));
+                REQUIRE( !meshletFaces[0].isTriangle() );
+                REQUIRE( !meshletFaces[0].isUnsupported() );
+                REQUIRE( meshletFaces[1].isUnsupported() );
+            }
+        }
+
+        WHEN( "Adding them with groups" )
+        {
+            const std::vector<std::uint8_t> faceGroups = { 3, 0, 3, 63 };
+            MeshletStore groupStore;
+            MeshletBuilder groupBuilder(faces, vertices, groupStore, nullptr,
+                                        getDefaultMemoryResource(), -1.0f, faceGroups.data());
+            groupBuilder.add({ 0, 1 });
+            groupBuilder.add({ 2, 3 });
+            groupBuilder.finish();
+
+            THEN( "Faces keep their group, and meshlets the mask of the groups of their faces" )
+            {
+                const std::uint8_t *groups = groupStore.getFaceGroups(groupStore.getMeshlet(1));
+                REQUIRE( groups[0] == 3 );
+                REQUIRE( groups[1] == 63 );
+                REQUIRE( groupStore.getGroupMask(0) == 9u );
+                REQUIRE( groupStore.getGroupMask(1) == ((std::uint64_t(1) << 63) | 8u) );
+                REQUIRE( groupStore.getGroupBytes() > 0 );
+            }
+            THEN( "Meshlets built without groups have no face group, and group 0" )
+            {
+                builder.add({ 0, 1 });
+                builder.finish();
+                REQUIRE( store.getFaceGroups(store.getMeshlet(0)) == nullptr );
+                REQUIRE( store.getGroupMask(0) == 1u );
+                REQUIRE( store.getGroupBytes() == 0 );
+            }
+        }
+    }
+
+    GIVEN( "A planar quad, a non-planar quad and a non-convex quad" )
+    {
+        const std::vector<Point> vertices = { Point(0.0f, 0.0f, 0.0f),
+                                              Point(1.0f, 0.0f, 0.0f),
+                                              Point(1.0f, 1.0f, 0.0f),
+                                              Point(0.0f, 1.0f, 0.0f),
+                                              Point(1.0f, 1.0f, 0.5f),
+                                              Point(0.2f, 0.2f, 0.0f) };
+        const std::vector<Face> faces = { { { 0, 1, 2, 3 } },
+                                          { { 0, 1, 4, 3 } },
+                                          { { 0, 1, 5, 3 } } };
+        MeshletStore store;
+        MeshletBuilder builder(faces, vertices, store, nullptr,
+                               getDefaultMemoryResource(), 1e-5f);
+
+        WHEN( "Adding each quad to its own meshlet" )
+        {
+            for (std::uint32_t i = 0; i < 3; ++i)
+                builder.add({ i });
+            builder.finish();
+
+            THEN( "Only the meshlet of the planar convex quad has planar quads" )
+            {
+                REQUIRE( store.getMeshlet(0).hasPlanarQuads );
+                REQUIRE( !store.getMeshlet(1).hasPlanarQuads );
+                REQUIRE( !store.getMeshlet(2).hasPlanarQuads );
+            }
+        }
+
+        WHEN( "Adding all quads to a meshlet built without tolerance" )
+        {
+            MeshletStore otherStore;
+            MeshletBuilder otherBuilder(faces, vertices, otherStore);
+            const auto range = otherBuilder.add({ 0, 1, 2 });
+            otherBuilder.finish();
+
+            THEN( "The meshlet has no planar quads" )
+            {
+                REQUIRE( range.first == 0 );
+                REQUIRE( range.second == 1 );
+                REQUIRE( otherStore.getMeshlet(0).faceCount == 3 );
+                REQUIRE( !otherStore.getMeshlet(0).hasPlanarQuads );
+            }
+        }
+    }
+
+    GIVEN( "A strip of triangles using more vertices than a meshlet can hold" )
+    {
+        constexpr int triangleCount = 1000;
+        std::vector<Point> vertices;
+        std::vector<Face> faces;
+        std::vector<std::uint32_t> faceIndices;
+        for (int i = 0; i < triangleCount + 2; ++i)
+        {
+            vertices.push_back(Point(0.5f * i, static_cast<float>(i % 2), 0.0f));
+        }
+        for (int i = 0; i < triangleCount; ++i)
+        {
+            faces.push_back({ { i, i+1, i+2 } });
+            faceIndices.push_back(i);
+        }
+        MeshletStore store;
+        MeshletBuilder builder(faces, vertices, store);
+
+        WHEN( "Adding all triangles" )
+        {
+            const auto range = builder.add(faceIndices);
+            builder.finish();
+
+            THEN( "They are split in meshlets of at most 255 vertices" )
+            {
+                REQUIRE( range.second - range.first > 1 );
+                int faceCount = 0;
+                for (std::uint32_t i = range.first; i < range.second; ++i)
+                {
+                    REQUIRE( store.getMeshlet(i).vertexCount <= MeshletStore::maxVertices );
+                    faceCount += store.getMeshlet(i).faceCount;
+                }
+                REQUIRE( faceCount == triangleCount );
+            }
+        }
+    }
+}
+
+} // anonymous namespace
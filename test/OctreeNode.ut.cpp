@@ -1,7 +1,9 @@
 #include <../src/OctreeNode.h>
 #include <catch.hpp>
 
+#include <bitset>
 #include <limits>
+#include <vector>
 
 using namespace cpom;
 
@@ -21,14 +23,13 @@ bool intersect(const AABCube &cube, const Point &point)
 
 SCENARIO( "Basic octree", "[Octree]" )
 {
-    GIVEN( "Some bounds" )
+    GIVEN( "Nothing" )
     {
-        const AABCube bounds{ Point(0.0f), 0.5f };
         WHEN( "Constructing an OctreeNode" )
         {
             THEN( "No exception is thrown" )
             {
-                REQUIRE_NOTHROW( new OctreeNode<int>(bounds) );
+                REQUIRE_NOTHROW( new OctreeNode<int>() );
             }
         }
     }
@@ -37,17 +38,21 @@ SCENARIO( "Basic octree", "[Octree]" )
     {
         using Node = OctreeNode<Point>;
         const AABCube bounds{ Point(0.0f), 0.5f };
-        Node rootNode(bounds);
+        Node rootNode;
 
         Point point(0.0f);
 
         WHEN ("The point is inserted 1 time")
         {
-            rootNode.insert( point, intersect );
+            rootNode.insert( point, bounds, intersect );
             THEN ("The root node is a leaf")
             {
                 REQUIRE(rootNode.isLeaf());
             }
+            THEN ("The root node has no child")
+            {
+                REQUIRE(rootNode.getChildMask() == 0u);
+            }
             AND_WHEN ( "Visiting the children of the root node" )
             {
                 bool visitedNode = false;
@@ -80,7 +85,7 @@ SCENARIO( "Basic octree", "[Octree]" )
             constexpr float maxFill = 0.0;
             for (int i = 0; i < 10; ++i)
             {
-                rootNode.insert(point, intersect, maxDepth,  maxFill);
+                rootNode.insert(point, bounds, intersect, maxDepth,  maxFill);
             }
             THEN ("The root node is a leaf")
             {
@@ -93,7 +98,7 @@ SCENARIO( "Basic octree", "[Octree]" )
             constexpr float maxFill = 3.0;
             for (int i = 0; i < 20; ++i)
             {
-                rootNode.insert( point, intersect, maxDepth,  maxFill);
+                rootNode.insert( point, bounds, intersect, maxDepth,  maxFill);
             }
             THEN ("The root node is not a leaf")
             {
@@ -153,7 +158,7 @@ SCENARIO( "Basic octree", "[Octree]" )
     {
         using Node = OctreeNode<Point>;
         const AABCube bounds{ Point(0.0f), 2.0f };
-        Node rootNode(bounds);
+        Node rootNode;
 
         WHEN ("A point is inserted in each corner with maxFill=1")
         {
@@ -169,7 +174,7 @@ SCENARIO( "Basic octree", "[Octree]" )
                                 {+1, +1, +1} };
             for (auto &point: points)
             {
-                rootNode.insert(point, intersect, maxDepth,  maxFill);
+                rootNode.insert(point, bounds, intersect, maxDepth,  maxFill);
             }
             THEN ("The root node is not a leaf")
             {
@@ -196,6 +201,90 @@ SCENARIO( "Basic octree", "[Octree]" )
                     REQUIRE(visitedChildren == visitedLeaves);
                 }
             }
+            AND_WHEN ("Computing the bounds of the children of the root node")
+            {
+                THEN ("Each corner point is at the center of a child")
+                {
+                    for (int i = 0; i < 8; ++i)
+                    {
+                        const AABCube childBounds = Node::getChildBounds(bounds, i);
+                        REQUIRE( childBounds.center.equalsTo(points[i]) );
+                        REQUIRE( childBounds.halfWidth == 1.0f );
+                    }
+                }
+            }
+            AND_WHEN ("Querying the children mask of the root node")
+            {
+                const unsigned childMask = rootNode.getChildMask();
+                THEN ("All 8 children exist")
+                {
+                    REQUIRE(childMask == 0xFFu);
+                    for (int i = 0; i < 8; ++i)
+                    {
+                        REQUIRE(rootNode.getChild(i) != nullptr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Octree subdivided top-down", "[Octree]" )
+{
+    GIVEN( "A root node holding a point in each corner and two at its center" )
+    {
+        using Node = OctreeNode<Point>;
+        const AABCube bounds{ Point(0.0f), 2.0f };
+        Node rootNode;
+        for (int i = 0; i < 8; ++i)
+        {
+            Point corner( (i & 1) ? 1.25f : -1.25f,
+                          (i & 2) ? 1.25f : -1.25f,
+                          (i & 4) ? 1.25f : -1.25f );
+            rootNode.insert(corner, bounds, intersect, 0);
+        }
+        Point center(0.0f);
+        rootNode.insert(center, bounds, intersect, 0);
+        rootNode.insert(center, bounds, intersect, 0);
+
+        WHEN( "Subdividing it while leaves hold more than 2 points" )
+        {
+            std::vector<std::size_t> rootChildCounts;
+            rootNode.subdivide(bounds, intersect,
+                [&](const AABCube &, int depth, std::size_t count, const std::size_t (&childCounts)[8])
+                {
+                    if (depth == 0)
+                        rootChildCounts.assign(childCounts, childCounts + 8);
+                    return count > 2 && depth < 4;
+                });
+
+            THEN( "The root is told that each child holds a corner and the center points" )
+            {
+                REQUIRE( rootChildCounts == std::vector<std::size_t>(8, 3) );
+            }
+            THEN( "The root has 8 children, split between their corner and center points" )
+            {
+                REQUIRE( !rootNode.isLeaf() );
+                REQUIRE( rootNode.getChildMask() == 0xFFu );
+                REQUIRE( rootNode.getElements().empty() );
+                for (int i = 0; i < 8; ++i)
+                {
+                    const Node &child = *rootNode.getChild(i);
+                    REQUIRE( !child.isLeaf() );
+                    REQUIRE( std::bitset<8>(child.getChildMask()).count() == 2 );
+                }
+            }
+        }
+        WHEN( "Subdividing it with a function always returning false" )
+        {
+            rootNode.subdivide(bounds, intersect,
+                [](const AABCube &, int, std::size_t, const std::size_t (&)[8]) { return false; });
+
+            THEN( "The root node is a leaf holding all points" )
+            {
+                REQUIRE( rootNode.isLeaf() );
+                REQUIRE( rootNode.getElements().size() == 10 );
+            }
         }
     }
 }
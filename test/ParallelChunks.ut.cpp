@@ -0,0 +1,100 @@
+#include <ParallelChunks.h>
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for the chunks of items processed on several threads.
+
+SCENARIO( "Chunks processed on several threads", "[ParallelChunks]" )
+{
+    GIVEN( "Items processed by chunks, recording the chunks and the threads" )
+    {
+        std::mutex mutex;
+        std::vector<std::pair<std::size_t, std::size_t>> chunks;
+        std::set<std::thread::id> threadIds;
+        const auto task = [&](std::size_t begin, std::size_t end)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            chunks.emplace_back(begin, end);
+            threadIds.insert(std::this_thread::get_id());
+        };
+
+        WHEN( "Splitting 10 items among 3 threads" )
+        {
+            forEachChunk(10, 3, task);
+
+            THEN( "Three contiguous chunks cover the items, the first on the calling thread" )
+            {
+                REQUIRE( chunks.size() == 3 );
+                REQUIRE( threadIds.size() == 3 );
+                REQUIRE( threadIds.count(std::this_thread::get_id()) == 1 );
+                std::size_t itemCount = 0;
+                for (const auto &chunk: chunks)
+                {
+                    REQUIRE( chunk.second - chunk.first >= 3 );
+                    REQUIRE( chunk.second - chunk.first <= 4 );
+                    itemCount += chunk.second - chunk.first;
+                }
+                REQUIRE( itemCount == 10 );
+            }
+        }
+
+        WHEN( "Splitting fewer items than threads" )
+        {
+            forEachChunk(2, 8, task);
+
+            THEN( "There is one chunk per item" )
+            {
+                REQUIRE( chunks.size() == 2 );
+                for (const auto &chunk: chunks)
+                    REQUIRE( chunk.second - chunk.first == 1 );
+            }
+        }
+
+        WHEN( "Splitting no item" )
+        {
+            forEachChunk(0, 4, task);
+
+            THEN( "A single empty chunk is processed on the calling thread" )
+            {
+                REQUIRE( chunks.size() == 1 );
+                REQUIRE( chunks[0].first == chunks[0].second );
+                REQUIRE( threadIds.count(std::this_thread::get_id()) == 1 );
+            }
+        }
+    }
+
+    GIVEN( "A task throwing on all chunks but the first" )
+    {
+        std::atomic<int> chunkCount(0);
+        const auto task = [&](std::size_t begin, std::size_t)
+        {
+            ++chunkCount;
+            if (begin > 0)
+                throw std::runtime_error("Chunk failed");
+        };
+
+        WHEN( "Splitting items among 4 threads" )
+        {
+            THEN( "The exception is rethrown once all chunks are processed" )
+            {
+                REQUIRE_THROWS_AS( forEachChunk(100, 4, task), std::runtime_error );
+                REQUIRE( chunkCount == 4 );
+            }
+        }
+    }
+}
+
+} // anonymous namespace
@@ -0,0 +1,156 @@
+#include <QueryTrace.h>
+#include <ClosestPointQuery.h>
+#include <catch.hpp>
+
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for cpom::QueryTraceRecorder and the mesh and trace formats.
+
+/// Mesh of a triangle and a quad side by side, the quad raised by a given height.
+class StubMixedMesh : public Mesh
+{
+public:
+    explicit StubMixedMesh(float height = 0.0f)
+    : m_height(height)
+    { }
+
+    virtual std::vector<Point> getVertices() const
+    {
+        return { Point(0.0f, 0.0f, 0.0f), Point(1.0f, 0.0f, 0.0f), Point(0.0f, 1.0f, 0.0f),
+                 Point(1.0f, 1.0f, m_height), Point(2.0f, 0.0f, m_height),
+                 Point(2.0f, 1.0f, m_height) };
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        return { { { 0, 1, 2 } }, { { 1, 4, 5, 3 } } };
+    }
+
+private:
+    float m_height;
+};
+
+SCENARIO( "Serialized meshes", "[QueryTrace]" )
+{
+    GIVEN( "A mesh of a triangle and a quad" )
+    {
+        const StubMixedMesh mesh;
+
+        WHEN( "Writing and reading it back" )
+        {
+            std::stringstream stream;
+            writeMesh(stream, mesh);
+            const MeshData copy = readMesh(stream);
+
+            THEN( "Its vertices, faces and fingerprint are preserved" )
+            {
+                const std::vector<Point> vertices = mesh.getVertices();
+                REQUIRE( copy.vertices.size() == vertices.size() );
+                for (std::size_t i = 0; i < vertices.size(); ++i)
+                    REQUIRE( copy.vertices[i] == vertices[i] );
+                REQUIRE( copy.faces.size() == 2 );
+                REQUIRE( copy.faces[0].vertexIds == mesh.getFaces()[0].vertexIds );
+                REQUIRE( copy.faces[1].vertexIds == mesh.getFaces()[1].vertexIds );
+                REQUIRE( computeMeshFingerprint(copy) == computeMeshFingerprint(mesh) );
+            }
+        }
+        WHEN( "Changing one of its vertices" )
+        {
+            THEN( "Its fingerprint changes" )
+            {
+                REQUIRE( computeMeshFingerprint(StubMixedMesh(0.5f)) !=
+                         computeMeshFingerprint(mesh) );
+            }
+        }
+        WHEN( "Reading a truncated copy" )
+        {
+            std::stringstream stream;
+            writeMesh(stream, mesh);
+            const std::string data = stream.str();
+            std::stringstream truncated(data.substr(0, data.size() - 2));
+
+            THEN( "An exception is thrown" )
+            {
+                REQUIRE_THROWS_AS( readMesh(truncated), std::invalid_argument );
+            }
+        }
+    }
+    GIVEN( "Data which is not a mesh" )
+    {
+        std::stringstream stream("This is not a mesh, but some text long enough.");
+
+        THEN( "Reading it throws an exception" )
+        {
+            REQUIRE_THROWS_AS( readMesh(stream), std::invalid_argument );
+        }
+    }
+}
+
+SCENARIO( "Recording query traces", "[QueryTrace]" )
+{
+    GIVEN( "A ClosestPointQuery recording its calls" )
+    {
+        const StubMixedMesh mesh;
+        std::stringstream stream;
+        QueryOptions queryOptions;
+        queryOptions.traceRecorder = std::make_shared<QueryTraceRecorder>(stream, mesh);
+        const ClosestPointQuery query(mesh, BuildOptions(), queryOptions);
+
+        WHEN( "Finding closest points one by one and in a batch" )
+        {
+            const Point single(0.2f, 0.2f, 1.0f);
+            query.find(single, 2.0f);
+            query(single, std::numeric_limits<float>::infinity());
+            const std::vector<Point> batch = { Point(1.5f, 0.5f, 1.0f), Point(0.1f, 0.1f, -1.0f),
+                                               Point(3.0f, 3.0f, 3.0f) };
+            std::vector<ClosestPointQuery::Result> results(batch.size());
+            query.find(batch.data(), batch.size(), 0.5f, results.data());
+            queryOptions.traceRecorder->flush();
+
+            THEN( "The trace holds each call, on the fingerprint of the mesh" )
+            {
+                const QueryTrace trace = readQueryTrace(stream);
+                REQUIRE( trace.meshFingerprint == computeMeshFingerprint(mesh) );
+                REQUIRE( trace.calls.size() == 3 );
+                REQUIRE( trace.points.size() == 5 );
+                REQUIRE( trace.calls[0].count == 1 );
+                REQUIRE( trace.calls[0].maxDist == 2.0f );
+                REQUIRE( trace.calls[1].maxDist == std::numeric_limits<float>::infinity() );
+                REQUIRE( trace.calls[2].begin == 2 );
+                REQUIRE( trace.calls[2].count == 3 );
+                REQUIRE( trace.calls[2].maxDist == 0.5f );
+                REQUIRE( trace.points[0] == single );
+                for (std::size_t i = 0; i < batch.size(); ++i)
+                    REQUIRE( trace.points[2 + i] == batch[i] );
+            }
+            THEN( "Replaying the trace on the mesh read back gives the same results" )
+            {
+                const QueryTrace trace = readQueryTrace(stream);
+                std::stringstream meshStream;
+                writeMesh(meshStream, mesh);
+                const ClosestPointQuery replay(readMesh(meshStream));
+                const QueryTrace::Call &call = trace.calls[2];
+                std::vector<ClosestPointQuery::Result> replayed(call.count);
+                replay.find(trace.points.data() + call.begin, call.count, call.maxDist,
+                            replayed.data());
+                for (std::size_t i = 0; i < batch.size(); ++i)
+                {
+                    REQUIRE( replayed[i].faceId == results[i].faceId );
+                    REQUIRE( replayed[i].distance == results[i].distance );
+                }
+            }
+        }
+    }
+}
+
+} // anonymous namespace
@@ -0,0 +1,574 @@
+#include <../src/SubdivisionPatch.h>
+#include <ClosestPointQuery.h>
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for cpom::buildCatmullClarkPatches and cpom::evaluatePatch.
+
+using PatchArray = std::vector<BicubicPatch, PolymorphicAllocator<BicubicPatch>>;
+using FaceIdArray = std::vector<std::uint32_t, PolymorphicAllocator<std::uint32_t>>;
+
+/// Relative size of the 1-ring under which faces are no longer subdivided.
+constexpr float tolerance = 1e-3f;
+
+/// Torus cage of N*M quads, all of its vertices having four faces around them.
+template<int N, int M>
+class StubTorusMesh : public Mesh
+{
+public:
+    static int vertexIndex(int i, int j)
+    {
+        return (i % N) + (j % M) * N;
+    }
+
+    virtual std::vector<Point> getVertices() const
+    {
+        const float pi = 3.14159265f;
+        std::vector<Point> vertices(N * M);
+        for (int j = 0; j < M; ++j)
+        {
+            for (int i = 0; i < N; ++i)
+            {
+                const float a = 2.0f * pi * i / N;
+                const float b = 2.0f * pi * j / M;
+                const float radius = 2.0f + 0.8f * std::cos(b);
+                vertices[vertexIndex(i, j)] = Point(radius * std::cos(a),
+                                                    radius * std::sin(a),
+                                                    0.8f * std::sin(b));
+            }
+        }
+        return vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces;
+        for (int j = 0; j < M; ++j)
+        {
+            for (int i = 0; i < N; ++i)
+            {
+                faces.push_back({ { vertexIndex(i, j), vertexIndex(i+1, j),
+                                    vertexIndex(i+1, j+1), vertexIndex(i, j+1) } });
+            }
+        }
+        return faces;
+    }
+};
+
+/// Mesh of given vertices and faces.
+class StubCageMesh : public Mesh
+{
+public:
+    StubCageMesh(const std::vector<Point> &vertices, const std::vector<Face> &faces)
+    : m_vertices(vertices),
+      m_faces(faces)
+    {}
+
+    virtual std::vector<Point> getVertices() const
+    {
+        return m_vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        return m_faces;
+    }
+
+private:
+    std::vector<Point> m_vertices;
+    std::vector<Face> m_faces;
+};
+
+/// Type describing the faces and edges around each vertex of a quad mesh.
+struct MeshRings
+{
+    /// Undirected edges, smallest vertex first, and the faces holding them.
+    std::map<std::pair<int, int>, std::vector<int>> edgeFaces;
+    /// Faces around each vertex.
+    std::vector<std::vector<int>> vertexFaces;
+    /// Vertices sharing an edge with each vertex, and those on a boundary edge.
+    std::vector<std::set<int>> neighbours;
+    std::vector<std::set<int>> boundaryNeighbours;
+
+    MeshRings(const std::vector<Point> &vertices, const std::vector<Face> &faces)
+    : vertexFaces(vertices.size()),
+      neighbours(vertices.size()),
+      boundaryNeighbours(vertices.size())
+    {
+        for (int f = 0; f < static_cast<int>(faces.size()); ++f)
+        {
+            const auto &ids = faces[f].vertexIds;
+            for (int k = 0; k < 4; ++k)
+            {
+                vertexFaces[ids[k]].push_back(f);
+                edgeFaces[edgeKey(ids[k], ids[(k+1) % 4])].push_back(f);
+            }
+        }
+        for (const auto &edge : edgeFaces)
+        {
+            neighbours[edge.first.first].insert(edge.first.second);
+            neighbours[edge.first.second].insert(edge.first.first);
+            if (edge.second.size() == 1)
+            {
+                boundaryNeighbours[edge.first.first].insert(edge.first.second);
+                boundaryNeighbours[edge.first.second].insert(edge.first.first);
+            }
+        }
+    }
+
+    static std::pair<int, int> edgeKey(int a, int b)
+    {
+        return std::make_pair(std::min(a, b), std::max(a, b));
+    }
+
+    bool isInterior(int vertex) const
+    {
+        return boundaryNeighbours[vertex].empty();
+    }
+
+    bool isSmoothBoundary(int vertex) const
+    {
+        return boundaryNeighbours[vertex].size() == 2 && vertexFaces[vertex].size() > 1;
+    }
+};
+
+Point computeCenter(const std::vector<Point> &vertices, const Face &face)
+{
+    Point center(0.0f);
+    for (const int vertexId : face.vertexIds)
+        center = center + vertices[vertexId] * 0.25f;
+    return center;
+}
+
+/// Subdivide a quad mesh once with the Catmull-Clark rules, boundary edges being
+/// split at their midpoint, and corners of a single face staying in place.
+void subdivide(std::vector<Point> &vertices, std::vector<Face> &faces)
+{
+    const MeshRings rings(vertices, faces);
+    std::vector<Point> facePoints;
+    for (const Face &face : faces)
+        facePoints.push_back(computeCenter(vertices, face));
+
+    std::vector<Point> subdivided;
+    for (std::size_t v = 0; v < vertices.size(); ++v)
+    {
+        const Point &vertex = vertices[v];
+        const float n = static_cast<float>(rings.vertexFaces[v].size());
+        Point next = vertex;
+        if (rings.isInterior(v))
+        {
+            Point q(0.0f);
+            for (const int f : rings.vertexFaces[v])
+                q = q + facePoints[f] / n;
+            Point r(0.0f);
+            for (const int neighbour : rings.neighbours[v])
+                r = r + (vertex + vertices[neighbour]) * (0.5f / n);
+            next = (q + r * 2.0f + vertex * (n - 3.0f)) / n;
+        }
+        else if (rings.isSmoothBoundary(v))
+        {
+            next = vertex * 0.75f;
+            for (const int neighbour : rings.boundaryNeighbours[v])
+                next = next + vertices[neighbour] * 0.125f;
+        }
+        subdivided.push_back(next);
+    }
+    const int firstFacePoint = static_cast<int>(subdivided.size());
+    subdivided.insert(subdivided.end(), facePoints.begin(), facePoints.end());
+    std::map<std::pair<int, int>, int> edgePoints;
+    for (const auto &edge : rings.edgeFaces)
+    {
+        edgePoints[edge.first] = static_cast<int>(subdivided.size());
+        const Point midpoint = (vertices[edge.first.first] + vertices[edge.first.second]) * 0.5f;
+        if (edge.second.size() == 2)
+            subdivided.push_back((midpoint + (facePoints[edge.second[0]] +
+                                              facePoints[edge.second[1]]) * 0.5f) * 0.5f);
+        else
+            subdivided.push_back(midpoint);
+    }
+
+    std::vector<Face> children;
+    for (int f = 0; f < static_cast<int>(faces.size()); ++f)
+    {
+        const auto &ids = faces[f].vertexIds;
+        for (int k = 0; k < 4; ++k)
+        {
+            children.push_back({ { ids[k],
+                                   edgePoints[MeshRings::edgeKey(ids[k], ids[(k+1) % 4])],
+                                   firstFacePoint + f,
+                                   edgePoints[MeshRings::edgeKey(ids[(k+3) % 4], ids[k])] } });
+        }
+    }
+    vertices.swap(subdivided);
+    faces.swap(children);
+}
+
+/// Move the vertices of a quad mesh to their limit positions.
+void moveToLimit(std::vector<Point> &vertices, const std::vector<Face> &faces)
+{
+    const MeshRings rings(vertices, faces);
+    std::vector<Point> limits(vertices);
+    for (std::size_t v = 0; v < vertices.size(); ++v)
+    {
+        const float n = static_cast<float>(rings.vertexFaces[v].size());
+        if (rings.isInterior(v))
+        {
+            Point sum = vertices[v] * (n * n);
+            for (const int neighbour : rings.neighbours[v])
+                sum = sum + vertices[neighbour] * 4.0f;
+            for (const int f : rings.vertexFaces[v])
+            {
+                const auto &ids = faces[f].vertexIds;
+                const int k = static_cast<int>(std::find(ids.begin(), ids.end(), v) - ids.begin());
+                sum = sum + vertices[ids[(k+2) % 4]];
+            }
+            limits[v] = sum / (n * (n + 5.0f));
+        }
+        else if (rings.isSmoothBoundary(v))
+        {
+            limits[v] = vertices[v] * (4.0f / 6.0f);
+            for (const int neighbour : rings.boundaryNeighbours[v])
+                limits[v] = limits[v] + vertices[neighbour] / 6.0f;
+        }
+    }
+    vertices.swap(limits);
+}
+
+/// \brief Return the largest difference between the distances to the limit surface
+/// of a cage, and to its densely subdivided mesh, from positions around each vertex.
+float compareWithSubdividedCage(const std::vector<Point> &vertices,
+                                const std::vector<Face> &faces,
+                                const BuildOptions &limitOptions)
+{
+    const ClosestPointQuery limitQuery(StubCageMesh(vertices, faces), limitOptions);
+    std::vector<Point> denseVertices(vertices);
+    std::vector<Face> denseFaces(faces);
+    for (int level = 0; level < 5; ++level)
+        subdivide(denseVertices, denseFaces);
+    moveToLimit(denseVertices, denseFaces);
+    const ClosestPointQuery denseQuery(StubCageMesh(denseVertices, denseFaces));
+
+    float maxDifference = 0.0f;
+    for (const Point &vertex : vertices)
+    {
+        for (const Float3 &offset : { Float3(0.0f), Float3(0.1f, 0.05f, 0.3f),
+                                      Float3(-0.2f, 0.1f, -0.25f), Float3(0.15f, -0.3f, 0.0f) })
+        {
+            const Point position = vertex + offset;
+            const auto limitResult = limitQuery.find(position, 10.0f);
+            const auto denseResult = denseQuery.find(position, 10.0f);
+            maxDifference = std::max(maxDifference,
+                                     std::abs(limitResult.distance - denseResult.distance));
+        }
+    }
+    return maxDifference;
+}
+
+SCENARIO( "Bicubic patches", "[Subdivision]" )
+{
+    GIVEN( "A patch with uneven control points" )
+    {
+        BicubicPatch patch;
+        for (int j = 0; j < 4; ++j)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                const float height = static_cast<float>((i * 5 + j * 3) % 7) * 0.1f;
+                patch.controlPoints[j][i] = Point(static_cast<float>(i), static_cast<float>(j),
+                                                  height);
+            }
+        }
+
+        WHEN( "Evaluating it" )
+        {
+            const float u = 0.3f;
+            const float v = 0.6f;
+            const float h = 1e-2f;
+            const PatchSample sample = evaluatePatch(patch, u, v);
+
+            THEN( "Derivatives match finite differences of the positions" )
+            {
+                const auto position = [&patch](float s, float t)
+                {
+                    return evaluatePatch(patch, s, t).position;
+                };
+                const auto derivative = [&patch](float s, float t, bool alongU)
+                {
+                    const PatchSample other = evaluatePatch(patch, s, t);
+                    return alongU ? other.du : other.dv;
+                };
+                const Float3 du = (position(u + h, v) - position(u - h, v)) / (2.0f * h);
+                const Float3 dv = (position(u, v + h) - position(u, v - h)) / (2.0f * h);
+                const Float3 duu = (derivative(u + h, v, true) - derivative(u - h, v, true)) / (2.0f * h);
+                const Float3 duv = (derivative(u, v + h, true) - derivative(u, v - h, true)) / (2.0f * h);
+                const Float3 dvv = (derivative(u, v + h, false) - derivative(u, v - h, false)) / (2.0f * h);
+                REQUIRE( (sample.du - du).length() < 1e-3f );
+                REQUIRE( (sample.dv - dv).length() < 1e-3f );
+                REQUIRE( (sample.duu - duu).length() < 1e-3f );
+                REQUIRE( (sample.duv - duv).length() < 1e-3f );
+                REQUIRE( (sample.dvv - dvv).length() < 1e-3f );
+            }
+        }
+    }
+}
+
+SCENARIO( "Catmull-Clark patches", "[Subdivision]" )
+{
+    GIVEN( "A cage of a single quad" )
+    {
+        const std::vector<Point> vertices = { Point(0.0f, 0.0f, 0.0f),
+                                              Point(1.0f, 0.0f, 0.0f),
+                                              Point(1.0f, 1.0f, 0.5f),
+                                              Point(0.0f, 1.0f, 0.0f) };
+        const std::vector<Face> faces = { { { 0, 1, 2, 3 } } };
+
+        WHEN( "Building its patches" )
+        {
+            PatchArray patches;
+            FaceIdArray faceIds;
+            buildCatmullClarkPatches(faces, vertices, tolerance, patches, faceIds);
+
+            THEN( "Its patch is the bilinear patch through its corners" )
+            {
+                REQUIRE( patches.size() == 1 );
+                REQUIRE( (evaluatePatch(patches[0], 0.0f, 0.0f).position - vertices[0]).length() < 1e-6f );
+                REQUIRE( (evaluatePatch(patches[0], 1.0f, 1.0f).position - vertices[2]).length() < 1e-6f );
+                const Point center = (vertices[0] + vertices[1] + vertices[2] + vertices[3]) * 0.25f;
+                REQUIRE( (evaluatePatch(patches[0], 0.5f, 0.5f).position - center).length() < 1e-6f );
+            }
+        }
+    }
+
+    GIVEN( "A torus cage of quads" )
+    {
+        constexpr int n = 8;
+        constexpr int m = 6;
+        const StubTorusMesh<n, m> mesh;
+        const std::vector<Point> vertices = mesh.getVertices();
+        const std::vector<Face> faces = mesh.getFaces();
+
+        WHEN( "Building its patches" )
+        {
+            PatchArray patches;
+            FaceIdArray faceIds;
+            buildCatmullClarkPatches(faces, vertices, tolerance, patches, faceIds);
+
+            THEN( "Corners of patches are at the limit positions of regular vertices" )
+            {
+                REQUIRE( patches.size() == faces.size() );
+                const auto v = [&vertices](int i, int j)
+                {
+                    return vertices[StubTorusMesh<n, m>::vertexIndex(i + n, j + m)];
+                };
+                const Point edges = v(1, 3) + v(3, 3) + v(2, 2) + v(2, 4);
+                const Point diagonals = v(1, 2) + v(3, 2) + v(1, 4) + v(3, 4);
+                const Point limit = (v(2, 3) * 16.0f + edges * 4.0f + diagonals) / 36.0f;
+                const int face = 2 + 3 * n;
+                REQUIRE( (evaluatePatch(patches[face], 0.0f, 0.0f).position - limit).length() < 1e-5f );
+            }
+            THEN( "Adjacent patches join along their shared side" )
+            {
+                for (int j = 0; j < m; ++j)
+                {
+                    for (int i = 0; i < n; ++i)
+                    {
+                        const BicubicPatch &patch = patches[i + j * n];
+                        const BicubicPatch &right = patches[(i + 1) % n + j * n];
+                        const BicubicPatch &above = patches[i + ((j + 1) % m) * n];
+                        for (const float t : { 0.0f, 0.25f, 0.7f, 1.0f })
+                        {
+                            REQUIRE( (evaluatePatch(patch, 1.0f, t).position -
+                                      evaluatePatch(right, 0.0f, t).position).length() < 1e-5f );
+                            REQUIRE( (evaluatePatch(patch, t, 1.0f).position -
+                                      evaluatePatch(above, t, 0.0f).position).length() < 1e-5f );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN( "A cage with a triangle" )
+    {
+        const std::vector<Point> vertices = { Point(0.0f), Point(1.0f, 0.0f, 0.0f),
+                                              Point(0.0f, 1.0f, 0.0f) };
+        const std::vector<Face> faces = { { { 0, 1, 2 } } };
+
+        WHEN( "Building its patches" )
+        {
+            THEN( "An exception is thrown" )
+            {
+                PatchArray patches;
+                FaceIdArray faceIds;
+                REQUIRE_THROWS_AS( buildCatmullClarkPatches(faces, vertices, tolerance,
+                                                            patches, faceIds),
+                                   std::invalid_argument );
+            }
+        }
+    }
+}
+
+SCENARIO( "Closest points on limit surfaces", "[Subdivision]" )
+{
+    GIVEN( "A torus cage and a ClosestPointQuery on its limit surface per index type" )
+    {
+        constexpr int n = 8;
+        constexpr int m = 6;
+        const StubTorusMesh<n, m> mesh;
+        PatchArray patches;
+        FaceIdArray faceIds;
+        buildCatmullClarkPatches(mesh.getFaces(), mesh.getVertices(), tolerance, patches,
+                                 faceIds);
+        std::vector<ClosestPointQuery> queries;
+        for (const IndexType indexType : { IndexType::Octree, IndexType::WideBvh4,
+                                           IndexType::WideBvh8 })
+        {
+            BuildOptions options;
+            options.indexType = indexType;
+            options.surfaceType = SurfaceType::CatmullClarkLimit;
+            queries.push_back(ClosestPointQuery(mesh, options));
+        }
+
+        WHEN( "Finding the closest points from positions around the torus" )
+        {
+            THEN( "They are as close as the closest samples of the patches" )
+            {
+                for (int i = 0; i < 12; ++i)
+                {
+                    const Point position(std::cos(i * 0.9f) * (1.0f + 0.25f * (i % 5)),
+                                         std::sin(i * 0.9f) * (1.0f + 0.25f * (i % 5)),
+                                         0.3f * (i % 3) - 0.2f);
+                    constexpr int sampleCount = 32;
+                    float sampledDistance = std::numeric_limits<float>::infinity();
+                    for (const BicubicPatch &patch : patches)
+                    {
+                        for (int t = 0; t <= sampleCount; ++t)
+                        {
+                            for (int s = 0; s <= sampleCount; ++s)
+                            {
+                                const Point sample = evaluatePatch(patch,
+                                    static_cast<float>(s) / sampleCount,
+                                    static_cast<float>(t) / sampleCount).position;
+                                sampledDistance = std::min(sampledDistance,
+                                                           (sample - position).length());
+                            }
+                        }
+                    }
+                    for (const ClosestPointQuery &query : queries)
+                    {
+                        const auto result = query.find(position, 10.0f);
+                        CAPTURE( position );
+                        REQUIRE( result.faceId >= 0 );
+                        REQUIRE( result.distance <= sampledDistance + 1e-5f );
+                        REQUIRE( result.distance >= sampledDistance - 1e-2f );
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "Closest points on limit surfaces around extraordinary vertices", "[Subdivision]" )
+{
+    GIVEN( "A cube cage, all of its vertices having three faces around them" )
+    {
+        const std::vector<Point> vertices = { Point(-1.0f, -1.0f, -1.0f), Point(1.0f, -1.0f, -1.0f),
+                                              Point(1.0f, 1.0f, -1.0f), Point(-1.0f, 1.0f, -1.0f),
+                                              Point(-1.0f, -1.0f, 1.0f), Point(1.0f, -1.0f, 1.0f),
+                                              Point(1.0f, 1.0f, 1.0f), Point(-1.0f, 1.0f, 1.0f) };
+        const std::vector<Face> faces = { { { 0, 3, 2, 1 } }, { { 4, 5, 6, 7 } },
+                                          { { 0, 1, 5, 4 } }, { { 1, 2, 6, 5 } },
+                                          { { 2, 3, 7, 6 } }, { { 3, 0, 4, 7 } } };
+
+        WHEN( "Finding closest points around its vertices" )
+        {
+            BuildOptions options;
+            options.surfaceType = SurfaceType::CatmullClarkLimit;
+
+            THEN( "Their distances match those to the densely subdivided cage" )
+            {
+                REQUIRE( compareWithSubdividedCage(vertices, faces, options) < 1e-3f );
+            }
+        }
+    }
+
+    GIVEN( "An open cage around an interior vertex of five faces, with a boundary "
+           "vertex of three faces and corners" )
+    {
+        // Five sectors of 2x2 quads around the center, vertex (r, s) of sector i
+        // being at r e_i + s e_i+1. The outer quad of the first sector is missing.
+        const float pi = 3.14159265f;
+        std::vector<Point> vertices(1, Point(0.0f, 0.0f, 0.3f));
+        const auto addVertex = [&vertices](float x, float y)
+        {
+            vertices.push_back(Point(x, y, 0.3f * std::cos(1.3f * x) * std::cos(0.9f * y)));
+            return static_cast<int>(vertices.size()) - 1;
+        };
+        int spokes[5][3];
+        for (int i = 0; i < 5; ++i)
+        {
+            spokes[i][0] = 0;
+            for (int r = 1; r < 3; ++r)
+                spokes[i][r] = addVertex(0.6f * r * std::cos(2.0f * pi * i / 5),
+                                         0.6f * r * std::sin(2.0f * pi * i / 5));
+        }
+        std::vector<Face> faces;
+        for (int i = 0; i < 5; ++i)
+        {
+            const int j = (i + 1) % 5;
+            int grid[3][3];
+            for (int r = 0; r < 3; ++r)
+            {
+                grid[r][0] = spokes[i][r];
+                grid[0][r] = spokes[j][r];
+            }
+            for (int r = 1; r < 3; ++r)
+            {
+                for (int s = 1; s < 3; ++s)
+                {
+                    if (i == 0 && r == 2 && s == 2)
+                        continue;
+                    const Point position = vertices[spokes[i][r]] + vertices[spokes[j][s]];
+                    grid[r][s] = addVertex(position.x, position.y);
+                }
+            }
+            for (int r = 0; r < 2; ++r)
+            {
+                for (int s = 0; s < 2; ++s)
+                {
+                    if (i == 0 && r == 1 && s == 1)
+                        continue;
+                    faces.push_back({ { grid[r][s], grid[r+1][s], grid[r+1][s+1],
+                                        grid[r][s+1] } });
+                }
+            }
+        }
+
+        WHEN( "Finding closest points around its vertices" )
+        {
+            BuildOptions options;
+            options.surfaceType = SurfaceType::CatmullClarkLimit;
+
+            THEN( "Their distances match those to the densely subdivided cage" )
+            {
+                REQUIRE( compareWithSubdividedCage(vertices, faces, options) < 1e-3f );
+            }
+        }
+    }
+}
+
+} // anonymous namespace
@@ -0,0 +1,163 @@
+#include <Tracing.h>
+#include <ClosestPointQuery.h>
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for the trace spans of cpom, recorded if built with CPOM_ENABLE_TRACING.
+
+/// Plane of R*R quads, enough for the index to partition space.
+template<int R>
+class StubGridMesh : public Mesh
+{
+public:
+    virtual std::vector<Point> getVertices() const
+    {
+        std::vector<Point> vertices;
+        for (int y = 0; y <= R; ++y)
+            for (int x = 0; x <= R; ++x)
+                vertices.push_back(Point(static_cast<float>(x), static_cast<float>(y), 0.0f));
+        return vertices;
+    }
+
+    virtual std::vector<Face> getFaces() const
+    {
+        std::vector<Face> faces;
+        for (int y = 0; y < R; ++y)
+        {
+            for (int x = 0; x < R; ++x)
+            {
+                const int v = x + y * (R+1);
+                faces.push_back({ { v, v + 1, v + R + 2, v + R + 1 } });
+            }
+        }
+        return faces;
+    }
+};
+
+/// Return the number of occurrences of a string in another.
+std::size_t countOccurrences(const std::string &text, const std::string &pattern)
+{
+    std::size_t count = 0;
+    for (std::size_t i = text.find(pattern); i != std::string::npos; i = text.find(pattern, i + 1))
+        ++count;
+    return count;
+}
+
+SCENARIO( "Trace spans", "[Tracing]" )
+{
+    GIVEN( "A mesh indexed and queried in a batch while tracing" )
+    {
+        const StubGridMesh<10> mesh;
+        const std::vector<Point> points = { Point(0.5f, 0.5f, 1.0f), Point(3.2f, 7.1f, -1.0f) };
+        std::vector<ClosestPointQuery::Result> results(points.size());
+
+        startTracing();
+        const ClosestPointQuery query(mesh);
+        query.find(points.data(), points.size(), 10.0f, results.data());
+        stopTracing();
+        query.find(points.data(), points.size(), 10.0f, results.data());
+
+        WHEN( "Writing the trace events" )
+        {
+            std::ostringstream stream;
+            writeTraceEvents(stream);
+            const std::string json = stream.str();
+
+            THEN( "They hold the phases of the build and the batch recorded, if tracing is available" )
+            {
+                REQUIRE( json.find("{\"traceEvents\":[") == 0 );
+                if (isTracingAvailable())
+                {
+                    REQUIRE( countOccurrences(json, "\"name\":\"build index\"") == 1 );
+                    REQUIRE( countOccurrences(json, "\"name\":\"copy mesh\"") == 1 );
+                    REQUIRE( countOccurrences(json, "\"name\":\"insert faces\"") == 1 );
+                    REQUIRE( countOccurrences(json, "\"name\":\"flatten octree\"") == 1 );
+                    REQUIRE( countOccurrences(json, "\"name\":\"find batch\"") == 1 );
+                    REQUIRE( json.find("\"args\":{\"count\":2}") != std::string::npos );
+                }
+                else
+                {
+                    REQUIRE( json.find("\"name\"") == std::string::npos );
+                }
+            }
+        }
+    }
+    GIVEN( "A mesh queried in a batch split among three threads while tracing" )
+    {
+        const StubGridMesh<10> mesh;
+        const ClosestPointQuery query(mesh);
+        const std::vector<Point> points(6, Point(1.0f, 1.0f, 1.0f));
+        std::vector<ClosestPointQuery::Result> results(points.size());
+
+        startTracing();
+        query.find(points.data(), points.size(), 10.0f, results.data(), 3);
+        stopTracing();
+
+        WHEN( "Writing the trace events" )
+        {
+            std::ostringstream stream;
+            writeTraceEvents(stream);
+            const std::string json = stream.str();
+
+            THEN( "Each chunk is recorded with its batch, if tracing is available" )
+            {
+                if (isTracingAvailable())
+                {
+                    REQUIRE( countOccurrences(json, "\"name\":\"find chunk\"") == 3 );
+                    REQUIRE( countOccurrences(json, "\"name\":\"find batch\"") == 3 );
+                    REQUIRE( countOccurrences(json, "\"args\":{\"count\":2}") == 6 );
+                }
+                else
+                {
+                    REQUIRE( json.find("\"name\"") == std::string::npos );
+                }
+            }
+        }
+    }
+    GIVEN( "A ring buffer of two spans" )
+    {
+        const StubGridMesh<10> mesh;
+        const ClosestPointQuery query(mesh);
+        std::vector<ClosestPointQuery::Result> results(5);
+        const std::vector<Point> points(5, Point(1.0f, 1.0f, 1.0f));
+
+        startTracing(2);
+        for (std::size_t count = 1; count <= 4; ++count)
+            query.find(points.data(), count, 10.0f, results.data());
+        stopTracing();
+
+        WHEN( "Writing the trace events" )
+        {
+            std::ostringstream stream;
+            writeTraceEvents(stream);
+            const std::string json = stream.str();
+
+            THEN( "Only the last spans are kept, oldest first" )
+            {
+                if (isTracingAvailable())
+                {
+                    REQUIRE( countOccurrences(json, "\"name\":\"find batch\"") == 2 );
+                    const std::size_t third = json.find("\"count\":3");
+                    const std::size_t fourth = json.find("\"count\":4");
+                    REQUIRE( third != std::string::npos );
+                    REQUIRE( fourth != std::string::npos );
+                    REQUIRE( third < fourth );
+                }
+                else
+                {
+                    REQUIRE( json.find("\"name\"") == std::string::npos );
+                }
+            }
+        }
+    }
+}
+
+} // anonymous namespace
@@ -0,0 +1,107 @@
+#include <../src/WideBvh.h>
+#include <catch.hpp>
+
+#include <functional>
+#include <vector>
+
+using namespace cpom;
+
+namespace {
+
+/// \file
+/// Unit test for cpom::WideBvh.
+
+SCENARIO( "Wide bounding volume hierarchy", "[WideBvh]" )
+{
+    using Hierarchy = WideBvh<int, 4>;
+
+    GIVEN( "A set of points on a grid" )
+    {
+        std::vector<int> elements;
+        std::vector<AABBox> bounds;
+        for (int z = 0; z < 10; ++z)
+        {
+            for (int y = 0; y < 10; ++y)
+            {
+                for (int x = 0; x < 10; ++x)
+                {
+                    elements.push_back(static_cast<int>(elements.size()));
+                    bounds.push_back(AABBox{ Point(x, y, z), Float3(0.0f) });
+                }
+            }
+        }
+
+        WHEN( "Constructing a WideBvh over them" )
+        {
+            const Hierarchy hierarchy(elements, bounds);
+
+            int leafCount = 0;
+            int maxLeafSize = 0;
+            bool boundsEncloseElements = true;
+            std::vector<int> visitCount(elements.size(), 0);
+
+            // Walk all nodes and leaves from the root.
+            std::function<void(std::uint32_t)> visitNode = [&](std::uint32_t nodeIndex)
+            {
+                const auto &node = hierarchy.getNode(nodeIndex);
+                for (int slot = 0; slot < 4; ++slot)
+                {
+                    const std::uint32_t ref = node.child[slot];
+                    if (node.minX[slot] > node.maxX[slot])
+                        continue;
+                    if (!Hierarchy::isLeafRef(ref))
+                    {
+                        visitNode(Hierarchy::getRefIndex(ref));
+                        continue;
+                    }
+                    ++leafCount;
+                    maxLeafSize = std::max(maxLeafSize, int(node.elementCount[slot]));
+                    const std::uint32_t first = Hierarchy::getRefIndex(ref);
+                    for (std::uint32_t i = first; i < first + node.elementCount[slot]; ++i)
+                    {
+                        const int element = hierarchy.getElement(i);
+                        ++visitCount[element];
+                        const Point &p = bounds[element].center;
+                        boundsEncloseElements &= p.x >= node.minX[slot] && p.x <= node.maxX[slot] &&
+                                                 p.y >= node.minY[slot] && p.y <= node.maxY[slot] &&
+                                                 p.z >= node.minZ[slot] && p.z <= node.maxZ[slot];
+                    }
+                }
+            };
+            visitNode(0);
+
+            THEN( "Each element is referenced by exactly one leaf" )
+            {
+                REQUIRE( hierarchy.getElements().size() == elements.size() );
+                REQUIRE( std::count(visitCount.begin(), visitCount.end(), 1) ==
+                         static_cast<long>(elements.size()) );
+            }
+            THEN( "Leaves hold at most 4 elements" )
+            {
+                REQUIRE( maxLeafSize <= Hierarchy::leafCapacity );
+                REQUIRE( leafCount * Hierarchy::leafCapacity >= static_cast<int>(elements.size()) );
+            }
+            THEN( "Children bounds enclose their elements" )
+            {
+                REQUIRE( boundsEncloseElements );
+            }
+        }
+    }
+
+    GIVEN( "No element" )
+    {
+        WHEN( "Constructing a WideBvh" )
+        {
+            const std::vector<int> elements;
+            const std::vector<AABBox> bounds;
+            const Hierarchy hierarchy(elements, bounds);
+
+            THEN( "The hierarchy is empty" )
+            {
+                REQUIRE( hierarchy.empty() );
+            }
+        }
+    }
+}
+
+} // anonymous namespace